@@ -1,5 +1,7 @@
 import sys
 import os
+import threading
+import time
 sys.path.append(os.path.join(os.path.dirname(__file__), 'tiny-ml'))
 
 from flask import Flask, request, jsonify
@@ -13,7 +15,7 @@ from tinygrad.helpers import getenv
 from tinygrad.nn.state import safe_load, get_state_dict
 
 from model import ChessNet
-from mcts import MCTSNode, mcts_alphazero
+from mcts import MCTSNode, mcts_alphazero, find_subtree
 from chess_helpers.cpp import chess_engine as cpp_engine
 from chess_helpers.game_logic import get_board_planes
 
@@ -24,6 +26,11 @@ class ChessBot:
     def __init__(self, model_path="tiny-ml/models/chess_net_checkpoint.safetensors"):
         self.board = chess.Board() # For python-chess compatibility if needed elsewhere
         self.model = self._load_model(model_path)
+        self.search_tree = None # Root of the last search, reused by the next request
+        self.ponder_thread = None # Background search of the position after our last move
+        self.ponder_stop = threading.Event()
+        # BOOK=path/to/book.bin answers book positions without searching
+        self.book = cpp_engine.OpeningBook(getenv("BOOK", "")) if getenv("BOOK", "") else None
         Tensor.training = False # Set model to evaluation mode
 
     def _load_model(self, model_path):
@@ -47,14 +54,41 @@ class ChessBot:
 
     def reset_board(self):
         """Reset the chess board to starting position"""
+        self.stop_pondering()
         self.board.reset()
+        self.search_tree = None
 
-    def get_best_move(self, fen):
+    def stop_pondering(self):
+        """Finish the background search before the tree is used again"""
+        if self.ponder_thread is not None:
+            self.ponder_stop.set()
+            self.ponder_thread.join()
+            self.ponder_thread = None
+
+    def start_pondering(self, node, parent_board):
+        """
+        Keep searching the position after our move while the opponent thinks; whichever
+        reply they pick, its subtree has grown by the time the next request finds it.
+        """
+        self.ponder_stop.clear()
+        history = [get_board_planes(node.board), get_board_planes(parent_board)]
+        self.ponder_thread = threading.Thread(
+            target=mcts_alphazero,
+            args=(self.model, node, history),
+            kwargs={"num_simulations": getenv("PONDER_SIMS", 20000), "dirichlet_epsilon": 0.0,
+                    "stop_event": self.ponder_stop},
+            daemon=True)
+        self.ponder_thread.start()
+
+    def get_best_move(self, fen, limits=None):
         """
         Get the best move from the AlphaZero model using MCTS.
+        `limits` (a chess_engine.SearchLimits) bounds the thinking time; without a movetime
+        or clock the search runs SIMS simulations, or MOVETIME milliseconds if that is set.
         """
         if self.model is None:
             raise Exception("Model is not loaded.")
+        self.stop_pondering()
 
         # 1. Set up the board in our C++ engine
         ai_board = cpp_engine.ChessBitboard()
@@ -63,29 +97,62 @@ class ChessBot:
         if ai_board.is_game_over():
             return None
 
+        if self.book is not None:
+            book_move = self.book.pick(ai_board)
+            if book_move is not None:
+                print("Book move")
+                self.search_tree = None
+                return self._move_to_dict(book_move)
+
         # 2. Run MCTS to find the best move
         print("AI is thinking...")
-        root_node = MCTSNode(board=ai_board)
+        # Continue from the previous search if this position is in its tree
+        # (normally our last move followed by the opponent's reply)
+        root_node = find_subtree(self.search_tree, ai_board) or MCTSNode(board=ai_board)
         
         num_simulations = getenv("SIMS", 800)
-        
+        if limits is None:
+            limits = cpp_engine.SearchLimits()
+        if not limits.timed():
+            limits.movetime_ms = getenv("MOVETIME", 0)
+        time_budget_ms = None
+        if limits.timed():
+            # A clock makes the simulation count a cap rather than a target
+            time_manager = cpp_engine.TimeManager()
+            time_manager.start(limits)
+            time_budget_ms = time_manager.optimum_ms()
+            num_simulations = getenv("MAX_SIMS", 1000000)
+
         current_planes = get_board_planes(ai_board)
         board_plane_history = [current_planes]
 
+        start_visits = root_node.visit_count
+        start_time = time.perf_counter()
         best_child_node = mcts_alphazero(
             self.model,
             root_node,
             board_plane_history,
             num_simulations=num_simulations,
-            dirichlet_epsilon=0.0
+            dirichlet_epsilon=0.0,
+            time_budget_ms=time_budget_ms,
+            early_stop=bool(getenv("EARLY_STOP", 1))
         )
-        
+        print(f"Searched {root_node.visit_count - start_visits} simulations in "
+              f"{(time.perf_counter() - start_time) * 1000:.0f} ms"
+              + (f" (budget {time_budget_ms} ms)" if time_budget_ms is not None else ""))
+
         if best_child_node is None:
+            self.search_tree = None
             return None
+        self.search_tree = root_node
+        if getenv("PONDER", 0):
+            self.start_pondering(best_child_node, ai_board)
 
         # 3. Convert move to UCI format for the frontend
-        move = best_child_node.move
-        
+        return self._move_to_dict(best_child_node.move)
+
+    def _move_to_dict(self, move):
+        """from/to/promotion of an engine move, as the frontend expects it"""
         from_sq = move.get_from()
         to_sq = move.get_to()
         
@@ -121,13 +188,20 @@ def handle_move():
 
         bot.board.set_fen(fen)
 
+        # Optional time control for this move, in milliseconds
+        limits = cpp_engine.SearchLimits()
+        limits.movetime_ms = int(data.get('movetime_ms') or 0)
+        limits.time_left_ms = int(data.get('time_left_ms') or 0)
+        limits.increment_ms = int(data.get('increment_ms') or 0)
+        limits.moves_to_go = int(data.get('moves_to_go') or 0)
+
         if bot.board.is_game_over():
              return jsonify({
                 "message": "Game is over",
                 "game_over": True
             })
 
-        ai_move = bot.get_best_move(fen)
+        ai_move = bot.get_best_move(fen, limits)
         
         if ai_move is None:
             return jsonify({
@@ -229,5 +303,8 @@ if __name__ == '__main__':
     print("📡 Server will run on http://localhost:8080")
     print("🎯 Frontend should connect to: http://localhost:8080/api/move")
     print("💡 AI strength can be configured with the 'SIMS' environment variable.")
+    print("📖 BOOK=book.bin plays opening-book moves without searching.")
+    print("⏱️  MOVETIME (ms) or per-request movetime_ms / time_left_ms / increment_ms bound the thinking time;")
+    print("   EARLY_STOP=0 always uses the whole budget, PONDER=1 thinks on the opponent's time.")
     
     app.run(host='0.0.0.0', port=8080, debug=True) 
\ No newline at end of file
@@ -0,0 +1,80 @@
+"""
+Native MCTS throughput versus search threads.
+
+Runs chess_engine.MCTS from a few fixed positions for every combination of THREADS and
+BATCHES and prints simulations per second, then the tree memory of a single search. Uses the native network on the training
+checkpoint when it exists (NETWORK=0 forces the hand-crafted evaluator, which is cheap
+enough that tree contention dominates).
+
+    python bench_mcts.py                # SIMS=800 THREADS=1,2,4,8 BATCHES=8,32
+    SIMS=1000000 THREADS=1 python bench_mcts.py
+"""
+import os
+import sys
+import time
+
+from tinygrad.helpers import getenv
+
+sys.path.append(os.path.join(os.path.dirname(__file__), '..'))
+from chess_helpers.cpp import chess_engine
+
+CHECKPOINT_PATH = "models/chess_net_checkpoint.safetensors"
+POSITIONS = [
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+    "r3k2r/pPppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+]
+
+def make_config(simulations, threads, batch_size):
+    config = chess_engine.MCTSConfig()
+    config.num_simulations = simulations
+    config.threads = threads
+    config.batch_size = batch_size
+    config.reuse_tree = False
+    return config
+
+def simulations_per_second(evaluator, simulations, threads, batch_size):
+    config = make_config(simulations, threads, batch_size)
+    board = chess_engine.ChessBitboard()
+    elapsed = 0.0
+    for fen in POSITIONS:
+        board.load_fen(fen)
+        mcts = chess_engine.MCTS(evaluator, config)
+        start = time.perf_counter()
+        mcts.search(board)
+        elapsed += time.perf_counter() - start
+    return simulations * len(POSITIONS) / elapsed
+
+if __name__ == "__main__":
+    simulations = getenv("SIMS", 800)
+    thread_counts = [int(t) for t in getenv("THREADS", "1,2,4,8").split(",")]
+    batch_sizes = [int(b) for b in getenv("BATCHES", "8,32").split(",")]
+
+    if getenv("NETWORK", 1) and os.path.exists(CHECKPOINT_PATH):
+        evaluator = chess_engine.NetworkEvaluator(CHECKPOINT_PATH)
+        print(f"Evaluator: native ChessNet ({CHECKPOINT_PATH})")
+    else:
+        evaluator = chess_engine.HandcraftedEvaluator()
+        print("Evaluator: hand-crafted")
+    print(f"{simulations} simulations from {len(POSITIONS)} positions, {os.cpu_count()} CPUs")
+
+    print(f"{'threads':>7}" + "".join(f"{f'batch {b} sims/s':>22}" for b in batch_sizes))
+    baseline = {}
+    for threads in thread_counts:
+        row = f"{threads:>7}"
+        for batch_size in batch_sizes:
+            rate = simulations_per_second(evaluator, simulations, threads, batch_size)
+            baseline.setdefault(batch_size, rate)
+            row += f"{rate:>14.0f} ({rate / baseline[batch_size]:.2f}x)"
+        print(row)
+
+    mcts = chess_engine.MCTS(evaluator, make_config(simulations, thread_counts[0], batch_sizes[-1]))
+    board = chess_engine.ChessBitboard()
+    board.load_fen(POSITIONS[0])
+    mcts.search(board)
+    memory = mcts.memory_usage()
+    used = memory.node_bytes + memory.edge_bytes
+    print(f"Tree after {simulations} simulations: {memory.nodes} nodes ({memory.node_bytes / 2**20:.1f} MB), "
+          f"{memory.edges} edges ({memory.edge_bytes / 2**20:.1f} MB), {used / simulations:.0f} bytes/simulation, "
+          f"{memory.reserved_bytes / 2**20:.1f} MB reserved")
@@ -0,0 +1,286 @@
+// bench.cpp
+// Micro-benchmarks for the board (chess_engine_bench, see build.sh): move generation,
+// copy-make, attack tests, FEN parsing and perft over opening, middlegame and endgame
+// positions. Each benchmark runs at least --min-time seconds and reports ns/op and
+// items/sec (moves, nodes or calls), --repetitions times; --json prints Google
+// Benchmark's JSON layout so runs can be compared with its tools.
+//
+//     ./chess_engine_bench [--filter perft] [--min-time 0.5] [--repetitions 3] [--json]
+#include "bitboard.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Position {
+    const char* phase;
+    const char* fen;
+};
+
+const Position CORPUS[] = {
+    {"opening", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"},
+    {"opening", "rnbqkb1r/pppp1ppp/5n2/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3"},
+    {"opening", "r1bqkbnr/pppp1ppp/2n5/1B2p3/4P3/5N2/PPPP1PPP/RNBQK2R b KQkq - 3 3"},
+    {"opening", "rnbqkb1r/pp2pppp/3p1n2/8/3NP3/8/PPP2PPP/RNBQKB1R w KQkq - 1 5"},
+    {"middlegame", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"},
+    {"middlegame", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1"},
+    {"middlegame", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8"},
+    {"middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10"},
+    {"endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"},
+    {"endgame", "8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 1"},
+    {"endgame", "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1"},
+    {"endgame", "8/8/8/4k3/8/8/2Q5/4K3 w - - 0 1"},
+};
+const char* PHASES[] = {"opening", "middlegame", "endgame"};
+
+// Perft at fixed depths; the node counts double as a correctness check
+struct PerftCase {
+    const char* name;
+    const char* fen;
+    int depth;
+    uint64_t nodes;
+};
+
+const PerftCase PERFT[] = {
+    {"startpos", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 4, 197281},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 3, 97862},
+    {"position3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624},
+    {"position4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 3, 9467},
+    {"position5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 3, 62379},
+};
+
+struct Options {
+    std::string filter;
+    double min_time = 0.5;
+    int repetitions = 1;
+    bool json = false;
+};
+
+// Runs `iterations` operations and returns the items they processed
+using Body = std::function<uint64_t(int64_t iterations)>;
+
+struct Benchmark {
+    std::string name;
+    const char* items;  // what items/sec counts
+    Body body;
+};
+
+struct Run {
+    std::string name;
+    const char* items;
+    int64_t iterations;
+    double ns_per_op;
+    double items_per_second;
+};
+
+// Keeps a result alive without the compiler seeing through it
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+std::vector<ChessBitboard> loadPhase(const ChessBitboard& prototype, const char* phase) {
+    std::vector<ChessBitboard> boards;
+    for (const Position& position : CORPUS) {
+        if (std::string(position.phase) != phase) continue;
+        boards.push_back(prototype);
+        boards.back().loadFen(position.fen);
+    }
+    return boards;
+}
+
+std::vector<Benchmark> makeBenchmarks(const ChessBitboard& prototype) {
+    std::vector<Benchmark> benchmarks;
+    for (const char* phase : PHASES) {
+        std::vector<ChessBitboard> boards = loadPhase(prototype, phase);
+        std::vector<std::string> fens;
+        std::vector<std::pair<size_t, Move>> moves;  // every legal move of every board
+        for (size_t i = 0; i < boards.size(); i++) {
+            fens.push_back(boards[i].toFen());
+            for (const Move& move : boards[i].generateLegalMoves()) moves.emplace_back(i, move);
+        }
+        std::string suffix = std::string("/") + phase;
+
+        benchmarks.push_back({"generateLegalMoves" + suffix, "moves", [boards](int64_t iterations) {
+            uint64_t generated = 0;
+            for (int64_t i = 0; i < iterations; i++) {
+                std::vector<Move> list = boards[i % boards.size()].generateLegalMoves();
+                generated += list.size();
+                doNotOptimize(list.data());
+            }
+            return generated;
+        }});
+        benchmarks.push_back({"generatePseudoLegalMoves" + suffix, "moves", [boards](int64_t iterations) {
+            uint64_t generated = 0;
+            for (int64_t i = 0; i < iterations; i++) {
+                std::vector<Move> list = boards[i % boards.size()].generatePseudoLegalMoves();
+                generated += list.size();
+                doNotOptimize(list.data());
+            }
+            return generated;
+        }});
+        // Copy-make: the board has no unmake, so a copy is part of every move
+        benchmarks.push_back({"makeMove" + suffix, "moves", [boards, moves](int64_t iterations) {
+            for (int64_t i = 0; i < iterations; i++) {
+                const auto& [index, move] = moves[i % moves.size()];
+                ChessBitboard child = boards[index];
+                child.makeMove(move);
+                doNotOptimize(child.hash);
+            }
+            return static_cast<uint64_t>(iterations);
+        }});
+        benchmarks.push_back({"isSquareAttacked" + suffix, "calls", [boards](int64_t iterations) {
+            int attacked = 0;
+            for (int64_t i = 0; i < iterations; i++) {
+                const ChessBitboard& board = boards[(i >> 7) % boards.size()];
+                Piece::Color by = (i & 64) ? Piece::Color::BLACK : Piece::Color::WHITE;
+                attacked += board.isSquareAttacked(static_cast<Square>(i & 63), by);
+            }
+            doNotOptimize(attacked);
+            return static_cast<uint64_t>(iterations);
+        }});
+        benchmarks.push_back({"loadFen" + suffix, "positions", [prototype, fens](int64_t iterations) {
+            ChessBitboard board = prototype;
+            for (int64_t i = 0; i < iterations; i++) {
+                board.loadFen(fens[i % fens.size()]);
+                doNotOptimize(board.hash);
+            }
+            return static_cast<uint64_t>(iterations);
+        }});
+    }
+    for (const PerftCase& test : PERFT) {
+        ChessBitboard board = prototype;
+        board.loadFen(test.fen);
+        std::string name = std::string("perft/") + test.name + "/" + std::to_string(test.depth);
+        benchmarks.push_back({name, "nodes", [board, test, name](int64_t iterations) {
+            uint64_t nodes = 0;
+            for (int64_t i = 0; i < iterations; i++) {
+                uint64_t found = board.perft(test.depth);
+                if (found != test.nodes) {
+                    throw std::runtime_error(name + " counted " + std::to_string(found) + " nodes, expected " +
+                                             std::to_string(test.nodes));
+                }
+                nodes += found;
+            }
+            return nodes;
+        }});
+    }
+    return benchmarks;
+}
+
+// Grows the iteration count until one batch takes at least min_time, as Google Benchmark does
+Run measure(const Benchmark& benchmark, double min_time) {
+    int64_t iterations = 1;
+    for (;;) {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t items = benchmark.body(iterations);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (seconds >= min_time || iterations >= (int64_t(1) << 40)) {
+            return {benchmark.name, benchmark.items, iterations, seconds * 1e9 / iterations, items / seconds};
+        }
+        double scale = seconds > 0 ? 1.4 * min_time / seconds : 100.0;
+        iterations = std::max(iterations + 1, static_cast<int64_t>(iterations * std::min(scale, 100.0)));
+    }
+}
+
+std::string jsonEscape(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+void printJson(const std::vector<Run>& runs) {
+    auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    char date[64];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+    std::printf("{\n  \"context\": {\n    \"date\": \"%s\",\n    \"executable\": \"chess_engine_bench\",\n"
+                "    \"num_cpus\": %u,\n    \"library_build_type\": \"release\"\n  },\n  \"benchmarks\": [",
+                date, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < runs.size(); i++) {
+        const Run& run = runs[i];
+        std::printf("%s\n    {\n      \"name\": \"%s\",\n      \"run_type\": \"iteration\",\n"
+                    "      \"iterations\": %lld,\n      \"real_time\": %.3f,\n      \"cpu_time\": %.3f,\n"
+                    "      \"time_unit\": \"ns\",\n      \"items_per_second\": %.1f,\n      \"items\": \"%s\"\n    }",
+                    i ? "," : "", jsonEscape(run.name).c_str(), static_cast<long long>(run.iterations),
+                    run.ns_per_op, run.ns_per_op, run.items_per_second, run.items);
+    }
+    std::printf("\n  ]\n}\n");
+}
+
+std::string rate(double per_second) {
+    char text[32];
+    if (per_second >= 1e9) std::snprintf(text, sizeof(text), "%.3fG/s", per_second / 1e9);
+    else if (per_second >= 1e6) std::snprintf(text, sizeof(text), "%.3fM/s", per_second / 1e6);
+    else if (per_second >= 1e3) std::snprintf(text, sizeof(text), "%.3fk/s", per_second / 1e3);
+    else std::snprintf(text, sizeof(text), "%.3f/s", per_second);
+    return text;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string flag = argv[i];
+        if (flag == "--json") {
+            options.json = true;
+            continue;
+        }
+        if (i + 1 >= argc) return false;
+        std::string value = argv[++i];
+        try {
+            if (flag == "--filter") options.filter = value;
+            else if (flag == "--min-time") options.min_time = std::stod(value);
+            else if (flag == "--repetitions") options.repetitions = std::max(1, std::stoi(value));
+            else return false;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: " << argv[0] << " [--filter SUBSTRING] [--min-time SECONDS] [--repetitions N] [--json]\n";
+        return 2;
+    }
+
+    ChessBitboard prototype;  // copied instead of constructing boards (which rebuilds tables)
+    std::vector<Run> runs;
+    try {
+        std::vector<Benchmark> benchmarks = makeBenchmarks(prototype);
+        if (!options.json) {
+            std::printf("%-36s %14s %12s %16s\n", "Benchmark", "ns/op", "Iterations", "Rate");
+            std::printf("%s\n", std::string(81, '-').c_str());
+        }
+        for (const Benchmark& benchmark : benchmarks) {
+            if (benchmark.name.find(options.filter) == std::string::npos) continue;
+            for (int r = 0; r < options.repetitions; r++) {
+                Run run = measure(benchmark, options.min_time);
+                if (!options.json) {
+                    std::printf("%-36s %14.1f %12lld %16s %s\n", run.name.c_str(), run.ns_per_op,
+                                static_cast<long long>(run.iterations), rate(run.items_per_second).c_str(), run.items);
+                    std::fflush(stdout);
+                }
+                runs.push_back(run);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    if (options.json) printJson(runs);
+    return 0;
+}
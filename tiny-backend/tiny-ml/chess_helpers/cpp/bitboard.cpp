@@ -1,10 +1,15 @@
 #include "bitboard.h"
 #include <algorithm>
+#include <cstring>
 #include <sstream>
 #include <vector>
 #include <map>
 #include "magicmoves.h"
 #include "bitmasks.h"
+#include "evaluate.h"
+#include "instrument.h"
+#include "tablebase.h"
+#include "zobrist.h"
 
 // Helper to convert move to string format for map keys
 std::string move_to_string(const Move& move) {
@@ -66,11 +71,14 @@ ChessBitboard::ChessBitboard() {
     en_passant_square = -1;
     halfmove_clock = 0;
     fullmove_number = 1;
+    psq_mg = psq_eg = game_phase = 0;
+    dirty_count = MAX_DIRTY + 1;
     
     // Clear mailbox
     for (int i = 0; i < 64; i++) {
         mailbox[i] = Piece();
     }
+    hash = computeHash();
     
     // Initialize attack tables
     initAttacks();
@@ -86,6 +94,7 @@ void ChessBitboard::loadFen(const std::string& fen) {
     for (int i = 0; i < 64; ++i) {
         mailbox[i] = Piece();
     }
+    psq_mg = psq_eg = game_phase = 0;
     castling_rights = 0;
     en_passant_square = -1;
     halfmove_clock = 0;
@@ -150,6 +159,115 @@ void ChessBitboard::loadFen(const std::string& fen) {
     updateMailbox();
 }
 
+bool ChessBitboard::tryLoadFen(const std::string& fen) {
+    std::istringstream ss(fen);
+    std::vector<std::string> fields;
+    for (std::string field; ss >> field;) fields.push_back(field);
+    if (fields.size() < 4 || fields.size() > 6) return false;
+
+    int rank = 7, file = 0, white_kings = 0, black_kings = 0;
+    char placement[64] = {};  // by square, 0 = empty
+    for (char c : fields[0]) {
+        if (c == '/') {
+            if (file != 8 || rank == 0) return false;
+            rank--;
+            file = 0;
+        } else if (c >= '1' && c <= '8') {
+            file += c - '0';
+            if (file > 8) return false;
+        } else {
+            const char* kind = strchr("pnbrqkPNBRQK", c);
+            if (c == '\0' || !kind || file >= 8) return false;
+            if (tolower(c) == 'p' && (rank == 0 || rank == 7)) return false;
+            white_kings += c == 'K';
+            black_kings += c == 'k';
+            placement[rank * 8 + file] = c;
+            file++;
+        }
+    }
+    if (rank != 0 || file != 8 || white_kings != 1 || black_kings != 1) return false;
+
+    if (fields[1] != "w" && fields[1] != "b") return false;
+    const std::string& castling = fields[2];
+    if (castling != "-") {
+        if (castling.size() > 4) return false;
+        for (size_t i = 0; i < castling.size(); i++) {
+            if (!strchr("KQkq", castling[i]) || castling.find(castling[i], i + 1) != std::string::npos) return false;
+            // Move generation trusts the rights, so the king and rook must be at home
+            bool white = castling[i] == 'K' || castling[i] == 'Q';
+            int king = white ? 4 : 60;
+            int rook = king + (tolower(castling[i]) == 'k' ? 3 : -4);
+            if (placement[king] != (white ? 'K' : 'k') || placement[rook] != (white ? 'R' : 'r')) return false;
+        }
+    }
+    const std::string& en_passant = fields[3];
+    if (en_passant != "-" &&
+        (en_passant.size() != 2 || en_passant[0] < 'a' || en_passant[0] > 'h' ||
+         en_passant[1] != (fields[1] == "w" ? '6' : '3'))) {
+        return false;
+    }
+    if (en_passant != "-") {
+        // Behind a pawn that just made a double step: it stands one rank past the square,
+        // which is empty along with the one the pawn came from
+        int square = (en_passant[1] - '1') * 8 + (en_passant[0] - 'a');
+        int forward = fields[1] == "w" ? -8 : 8;  // direction the pawn moved
+        if (placement[square + forward] != (fields[1] == "w" ? 'p' : 'P') || placement[square] ||
+            placement[square - forward]) {
+            return false;
+        }
+    }
+    // Counters are often left out; loadFen needs them
+    for (size_t i = 4; i < fields.size(); i++) {
+        if (fields[i].empty() || fields[i].size() > 6 ||
+            !std::all_of(fields[i].begin(), fields[i].end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            return false;
+        }
+    }
+    if (fields.size() < 5) fields.push_back("0");
+    if (fields.size() < 6) fields.push_back("1");
+
+    loadFen(fields[0] + ' ' + fields[1] + ' ' + fields[2] + ' ' + fields[3] + ' ' + fields[4] + ' ' + fields[5]);
+    return true;
+}
+
+std::string ChessBitboard::toFen() const {
+    static const char SYMBOLS[] = " pnbrqk";
+    std::string fen;
+    for (int rank = 7; rank >= 0; rank--) {
+        int empty = 0;
+        for (int file = 0; file < 8; file++) {
+            Piece piece = mailbox[rank * 8 + file];
+            if (piece.type() == Piece::Type::NONE) {
+                empty++;
+                continue;
+            }
+            if (empty) fen += static_cast<char>('0' + empty);
+            empty = 0;
+            char symbol = SYMBOLS[static_cast<int>(piece.type())];
+            fen += piece.color() == Piece::Color::WHITE ? static_cast<char>(toupper(symbol)) : symbol;
+        }
+        if (empty) fen += static_cast<char>('0' + empty);
+        if (rank > 0) fen += '/';
+    }
+
+    fen += white_to_move ? " w " : " b ";
+    std::string castling;
+    if (castling_rights & 0b0001) castling += 'K';
+    if (castling_rights & 0b0010) castling += 'Q';
+    if (castling_rights & 0b0100) castling += 'k';
+    if (castling_rights & 0b1000) castling += 'q';
+    fen += castling.empty() ? "-" : castling;
+    fen += ' ';
+    if (en_passant_square >= 0) {
+        fen += static_cast<char>('a' + en_passant_square % 8);
+        fen += static_cast<char>('1' + en_passant_square / 8);
+    } else {
+        fen += '-';
+    }
+    fen += ' ' + std::to_string(halfmove_clock) + ' ' + std::to_string(fullmove_number);
+    return fen;
+}
+
 Bitboard ChessBitboard::getWhitePieces() const {
     return white_pawns | white_knights | white_bishops | white_rooks | white_queens | white_king;
 }
@@ -162,6 +280,19 @@ Bitboard ChessBitboard::getAllPieces() const {
     return getWhitePieces() | getBlackPieces();
 }
 
+Bitboard ChessBitboard::getPieces(Piece::Color color, Piece::Type type) const {
+    bool white = (color == Piece::Color::WHITE);
+    switch (type) {
+        case Piece::Type::PAWN:   return white ? white_pawns : black_pawns;
+        case Piece::Type::KNIGHT: return white ? white_knights : black_knights;
+        case Piece::Type::BISHOP: return white ? white_bishops : black_bishops;
+        case Piece::Type::ROOK:   return white ? white_rooks : black_rooks;
+        case Piece::Type::QUEEN:  return white ? white_queens : black_queens;
+        case Piece::Type::KING:   return white ? white_king : black_king;
+        default:                  return 0ULL;
+    }
+}
+
 void ChessBitboard::setStartingPosition() {
     // White pieces
     white_pawns = 0x000000000000FF00ULL;
@@ -229,69 +360,203 @@ Bitboard ChessBitboard::getAttacks(Square square, Piece::Type piece_type, Bitboa
 std::vector<Move> ChessBitboard::generatePseudoLegalMoves() const {
     std::vector<Move> moves;
     moves.reserve(256); // Pre-allocate for performance
-    
+    generateMoves(moves, GenType::ALL);
+    return moves;
+}
+
+void ChessBitboard::generateCaptures(std::vector<Move>& moves) const {
+    generateMoves(moves, GenType::CAPTURES);
+}
+
+void ChessBitboard::generateQuiets(std::vector<Move>& moves) const {
+    generateMoves(moves, GenType::QUIETS);
+}
+
+void ChessBitboard::generateMoves(std::vector<Move>& moves, GenType type) const {
     Bitboard occupancy = getAllPieces();
+    Bitboard enemy = white_to_move ? getBlackPieces() : getWhitePieces();
+    Bitboard targets = targetSquares(type);
+
+    generateSliderMoves(moves, Piece::Type::ROOK, targets);
+    generateSliderMoves(moves, Piece::Type::BISHOP, targets);
+    generateSliderMoves(moves, Piece::Type::QUEEN, targets);
+    generatePawnMoves(moves, type, ~occupancy, enemy);
+    generateKnightMoves(moves, targets);
+    generateKingMoves(moves, targets, type != GenType::CAPTURES);
+}
+
+void ChessBitboard::generateEvasions(std::vector<Move>& moves) const {
+    Piece::Color us = white_to_move ? Piece::Color::WHITE : Piece::Color::BLACK;
     Bitboard friendly = white_to_move ? getWhitePieces() : getBlackPieces();
     Bitboard enemy = white_to_move ? getBlackPieces() : getWhitePieces();
-    
-    // Generate moves for each piece type
-    Bitboard pieces = white_to_move ? white_rooks : black_rooks;
-    while (pieces) {
-        Square from = __builtin_ctzll(pieces); // Get LSB
-        pieces &= pieces - 1; // Clear LSB
-        
-        Bitboard attacks = Rmagic(from, occupancy);
-        attacks &= ~friendly; // Can't capture own pieces
-        
-        while (attacks) {
-            Square to = __builtin_ctzll(attacks);
-            attacks &= attacks - 1;
-            moves.emplace_back(from, to, Piece::Type::ROOK);
-        }
+    Square king_square = __builtin_ctzll(getPieces(us, Piece::Type::KING));
+    Bitboard checkers = attackersTo(king_square, getAllPieces()) & enemy;
+
+    // The king can always try to step away; castling out of check is never legal
+    generateKingMoves(moves, ~friendly, false);
+    if (!checkers) return;
+
+    // Against a double check only a king move helps
+    if (checkers & (checkers - 1)) return;
+
+    // Otherwise capture the checker or interpose on the line between it and the king
+    Square checker = __builtin_ctzll(checkers);
+    Bitboard block = betweenSquares(king_square, checker);
+    Bitboard targets = checkers | block;
+
+    generateSliderMoves(moves, Piece::Type::ROOK, targets);
+    generateSliderMoves(moves, Piece::Type::BISHOP, targets);
+    generateSliderMoves(moves, Piece::Type::QUEEN, targets);
+    generatePawnMoves(moves, GenType::ALL, block, checkers);
+    generateKnightMoves(moves, targets);
+}
+
+void ChessBitboard::generateQuietChecks(std::vector<Move>& moves) const {
+    Piece::Color them = white_to_move ? Piece::Color::BLACK : Piece::Color::WHITE;
+    Bitboard occupancy = getAllPieces();
+    Bitboard empty = ~occupancy;
+    Square enemy_king = __builtin_ctzll(getPieces(them, Piece::Type::KING));
+
+    // A piece that alone blocks one of our sliders from the enemy king checks by moving away
+    Bitboard candidates = discoveredCheckCandidates();
+    Bitboard others = ~candidates;
+
+    // Direct checks: land on a square from which the piece attacks the king
+    Bitboard king_bb = 1ULL << enemy_king;
+    Bitboard pawn_checks = white_to_move
+        ? (((king_bb & Bitmasks::NOT_A_FILE) >> 9) | ((king_bb & Bitmasks::NOT_H_FILE) >> 7))
+        : (((king_bb & Bitmasks::NOT_H_FILE) << 9) | ((king_bb & Bitmasks::NOT_A_FILE) << 7));
+    Bitboard bishop_checks = Bmagic(enemy_king, occupancy);
+    Bitboard rook_checks = Rmagic(enemy_king, occupancy);
+
+    generateSliderMoves(moves, Piece::Type::ROOK, rook_checks & empty, others);
+    generateSliderMoves(moves, Piece::Type::BISHOP, bishop_checks & empty, others);
+    generateSliderMoves(moves, Piece::Type::QUEEN, (rook_checks | bishop_checks) & empty, others);
+    generatePawnMoves(moves, GenType::QUIETS, pawn_checks & empty, 0ULL, others);
+    generateKnightMoves(moves, knight_attacks[enemy_king] & empty, others);
+
+    // Discovered checks and castling (the rook may check) are rare; test each one directly
+    std::vector<Move> rare;
+    if (candidates) {
+        generateSliderMoves(rare, Piece::Type::ROOK, empty, candidates);
+        generateSliderMoves(rare, Piece::Type::BISHOP, empty, candidates);
+        generateSliderMoves(rare, Piece::Type::QUEEN, empty, candidates);
+        generatePawnMoves(rare, GenType::QUIETS, empty, 0ULL, candidates);
+        generateKnightMoves(rare, empty, candidates);
     }
-    
-    // Similar for bishops
-    pieces = white_to_move ? white_bishops : black_bishops;
-    while (pieces) {
-        Square from = __builtin_ctzll(pieces);
-        pieces &= pieces - 1;
-        
-        Bitboard attacks = Bmagic(from, occupancy);
-        attacks &= ~friendly;
-        
-        while (attacks) {
-            Square to = __builtin_ctzll(attacks);
-            attacks &= attacks - 1;
-            moves.emplace_back(from, to, Piece::Type::BISHOP);
-        }
+    Bitboard our_king = getPieces(white_to_move ? Piece::Color::WHITE : Piece::Color::BLACK, Piece::Type::KING);
+    generateKingMoves(rare, (candidates & our_king) ? empty : 0ULL, true);
+    for (const Move& move : rare) {
+        if (givesCheck(move)) moves.push_back(move);
     }
-    
-    // Queens
-    pieces = white_to_move ? white_queens : black_queens;
+}
+
+Bitboard ChessBitboard::targetSquares(GenType type) const {
+    switch (type) {
+        case GenType::CAPTURES: return white_to_move ? getBlackPieces() : getWhitePieces();
+        case GenType::QUIETS:   return ~getAllPieces();
+        default:                return ~(white_to_move ? getWhitePieces() : getBlackPieces());
+    }
+}
+
+Bitboard ChessBitboard::betweenSquares(Square a, Square b) {
+    // With only the two squares occupied, the rays from each end meet exactly on the
+    // squares between them, and nowhere at all if they do not share a line
+    Bitboard occupancy = (1ULL << a) | (1ULL << b);
+    if (Rmagic(a, occupancy) & (1ULL << b)) return Rmagic(a, occupancy) & Rmagic(b, occupancy);
+    if (Bmagic(a, occupancy) & (1ULL << b)) return Bmagic(a, occupancy) & Bmagic(b, occupancy);
+    return 0ULL;
+}
+
+Bitboard ChessBitboard::discoveredCheckCandidates() const {
+    Piece::Color us = white_to_move ? Piece::Color::WHITE : Piece::Color::BLACK;
+    Piece::Color them = white_to_move ? Piece::Color::BLACK : Piece::Color::WHITE;
+    Bitboard friendly = white_to_move ? getWhitePieces() : getBlackPieces();
+    Bitboard occupancy = getAllPieces();
+    Square enemy_king = __builtin_ctzll(getPieces(them, Piece::Type::KING));
+
+    // Our sliders that would see the king on an empty board
+    Bitboard queens = getPieces(us, Piece::Type::QUEEN);
+    Bitboard snipers = (Rmagic(enemy_king, 0ULL) & (getPieces(us, Piece::Type::ROOK) | queens))
+                     | (Bmagic(enemy_king, 0ULL) & (getPieces(us, Piece::Type::BISHOP) | queens));
+
+    Bitboard candidates = 0ULL;
+    while (snipers) {
+        Square sniper = __builtin_ctzll(snipers);
+        snipers &= snipers - 1;
+        Bitboard blockers = betweenSquares(enemy_king, sniper) & occupancy;
+        if (blockers && !(blockers & (blockers - 1))) candidates |= blockers & friendly;
+    }
+    return candidates;
+}
+
+bool ChessBitboard::givesCheck(const Move& move) const {
+    Piece::Color us = white_to_move ? Piece::Color::WHITE : Piece::Color::BLACK;
+    Piece::Color them = white_to_move ? Piece::Color::BLACK : Piece::Color::WHITE;
+    Square from = move.getFrom();
+    Square to = move.getTo();
+    Square enemy_king = __builtin_ctzll(getPieces(them, Piece::Type::KING));
+    Bitboard king_bb = 1ULL << enemy_king;
+
+    // Occupancy and our pieces after the move
+    Bitboard occupancy = (getAllPieces() & ~(1ULL << from)) | (1ULL << to);
+    Bitboard rooks = getPieces(us, Piece::Type::ROOK) | getPieces(us, Piece::Type::QUEEN);
+    Bitboard bishops = getPieces(us, Piece::Type::BISHOP) | getPieces(us, Piece::Type::QUEEN);
+    Piece::Type piece_type = move.isPromotion() ? move.getPromotionType() : mailbox[from].type();
+    rooks &= ~(1ULL << from);
+    bishops &= ~(1ULL << from);
+    if (piece_type == Piece::Type::ROOK || piece_type == Piece::Type::QUEEN) rooks |= 1ULL << to;
+    if (piece_type == Piece::Type::BISHOP || piece_type == Piece::Type::QUEEN) bishops |= 1ULL << to;
+
+    if (move.getFlags() == Move::EN_PASSANT_FLAG) {
+        occupancy &= ~(1ULL << (white_to_move ? to - 8 : to + 8));
+    } else if (move.getFlags() == Move::CASTLE_FLAG) {
+        Square rook_from = (to > from) ? from + 3 : from - 4;
+        Square rook_to = (to > from) ? from + 1 : from - 1;
+        occupancy = (occupancy & ~(1ULL << rook_from)) | (1ULL << rook_to);
+        rooks = (rooks & ~(1ULL << rook_from)) | (1ULL << rook_to);
+    }
+
+    // Sliders cover both direct checks by the moved piece and discovered checks
+    if ((Rmagic(enemy_king, occupancy) & rooks) || (Bmagic(enemy_king, occupancy) & bishops)) return true;
+
+    Bitboard to_bb = 1ULL << to;
+    if (piece_type == Piece::Type::KNIGHT) return knight_attacks[to] & king_bb;
+    if (piece_type == Piece::Type::PAWN) {
+        Bitboard pawn_attacks = white_to_move
+            ? (((to_bb & Bitmasks::NOT_A_FILE) << 7) | ((to_bb & Bitmasks::NOT_H_FILE) << 9))
+            : (((to_bb & Bitmasks::NOT_H_FILE) >> 7) | ((to_bb & Bitmasks::NOT_A_FILE) >> 9));
+        return pawn_attacks & king_bb;
+    }
+    return false;
+}
+
+void ChessBitboard::generateSliderMoves(std::vector<Move>& moves, Piece::Type type, Bitboard targets, Bitboard from_mask) const {
+    Bitboard occupancy = getAllPieces();
+    Bitboard pieces = getPieces(white_to_move ? Piece::Color::WHITE : Piece::Color::BLACK, type) & from_mask;
+
     while (pieces) {
-        Square from = __builtin_ctzll(pieces);
-        pieces &= pieces - 1;
+        Square from = __builtin_ctzll(pieces); // Get LSB
+        pieces &= pieces - 1; // Clear LSB
         
-        Bitboard attacks = Qmagic(from, occupancy);
-        attacks &= ~friendly;
+        Bitboard attacks = getAttacks(from, type, occupancy);
+        attacks &= targets; // Never contains our own pieces
         
         while (attacks) {
             Square to = __builtin_ctzll(attacks);
             attacks &= attacks - 1;
-            moves.emplace_back(from, to, Piece::Type::QUEEN);
+            moves.emplace_back(from, to, type);
         }
     }
-    
-    generatePawnMoves(moves);
-    generateKnightMoves(moves);
-    generateKingMoves(moves);
-    
-    return moves;
 }
 
-void ChessBitboard::generatePawnMoves(std::vector<Move>& moves) const {
-    Bitboard pawns = white_to_move ? white_pawns : black_pawns;
-    Bitboard enemy_pieces = white_to_move ? getBlackPieces() : getWhitePieces();
+void ChessBitboard::generatePawnMoves(std::vector<Move>& moves, GenType type, Bitboard push_targets,
+                                      Bitboard capture_targets, Bitboard from_mask) const {
+    // Promotions count as captures so that tactical stages see them first
+    bool gen_captures = (type != GenType::QUIETS);
+    bool gen_quiets = (type != GenType::CAPTURES);
+    Bitboard pawns = (white_to_move ? white_pawns : black_pawns) & from_mask;
+    Bitboard enemy_pieces = (white_to_move ? getBlackPieces() : getWhitePieces()) & capture_targets;
     
     int direction = white_to_move ? 8 : -8;
     Bitboard promotion_rank = white_to_move ? Bitmasks::RANK_7 : Bitmasks::RANK_2;
@@ -303,28 +568,33 @@ void ChessBitboard::generatePawnMoves(std::vector<Move>& moves) const {
         // 1. Pushes (single and double)
         Square to = from + direction;
         if (to >= 0 && to < 64 && getPieceAt(to).is_empty()) {
+            bool to_is_target = (1ULL << to) & push_targets;
             if ((1ULL << from) & promotion_rank) {
-                // This is a promotion push
-                moves.emplace_back(from, to, Piece::Type::PAWN, Move::PROMOTION_QUEEN_FLAG);
-                moves.emplace_back(from, to, Piece::Type::PAWN, Move::PROMOTION_ROOK_FLAG);
-                moves.emplace_back(from, to, Piece::Type::PAWN, Move::PROMOTION_BISHOP_FLAG);
-                moves.emplace_back(from, to, Piece::Type::PAWN, Move::PROMOTION_KNIGHT_FLAG);
-            } else {
+                if (gen_captures && to_is_target) {
+                    // This is a promotion push
+                    moves.emplace_back(from, to, Piece::Type::PAWN, Move::PROMOTION_QUEEN_FLAG);
+                    moves.emplace_back(from, to, Piece::Type::PAWN, Move::PROMOTION_ROOK_FLAG);
+                    moves.emplace_back(from, to, Piece::Type::PAWN, Move::PROMOTION_BISHOP_FLAG);
+                    moves.emplace_back(from, to, Piece::Type::PAWN, Move::PROMOTION_KNIGHT_FLAG);
+                }
+            } else if (gen_quiets && to_is_target) {
                 // Regular single push
                 moves.emplace_back(from, to, Piece::Type::PAWN);
             }
 
             // Double push from starting rank
             bool is_on_start_rank = (1ULL << from) & (white_to_move ? Bitmasks::RANK_2 : Bitmasks::RANK_7);
-            if (is_on_start_rank) {
+            if (is_on_start_rank && gen_quiets) {
                 Square double_to = from + 2 * direction;
-                if (double_to >= 0 && double_to < 64 && getPieceAt(double_to).is_empty()) {
+                if (double_to >= 0 && double_to < 64 && getPieceAt(double_to).is_empty() &&
+                    ((1ULL << double_to) & push_targets)) {
                     moves.emplace_back(from, double_to, Piece::Type::PAWN);
                 }
             }
         }
         
         // 2. Captures
+        if (!gen_captures) continue;
         Bitboard from_bb = 1ULL << from;
         Bitboard attacks = 0ULL;
         if (white_to_move) {
@@ -351,9 +621,12 @@ void ChessBitboard::generatePawnMoves(std::vector<Move>& moves) const {
     }
     
     // 3. En Passant
-    if (en_passant_square != -1) {
+    if (en_passant_square != -1 && gen_captures) {
         Bitboard ep_bb = 1ULL << en_passant_square;
-        Bitboard potential_attackers = white_to_move ? white_pawns : black_pawns;
+        Bitboard potential_attackers = (white_to_move ? white_pawns : black_pawns) & from_mask;
+        Bitboard captured_bb = white_to_move ? (ep_bb >> 8) : (ep_bb << 8);
+        // Allowed when the captured pawn is a target, or when landing on ep_square is (blocking a check)
+        if (!(captured_bb & capture_targets) && !(ep_bb & push_targets)) potential_attackers = 0ULL;
         Bitboard attackers = 0ULL;
         
         if (white_to_move) { // Black just double-pushed, we are white, ep_sq is on rank 6
@@ -378,13 +651,12 @@ void ChessBitboard::generatePawnMoves(std::vector<Move>& moves) const {
     }
 }
 
-void ChessBitboard::generateKnightMoves(std::vector<Move>& moves) const {
-    Bitboard knights = white_to_move ? white_knights : black_knights;
-    Bitboard friendly_pieces = white_to_move ? getWhitePieces() : getBlackPieces();
+void ChessBitboard::generateKnightMoves(std::vector<Move>& moves, Bitboard targets, Bitboard from_mask) const {
+    Bitboard knights = (white_to_move ? white_knights : black_knights) & from_mask;
 
     while (knights) {
         Square from = __builtin_ctzll(knights);
-        Bitboard attacks = knight_attacks[from] & ~friendly_pieces;
+        Bitboard attacks = knight_attacks[from] & targets;
 
         while (attacks) {
             Square to = __builtin_ctzll(attacks);
@@ -395,13 +667,12 @@ void ChessBitboard::generateKnightMoves(std::vector<Move>& moves) const {
     }
 }
 
-void ChessBitboard::generateKingMoves(std::vector<Move>& moves) const {
+void ChessBitboard::generateKingMoves(std::vector<Move>& moves, Bitboard targets, bool include_castling) const {
     Bitboard king = white_to_move ? white_king : black_king;
-    Bitboard friendly_pieces = white_to_move ? getWhitePieces() : getBlackPieces();
     
     // Assumes only one king per side
     Square from = __builtin_ctzll(king);
-    Bitboard attacks = king_attacks[from] & ~friendly_pieces;
+    Bitboard attacks = king_attacks[from] & targets;
 
     while (attacks) {
         Square to = __builtin_ctzll(attacks);
@@ -410,6 +681,7 @@ void ChessBitboard::generateKingMoves(std::vector<Move>& moves) const {
     }
     
     // Castling move generation
+    if (!include_castling) return;
     Bitboard occupancy = getAllPieces();
     if (white_to_move) {
         // White Kingside
@@ -448,7 +720,67 @@ void ChessBitboard::generateKingMoves(std::vector<Move>& moves) const {
     }
 }
 
+bool ChessBitboard::isCapture(const Move& move) const {
+    return !mailbox[move.getTo()].is_empty() || move.getFlags() == Move::EN_PASSANT_FLAG;
+}
+
+bool ChessBitboard::isPseudoLegal(const Move& move) const {
+    // Validates a move that may come from another position (TT move, killers)
+    Square from = move.getFrom();
+    Square to = move.getTo();
+    Piece piece = mailbox[from];
+    Piece::Color us = white_to_move ? Piece::Color::WHITE : Piece::Color::BLACK;
+    if (move.isNone() || piece.is_empty() || piece.color() != us || piece.type() != move.getPieceType()) {
+        return false;
+    }
+
+    uint8_t flags = move.getFlags();
+    if (flags == Move::CASTLE_FLAG) {
+        std::vector<Move> king_moves;
+        generateKingMoves(king_moves, 0ULL, true);
+        return std::find(king_moves.begin(), king_moves.end(), move) != king_moves.end();
+    }
+
+    Bitboard to_bb = 1ULL << to;
+    Bitboard occupancy = getAllPieces();
+    Bitboard friendly = white_to_move ? getWhitePieces() : getBlackPieces();
+    if (to_bb & friendly) return false;
+
+    if (piece.type() != Piece::Type::PAWN) {
+        if (flags != Move::NO_FLAG) return false;
+        switch (piece.type()) {
+            case Piece::Type::KNIGHT: return knight_attacks[from] & to_bb;
+            case Piece::Type::KING:   return king_attacks[from] & to_bb;
+            default:                  return getAttacks(from, piece.type(), occupancy) & to_bb;
+        }
+    }
+
+    Bitboard from_bb = 1ULL << from;
+    Bitboard pawn_attacks = white_to_move
+        ? (((from_bb & Bitmasks::NOT_A_FILE) << 7) | ((from_bb & Bitmasks::NOT_H_FILE) << 9))
+        : (((from_bb & Bitmasks::NOT_H_FILE) >> 7) | ((from_bb & Bitmasks::NOT_A_FILE) >> 9));
+    if (flags == Move::EN_PASSANT_FLAG) {
+        return to == en_passant_square && (pawn_attacks & to_bb);
+    }
+
+    bool reaches_last_rank = to_bb & (white_to_move ? Bitmasks::RANK_8 : Bitmasks::RANK_1);
+    if (reaches_last_rank != move.isPromotion()) return false;
+    if (flags != Move::NO_FLAG && !move.isPromotion()) return false;
+
+    Bitboard enemy = occupancy & ~friendly;
+    if (pawn_attacks & to_bb) return enemy & to_bb;
+
+    int direction = white_to_move ? 8 : -8;
+    if (to == from + direction) return !(occupancy & to_bb);
+    if (to == from + 2 * direction) {
+        bool is_on_start_rank = from_bb & (white_to_move ? Bitmasks::RANK_2 : Bitmasks::RANK_7);
+        return is_on_start_rank && !(occupancy & to_bb) && !(occupancy & (1ULL << (from + direction)));
+    }
+    return false;
+}
+
 std::vector<Move> ChessBitboard::generateLegalMoves() const {
+    INSTRUMENT_TIMER(MOVEGEN);
     std::vector<Move> pseudo_legal = generatePseudoLegalMoves();
     std::vector<Move> legal_moves;
     legal_moves.reserve(pseudo_legal.size());
@@ -464,7 +796,9 @@ std::vector<Move> ChessBitboard::generateLegalMoves() const {
 
 void ChessBitboard::makeMove(const Move& move) {
     Piece moving_piece = getPieceAt(move.getFrom());
+    dirty_count = 0;
     Piece captured_piece = getPieceAt(move.getTo());
+    hash ^= Zobrist::KEYS.castling[castling_rights] ^ enPassantKey();
 
     // 1. Update Halfmove Clock
     if (moving_piece.type() == Piece::Type::PAWN || !captured_piece.is_empty()) {
@@ -553,9 +887,12 @@ void ChessBitboard::makeMove(const Move& move) {
     if (white_to_move) {
         fullmove_number++;
     }
+    hash ^= Zobrist::KEYS.castling[castling_rights] ^ enPassantKey() ^ Zobrist::KEYS.side;
 }
 
 bool ChessBitboard::isLegal(const Move& move) const {
+    INSTRUMENT_COUNT(LEGAL_CHECKS, 1);
+    INSTRUMENT_TIMER(LEGALITY);
      // Simple legality check - implement properly later
     ChessBitboard temp = *this;
     temp.makeMove(move);
@@ -613,6 +950,143 @@ bool ChessBitboard::isSquareAttacked(Square square, Piece::Color by_color) const
     return false;
 }
 
+Bitboard ChessBitboard::attackersTo(Square square, Bitboard occupancy) const {
+    Bitboard square_bb = 1ULL << square;
+    // A white pawn attacks this square from the rank below, a black pawn from the rank above
+    Bitboard white_pawn_sources = ((square_bb & Bitmasks::NOT_A_FILE) >> 9) | ((square_bb & Bitmasks::NOT_H_FILE) >> 7);
+    Bitboard black_pawn_sources = ((square_bb & Bitmasks::NOT_H_FILE) << 9) | ((square_bb & Bitmasks::NOT_A_FILE) << 7);
+
+    return (white_pawn_sources & white_pawns)
+         | (black_pawn_sources & black_pawns)
+         | (knight_attacks[square] & (white_knights | black_knights))
+         | (king_attacks[square] & (white_king | black_king))
+         | (Rmagic(square, occupancy) & (white_rooks | black_rooks | white_queens | black_queens))
+         | (Bmagic(square, occupancy) & (white_bishops | black_bishops | white_queens | black_queens));
+}
+
+int ChessBitboard::see(const Move& move) const {
+    Square from = move.getFrom();
+    Square to = move.getTo();
+    uint8_t flags = move.getFlags();
+    if (flags == Move::CASTLE_FLAG) return 0;
+
+    Bitboard occupancy = getAllPieces();
+    Bitboard diagonal_sliders = white_bishops | black_bishops | white_queens | black_queens;
+    Bitboard straight_sliders = white_rooks | black_rooks | white_queens | black_queens;
+    Piece::Type attacker = mailbox[from].type();
+    Piece::Color side = mailbox[from].color();
+
+    // gain[d] is the material balance, from the point of view of the side making
+    // the d-th capture, if the exchange stops after that capture.
+    int gain[33];
+    int depth = 0;
+    if (flags == Move::EN_PASSANT_FLAG) {
+        gain[0] = SEE_VALUE[Piece::Type::PAWN];
+        occupancy ^= 1ULL << (side == Piece::Color::WHITE ? to - 8 : to + 8);
+    } else {
+        gain[0] = SEE_VALUE[mailbox[to].type()];
+    }
+    if (move.isPromotion()) {
+        attacker = move.getPromotionType();
+        gain[0] += SEE_VALUE[attacker] - SEE_VALUE[Piece::Type::PAWN];
+    }
+
+    Bitboard from_bb = 1ULL << from;
+    Bitboard attackers = attackersTo(to, occupancy);
+    while (true) {
+        depth++;
+        gain[depth] = SEE_VALUE[attacker] - gain[depth - 1];
+
+        // Lifting the attacker off the occupancy uncovers any x-ray slider lined up behind it
+        occupancy ^= from_bb;
+        attackers |= (Bmagic(to, occupancy) & diagonal_sliders) | (Rmagic(to, occupancy) & straight_sliders);
+        attackers &= occupancy;
+
+        side = (side == Piece::Color::WHITE) ? Piece::Color::BLACK : Piece::Color::WHITE;
+        Bitboard side_pieces = (side == Piece::Color::WHITE) ? getWhitePieces() : getBlackPieces();
+        Bitboard side_attackers = attackers & side_pieces;
+        if (!side_attackers) break;
+
+        // Recapture with the least valuable attacker
+        for (int type = Piece::Type::PAWN; type <= Piece::Type::KING; type++) {
+            Bitboard candidates = side_attackers & getPieces(side, Piece::Type(type));
+            if (candidates) {
+                from_bb = candidates & (~candidates + 1);
+                attacker = Piece::Type(type);
+                break;
+            }
+        }
+        // The king may only take last, when the opponent has nothing left to recapture with
+        if (attacker == Piece::Type::KING && (attackers & ~side_pieces)) break;
+    }
+
+    // Negamax the speculative gains back to the root; either side may decline to recapture
+    while (--depth) {
+        gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+    }
+    return gain[0];
+}
+
+bool ChessBitboard::seeGE(const Move& move, int threshold) const {
+    uint8_t flags = move.getFlags();
+    if (flags == Move::CASTLE_FLAG) return 0 >= threshold;
+    // En passant and promotions are rare enough to take the exact path
+    if (flags != Move::NO_FLAG) return see(move) >= threshold;
+
+    Square from = move.getFrom();
+    Square to = move.getTo();
+
+    int swap = SEE_VALUE[mailbox[to].type()] - threshold;
+    if (swap < 0) return false;
+    swap = SEE_VALUE[mailbox[from].type()] - swap;
+    if (swap <= 0) return true;
+
+    Bitboard white_pieces = getWhitePieces();
+    Bitboard black_pieces = getBlackPieces();
+    Bitboard occupancy = (white_pieces | black_pieces) ^ (1ULL << from) ^ (1ULL << to);
+    Bitboard diagonal_sliders = white_bishops | black_bishops | white_queens | black_queens;
+    Bitboard straight_sliders = white_rooks | black_rooks | white_queens | black_queens;
+    Piece::Color side = mailbox[from].color();
+    Bitboard attackers = attackersTo(to, occupancy);
+
+    // res flips every time a side gets to recapture; it is the answer if that side then stands pat
+    int res = 1;
+    while (true) {
+        side = (side == Piece::Color::WHITE) ? Piece::Color::BLACK : Piece::Color::WHITE;
+        attackers &= occupancy;
+        Bitboard side_pieces = (side == Piece::Color::WHITE) ? white_pieces : black_pieces;
+        Bitboard side_attackers = attackers & side_pieces;
+        if (!side_attackers) break;
+
+        res ^= 1;
+        Bitboard bb;
+        if ((bb = side_attackers & getPieces(side, Piece::Type::PAWN))) {
+            if ((swap = SEE_VALUE[Piece::Type::PAWN] - swap) < res) break;
+            occupancy ^= bb & (~bb + 1);
+            attackers |= Bmagic(to, occupancy) & diagonal_sliders;
+        } else if ((bb = side_attackers & getPieces(side, Piece::Type::KNIGHT))) {
+            if ((swap = SEE_VALUE[Piece::Type::KNIGHT] - swap) < res) break;
+            occupancy ^= bb & (~bb + 1);
+        } else if ((bb = side_attackers & getPieces(side, Piece::Type::BISHOP))) {
+            if ((swap = SEE_VALUE[Piece::Type::BISHOP] - swap) < res) break;
+            occupancy ^= bb & (~bb + 1);
+            attackers |= Bmagic(to, occupancy) & diagonal_sliders;
+        } else if ((bb = side_attackers & getPieces(side, Piece::Type::ROOK))) {
+            if ((swap = SEE_VALUE[Piece::Type::ROOK] - swap) < res) break;
+            occupancy ^= bb & (~bb + 1);
+            attackers |= Rmagic(to, occupancy) & straight_sliders;
+        } else if ((bb = side_attackers & getPieces(side, Piece::Type::QUEEN))) {
+            if ((swap = SEE_VALUE[Piece::Type::QUEEN] - swap) < res) break;
+            occupancy ^= bb & (~bb + 1);
+            attackers |= (Bmagic(to, occupancy) & diagonal_sliders) | (Rmagic(to, occupancy) & straight_sliders);
+        } else {
+            // Only the king is left: it may recapture only if the opponent has nothing more to add
+            return (attackers & ~side_pieces) ? res ^ 1 : res;
+        }
+    }
+    return res;
+}
+
 uint64_t ChessBitboard::perft(int depth) const {
     if (depth == 0) return 1;
     
@@ -642,6 +1116,38 @@ std::map<std::string, uint64_t> ChessBitboard::perft_divide(int depth) {
 }
 
 // Helper methods
+void ChessBitboard::flipVertical() {
+    using Bitmasks::flipVertical;
+    Bitboard white[6] = {white_pawns, white_knights, white_bishops, white_rooks, white_queens, white_king};
+    white_pawns = flipVertical(black_pawns);
+    white_knights = flipVertical(black_knights);
+    white_bishops = flipVertical(black_bishops);
+    white_rooks = flipVertical(black_rooks);
+    white_queens = flipVertical(black_queens);
+    white_king = flipVertical(black_king);
+    black_pawns = flipVertical(white[0]);
+    black_knights = flipVertical(white[1]);
+    black_bishops = flipVertical(white[2]);
+    black_rooks = flipVertical(white[3]);
+    black_queens = flipVertical(white[4]);
+    black_king = flipVertical(white[5]);
+    white_to_move = !white_to_move;
+    castling_rights = ((castling_rights & 3) << 2) | ((castling_rights >> 2) & 3);
+    if (en_passant_square >= 0) en_passant_square ^= 56;
+    updateMailbox();
+}
+
+bool ChessBitboard::mirrorHorizontal() {
+    if (castling_rights) return false;
+    for (Bitboard* bitboard : {&white_pawns, &white_knights, &white_bishops, &white_rooks, &white_queens, &white_king,
+                               &black_pawns, &black_knights, &black_bishops, &black_rooks, &black_queens, &black_king}) {
+        *bitboard = Bitmasks::mirrorHorizontal(*bitboard);
+    }
+    if (en_passant_square >= 0) en_passant_square ^= 7;
+    updateMailbox();
+    return true;
+}
+
 void ChessBitboard::updateMailbox() {
     // Clear mailbox
     for (int i = 0; i < 64; i++) {
@@ -666,10 +1172,58 @@ void ChessBitboard::updateMailbox() {
         else if (black_queens & mask) mailbox[square] = Piece(Piece::Color::BLACK, Piece::Type::QUEEN);
         else if (black_king & mask) mailbox[square] = Piece(Piece::Color::BLACK, Piece::Type::KING);
     }
+
+    // The bitboards may have been written directly, so rebuild the evaluation sums too
+    psq_mg = psq_eg = game_phase = 0;
+    dirty_count = MAX_DIRTY + 1;
+    for (int square = 0; square < 64; square++) {
+        Piece piece = mailbox[square];
+        if (piece.is_empty()) continue;
+        psq_mg += Eval::PSQ_MG[piece.raw()][square];
+        psq_eg += Eval::PSQ_EG[piece.raw()][square];
+        game_phase += Eval::PHASE_WEIGHT[piece.type()];
+    }
+    hash = computeHash();
+}
+
+uint64_t ChessBitboard::computeHash() const {
+    uint64_t key = Zobrist::KEYS.castling[castling_rights] ^ enPassantKey();
+    if (!white_to_move) key ^= Zobrist::KEYS.side;
+    for (int square = 0; square < 64; square++) {
+        if (!mailbox[square].is_empty()) key ^= Zobrist::KEYS.piece_square[mailbox[square].raw()][square];
+    }
+    return key;
+}
+
+bool ChessBitboard::samePosition(const ChessBitboard& other) const {
+    return hash == other.hash &&
+           white_pawns == other.white_pawns && white_knights == other.white_knights &&
+           white_bishops == other.white_bishops && white_rooks == other.white_rooks &&
+           white_queens == other.white_queens && white_king == other.white_king &&
+           black_pawns == other.black_pawns && black_knights == other.black_knights &&
+           black_bishops == other.black_bishops && black_rooks == other.black_rooks &&
+           black_queens == other.black_queens && black_king == other.black_king &&
+           white_to_move == other.white_to_move && castling_rights == other.castling_rights &&
+           enPassantKey() == other.enPassantKey();
+}
+
+uint64_t ChessBitboard::enPassantKey() const {
+    if (en_passant_square == -1) return 0;
+    Bitboard ep = 1ULL << en_passant_square;
+    Bitboard attackers = white_to_move
+        ? (((ep >> 9) & Bitmasks::NOT_H_FILE) | ((ep >> 7) & Bitmasks::NOT_A_FILE)) & white_pawns
+        : (((ep << 7) & Bitmasks::NOT_H_FILE) | ((ep << 9) & Bitmasks::NOT_A_FILE)) & black_pawns;
+    return attackers ? Zobrist::KEYS.en_passant_file[en_passant_square % 8] : 0;
 }
 
 void ChessBitboard::addPieceToBitboard(Square square, Piece piece) {
     Bitboard mask = 1ULL << square;
+    psq_mg += Eval::PSQ_MG[piece.raw()][square];
+    psq_eg += Eval::PSQ_EG[piece.raw()][square];
+    game_phase += Eval::PHASE_WEIGHT[piece.type()];
+    hash ^= Zobrist::KEYS.piece_square[piece.raw()][square];
+    if (dirty_count < MAX_DIRTY) dirty[dirty_count] = {piece, square, true};
+    if (dirty_count <= MAX_DIRTY) dirty_count++;
     
     if (piece.color() == Piece::Color::WHITE) {
         switch (piece.type()) {
@@ -696,6 +1250,12 @@ void ChessBitboard::addPieceToBitboard(Square square, Piece piece) {
 
 void ChessBitboard::removePieceFromBitboard(Square square, Piece piece) {
     Bitboard mask = ~(1ULL << square);
+    psq_mg -= Eval::PSQ_MG[piece.raw()][square];
+    psq_eg -= Eval::PSQ_EG[piece.raw()][square];
+    game_phase -= Eval::PHASE_WEIGHT[piece.type()];
+    hash ^= Zobrist::KEYS.piece_square[piece.raw()][square];
+    if (dirty_count < MAX_DIRTY) dirty[dirty_count] = {piece, square, false};
+    if (dirty_count <= MAX_DIRTY) dirty_count++;
     
     if (piece.color() == Piece::Color::WHITE) {
         switch (piece.type()) {
@@ -772,6 +1332,8 @@ bool ChessBitboard::hasInsufficientMaterial() const {
     return false;
 }
 
+const Tablebase* ChessBitboard::adjudication_tablebase = nullptr;
+
 bool ChessBitboard::isGameOver() const {
     std::vector<Move> legal_moves = generateLegalMoves();
     
@@ -789,6 +1351,11 @@ bool ChessBitboard::isGameOver() const {
     if (hasInsufficientMaterial()) {
         return true;
     }
+
+    int result;
+    if (adjudication_tablebase && adjudication_tablebase->adjudicate(*this, result)) {
+        return true;
+    }
     
     // TODO: Add threefold repetition check
     return false;
@@ -809,6 +1376,11 @@ int ChessBitboard::getResult() const {
     if (halfmove_clock >= 100 || hasInsufficientMaterial()) {
         return 0;  // Draw
     }
+
+    int result;
+    if (adjudication_tablebase && adjudication_tablebase->adjudicate(*this, result)) {
+        return result;
+    }
     
     // Game continues
     return 999;  // Special value meaning game not over
@@ -7,6 +7,16 @@
 #include <string>
 #include <map>
 
+class Tablebase;
+
+// A piece put on or taken off a square during the last makeMove, so incrementally
+// updated evaluators (NNUE accumulators) can replay the change instead of rescanning
+struct DirtyPiece {
+    Piece piece;
+    Square square;
+    bool added;
+};
+
 class ChessBitboard {
 public:
     // Piece bitboards
@@ -33,6 +43,22 @@ public:
     
     // Mailbox for fast piece lookup
     Piece mailbox[64];
+
+    // Material + piece-square sums (white positive) and game phase, kept up to date by
+    // setPiece/clearSquare so a static evaluation does not have to rescan the board
+    int psq_mg;
+    int psq_eg;
+    int game_phase;
+
+    // Pieces changed by the last makeMove (at most 4: castling moves king and rook).
+    // dirty_count > MAX_DIRTY means the board was edited some other way.
+    static constexpr int MAX_DIRTY = 4;
+    DirtyPiece dirty[MAX_DIRTY];
+    int dirty_count;
+
+    // Zobrist hash of the position (see zobrist.h), updated incrementally like the
+    // evaluation sums; call updateMailbox() after writing fields directly
+    uint64_t hash;
     
     // Pre-computed attack tables
     Bitboard knight_attacks[64];
@@ -44,6 +70,7 @@ public:
     Bitboard getWhitePieces() const;
     Bitboard getBlackPieces() const;
     Bitboard getAllPieces() const;
+    Bitboard getPieces(Piece::Color color, Piece::Type type) const;
     void setStartingPosition();
     
     // Piece operations
@@ -54,6 +81,18 @@ public:
     // Move generation
     std::vector<Move> generateLegalMoves() const;
     std::vector<Move> generatePseudoLegalMoves() const;
+    // Slices of the pseudo-legal moves, appended to `moves`. Captures include en passant
+    // and all promotions; quiets are the rest (castling included), so together they
+    // cover generatePseudoLegalMoves exactly.
+    void generateCaptures(std::vector<Move>& moves) const;
+    void generateQuiets(std::vector<Move>& moves) const;
+    // When in check: king steps, captures of a single checker and interpositions
+    void generateEvasions(std::vector<Move>& moves) const;
+    // Non-capturing, non-promoting moves that give check, direct or discovered
+    void generateQuietChecks(std::vector<Move>& moves) const;
+    bool isPseudoLegal(const Move& move) const;
+    bool isCapture(const Move& move) const;
+    bool givesCheck(const Move& move) const;
     
     // Move execution
     void makeMove(const Move& move);
@@ -61,32 +100,80 @@ public:
     bool isGameOver() const;
     bool hasInsufficientMaterial() const;
     int getResult() const; // 1 if white wins, -1 if black wins, 0 if draw
+    // Let isGameOver/getResult also end games whose result `tablebase` settles (see
+    // Tablebase::adjudicate), e.g. to stop self-play games early. Applies to every board;
+    // nullptr turns it off. Not owned.
+    static void setAdjudicationTablebase(const Tablebase* tablebase) { adjudication_tablebase = tablebase; }
 
     // Attack generation using magic bitboards
     Bitboard getAttacks(Square square, Piece::Type piece_type, Bitboard occupancy) const;
     
     // Check detection
     bool isInCheck(Piece::Color color) const;
+    bool isSquareAttacked(Square square, Piece::Color by_color) const;
+
+    // Static exchange evaluation
+    static constexpr int SEE_VALUE[7] = {0, 100, 320, 330, 500, 900, 20000};
+    Bitboard attackersTo(Square square, Bitboard occupancy) const;
+    int see(const Move& move) const;
+    bool seeGE(const Move& move, int threshold = 0) const;
+
+    // Tapered hand-crafted evaluation in centipawns, from the side to move's point of view
+    int evaluate() const;
 
     // Performance testing
     uint64_t perft(int depth) const;
     std::map<std::string, uint64_t> perft_divide(int depth);
 
-    // FEN parsing
+    // FEN parsing. loadFen trusts its input; tryLoadFen first checks that the FEN is well
+    // formed (8 ranks of 8 files, known pieces, no pawns on the back ranks, one king per
+    // side, valid side, castling rights with king and rook at home, an en passant square
+    // just behind the pawn that double-stepped, optional counters) and returns false,
+    // leaving the board as it was, if not.
     void loadFen(const std::string& fen);
+    bool tryLoadFen(const std::string& fen);
+    // FEN of the current position; the en passant square is written whenever one is set
+    std::string toFen() const;
+
+    // Symmetries, used to augment training data.
+    // The position seen from the other side: ranks reversed and colours exchanged, so the
+    // side to move, castling rights and en passant square change sides with the pieces
+    void flipVertical();
+    // Files reversed. Only a symmetry of chess without castling rights, so a position
+    // that still has some is left as it is and false returned.
+    bool mirrorHorizontal();
 
     void updateMailbox();
+    // Hash recomputed from scratch; equals `hash` whenever the board is consistent
+    uint64_t computeHash() const;
+    // Same pieces, side to move, castling rights and usable en passant capture
+    // (move counters ignored), i.e. the same position for search purposes
+    bool samePosition(const ChessBitboard& other) const;
+
+    // Squares strictly between a and b when they share a rank, file or diagonal
+    static Bitboard betweenSquares(Square a, Square b);
 
 private:
+    static const Tablebase* adjudication_tablebase;
+
+    // Which slice of the pseudo-legal moves a generator produces.
+    // CAPTURES also holds en passant and every promotion; QUIETS holds the rest, castling included.
+    enum class GenType { CAPTURES, QUIETS, ALL };
+
     void initAttacks();
     void removePieceFromBitboard(Square square, Piece piece);
     void addPieceToBitboard(Square square, Piece piece);
+    // Key of the en passant file if the side to move has a pawn that can capture there
+    uint64_t enPassantKey() const;
 
     // Helper methods for move generation
-    void generatePawnMoves(std::vector<Move>& moves) const;
-    void generateKnightMoves(std::vector<Move>& moves) const;
-    void generateKingMoves(std::vector<Move>& moves) const;
-    
-    // Check detection
-    bool isSquareAttacked(Square square, Piece::Color by_color) const;
+    // Each generator only emits moves onto its target mask, and only for pieces in from_mask
+    void generateMoves(std::vector<Move>& moves, GenType type) const;
+    Bitboard targetSquares(GenType type) const;
+    Bitboard discoveredCheckCandidates() const;
+    void generateSliderMoves(std::vector<Move>& moves, Piece::Type type, Bitboard targets, Bitboard from_mask = ~0ULL) const;
+    void generatePawnMoves(std::vector<Move>& moves, GenType type, Bitboard push_targets,
+                           Bitboard capture_targets, Bitboard from_mask = ~0ULL) const;
+    void generateKnightMoves(std::vector<Move>& moves, Bitboard targets, Bitboard from_mask = ~0ULL) const;
+    void generateKingMoves(std::vector<Move>& moves, Bitboard targets, bool include_castling) const;
 };
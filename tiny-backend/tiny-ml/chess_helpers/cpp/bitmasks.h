@@ -40,4 +40,12 @@ constexpr uint64_t BLACK_QUEEN_CASTLE_EMPTY = 0x0E00000000000000ULL;
 constexpr uint64_t BLACK_KING_CASTLE_SAFE   = 0x7000000000000000ULL;
 constexpr uint64_t BLACK_QUEEN_CASTLE_SAFE  = 0x1C00000000000000ULL;
 
+// Board symmetries: ranks reversed (a1 <-> a8) and files reversed (a1 <-> h1)
+constexpr uint64_t flipVertical(uint64_t b) { return __builtin_bswap64(b); }
+constexpr uint64_t mirrorHorizontal(uint64_t b) {
+    b = ((b >> 1) & 0x5555555555555555ULL) | ((b & 0x5555555555555555ULL) << 1);
+    b = ((b >> 2) & 0x3333333333333333ULL) | ((b & 0x3333333333333333ULL) << 2);
+    return ((b >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((b & 0x0F0F0F0F0F0F0F0FULL) << 4);
+}
+
 } // namespace Bitmasks 
\ No newline at end of file
@@ -0,0 +1,87 @@
+// book.h
+#pragma once
+#include "bitboard.h"
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Opening books in the Polyglot .bin layout: 16-byte big-endian entries (position key,
+// move, weight, learn) sorted by key, several entries per position. The file is
+// memory-mapped and searched in place, so opening even a large book costs nothing and
+// any number of threads can probe it at once.
+//
+// Keys are Polyglot's (its 781 published random numbers: piece on square, castling
+// rights, en passant file when a pawn can take there, white to move), so books written by
+// other tools and OpeningBookBuilder's books read the same way.
+class OpeningBook {
+public:
+    struct Entry {
+        Move move;
+        uint16_t weight;
+        uint32_t learn;
+    };
+
+    // Throws std::runtime_error if the file cannot be mapped or is not a whole number of entries
+    explicit OpeningBook(const std::string& path);
+    ~OpeningBook();
+    OpeningBook(const OpeningBook&) = delete;
+    OpeningBook& operator=(const OpeningBook&) = delete;
+
+    const std::string& path() const { return file_path; }
+    size_t size() const { return count; }
+
+    // Book moves for the position, highest weight first; entries whose move is not legal
+    // here (key collisions, corrupt books) are left out
+    std::vector<Entry> probe(const ChessBitboard& board) const;
+    // Book move drawn with probability proportional to its weight; Move() out of book
+    Move pick(const ChessBitboard& board, std::mt19937_64& rng) const;
+    // Highest-weight book move; Move() out of book
+    Move best(const ChessBitboard& board) const;
+
+    static uint64_t key(const ChessBitboard& board);
+    // Polyglot move encoding: to, from and promotion piece, castling written as the king
+    // taking its own rook
+    static uint16_t encodeMove(const Move& move);
+    // The legal move `encoded` stands for in this position, Move() if there is none
+    static Move decodeMove(const ChessBitboard& board, uint16_t encoded);
+
+private:
+    std::string file_path;
+    const unsigned char* data = nullptr;
+    size_t count = 0;
+
+    // Index of the first entry with a key not below `key`
+    size_t lowerBound(uint64_t key) const;
+};
+
+// Collects the opening moves of finished games and writes them out as a book. Each move
+// is weighted by how it scored for the side that played it (2 a win, 1 a draw, 0 a loss),
+// Polyglot's usual weighting, so moves that only ever lost never leave the book.
+class OpeningBookBuilder {
+public:
+    // Only the first `max_ply` half-moves of each game are recorded
+    explicit OpeningBookBuilder(int max_ply = 30) : max_ply(max_ply) {}
+
+    // `moves` are played from `start`; `result` is from white's point of view
+    // (1 white won, -1 black won, 0 draw) like ChessBitboard::getResult
+    void addGame(const ChessBitboard& start, const std::vector<Move>& moves, int result);
+    // Record one move directly; `score` is 2, 1 or 0 as above
+    void add(const ChessBitboard& board, const Move& move, uint32_t score);
+
+    size_t positions() const { return table.size(); }
+    // Writes every move played in at least `min_games` recorded games and scoring above
+    // zero; weights are scaled per position to fit 16 bits. Returns the entries written.
+    size_t write(const std::string& path, uint32_t min_games = 1) const;
+
+private:
+    struct Stats {
+        uint32_t games = 0;
+        uint64_t score = 0;
+    };
+
+    int max_ply;
+    // Position key -> encoded move -> totals
+    std::unordered_map<uint64_t, std::unordered_map<uint16_t, Stats>> table;
+};
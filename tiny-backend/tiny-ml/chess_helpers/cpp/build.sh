@@ -1,4 +1,26 @@
 #!/bin/bash
-# run bash build.sh to build the C++ extension.
+# run bash build.sh to build the C++ extension and the standalone UCI engine.
+# CHESS_INSTRUMENT=1 bash build.sh compiles in the hot-path counters and timers (instrument.h).
+# The extension is built per CPU level (see setup.py, chess_engine.py); CHESS_VARIANTS=v3
+# limits it to one for quicker builds, and pgo.sh makes a profile-guided build instead.
 python3 -m pip install pybind11
-python3 setup.py build_ext --inplace 
\ No newline at end of file
+rm -f chess_engine.*.so  # a stale single-module build would shadow the chess_engine.py loader
+python3 setup.py build_ext --inplace
+
+# Standalone tools on the same sources without the Python bindings:
+#   chess_engine_uci       UCI engine for GUIs and tournament managers
+#                          (cutechess-cli -engine cmd=./chess_engine_uci proto=uci ...)
+#   chess_engine_server    HTTP/JSON move service, a drop-in for server.py
+#   chess_engine_loadtest  concurrent-games load test against either server
+#   chess_engine_bench     board micro-benchmarks (movegen, makeMove, perft; --json)
+#   chess_engine_perf_gate regression gate against perf_baseline.json
+#                          (./chess_engine_perf_gate --baseline perf_baseline.json)
+SOURCES=$(python3 -c "import ast; tree = ast.parse(open('setup.py').read()); \
+print(' '.join(n.value for n in ast.walk(tree) if isinstance(n, ast.Constant) and isinstance(n.value, str) \
+and n.value.endswith('.cpp') and n.value != 'python_bindings.cpp'))")
+# The tools run where they are built, so they target this CPU (TOOL_ARCH overrides)
+FLAGS="-flto=auto ${TOOL_ARCH:--march=native}"
+[ "$CHESS_INSTRUMENT" = "1" ] && FLAGS="$FLAGS -DCHESS_INSTRUMENT"
+for tool in uci server loadtest bench perf_gate; do
+    g++ -std=c++17 -O3 -pthread $FLAGS -o chess_engine_$tool $tool.cpp $SOURCES
+done
@@ -0,0 +1,61 @@
+"""Loads the fastest build of the native engine that this CPU can run.
+
+setup.py compiles the extension once per x86-64 level (_chess_engine_generic, _v2, _v3,
+_v4). Importing this module replaces it with the best variant that is both built and
+supported, so `import chess_engine` and `from chess_helpers.cpp import chess_engine`
+still give the extension module itself. `chess_engine.variant` names the one loaded.
+
+CHESS_ENGINE_VARIANT=v3 forces a variant, e.g. for PGO training or comparisons.
+"""
+import importlib
+import os
+import platform
+import sys
+
+# /proc/cpuinfo flags each x86-64 micro-architecture level requires
+_LEVELS = {"v2": {"cx16", "lahf_lm", "popcnt", "pni", "ssse3", "sse4_1", "sse4_2"}}
+_LEVELS["v3"] = _LEVELS["v2"] | {"avx", "avx2", "bmi1", "bmi2", "f16c", "fma", "abm", "movbe", "xsave"}
+_LEVELS["v4"] = _LEVELS["v3"] | {"avx512f", "avx512bw", "avx512cd", "avx512dq", "avx512vl"}
+PREFERENCE = ["v4", "v3", "v2", "generic"]
+
+
+def _cpu_flags():
+    if platform.machine().lower() not in ("x86_64", "amd64"):
+        return set()
+    try:
+        with open("/proc/cpuinfo") as cpuinfo:
+            for line in cpuinfo:
+                if line.startswith("flags"):
+                    return set(line.split(":", 1)[1].split())
+    except OSError:
+        pass
+    return set()  # unknown: only the generic build is safe
+
+
+def supported_variants():
+    """Variants this CPU can execute, best first."""
+    flags = _cpu_flags()
+    return [variant for variant in PREFERENCE if variant == "generic" or _LEVELS[variant] <= flags]
+
+
+def _load():
+    candidates = supported_variants()
+    forced = os.environ.get("CHESS_ENGINE_VARIANT")
+    if forced:
+        if forced not in candidates:
+            raise ImportError(f"CHESS_ENGINE_VARIANT={forced} cannot run on this CPU (supported: {', '.join(candidates)})")
+        candidates = [forced]
+    errors = []
+    for variant in candidates:
+        name = "_chess_engine_" + variant
+        try:
+            module = importlib.import_module("." + name, __package__) if __package__ else importlib.import_module(name)
+        except ImportError as error:  # not built (or skipped by the compiler)
+            errors.append(f"{name}: {error}")
+            continue
+        module.variant = variant
+        return module
+    raise ImportError("No chess_engine build for this CPU; run build.sh\n" + "\n".join(errors))
+
+
+sys.modules[__name__] = _load()
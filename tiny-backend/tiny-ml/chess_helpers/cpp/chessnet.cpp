@@ -0,0 +1,280 @@
+#include "chessnet.h"
+#include "gemm.h"
+#include "safetensors.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
+
+namespace {
+
+using TensorMap = std::map<std::string, TensorData>;
+
+const TensorData& require(const TensorMap& tensors, const std::string& name, const std::vector<int64_t>& shape) {
+    auto it = tensors.find(name);
+    if (it == tensors.end()) throw std::runtime_error("Checkpoint is missing " + name);
+    if (it->second.shape != shape) throw std::runtime_error("Checkpoint tensor " + name + " has an unexpected shape");
+    return it->second;
+}
+
+// [channels][batch * size * size] -> [channels * k * k][batch * out * out] with zero padding
+void im2col(const std::vector<float>& in, int channels, int batch, int size, int kernel, int stride,
+            int padding, int out_size, std::vector<float>& col) {
+    int columns = batch * out_size * out_size;
+    col.assign(static_cast<size_t>(channels) * kernel * kernel * columns, 0.0f);
+    for (int c = 0; c < channels; c++) {
+        const float* plane = in.data() + static_cast<size_t>(c) * batch * size * size;
+        for (int ky = 0; ky < kernel; ky++) {
+            for (int kx = 0; kx < kernel; kx++) {
+                float* row = col.data() + (static_cast<size_t>(c) * kernel * kernel + ky * kernel + kx) * columns;
+                for (int b = 0; b < batch; b++) {
+                    for (int y = 0; y < out_size; y++) {
+                        int iy = y * stride + ky - padding;
+                        if (iy < 0 || iy >= size) continue;
+                        for (int x = 0; x < out_size; x++) {
+                            int ix = x * stride + kx - padding;
+                            if (ix < 0 || ix >= size) continue;
+                            row[(b * out_size + y) * out_size + x] = plane[(b * size + iy) * size + ix];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+void ChessNet::load(const std::string& path) {
+    TensorMap tensors = SafeTensors::load(path);
+
+    auto loadConv = [&](const std::string& conv_name, const std::string& bn_name, int in_channels,
+                        int out_channels, int kernel, int stride) {
+        Conv conv;
+        conv.in_channels = in_channels;
+        conv.out_channels = out_channels;
+        conv.kernel = kernel;
+        conv.stride = stride;
+        conv.padding = kernel / 2;
+        const TensorData& w = require(tensors, conv_name + ".weight", {out_channels, in_channels, kernel, kernel});
+        const TensorData& gamma = require(tensors, bn_name + ".weight", {out_channels});
+        const TensorData& beta = require(tensors, bn_name + ".bias", {out_channels});
+        const TensorData& mean = require(tensors, bn_name + ".running_mean", {out_channels});
+        const TensorData& var = require(tensors, bn_name + ".running_var", {out_channels});
+
+        // y = gamma * (conv(x) - mean) / sqrt(var + eps) + beta
+        size_t fan_in = static_cast<size_t>(in_channels) * kernel * kernel;
+        conv.weight.resize(out_channels * fan_in);
+        conv.bias.resize(out_channels);
+        for (int o = 0; o < out_channels; o++) {
+            float scale = gamma.values[o] / std::sqrt(var.values[o] + BN_EPS);
+            for (size_t i = 0; i < fan_in; i++) conv.weight[o * fan_in + i] = w.values[o * fan_in + i] * scale;
+            conv.bias[o] = beta.values[o] - mean.values[o] * scale;
+        }
+        return conv;
+    };
+    auto loadLinear = [&](const std::string& name, int in_features, int out_features) {
+        Linear linear;
+        linear.in_features = in_features;
+        linear.out_features = out_features;
+        linear.weight = require(tensors, name + ".weight", {out_features, in_features}).values;
+        linear.bias = require(tensors, name + ".bias", {out_features}).values;
+        return linear;
+    };
+
+    const std::string body = "resnet_body.";
+    stem = loadConv(body + "conv1", body + "bn1", INPUT_PLANES, 64, 3, 1);
+
+    std::vector<Block> loaded;
+    int in_channels = 64;
+    const int widths[4] = {64, 128, 256, 512};
+    for (int layer = 0; layer < 4; layer++) {
+        for (int index = 0; index < 2; index++) {
+            std::string prefix = body + "layer" + std::to_string(layer + 1) + "." + std::to_string(index) + ".";
+            int stride = (layer > 0 && index == 0) ? 2 : 1;
+            Block block;
+            block.conv1 = loadConv(prefix + "conv1", prefix + "bn1", in_channels, widths[layer], 3, stride);
+            block.conv2 = loadConv(prefix + "conv2", prefix + "bn2", widths[layer], widths[layer], 3, 1);
+            if (stride != 1 || in_channels != widths[layer]) {
+                block.has_downsample = true;
+                block.downsample = loadConv(prefix + "downsample.0", prefix + "downsample.1",
+                                            in_channels, widths[layer], 1, stride);
+            }
+            loaded.push_back(std::move(block));
+            in_channels = widths[layer];
+        }
+    }
+
+    policy_fc = loadLinear("policy_fc", 512, POLICY_SIZE);
+    value_fc1 = loadLinear("value_fc1", 512, 256);
+    value_fc2 = loadLinear("value_fc2", 256, 1);
+    blocks = std::move(loaded);
+}
+
+int ChessNet::runConv(const Conv& conv, const std::vector<float>& in, int batch, int size,
+                      std::vector<float>& out, const float* residual, bool relu, ActivationRanges* ranges) const {
+    if (ranges) ranges->conv_inputs.push_back(*std::max_element(in.begin(), in.end()));
+    int out_size = (size + 2 * conv.padding - conv.kernel) / conv.stride + 1;
+    int columns = batch * out_size * out_size;
+    out.resize(static_cast<size_t>(conv.out_channels) * columns);
+
+    GemmEpilogue epilogue;
+    epilogue.bias = conv.bias.data();
+    epilogue.residual = residual;
+    epilogue.relu = relu;
+    int fan_in = conv.in_channels * conv.kernel * conv.kernel;
+    if (conv.kernel == 1 && conv.stride == 1) {
+        gemm(conv.out_channels, columns, fan_in, conv.weight.data(), in.data(), out.data(), epilogue);
+    } else {
+        std::vector<float> col;
+        im2col(in, conv.in_channels, batch, size, conv.kernel, conv.stride, conv.padding, out_size, col);
+        gemm(conv.out_channels, columns, fan_in, conv.weight.data(), col.data(), out.data(), epilogue);
+    }
+    return out_size;
+}
+
+void ChessNet::forward(const float* input, int batch, float* policy_logits, float* values,
+                       ActivationRanges* ranges) const {
+    if (!isLoaded()) throw std::runtime_error("ChessNet weights are not loaded");
+    if (ranges) ranges->conv_inputs.clear();
+
+    // [batch][25][64] -> [25][batch * 64]
+    std::vector<float> x(static_cast<size_t>(INPUT_PLANES) * batch * 64);
+    for (int b = 0; b < batch; b++) {
+        for (int c = 0; c < INPUT_PLANES; c++) {
+            for (int i = 0; i < 64; i++) {
+                x[(static_cast<size_t>(c) * batch + b) * 64 + i] = input[(static_cast<size_t>(b) * INPUT_PLANES + c) * 64 + i];
+            }
+        }
+    }
+
+    std::vector<float> h, y, shortcut;
+    int size = runConv(stem, x, batch, 8, y, nullptr, true, ranges);
+    for (const Block& block : blocks) {
+        x.swap(y);
+        int out_size = runConv(block.conv1, x, batch, size, h, nullptr, true, ranges);
+        const float* residual = x.data();
+        if (block.has_downsample) {
+            runConv(block.downsample, x, batch, size, shortcut, nullptr, false, ranges);
+            residual = shortcut.data();
+        }
+        runConv(block.conv2, h, batch, out_size, y, residual, true, ranges);
+        size = out_size;
+    }
+
+    // Global average pooling -> features [512][batch]
+    int channels = blocks.back().conv2.out_channels;
+    int area = size * size;
+    std::vector<float> features(static_cast<size_t>(channels) * batch);
+    for (int c = 0; c < channels; c++) {
+        for (int b = 0; b < batch; b++) {
+            float sum = 0.0f;
+            for (int i = 0; i < area; i++) sum += y[(static_cast<size_t>(c) * batch + b) * area + i];
+            features[static_cast<size_t>(c) * batch + b] = sum / area;
+        }
+    }
+    if (ranges) ranges->head_input = *std::max_element(features.begin(), features.end());
+
+    std::vector<float> policy(static_cast<size_t>(POLICY_SIZE) * batch);
+    GemmEpilogue policy_epilogue;
+    policy_epilogue.bias = policy_fc.bias.data();
+    gemm(POLICY_SIZE, batch, policy_fc.in_features, policy_fc.weight.data(), features.data(), policy.data(), policy_epilogue);
+    for (int b = 0; b < batch; b++) {
+        for (int i = 0; i < POLICY_SIZE; i++) policy_logits[static_cast<size_t>(b) * POLICY_SIZE + i] = policy[static_cast<size_t>(i) * batch + b];
+    }
+
+    std::vector<float> hidden(static_cast<size_t>(value_fc1.out_features) * batch);
+    GemmEpilogue hidden_epilogue;
+    hidden_epilogue.bias = value_fc1.bias.data();
+    hidden_epilogue.relu = true;
+    gemm(value_fc1.out_features, batch, value_fc1.in_features, value_fc1.weight.data(), features.data(), hidden.data(), hidden_epilogue);
+    GemmEpilogue value_epilogue;
+    value_epilogue.bias = value_fc2.bias.data();
+    gemm(1, batch, value_fc2.in_features, value_fc2.weight.data(), hidden.data(), values, value_epilogue);
+    for (int b = 0; b < batch; b++) values[b] = std::tanh(values[b]);
+}
+
+void encodePosition(const ChessBitboard& board, const ChessBitboard* previous, float* planes) {
+    // get_board_planes unpacks each bitboard from its most significant bit, so
+    // plane[row][col] holds square 63 - (row * 8 + col)
+    auto fill = [](const ChessBitboard& b, float* out) {
+        const Bitboard bitboards[12] = {
+            b.white_pawns, b.white_knights, b.white_bishops, b.white_rooks, b.white_queens, b.white_king,
+            b.black_pawns, b.black_knights, b.black_bishops, b.black_rooks, b.black_queens, b.black_king,
+        };
+        for (int p = 0; p < 12; p++) {
+            for (int i = 0; i < 64; i++) out[p * 64 + i] = static_cast<float>((bitboards[p] >> (63 - i)) & 1ULL);
+        }
+    };
+    fill(board, planes);
+    if (previous) {
+        fill(*previous, planes + 12 * 64);
+    } else {
+        std::fill(planes + 12 * 64, planes + 24 * 64, 0.0f);
+    }
+    std::fill(planes + 24 * 64, planes + 25 * 64, board.white_to_move ? 1.0f : 0.0f);
+}
+
+namespace {
+const int KNIGHT_DELTAS[8][2] = {{-2, -1}, {-2, 1}, {-1, -2}, {-1, 2}, {1, -2}, {1, 2}, {2, -1}, {2, 1}};
+}
+
+int policyIndex(const Move& move) {
+    int from = move.getFrom();
+    int row_diff = move.getTo() / 8 - from / 8;
+    int col_diff = move.getTo() % 8 - from % 8;
+
+    // Queen-like moves: 8 directions x 7 distances
+    if (std::abs(row_diff) == std::abs(col_diff) || row_diff == 0 || col_diff == 0) {
+        int direction;
+        if (row_diff > 0 && col_diff == 0) direction = 0;       // N
+        else if (row_diff > 0 && col_diff > 0) direction = 1;   // NE
+        else if (row_diff == 0 && col_diff > 0) direction = 2;  // E
+        else if (row_diff < 0 && col_diff > 0) direction = 3;   // SE
+        else if (row_diff < 0 && col_diff == 0) direction = 4;  // S
+        else if (row_diff < 0 && col_diff < 0) direction = 5;   // SW
+        else if (row_diff == 0 && col_diff < 0) direction = 6;  // W
+        else direction = 7;                                     // NW
+        int distance = std::max(std::abs(row_diff), std::abs(col_diff)) - 1;
+        return from * 73 + direction * 7 + distance;
+    }
+
+    for (int i = 0; i < 8; i++) {
+        if (row_diff == KNIGHT_DELTAS[i][0] && col_diff == KNIGHT_DELTAS[i][1]) return from * 73 + 56 + i;
+    }
+    return 0;
+}
+
+int transformPolicyIndex(int index, int symmetry) {
+    // One table per combination of flags, built on first use
+    static const std::vector<std::vector<uint16_t>> tables = [] {
+        std::vector<std::vector<uint16_t>> built(4, std::vector<uint16_t>(ChessNet::POLICY_SIZE));
+        for (int flags = 0; flags < 4; flags++) {
+            bool flip = flags & Symmetry::FLIP, mirror = flags & Symmetry::MIRROR;
+            for (int i = 0; i < ChessNet::POLICY_SIZE; i++) {
+                int from = i / 73, plane = i % 73;
+                from ^= (flip ? 56 : 0) | (mirror ? 7 : 0);
+                if (plane < 56) {
+                    // Directions N, NE, E, SE, S, SW, W, NW: flipping reflects them about
+                    // east-west, mirroring about north-south
+                    int direction = plane / 7;
+                    if (flip) direction = (12 - direction) % 8;
+                    if (mirror) direction = (8 - direction) % 8;
+                    plane = direction * 7 + plane % 7;
+                } else if (plane < 64) {
+                    int row = KNIGHT_DELTAS[plane - 56][0] * (flip ? -1 : 1);
+                    int col = KNIGHT_DELTAS[plane - 56][1] * (mirror ? -1 : 1);
+                    for (int k = 0; k < 8; k++) {
+                        if (KNIGHT_DELTAS[k][0] == row && KNIGHT_DELTAS[k][1] == col) plane = 56 + k;
+                    }
+                }
+                // The underpromotion planes are never produced by policyIndex (promotions
+                // use the queen-move planes), so they only move with their square
+                built[flags][i] = static_cast<uint16_t>(from * 73 + plane);
+            }
+        }
+        return built;
+    }();
+    return tables[symmetry & 3][index];
+}
@@ -0,0 +1,82 @@
+// chessnet.h
+#pragma once
+#include "bitboard.h"
+#include <string>
+#include <vector>
+
+// Native inference for ChessNet in model.py: the tinygrad ResNet-18 body with a 25-plane
+// 3x3 stem and no max-pool, global average pooling, a 4672-way policy head and a tanh
+// value head. Weights are read straight from the safetensors checkpoint. Every BatchNorm
+// is folded into the convolution before it at load time, and convolutions run as
+// im2col + GEMM with bias, residual add and ReLU fused into the GEMM epilogue.
+class ChessNet {
+public:
+    // Largest input activation of every layer, in execution order (stem, then each block's
+    // conv1, downsample, conv2), plus the pooled features feeding the heads.
+    // Used to calibrate QuantizedChessNet.
+    struct ActivationRanges {
+        std::vector<float> conv_inputs;
+        float head_input = 0.0f;
+    };
+
+    static constexpr int INPUT_PLANES = 25;
+    static constexpr int POLICY_SIZE = 4672;   // 64 from-squares x 73 move planes
+    static constexpr float BN_EPS = 1e-5f;
+
+    // Throws std::runtime_error if a tensor is missing or has the wrong shape
+    void load(const std::string& path);
+    bool isLoaded() const { return !blocks.empty(); }
+
+    // input: [batch][25][8][8]; policy_logits: [batch][4672]; values: [batch] in [-1, 1].
+    // With `ranges` set, also records each layer's input range.
+    void forward(const float* input, int batch, float* policy_logits, float* values,
+                 ActivationRanges* ranges = nullptr) const;
+
+private:
+    friend class QuantizedChessNet;
+
+    // Convolution with its BatchNorm folded in
+    struct Conv {
+        int in_channels = 0, out_channels = 0, kernel = 0, stride = 1, padding = 0;
+        std::vector<float> weight;  // [out][in * kernel * kernel]
+        std::vector<float> bias;    // [out]
+    };
+    struct Block {
+        Conv conv1, conv2;
+        bool has_downsample = false;
+        Conv downsample;
+    };
+    struct Linear {
+        int in_features = 0, out_features = 0;
+        std::vector<float> weight;  // [out][in]
+        std::vector<float> bias;    // [out]
+    };
+
+    Conv stem;
+    std::vector<Block> blocks;
+    Linear policy_fc, value_fc1, value_fc2;
+
+    // Activations are [channels][batch * height * width]; returns the output spatial size
+    int runConv(const Conv& conv, const std::vector<float>& in, int batch, int size,
+                std::vector<float>& out, const float* residual, bool relu, ActivationRanges* ranges) const;
+};
+
+// Network input for `board`, matching get_board_planes + history_to_tensor in
+// game_logic.py: current pieces, the previous position's pieces (zeros if none), side to move.
+// planes must hold 25 * 64 floats.
+void encodePosition(const ChessBitboard& board, const ChessBitboard* previous, float* planes);
+
+// Policy index of a move, matching move_to_policy_index in game_logic.py
+// (promotions share the queen-move planes there, so they do here too)
+int policyIndex(const Move& move);
+
+// Board symmetries as combinable flags: FLIP as ChessBitboard::flipVertical, MIRROR as
+// ChessBitboard::mirrorHorizontal
+namespace Symmetry {
+constexpr int FLIP = 1;
+constexpr int MIRROR = 2;
+}
+
+// Policy index of the same move once its position is transformed by `symmetry`;
+// a permutation of the 4672 indices for each combination
+int transformPolicyIndex(int index, int symmetry);
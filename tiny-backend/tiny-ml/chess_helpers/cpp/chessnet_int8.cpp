@@ -0,0 +1,222 @@
+#include "chessnet_int8.h"
+#include "gemm.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+constexpr int CALIBRATION_BATCH = 32;
+
+inline uint8_t quantizeActivation(float x, float inverse_scale) {
+    if (x <= 0.0f) return 0;
+    return static_cast<uint8_t>(std::min(127L, std::lround(x * inverse_scale)));
+}
+
+// [channels][batch * size * size] floats -> [batch * out * out][row_bytes] quantized patches,
+// one row per output position (the transposed im2col layout gemmInt8 takes)
+void im2row(const std::vector<float>& in, int channels, int batch, int size, int kernel, int stride,
+            int padding, int out_size, int row_bytes, float input_scale, std::vector<uint8_t>& rows) {
+    int columns = batch * out_size * out_size;
+    float inverse_scale = 1.0f / input_scale;
+    rows.assign(static_cast<size_t>(columns) * row_bytes, 0);
+    for (int c = 0; c < channels; c++) {
+        const float* plane = in.data() + static_cast<size_t>(c) * batch * size * size;
+        for (int ky = 0; ky < kernel; ky++) {
+            for (int kx = 0; kx < kernel; kx++) {
+                int k = (c * kernel + ky) * kernel + kx;
+                for (int b = 0; b < batch; b++) {
+                    for (int y = 0; y < out_size; y++) {
+                        int iy = y * stride + ky - padding;
+                        if (iy < 0 || iy >= size) continue;
+                        for (int x = 0; x < out_size; x++) {
+                            int ix = x * stride + kx - padding;
+                            if (ix < 0 || ix >= size) continue;
+                            size_t column = (static_cast<size_t>(b) * out_size + y) * out_size + x;
+                            rows[column * row_bytes + k] = quantizeActivation(plane[(b * size + iy) * size + ix], inverse_scale);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+QuantizedChessNet::Layer QuantizedChessNet::quantize(int in_channels, int out_channels, int kernel, int stride,
+                                                     const std::vector<float>& weight, const std::vector<float>& bias,
+                                                     float input_max) {
+    Layer layer;
+    layer.in_channels = in_channels;
+    layer.out_channels = out_channels;
+    layer.kernel = kernel;
+    layer.stride = stride;
+    layer.padding = kernel / 2;
+    int fan_in = in_channels * kernel * kernel;
+    layer.row_bytes = (fan_in + INT8_K_ALIGN - 1) / INT8_K_ALIGN * INT8_K_ALIGN;
+    layer.input_scale = input_max > 0.0f ? input_max / 127.0f : 1.0f;
+    layer.weight.assign(static_cast<size_t>(out_channels) * layer.row_bytes, 0);
+    layer.scale.resize(out_channels);
+    layer.bias = bias;
+
+    for (int o = 0; o < out_channels; o++) {
+        const float* w = weight.data() + static_cast<size_t>(o) * fan_in;
+        float max_abs = 0.0f;
+        for (int i = 0; i < fan_in; i++) max_abs = std::max(max_abs, std::fabs(w[i]));
+        float weight_scale = max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+        for (int i = 0; i < fan_in; i++) {
+            layer.weight[static_cast<size_t>(o) * layer.row_bytes + i] = static_cast<int8_t>(std::lround(w[i] / weight_scale));
+        }
+        layer.scale[o] = weight_scale * layer.input_scale;
+    }
+    return layer;
+}
+
+QuantizedChessNet::QuantizedChessNet(const ChessNet& net, const float* calibration_inputs, int count) {
+    if (!net.isLoaded()) throw std::runtime_error("ChessNet weights are not loaded");
+    if (count <= 0) throw std::runtime_error("Int8 calibration needs at least one position");
+
+    ChessNet::ActivationRanges ranges;
+    std::vector<float> logits, values;
+    for (int start = 0; start < count; start += CALIBRATION_BATCH) {
+        int batch = std::min(CALIBRATION_BATCH, count - start);
+        logits.resize(static_cast<size_t>(batch) * ChessNet::POLICY_SIZE);
+        values.resize(batch);
+        ChessNet::ActivationRanges seen;
+        net.forward(calibration_inputs + static_cast<size_t>(start) * ChessNet::INPUT_PLANES * 64, batch,
+                    logits.data(), values.data(), &seen);
+        if (ranges.conv_inputs.empty()) ranges.conv_inputs.assign(seen.conv_inputs.size(), 0.0f);
+        for (size_t i = 0; i < seen.conv_inputs.size(); i++) {
+            ranges.conv_inputs[i] = std::max(ranges.conv_inputs[i], seen.conv_inputs[i]);
+        }
+        ranges.head_input = std::max(ranges.head_input, seen.head_input);
+    }
+
+    // Same layer order as ChessNet::forward records them
+    size_t next = 0;
+    auto quantizeConv = [&](const ChessNet::Conv& conv) {
+        return quantize(conv.in_channels, conv.out_channels, conv.kernel, conv.stride, conv.weight, conv.bias,
+                        ranges.conv_inputs[next++]);
+    };
+    stem = quantizeConv(net.stem);
+    for (const ChessNet::Block& source : net.blocks) {
+        Block block;
+        block.conv1 = quantizeConv(source.conv1);
+        block.has_downsample = source.has_downsample;
+        if (source.has_downsample) block.downsample = quantizeConv(source.downsample);
+        block.conv2 = quantizeConv(source.conv2);
+        blocks.push_back(std::move(block));
+    }
+    policy_fc = quantize(net.policy_fc.in_features, net.policy_fc.out_features, 1, 1, net.policy_fc.weight,
+                         net.policy_fc.bias, ranges.head_input);
+    value_fc1 = quantize(net.value_fc1.in_features, net.value_fc1.out_features, 1, 1, net.value_fc1.weight,
+                         net.value_fc1.bias, ranges.head_input);
+    value_fc2_weight = net.value_fc2.weight;
+    value_fc2_bias = net.value_fc2.bias[0];
+}
+
+int QuantizedChessNet::runLayer(const Layer& layer, const std::vector<float>& in, int batch, int size,
+                                std::vector<float>& out, const float* residual, bool relu) const {
+    int out_size = (size + 2 * layer.padding - layer.kernel) / layer.stride + 1;
+    int columns = batch * out_size * out_size;
+    std::vector<uint8_t> rows;
+    im2row(in, layer.in_channels, batch, size, layer.kernel, layer.stride, layer.padding, out_size,
+           layer.row_bytes, layer.input_scale, rows);
+
+    GemmEpilogue epilogue;
+    epilogue.bias = layer.bias.data();
+    epilogue.residual = residual;
+    epilogue.relu = relu;
+    out.resize(static_cast<size_t>(layer.out_channels) * columns);
+    gemmInt8(layer.out_channels, columns, layer.row_bytes, layer.weight.data(), rows.data(), layer.scale.data(),
+             out.data(), epilogue);
+    return out_size;
+}
+
+void QuantizedChessNet::forward(const float* input, int batch, float* policy_logits, float* values) const {
+    std::vector<float> x(static_cast<size_t>(ChessNet::INPUT_PLANES) * batch * 64);
+    for (int b = 0; b < batch; b++) {
+        for (int c = 0; c < ChessNet::INPUT_PLANES; c++) {
+            for (int i = 0; i < 64; i++) {
+                x[(static_cast<size_t>(c) * batch + b) * 64 + i] = input[(static_cast<size_t>(b) * ChessNet::INPUT_PLANES + c) * 64 + i];
+            }
+        }
+    }
+
+    std::vector<float> h, y, shortcut;
+    int size = runLayer(stem, x, batch, 8, y, nullptr, true);
+    for (const Block& block : blocks) {
+        x.swap(y);
+        int out_size = runLayer(block.conv1, x, batch, size, h, nullptr, true);
+        const float* residual = x.data();
+        if (block.has_downsample) {
+            runLayer(block.downsample, x, batch, size, shortcut, nullptr, false);
+            residual = shortcut.data();
+        }
+        runLayer(block.conv2, h, batch, out_size, y, residual, true);
+        size = out_size;
+    }
+
+    // Global average pooling -> features [512][batch], i.e. 512 channels of a 1x1 image
+    int channels = blocks.back().conv2.out_channels;
+    int area = size * size;
+    std::vector<float> features(static_cast<size_t>(channels) * batch);
+    for (int c = 0; c < channels; c++) {
+        for (int b = 0; b < batch; b++) {
+            float sum = 0.0f;
+            for (int i = 0; i < area; i++) sum += y[(static_cast<size_t>(c) * batch + b) * area + i];
+            features[static_cast<size_t>(c) * batch + b] = sum / area;
+        }
+    }
+
+    std::vector<float> policy;
+    runLayer(policy_fc, features, batch, 1, policy, nullptr, false);
+    for (int b = 0; b < batch; b++) {
+        for (int i = 0; i < ChessNet::POLICY_SIZE; i++) {
+            policy_logits[static_cast<size_t>(b) * ChessNet::POLICY_SIZE + i] = policy[static_cast<size_t>(i) * batch + b];
+        }
+    }
+
+    std::vector<float> hidden;
+    runLayer(value_fc1, features, batch, 1, hidden, nullptr, true);
+    for (int b = 0; b < batch; b++) {
+        float sum = value_fc2_bias;
+        for (size_t i = 0; i < value_fc2_weight.size(); i++) sum += value_fc2_weight[i] * hidden[i * batch + b];
+        values[b] = std::tanh(sum);
+    }
+}
+
+QuantizationReport compareQuantized(const ChessNet& net, const QuantizedChessNet& quantized,
+                                    const float* inputs, int count) {
+    QuantizationReport report;
+    std::vector<float> float_logits, float_values, int8_logits, int8_values;
+    int agreements = 0;
+    double error_sum = 0.0;
+    for (int start = 0; start < count; start += CALIBRATION_BATCH) {
+        int batch = std::min(CALIBRATION_BATCH, count - start);
+        const float* chunk = inputs + static_cast<size_t>(start) * ChessNet::INPUT_PLANES * 64;
+        float_logits.resize(static_cast<size_t>(batch) * ChessNet::POLICY_SIZE);
+        int8_logits.resize(float_logits.size());
+        float_values.resize(batch);
+        int8_values.resize(batch);
+        net.forward(chunk, batch, float_logits.data(), float_values.data());
+        quantized.forward(chunk, batch, int8_logits.data(), int8_values.data());
+
+        for (int b = 0; b < batch; b++) {
+            auto row = [&](const std::vector<float>& logits) { return logits.begin() + static_cast<size_t>(b) * ChessNet::POLICY_SIZE; };
+            auto float_best = std::max_element(row(float_logits), row(float_logits) + ChessNet::POLICY_SIZE) - row(float_logits);
+            auto int8_best = std::max_element(row(int8_logits), row(int8_logits) + ChessNet::POLICY_SIZE) - row(int8_logits);
+            if (float_best == int8_best) agreements++;
+            double error = std::fabs(float_values[b] - int8_values[b]);
+            error_sum += error;
+            report.value_max_error = std::max(report.value_max_error, error);
+        }
+    }
+    report.positions = count;
+    if (count > 0) {
+        report.policy_top1_agreement = static_cast<double>(agreements) / count;
+        report.value_mae = error_sum / count;
+    }
+    return report;
+}
@@ -0,0 +1,58 @@
+// chessnet_int8.h
+#pragma once
+#include "chessnet.h"
+#include <cstdint>
+#include <vector>
+
+// Post-training int8 version of a loaded ChessNet. Weights are quantized per output channel
+// (scale = max|w| / 127). Each layer's input is quantized to 7 bits, using a per-tensor scale
+// taken from the largest activation seen while the fp32 net ran over calibration positions.
+// All inputs are post-ReLU, so they are unsigned. Convolutions and the policy and value_fc1
+// heads run as u8 x s8 dot products (gemmInt8); the residual adds and the 256 -> 1 value
+// output stay in fp32.
+class QuantizedChessNet {
+public:
+    // calibration_inputs: [count][25][8][8] encoded positions, e.g. from the replay buffer
+    QuantizedChessNet(const ChessNet& net, const float* calibration_inputs, int count);
+
+    // Same contract as ChessNet::forward
+    void forward(const float* input, int batch, float* policy_logits, float* values) const;
+
+private:
+    // Convolution (or a linear layer as a 1x1 convolution over a 1x1 input)
+    struct Layer {
+        int in_channels = 0, out_channels = 0, kernel = 1, stride = 1, padding = 0;
+        int row_bytes = 0;             // in_channels * kernel * kernel rounded up to INT8_K_ALIGN
+        float input_scale = 1.0f;      // real value of one input step
+        std::vector<int8_t> weight;    // [out][row_bytes]
+        std::vector<float> scale;      // [out] weight scale * input scale
+        std::vector<float> bias;       // [out]
+    };
+    struct Block {
+        Layer conv1, conv2;
+        bool has_downsample = false;
+        Layer downsample;
+    };
+
+    Layer stem;
+    std::vector<Block> blocks;
+    Layer policy_fc, value_fc1;
+    std::vector<float> value_fc2_weight;
+    float value_fc2_bias = 0.0f;
+
+    static Layer quantize(int in_channels, int out_channels, int kernel, int stride,
+                          const std::vector<float>& weight, const std::vector<float>& bias, float input_max);
+    int runLayer(const Layer& layer, const std::vector<float>& in, int batch, int size,
+                 std::vector<float>& out, const float* residual, bool relu) const;
+};
+
+// Agreement of the int8 network with the fp32 one over a set of encoded positions
+struct QuantizationReport {
+    int positions = 0;
+    double policy_top1_agreement = 0.0;  // fraction with the same argmax over all 4672 logits
+    double value_mae = 0.0;
+    double value_max_error = 0.0;
+};
+
+QuantizationReport compareQuantized(const ChessNet& net, const QuantizedChessNet& quantized,
+                                    const float* inputs, int count);
@@ -0,0 +1,125 @@
+#include "evalcache.h"
+#include "instrument.h"
+#include <algorithm>
+#include <cmath>
+
+EvalCache::EvalCache(size_t max_bytes, int shards) : max_bytes(max_bytes) {
+    shard_count = 1;
+    while (shard_count < shards) shard_count *= 2;
+    this->shards = std::make_unique<Shard[]>(shard_count);
+}
+
+size_t EvalCache::entryBytes(size_t num_moves) {
+    // Entry and list node, hash map node and bucket, and the prior array
+    return sizeof(Entry) + 2 * sizeof(void*) + sizeof(uint64_t) + 3 * sizeof(void*) + num_moves * sizeof(uint16_t);
+}
+
+bool EvalCache::lookup(uint64_t key, size_t num_moves, EvalResult& result) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    INSTRUMENT_COUNT(CACHE_PROBES, 1);
+    auto it = shard.index.find(key);
+    // A different move count means a hash collision; treat it as a miss
+    if (it == shard.index.end() || it->second->priors.size() != num_moves) {
+        shard.misses++;
+        return false;
+    }
+    shard.hits++;
+    INSTRUMENT_COUNT(CACHE_HITS, 1);
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    const Entry& entry = *it->second;
+    result.value = entry.value;
+    result.priors.resize(num_moves);
+    float sum = 0.0f;
+    for (size_t i = 0; i < num_moves; i++) sum += result.priors[i] = entry.priors[i];
+    for (float& p : result.priors) p = sum > 0.0f ? p / sum : 1.0f / num_moves;
+    return true;
+}
+
+void EvalCache::insert(uint64_t key, const EvalResult& result) {
+    Entry entry;
+    entry.key = key;
+    entry.value = result.value;
+    entry.priors.resize(result.priors.size());
+    for (size_t i = 0; i < result.priors.size(); i++) {
+        float p = std::min(std::max(result.priors[i], 0.0f), 1.0f);
+        entry.priors[i] = static_cast<uint16_t>(std::lround(p * 65535.0f));
+    }
+
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        shard.bytes -= entryBytes(it->second->priors.size());
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+    }
+    shard.bytes += entryBytes(entry.priors.size());
+    shard.lru.push_front(std::move(entry));
+    shard.index[key] = shard.lru.begin();
+    shard.inserts++;
+    evict(shard, shardBudget());
+}
+
+void EvalCache::evict(Shard& shard, size_t budget) {
+    while (shard.bytes > budget && !shard.lru.empty()) {
+        const Entry& oldest = shard.lru.back();
+        shard.bytes -= entryBytes(oldest.priors.size());
+        shard.index.erase(oldest.key);
+        shard.lru.pop_back();
+        shard.evictions++;
+    }
+}
+
+EvalCache::Stats EvalCache::stats() const {
+    Stats total;
+    total.max_bytes = max_bytes;
+    for (int i = 0; i < shard_count; i++) {
+        const Shard& shard = shards[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total.hits += shard.hits;
+        total.misses += shard.misses;
+        total.inserts += shard.inserts;
+        total.evictions += shard.evictions;
+        total.entries += shard.lru.size();
+        total.bytes += shard.bytes;
+    }
+    return total;
+}
+
+void EvalCache::clear() {
+    for (int i = 0; i < shard_count; i++) {
+        Shard& shard = shards[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.lru.clear();
+        shard.index.clear();
+        shard.bytes = 0;
+        shard.hits = shard.misses = shard.inserts = shard.evictions = 0;
+    }
+}
+
+void EvalCache::setMaxBytes(size_t max_bytes) {
+    this->max_bytes = max_bytes;
+    for (int i = 0; i < shard_count; i++) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        evict(shards[i], shardBudget());
+    }
+}
+
+void CachedEvaluator::evaluate(const std::vector<EvalRequest>& batch, std::vector<EvalResult>& results) {
+    results.resize(batch.size());
+    misses.clear();
+    miss_slots.clear();
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (!cache.lookup(EvalCache::key(batch[i]), batch[i].moves.size(), results[i])) {
+            misses.push_back(batch[i]);
+            miss_slots.push_back(i);
+        }
+    }
+    if (misses.empty()) return;
+    inner.evaluate(misses, miss_results);
+    for (size_t j = 0; j < misses.size(); j++) {
+        cache.insert(EvalCache::key(misses[j]), miss_results[j]);
+        results[miss_slots[j]] = std::move(miss_results[j]);
+    }
+}
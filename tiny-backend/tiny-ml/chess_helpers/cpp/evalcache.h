@@ -0,0 +1,85 @@
+// evalcache.h
+#pragma once
+#include "mcts.h"
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Bounded cache of evaluator results, shared by every search that uses it (several
+// MCTS instances, consecutive moves of a game, self-play games with the same openings).
+// Keys combine the position's Zobrist hash with the previous position's, since the
+// network sees both. Priors are stored as 16-bit fixed point in legal-move order.
+// Entries are spread over independently locked shards, each evicting least recently
+// used entries once it exceeds its share of the memory cap.
+class EvalCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t inserts = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+        size_t max_bytes = 0;
+    };
+
+    // shards is rounded up to a power of two
+    explicit EvalCache(size_t max_bytes = 64ULL << 20, int shards = 64);
+
+    static uint64_t key(uint64_t hash, uint64_t previous_hash) { return hash ^ (previous_hash * 0x9E3779B97F4A7C15ULL); }
+    static uint64_t key(const EvalRequest& request) {
+        return key(request.board.hash, request.has_previous ? request.previous.hash : 0);
+    }
+
+    // On a hit fills `result` (priors for `num_moves` moves) and marks the entry recently used
+    bool lookup(uint64_t key, size_t num_moves, EvalResult& result);
+    void insert(uint64_t key, const EvalResult& result);
+
+    Stats stats() const;
+    void clear();
+    // Change the memory cap, evicting as needed
+    void setMaxBytes(size_t max_bytes);
+
+private:
+    struct Entry {
+        uint64_t key;
+        float value;
+        std::vector<uint16_t> priors;
+    };
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> lru;  // most recently used first
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+        size_t bytes = 0;
+        uint64_t hits = 0, misses = 0, inserts = 0, evictions = 0;
+    };
+
+    std::unique_ptr<Shard[]> shards;
+    int shard_count;
+    std::atomic<size_t> max_bytes;
+
+    // High bits pick the shard; the low bits are left to each shard's hash map
+    Shard& shardFor(uint64_t key) { return shards[(key >> 40) & (shard_count - 1)]; }
+    size_t shardBudget() const { return max_bytes / shard_count; }
+    static size_t entryBytes(size_t num_moves);
+    void evict(Shard& shard, size_t budget);
+};
+
+// Evaluator decorator: answers what it can from the cache and sends the rest to `inner`
+// as one smaller batch
+class CachedEvaluator : public Evaluator {
+public:
+    CachedEvaluator(Evaluator& inner, EvalCache& cache) : inner(inner), cache(cache) {}
+    void evaluate(const std::vector<EvalRequest>& batch, std::vector<EvalResult>& results) override;
+
+private:
+    Evaluator& inner;
+    EvalCache& cache;
+    std::vector<EvalRequest> misses;
+    std::vector<size_t> miss_slots;
+    std::vector<EvalResult> miss_results;
+};
@@ -0,0 +1,281 @@
+#include "evaluate.h"
+#include "bitboard.h"
+#include "bitmasks.h"
+
+namespace {
+
+// Piece values per phase, indexed by Piece::Type
+constexpr int MATERIAL_MG[7] = {0, 82, 337, 365, 477, 1025, 0};
+constexpr int MATERIAL_EG[7] = {0, 94, 281, 297, 512, 936, 0};
+
+// Piece-square tables from white's point of view, written rank 8 first so they read
+// like a diagram. Square s (a1 = 0) of a white piece uses entry s ^ 56.
+constexpr int PAWN_MG[64] = {
+      0,   0,   0,   0,   0,   0,   0,   0,
+     50,  50,  50,  50,  50,  50,  50,  50,
+     10,  10,  20,  30,  30,  20,  10,  10,
+      5,   5,  10,  25,  25,  10,   5,   5,
+      0,   0,   0,  20,  20,   0,   0,   0,
+      5,  -5, -10,   0,   0, -10,  -5,   5,
+      5,  10,  10, -20, -20,  10,  10,   5,
+      0,   0,   0,   0,   0,   0,   0,   0,
+};
+constexpr int PAWN_EG[64] = {
+      0,   0,   0,   0,   0,   0,   0,   0,
+     80,  80,  80,  80,  80,  80,  80,  80,
+     50,  50,  50,  50,  50,  50,  50,  50,
+     30,  30,  30,  30,  30,  30,  30,  30,
+     15,  15,  15,  15,  15,  15,  15,  15,
+      5,   5,   5,   5,   5,   5,   5,   5,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+};
+constexpr int KNIGHT_PSQ[64] = {
+    -50, -40, -30, -30, -30, -30, -40, -50,
+    -40, -20,   0,   0,   0,   0, -20, -40,
+    -30,   0,  10,  15,  15,  10,   0, -30,
+    -30,   5,  15,  20,  20,  15,   5, -30,
+    -30,   0,  15,  20,  20,  15,   0, -30,
+    -30,   5,  10,  15,  15,  10,   5, -30,
+    -40, -20,   0,   5,   5,   0, -20, -40,
+    -50, -40, -30, -30, -30, -30, -40, -50,
+};
+constexpr int BISHOP_PSQ[64] = {
+    -20, -10, -10, -10, -10, -10, -10, -20,
+    -10,   0,   0,   0,   0,   0,   0, -10,
+    -10,   0,   5,  10,  10,   5,   0, -10,
+    -10,   5,   5,  10,  10,   5,   5, -10,
+    -10,   0,  10,  10,  10,  10,   0, -10,
+    -10,  10,  10,  10,  10,  10,  10, -10,
+    -10,   5,   0,   0,   0,   0,   5, -10,
+    -20, -10, -10, -10, -10, -10, -10, -20,
+};
+constexpr int ROOK_PSQ[64] = {
+      0,   0,   0,   0,   0,   0,   0,   0,
+      5,  10,  10,  10,  10,  10,  10,   5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+      0,   0,   0,   5,   5,   0,   0,   0,
+};
+constexpr int QUEEN_PSQ[64] = {
+    -20, -10, -10,  -5,  -5, -10, -10, -20,
+    -10,   0,   0,   0,   0,   0,   0, -10,
+    -10,   0,   5,   5,   5,   5,   0, -10,
+     -5,   0,   5,   5,   5,   5,   0,  -5,
+      0,   0,   5,   5,   5,   5,   0,  -5,
+    -10,   5,   5,   5,   5,   5,   0, -10,
+    -10,   0,   5,   0,   0,   0,   0, -10,
+    -20, -10, -10,  -5,  -5, -10, -10, -20,
+};
+constexpr int KING_MG[64] = {
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -20, -30, -30, -40, -40, -30, -30, -20,
+    -10, -20, -20, -20, -20, -20, -20, -10,
+     20,  20,   0,   0,   0,   0,  20,  20,
+     20,  30,  10,   0,   0,  10,  30,  20,
+};
+constexpr int KING_EG[64] = {
+    -50, -40, -30, -20, -20, -30, -40, -50,
+    -30, -20, -10,   0,   0, -10, -20, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -30,   0,   0,   0,   0, -30, -30,
+    -50, -30, -30, -30, -30, -30, -30, -50,
+};
+
+constexpr const int* PSQ_TABLE_MG[7] = {nullptr, PAWN_MG, KNIGHT_PSQ, BISHOP_PSQ, ROOK_PSQ, QUEEN_PSQ, KING_MG};
+constexpr const int* PSQ_TABLE_EG[7] = {nullptr, PAWN_EG, KNIGHT_PSQ, BISHOP_PSQ, ROOK_PSQ, QUEEN_PSQ, KING_EG};
+
+// Mobility: bonus per safe square beyond a typical count, per Piece::Type
+constexpr int MOBILITY_BASE[7] = {0, 0, 4, 6, 7, 13, 0};
+constexpr int MOBILITY_MG[7]   = {0, 0, 4, 5, 2, 1, 0};
+constexpr int MOBILITY_EG[7]   = {0, 0, 4, 5, 4, 2, 0};
+
+// Pawn structure
+constexpr int DOUBLED_MG = -10, DOUBLED_EG = -20;
+constexpr int ISOLATED_MG = -10, ISOLATED_EG = -15;
+// Passed pawn bonus by rank relative to the pawn's own side (rank 2 = index 1)
+constexpr int PASSED_MG[8] = {0, 5, 10, 15, 25, 40, 60, 0};
+constexpr int PASSED_EG[8] = {0, 10, 20, 35, 55, 85, 120, 0};
+
+// King safety (middlegame only): attack units per piece hitting the king zone
+constexpr int KING_ATTACK_UNITS[7] = {0, 0, 2, 2, 3, 5, 0};
+constexpr int PAWN_SHIELD_MISSING = -15;
+
+constexpr int BISHOP_PAIR_MG = 30, BISHOP_PAIR_EG = 50;
+constexpr int TEMPO = 10;
+
+constexpr Bitboard FILE_MASKS[8] = {
+    Bitmasks::FILE_A, Bitmasks::FILE_B, Bitmasks::FILE_C, Bitmasks::FILE_D,
+    Bitmasks::FILE_E, Bitmasks::FILE_F, Bitmasks::FILE_G, Bitmasks::FILE_H,
+};
+
+inline int popcount(Bitboard b) { return __builtin_popcountll(b); }
+inline int lsb(Bitboard b) { return __builtin_ctzll(b); }
+
+Bitboard adjacentFiles(int file) {
+    Bitboard mask = 0;
+    if (file > 0) mask |= FILE_MASKS[file - 1];
+    if (file < 7) mask |= FILE_MASKS[file + 1];
+    return mask;
+}
+
+// Squares in front of `square` (towards the promotion rank) on its own and adjacent files
+Bitboard passedSpan(Square square, bool white) {
+    int file = square % 8;
+    Bitboard files = FILE_MASKS[file] | adjacentFiles(file);
+    int rank = square / 8;
+    Bitboard ahead = white ? (rank == 7 ? 0 : ~0ULL << (8 * (rank + 1)))
+                           : (rank == 0 ? 0 : ~0ULL >> (8 * (8 - rank)));
+    return files & ahead;
+}
+
+Bitboard pawnAttacks(Bitboard pawns, bool white) {
+    if (white) return ((pawns & Bitmasks::NOT_A_FILE) << 7) | ((pawns & Bitmasks::NOT_H_FILE) << 9);
+    return ((pawns & Bitmasks::NOT_H_FILE) >> 7) | ((pawns & Bitmasks::NOT_A_FILE) >> 9);
+}
+
+struct Score {
+    int mg = 0;
+    int eg = 0;
+    void add(int m, int e) { mg += m; eg += e; }
+};
+
+Score pawnStructure(Bitboard own, Bitboard enemy, bool white) {
+    Score score;
+    for (int file = 0; file < 8; file++) {
+        int count = popcount(own & FILE_MASKS[file]);
+        if (count > 1) score.add(DOUBLED_MG * (count - 1), DOUBLED_EG * (count - 1));
+        if (count > 0 && !(own & adjacentFiles(file))) score.add(ISOLATED_MG * count, ISOLATED_EG * count);
+    }
+    for (Bitboard pawns = own; pawns; pawns &= pawns - 1) {
+        Square sq = lsb(pawns);
+        if (enemy & passedSpan(sq, white)) continue;
+        int relative_rank = white ? sq / 8 : 7 - sq / 8;
+        score.add(PASSED_MG[relative_rank], PASSED_EG[relative_rank]);
+    }
+    return score;
+}
+
+// Mobility plus the attack units this side's pieces put on the enemy king zone
+Score piecesAndKingAttack(const ChessBitboard& board, Piece::Color us, Bitboard occupancy) {
+    bool white = (us == Piece::Color::WHITE);
+    Piece::Color them = white ? Piece::Color::BLACK : Piece::Color::WHITE;
+    Bitboard own = white ? board.getWhitePieces() : board.getBlackPieces();
+    Bitboard safe = ~own & ~pawnAttacks(board.getPieces(them, Piece::Type::PAWN), !white);
+    Bitboard enemy_king = board.getPieces(them, Piece::Type::KING);
+    Bitboard king_zone = enemy_king ? board.king_attacks[lsb(enemy_king)] | enemy_king : 0;
+
+    Score score;
+    int attack_units = 0;
+    int attackers = 0;
+    for (int t = Piece::Type::KNIGHT; t <= Piece::Type::QUEEN; t++) {
+        Piece::Type type = static_cast<Piece::Type>(t);
+        for (Bitboard pieces = board.getPieces(us, type); pieces; pieces &= pieces - 1) {
+            Square sq = lsb(pieces);
+            Bitboard attacks;
+            switch (type) {
+                case Piece::Type::KNIGHT: attacks = board.knight_attacks[sq]; break;
+                case Piece::Type::BISHOP: attacks = Bmagic(sq, occupancy); break;
+                case Piece::Type::ROOK:   attacks = Rmagic(sq, occupancy); break;
+                default:                  attacks = Qmagic(sq, occupancy); break;
+            }
+            int mobility = popcount(attacks & safe) - MOBILITY_BASE[type];
+            score.add(mobility * MOBILITY_MG[type], mobility * MOBILITY_EG[type]);
+            if (attacks & king_zone) {
+                attackers++;
+                attack_units += KING_ATTACK_UNITS[type] * popcount(attacks & king_zone);
+            }
+        }
+    }
+    // A lone attacker is rarely dangerous; the penalty grows quadratically with the pressure
+    if (attackers >= 2) {
+        int danger = attack_units * attack_units;
+        score.mg += danger > 500 ? 500 : danger;
+    }
+    return score;
+}
+
+int pawnShield(Square king, Bitboard own_pawns, bool white) {
+    int file = king % 8;
+    int rank = king / 8;
+    // Only a king tucked away on a wing is expected to keep its pawns in front of it
+    if (file >= 3 && file <= 4) return 0;
+    Bitboard ranks = 0;
+    for (int step = 1; step <= 2; step++) {
+        int r = white ? rank + step : rank - step;
+        if (r >= 0 && r < 8) ranks |= Bitmasks::RANK_1 << (8 * r);
+    }
+    int missing = 0;
+    for (int f = (file > 0 ? file - 1 : 0); f <= (file < 7 ? file + 1 : 7); f++) {
+        if (!(own_pawns & FILE_MASKS[f] & ranks)) missing++;
+    }
+    return missing * PAWN_SHIELD_MISSING;
+}
+
+struct PsqInit {
+    PsqInit() {
+        for (int t = Piece::Type::PAWN; t <= Piece::Type::KING; t++) {
+            Piece white_piece(Piece::Color::WHITE, static_cast<Piece::Type>(t));
+            Piece black_piece(Piece::Color::BLACK, static_cast<Piece::Type>(t));
+            for (int sq = 0; sq < 64; sq++) {
+                // Black mirrors the board vertically
+                Eval::PSQ_MG[white_piece.raw()][sq] = MATERIAL_MG[t] + PSQ_TABLE_MG[t][sq ^ 56];
+                Eval::PSQ_EG[white_piece.raw()][sq] = MATERIAL_EG[t] + PSQ_TABLE_EG[t][sq ^ 56];
+                Eval::PSQ_MG[black_piece.raw()][sq] = -(MATERIAL_MG[t] + PSQ_TABLE_MG[t][sq]);
+                Eval::PSQ_EG[black_piece.raw()][sq] = -(MATERIAL_EG[t] + PSQ_TABLE_EG[t][sq]);
+            }
+        }
+    }
+};
+
+} // namespace
+
+namespace Eval {
+
+int PSQ_MG[16][64];
+int PSQ_EG[16][64];
+
+int evaluate(const ChessBitboard& board) {
+    Score score{board.psq_mg, board.psq_eg};
+    Bitboard occupancy = board.getAllPieces();
+
+    Score white_pawns = pawnStructure(board.white_pawns, board.black_pawns, true);
+    Score black_pawns = pawnStructure(board.black_pawns, board.white_pawns, false);
+    score.add(white_pawns.mg - black_pawns.mg, white_pawns.eg - black_pawns.eg);
+
+    // Mobility for the side, king danger against the opponent
+    Score white_pieces = piecesAndKingAttack(board, Piece::Color::WHITE, occupancy);
+    Score black_pieces = piecesAndKingAttack(board, Piece::Color::BLACK, occupancy);
+    score.add(white_pieces.mg - black_pieces.mg, white_pieces.eg - black_pieces.eg);
+
+    if (board.white_king && board.black_king) {
+        score.mg += pawnShield(lsb(board.white_king), board.white_pawns, true);
+        score.mg -= pawnShield(lsb(board.black_king), board.black_pawns, false);
+    }
+
+    if (popcount(board.white_bishops) >= 2) score.add(BISHOP_PAIR_MG, BISHOP_PAIR_EG);
+    if (popcount(board.black_bishops) >= 2) score.add(-BISHOP_PAIR_MG, -BISHOP_PAIR_EG);
+
+    int phase = board.game_phase < MAX_PHASE ? board.game_phase : MAX_PHASE;
+    int blended = (score.mg * phase + score.eg * (MAX_PHASE - phase)) / MAX_PHASE;
+    return (board.white_to_move ? blended : -blended) + TEMPO;
+}
+
+} // namespace Eval
+
+namespace {
+PsqInit psq_init;
+}
+
+int ChessBitboard::evaluate() const {
+    return Eval::evaluate(*this);
+}
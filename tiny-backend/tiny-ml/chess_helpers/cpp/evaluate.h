@@ -0,0 +1,23 @@
+// evaluate.h
+#pragma once
+#include "types.h"
+#include "piece.h"
+
+class ChessBitboard;
+
+// Hand-crafted, tapered evaluation. Every term is kept as a middlegame and an endgame
+// score and blended by the game phase (24 = all minor and major pieces on the board).
+namespace Eval {
+    constexpr int MAX_PHASE = 24;
+
+    // Material + piece-square value of a piece (indexed by Piece::raw()) on a square.
+    // White pieces are positive and black pieces negative, so the board can keep a
+    // single running sum per phase in setPiece/clearSquare.
+    extern int PSQ_MG[16][64];
+    extern int PSQ_EG[16][64];
+    // Phase weight per Piece::Type
+    constexpr int PHASE_WEIGHT[7] = {0, 0, 1, 1, 2, 4, 0};
+
+    // Full evaluation in centipawns from the side to move's point of view
+    int evaluate(const ChessBitboard& board);
+}
@@ -0,0 +1,204 @@
+#include "gemm.h"
+#include <algorithm>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+inline float finish(float sum, int m, int n, int N, const GemmEpilogue& ep) {
+    if (ep.bias) sum += ep.bias[m];
+    if (ep.residual) sum += ep.residual[static_cast<size_t>(m) * N + n];
+    return (ep.relu && sum < 0.0f) ? 0.0f : sum;
+}
+
+// Rows [m0, m1) x columns [n0, n1), one dot product at a time
+void scalarTile(int m0, int m1, int n0, int n1, int N, int K, const float* A, const float* B,
+                float* C, const GemmEpilogue& ep) {
+    for (int m = m0; m < m1; m++) {
+        for (int n = n0; n < n1; n++) {
+            float sum = 0.0f;
+            for (int k = 0; k < K; k++) sum += A[static_cast<size_t>(m) * K + k] * B[static_cast<size_t>(k) * N + n];
+            C[static_cast<size_t>(m) * N + n] = finish(sum, m, n, N, ep);
+        }
+    }
+}
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+inline __m256 epilogue8(__m256 acc, int m, int n, int N, const GemmEpilogue& ep) {
+    if (ep.bias) acc = _mm256_add_ps(acc, _mm256_set1_ps(ep.bias[m]));
+    if (ep.residual) acc = _mm256_add_ps(acc, _mm256_loadu_ps(ep.residual + static_cast<size_t>(m) * N + n));
+    if (ep.relu) acc = _mm256_max_ps(acc, _mm256_setzero_ps());
+    return acc;
+}
+
+// 4 rows x 16 columns of C kept in eight ymm accumulators over the whole K loop.
+// `panel` is columns [n, n + 16) of B packed into K contiguous rows of 16.
+void kernel4x16(int m, int n, int N, int K, const float* A, const float* panel, float* C, const GemmEpilogue& ep) {
+    __m256 c[4][2];
+    for (int r = 0; r < 4; r++) c[r][0] = c[r][1] = _mm256_setzero_ps();
+    const float* a = A + static_cast<size_t>(m) * K;
+    for (int k = 0; k < K; k++) {
+        const float* b = panel + static_cast<size_t>(k) * 16;
+        __m256 b0 = _mm256_loadu_ps(b);
+        __m256 b1 = _mm256_loadu_ps(b + 8);
+        for (int r = 0; r < 4; r++) {
+            __m256 av = _mm256_broadcast_ss(a + static_cast<size_t>(r) * K + k);
+            c[r][0] = _mm256_fmadd_ps(av, b0, c[r][0]);
+            c[r][1] = _mm256_fmadd_ps(av, b1, c[r][1]);
+        }
+    }
+    for (int r = 0; r < 4; r++) {
+        float* out = C + static_cast<size_t>(m + r) * N + n;
+        _mm256_storeu_ps(out, epilogue8(c[r][0], m + r, n, N, ep));
+        _mm256_storeu_ps(out + 8, epilogue8(c[r][1], m + r, n + 8, N, ep));
+    }
+}
+
+void kernel4x8(int m, int n, int N, int K, const float* A, const float* panel, float* C, const GemmEpilogue& ep) {
+    __m256 c[4];
+    for (int r = 0; r < 4; r++) c[r] = _mm256_setzero_ps();
+    const float* a = A + static_cast<size_t>(m) * K;
+    for (int k = 0; k < K; k++) {
+        __m256 b0 = _mm256_loadu_ps(panel + static_cast<size_t>(k) * 8);
+        for (int r = 0; r < 4; r++) {
+            c[r] = _mm256_fmadd_ps(_mm256_broadcast_ss(a + static_cast<size_t>(r) * K + k), b0, c[r]);
+        }
+    }
+    for (int r = 0; r < 4; r++) {
+        _mm256_storeu_ps(C + static_cast<size_t>(m + r) * N + n, epilogue8(c[r], m + r, n, N, ep));
+    }
+}
+
+inline float horizontalSum(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 0x55));
+    return _mm_cvtss_f32(s);
+}
+
+// Narrow matrices (the 1x1 spatial layers and the heads at small batch) and the right
+// edge of wider ones: transpose those columns of B so each output is a contiguous dot
+// product over K, reading every row of A once
+void narrowColumns(int n0, int M, int N, int K, const float* A, const float* B, float* C, const GemmEpilogue& ep) {
+    int width = N - n0;
+    std::vector<float> bt(static_cast<size_t>(width) * K);
+    for (int k = 0; k < K; k++) {
+        for (int j = 0; j < width; j++) bt[static_cast<size_t>(j) * K + k] = B[static_cast<size_t>(k) * N + n0 + j];
+    }
+    for (int m = 0; m < M; m++) {
+        const float* a = A + static_cast<size_t>(m) * K;
+        for (int j = 0; j < width; j++) {
+            const float* b = bt.data() + static_cast<size_t>(j) * K;
+            __m256 acc = _mm256_setzero_ps();
+            int k = 0;
+            for (; k + 8 <= K; k += 8) acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + k), _mm256_loadu_ps(b + k), acc);
+            float sum = horizontalSum(acc);
+            for (; k < K; k++) sum += a[k] * b[k];
+            C[static_cast<size_t>(m) * N + n0 + j] = finish(sum, m, n0 + j, N, ep);
+        }
+    }
+}
+
+#endif
+
+#if defined(__AVX2__)
+
+// acc += four-way u8 x s8 dot products per 32-bit lane
+inline __m256i dot4(__m256i acc, __m256i u8, __m256i s8) {
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+    return _mm256_dpbusd_epi32(acc, u8, s8);
+#else
+    __m256i pairs = _mm256_maddubs_epi16(u8, s8);
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(pairs, _mm256_set1_epi16(1)));
+#endif
+}
+
+inline int32_t horizontalSum(__m256i v) {
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+    return _mm_cvtsi128_si32(s);
+}
+
+// ROWS weight rows x COLS activation columns, each output a dot product over K
+template <int ROWS, int COLS>
+void int8Tile(int m, int n, int N, int K, const int8_t* A, const uint8_t* Bt, const float* scale, float* C,
+              const GemmEpilogue& ep) {
+    __m256i acc[ROWS][COLS];
+    for (int r = 0; r < ROWS; r++)
+        for (int c = 0; c < COLS; c++) acc[r][c] = _mm256_setzero_si256();
+    for (int k = 0; k < K; k += INT8_K_ALIGN) {
+        __m256i b[COLS];
+        for (int c = 0; c < COLS; c++) b[c] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Bt + static_cast<size_t>(n + c) * K + k));
+        for (int r = 0; r < ROWS; r++) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(A + static_cast<size_t>(m + r) * K + k));
+            for (int c = 0; c < COLS; c++) acc[r][c] = dot4(acc[r][c], b[c], a);
+        }
+    }
+    for (int r = 0; r < ROWS; r++) {
+        for (int c = 0; c < COLS; c++) {
+            C[static_cast<size_t>(m + r) * N + n + c] = finish(horizontalSum(acc[r][c]) * scale[m + r], m + r, n + c, N, ep);
+        }
+    }
+}
+
+#endif
+
+} // namespace
+
+void gemm(int M, int N, int K, const float* A, const float* B, float* C, const GemmEpilogue& epilogue) {
+#if defined(__AVX2__) && defined(__FMA__)
+    if (N < 16) {
+        narrowColumns(0, M, N, K, A, B, C, epilogue);
+        return;
+    }
+    int wide = N - N % 8;
+    int tall = M - M % 4;
+    // Column panels outermost: each K x 16 panel of B is packed once and stays in cache
+    // while all of A streams past it (unpacked, a row stride of N floats aliases in L1)
+    std::vector<float> panel(static_cast<size_t>(K) * 16);
+    int n = 0;
+    for (; n + 8 <= wide; n += 16) {
+        int width = (n + 16 <= wide) ? 16 : 8;
+        for (int k = 0; k < K; k++) {
+            std::copy(B + static_cast<size_t>(k) * N + n, B + static_cast<size_t>(k) * N + n + width,
+                      panel.begin() + static_cast<size_t>(k) * width);
+        }
+        for (int m = 0; m < tall; m += 4) {
+            if (width == 16) kernel4x16(m, n, N, K, A, panel.data(), C, epilogue);
+            else kernel4x8(m, n, N, K, A, panel.data(), C, epilogue);
+        }
+    }
+    scalarTile(tall, M, 0, wide, N, K, A, B, C, epilogue);
+    if (wide < N) narrowColumns(wide, M, N, K, A, B, C, epilogue);
+#else
+    scalarTile(0, M, 0, N, N, K, A, B, C, epilogue);
+#endif
+}
+
+void gemmInt8(int M, int N, int K, const int8_t* A, const uint8_t* Bt, const float* scale, float* C,
+              const GemmEpilogue& epilogue) {
+#if defined(__AVX2__)
+    int tall = M - M % 4;
+    int wide = N - N % 2;
+    for (int m = 0; m < tall; m += 4) {
+        for (int n = 0; n < wide; n += 2) int8Tile<4, 2>(m, n, N, K, A, Bt, scale, C, epilogue);
+        if (wide < N) int8Tile<4, 1>(m, wide, N, K, A, Bt, scale, C, epilogue);
+    }
+    for (int m = tall; m < M; m++) {
+        for (int n = 0; n < N; n++) int8Tile<1, 1>(m, n, N, K, A, Bt, scale, C, epilogue);
+    }
+#else
+    for (int m = 0; m < M; m++) {
+        for (int n = 0; n < N; n++) {
+            int32_t sum = 0;
+            for (int k = 0; k < K; k++) sum += A[static_cast<size_t>(m) * K + k] * Bt[static_cast<size_t>(n) * K + k];
+            C[static_cast<size_t>(m) * N + n] = finish(sum * scale[m], m, n, N, epilogue);
+        }
+    }
+#endif
+}
@@ -0,0 +1,26 @@
+// gemm.h
+#pragma once
+#include <cstdint>
+
+// Applied to each output element while its tile is still in registers, so a convolution
+// with folded BatchNorm, the residual add and the ReLU all happen in the GEMM's one pass.
+struct GemmEpilogue {
+    const float* bias = nullptr;      // [M], added to every column of row m
+    const float* residual = nullptr;  // [M][N], added before the ReLU
+    bool relu = false;
+};
+
+// C[M][N] = A[M][K] * B[K][N], all row-major, then the epilogue.
+// Uses an AVX2/FMA 4x16 register-tile kernel when compiled for it, scalar code otherwise.
+void gemm(int M, int N, int K, const float* A, const float* B, float* C,
+          const GemmEpilogue& epilogue = GemmEpilogue());
+
+// Rows of both int8 operands are zero-padded to a multiple of this many bytes
+constexpr int INT8_K_ALIGN = 32;
+
+// C[M][N] = scale[m] * (A[M][K] . Bt[N][K]), then the epilogue. A holds int8 weights and Bt
+// (B transposed, one activation column per row) uint8 activations in [0, 127]; K is the
+// padded row length. Seven-bit activations keep AVX2's maddubs pair sums below int16
+// saturation, so the AVX2, AVX-512 VNNI and scalar paths all produce the same integers.
+void gemmInt8(int M, int N, int K, const int8_t* A, const uint8_t* Bt, const float* scale, float* C,
+              const GemmEpilogue& epilogue = GemmEpilogue());
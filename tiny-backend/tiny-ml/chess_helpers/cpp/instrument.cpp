@@ -0,0 +1,180 @@
+#include "instrument.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+namespace instrument {
+
+namespace {
+
+// Blocks are never freed: a thread that exits hands its block to the next new thread,
+// totals included, so the list only grows to the peak number of live threads
+std::atomic<ThreadBlock*> blocks{nullptr};
+
+ThreadBlock* claimBlock() {
+    for (ThreadBlock* block = blocks.load(std::memory_order_acquire); block; block = block->next) {
+        bool free = false;
+        if (block->in_use.compare_exchange_strong(free, true, std::memory_order_acquire)) return block;
+    }
+    ThreadBlock* block = new ThreadBlock();
+    block->in_use.store(true, std::memory_order_relaxed);
+    block->next = blocks.load(std::memory_order_relaxed);
+    while (!blocks.compare_exchange_weak(block->next, block, std::memory_order_release, std::memory_order_relaxed)) {}
+    return block;
+}
+
+struct LocalBlock {
+    ThreadBlock* block = claimBlock();
+    ~LocalBlock() { block->in_use.store(false, std::memory_order_release); }
+};
+
+// reset() subtracts from here on instead of writing to blocks other threads own
+std::mutex baseline_mutex;
+Snapshot baseline;
+
+// Timestamp counter rate, from how far it and the steady clock moved since start-up
+const uint64_t start_ticks = timestamp();
+const auto start_time = std::chrono::steady_clock::now();
+
+double cyclesPerNs() {
+#if defined(__x86_64__) || defined(__i386__)
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_time).count();
+    return ns > 1e6 ? (timestamp() - start_ticks) / ns : 1.0;
+#else
+    return 1.0;  // timestamp() is already the steady clock in nanoseconds
+#endif
+}
+
+Snapshot totals() {
+    Snapshot total;
+    for (ThreadBlock* block = blocks.load(std::memory_order_acquire); block; block = block->next) {
+        for (int i = 0; i < COUNTER_COUNT; i++) total.counters[i] += block->counters[i].load(std::memory_order_relaxed);
+        for (int i = 0; i < PHASE_COUNT; i++) {
+            total.cycles[i] += block->cycles[i].load(std::memory_order_relaxed);
+            total.calls[i] += block->calls[i].load(std::memory_order_relaxed);
+        }
+    }
+    return total;
+}
+
+std::mutex dump_mutex;
+std::condition_variable dump_wake;
+bool dump_stop = false;
+std::thread dump_thread;
+// Ends a dump still running at exit, before its thread object is destroyed
+struct DumpStopper {
+    ~DumpStopper() { stopDump(); }
+} dump_stopper;
+
+void writeDump(const std::string& path) {
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        if (!out) return;
+        out << toJson(snapshot()) << "\n";
+    }
+    std::rename(temporary.c_str(), path.c_str());
+}
+
+}
+
+const char* name(Counter counter) {
+    static const char* const names[COUNTER_COUNT] = {
+        "search_nodes", "simulations", "legal_checks", "tt_probes", "tt_hits",
+        "cache_probes", "cache_hits", "batches", "batch_positions", "batch_capacity", "tb_hits",
+    };
+    return names[counter];
+}
+
+const char* name(Phase phase) {
+    static const char* const names[PHASE_COUNT] = {"movegen", "legality", "encode", "select", "evaluate", "backup"};
+    return names[phase];
+}
+
+bool enabled() {
+#ifdef CHESS_INSTRUMENT
+    return true;
+#else
+    return false;
+#endif
+}
+
+ThreadBlock& local() {
+    thread_local LocalBlock local_block;
+    return *local_block.block;
+}
+
+Snapshot snapshot() {
+    Snapshot total = totals();
+    std::lock_guard<std::mutex> lock(baseline_mutex);
+    for (int i = 0; i < COUNTER_COUNT; i++) total.counters[i] -= baseline.counters[i];
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        total.cycles[i] -= baseline.cycles[i];
+        total.calls[i] -= baseline.calls[i];
+    }
+    total.cycles_per_ns = cyclesPerNs();
+    return total;
+}
+
+void reset() {
+    Snapshot total = totals();
+    std::lock_guard<std::mutex> lock(baseline_mutex);
+    baseline = total;
+}
+
+std::string toJson(const Snapshot& snapshot) {
+    std::string json = "{\"enabled\": ";
+    json += enabled() ? "true" : "false";
+    json += ", \"counters\": {";
+    char number[64];
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        json += (i ? ", \"" : "\"") + std::string(name(static_cast<Counter>(i))) + "\": " + std::to_string(snapshot.counters[i]);
+    }
+    uint64_t capacity = snapshot.counters[BATCH_CAPACITY];
+    std::snprintf(number, sizeof(number), "%.4f", capacity ? double(snapshot.counters[BATCH_POSITIONS]) / capacity : 0.0);
+    json += std::string("}, \"batch_fill_ratio\": ") + number;
+    uint64_t probes = snapshot.counters[TT_PROBES];
+    std::snprintf(number, sizeof(number), "%.4f", probes ? double(snapshot.counters[TT_HITS]) / probes : 0.0);
+    json += std::string(", \"tt_hit_rate\": ") + number;
+    probes = snapshot.counters[CACHE_PROBES];
+    std::snprintf(number, sizeof(number), "%.4f", probes ? double(snapshot.counters[CACHE_HITS]) / probes : 0.0);
+    json += std::string(", \"cache_hit_rate\": ") + number + ", \"timers\": {";
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        std::snprintf(number, sizeof(number), "%.3f", snapshot.cycles[i] / snapshot.cycles_per_ns / 1e6);
+        json += (i ? ", \"" : "\"") + std::string(name(static_cast<Phase>(i))) + "\": {\"calls\": " +
+                std::to_string(snapshot.calls[i]) + ", \"cycles\": " + std::to_string(snapshot.cycles[i]) + ", \"ms\": " + number + "}";
+    }
+    std::snprintf(number, sizeof(number), "%.4f", snapshot.cycles_per_ns);
+    return json + "}, \"cycles_per_ns\": " + number + "}";
+}
+
+void startDump(const std::string& path, int interval_ms) {
+    stopDump();
+    std::lock_guard<std::mutex> lock(dump_mutex);
+    dump_stop = false;
+    dump_thread = std::thread([path, interval_ms] {
+        std::unique_lock<std::mutex> lock(dump_mutex);
+        while (!dump_wake.wait_for(lock, std::chrono::milliseconds(std::max(1, interval_ms)), [] { return dump_stop; })) {
+            lock.unlock();
+            writeDump(path);
+            lock.lock();
+        }
+        lock.unlock();
+        writeDump(path);  // final totals
+    });
+}
+
+void stopDump() {
+    {
+        std::lock_guard<std::mutex> lock(dump_mutex);
+        dump_stop = true;
+    }
+    dump_wake.notify_all();
+    if (dump_thread.joinable()) dump_thread.join();
+}
+
+}
@@ -0,0 +1,119 @@
+// instrument.h
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+// Hot-path counters and phase timers for finding where self-play time goes. Compiled in
+// only with -DCHESS_INSTRUMENT (CHESS_INSTRUMENT=1 python3 setup.py build_ext --inplace);
+// otherwise INSTRUMENT_COUNT and INSTRUMENT_TIMER expand to nothing and the hot paths
+// carry no trace of it.
+//
+// Every thread writes its own cache-line-aligned block, so updates are plain relaxed
+// stores with no locked instructions or sharing. Readers sum the blocks without
+// stopping the writers; totals are exact once the writers are idle.
+namespace instrument {
+
+enum Counter {
+    SEARCH_NODES,     // alpha-beta nodes
+    SIMULATIONS,      // MCTS simulations started
+    LEGAL_CHECKS,     // ChessBitboard::isLegal calls
+    TT_PROBES,
+    TT_HITS,
+    CACHE_PROBES,     // EvalCache lookups
+    CACHE_HITS,
+    BATCHES,          // evaluator calls made by MCTS batch queues
+    BATCH_POSITIONS,  // positions in those calls
+    BATCH_CAPACITY,   // room in those calls (batch_size each), for the fill ratio
+    TB_HITS,          // tablebase results used instead of searching or evaluating a position
+    COUNTER_COUNT
+};
+
+enum Phase {
+    MOVEGEN,   // generateLegalMoves, legality checks included
+    LEGALITY,  // isLegal
+    ENCODE,    // network input planes
+    SELECT,    // MCTS descent from the root to a leaf
+    EVALUATE,  // evaluator calls for MCTS batches
+    BACKUP,    // MCTS expansion and backup
+    PHASE_COUNT
+};
+
+const char* name(Counter counter);
+const char* name(Phase phase);
+
+struct Snapshot {
+    uint64_t counters[COUNTER_COUNT] = {};
+    uint64_t cycles[PHASE_COUNT] = {};
+    uint64_t calls[PHASE_COUNT] = {};
+    double cycles_per_ns = 1.0;  // timestamp counter rate, to turn cycles into time
+};
+
+// Whether this build was compiled with CHESS_INSTRUMENT
+bool enabled();
+// Totals over every thread since the last reset()
+Snapshot snapshot();
+void reset();
+std::string toJson(const Snapshot& snapshot);
+// Rewrite `path` with toJson(snapshot()) every `interval_ms` until stopDump() (or the
+// next startDump). The file is replaced atomically, so readers never see half of it.
+void startDump(const std::string& path, int interval_ms);
+void stopDump();
+
+struct alignas(64) ThreadBlock {
+    std::atomic<uint64_t> counters[COUNTER_COUNT] = {};
+    std::atomic<uint64_t> cycles[PHASE_COUNT] = {};
+    std::atomic<uint64_t> calls[PHASE_COUNT] = {};
+    std::atomic<bool> in_use{false};
+    ThreadBlock* next = nullptr;
+};
+
+// The calling thread's block, claimed on first use and handed back when the thread exits
+ThreadBlock& local();
+
+// Single writer per block, so a relaxed load and store is enough (no lock prefix)
+inline void bump(std::atomic<uint64_t>& value, uint64_t delta) {
+    value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+inline uint64_t timestamp() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+inline void add(Counter counter, uint64_t delta) { bump(local().counters[counter], delta); }
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Phase phase) : block(local()), phase(phase), start(timestamp()) {}
+    ~ScopedTimer() {
+        bump(block.cycles[phase], timestamp() - start);
+        bump(block.calls[phase], 1);
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    ThreadBlock& block;
+    Phase phase;
+    uint64_t start;
+};
+
+}
+
+#ifdef CHESS_INSTRUMENT
+#define INSTRUMENT_COUNT(counter, delta) ::instrument::add(::instrument::counter, (delta))
+// Times the rest of the enclosing scope; one per scope
+#define INSTRUMENT_TIMER(phase) ::instrument::ScopedTimer instrument_timer(::instrument::phase)
+#else
+#define INSTRUMENT_COUNT(counter, delta) ((void)0)
+#define INSTRUMENT_TIMER(phase) ((void)0)
+#endif
@@ -0,0 +1,152 @@
+// json.h
+#pragma once
+#include <cctype>
+#include <cstdio>
+#include <map>
+#include <string>
+
+// Just enough JSON for the move service (server.cpp, loadtest.cpp): one object's
+// members, with strings unescaped and every other value (numbers, literals, nested
+// objects and arrays) kept as its raw text.
+namespace json {
+
+namespace detail {
+
+inline void skipSpace(const std::string& text, size_t& pos) {
+    while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) pos++;
+}
+
+inline void appendUtf8(std::string& out, unsigned code) {
+    if (code < 0x80) {
+        out += static_cast<char>(code);
+    } else if (code < 0x800) {
+        out += static_cast<char>(0xC0 | code >> 6);
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else {
+        out += static_cast<char>(0xE0 | code >> 12);
+        out += static_cast<char>(0x80 | (code >> 6 & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+}
+
+// `pos` is on the opening quote; leaves it after the closing one
+inline bool parseString(const std::string& text, size_t& pos, std::string& out) {
+    out.clear();
+    for (pos++; pos < text.size(); pos++) {
+        char c = text[pos];
+        if (c == '"') {
+            pos++;
+            return true;
+        }
+        if (c != '\\') {
+            out += c;
+            continue;
+        }
+        if (++pos >= text.size()) return false;
+        switch (text[pos]) {
+            case '"': case '\\': case '/': out += text[pos]; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                if (pos + 4 >= text.size()) return false;
+                unsigned code = 0;
+                for (int i = 1; i <= 4; i++) {
+                    char h = text[pos + i];
+                    if (!std::isxdigit(static_cast<unsigned char>(h))) return false;
+                    code = code * 16 + (std::isdigit(static_cast<unsigned char>(h)) ? h - '0' : (std::tolower(h) - 'a' + 10));
+                }
+                appendUtf8(out, code);
+                pos += 4;
+                break;
+            }
+            default: return false;
+        }
+    }
+    return false;
+}
+
+// Any value other than a string, as raw text; nested containers are matched up to
+// their closing bracket
+inline bool skipValue(const std::string& text, size_t& pos) {
+    size_t start = pos;
+    int depth = 0;
+    std::string ignored;
+    while (pos < text.size()) {
+        char c = text[pos];
+        if (c == '"') {
+            if (!parseString(text, pos, ignored)) return false;
+            continue;
+        }
+        if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            if (depth == 0) break;
+            depth--;
+        } else if (depth == 0 && (c == ',' || std::isspace(static_cast<unsigned char>(c)))) {
+            break;
+        }
+        pos++;
+    }
+    return depth == 0 && pos > start;
+}
+
+}
+
+// Members of the object in `text` (later duplicates win). False on malformed input.
+inline bool parseObject(const std::string& text, std::map<std::string, std::string>& fields) {
+    size_t pos = 0;
+    detail::skipSpace(text, pos);
+    if (pos >= text.size() || text[pos] != '{') return false;
+    pos++;
+    detail::skipSpace(text, pos);
+    if (pos < text.size() && text[pos] == '}') return true;
+    while (pos < text.size()) {
+        std::string name, value;
+        detail::skipSpace(text, pos);
+        if (pos >= text.size() || text[pos] != '"' || !detail::parseString(text, pos, name)) return false;
+        detail::skipSpace(text, pos);
+        if (pos >= text.size() || text[pos++] != ':') return false;
+        detail::skipSpace(text, pos);
+        if (pos >= text.size()) return false;
+        if (text[pos] == '"') {
+            if (!detail::parseString(text, pos, value)) return false;
+        } else {
+            size_t start = pos;
+            if (!detail::skipValue(text, pos)) return false;
+            value = text.substr(start, pos - start);
+        }
+        fields[name] = value;
+        detail::skipSpace(text, pos);
+        if (pos >= text.size()) return false;
+        if (text[pos] == '}') return true;
+        if (text[pos++] != ',') return false;
+    }
+    return false;
+}
+
+inline std::string quote(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out + "\"";
+}
+
+}
@@ -0,0 +1,261 @@
+// loadtest.cpp
+// Load generator for the move service (chess_engine_loadtest, see build.sh). Each of
+// --clients threads plays its own game over a keep-alive connection: it posts the
+// position to /api/move, answers the engine's move with a random legal reply and starts
+// a new game when one ends. Reports requests/sec and latency percentiles over every
+// request. Works against server.py too, although that serves a single game.
+//
+//     ./chess_engine_loadtest --port 8080 --clients 32 --requests 20 [--movetime 100] [--json]
+#include "bitboard.h"
+#include "json.h"
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr const char* START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    int clients = 16;
+    int requests = 20;        // per client
+    int64_t movetime_ms = 0;  // sent with every move; 0 = the server's default budget
+    bool json = false;
+};
+
+struct ClientStats {
+    std::vector<double> latencies_ms;
+    int errors = 0;
+    int games = 0;
+};
+
+// Minimal blocking HTTP/1.1 client: one request at a time, reconnecting whenever the
+// server closes the connection
+class HttpClient {
+public:
+    HttpClient(const std::string& host, int port) : host(host), port(port) {}
+    ~HttpClient() { disconnect(); }
+
+    // Status code, or -1 on a connection failure
+    int post(const std::string& path, const std::string& body, std::string& response_body);
+
+private:
+    std::string host;
+    int port;
+    int fd = -1;
+    std::string buffer;
+
+    bool connect();
+    void disconnect();
+    bool sendAll(const std::string& data);
+    int readResponse(std::string& body, bool& close);
+};
+
+bool HttpClient::connect() {
+    addrinfo hints{}, *addresses = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) return false;
+    fd = socket(addresses->ai_family, addresses->ai_socktype, addresses->ai_protocol);
+    bool connected = fd >= 0 && ::connect(fd, addresses->ai_addr, addresses->ai_addrlen) == 0;
+    freeaddrinfo(addresses);
+    if (!connected) {
+        disconnect();
+        return false;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    buffer.clear();
+    return true;
+}
+
+void HttpClient::disconnect() {
+    if (fd >= 0) close(fd);
+    fd = -1;
+}
+
+bool HttpClient::sendAll(const std::string& data) {
+    for (size_t sent = 0; sent < data.size();) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+int HttpClient::readResponse(std::string& body, bool& close) {
+    char chunk[16384];
+    size_t header_end;
+    while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) return -1;
+        buffer.append(chunk, static_cast<size_t>(n));
+    }
+    std::string head = buffer.substr(0, header_end);
+    std::transform(head.begin(), head.end(), head.begin(), ::tolower);
+    int status = head.size() > 12 ? std::atoi(head.c_str() + 9) : -1;
+    close = head.find("connection: close") != std::string::npos || head.compare(0, 8, "http/1.0") == 0;
+    size_t length_at = head.find("content-length:");
+    buffer.erase(0, header_end + 4);
+    if (length_at == std::string::npos) {
+        // Body runs to the end of the connection
+        ssize_t n;
+        while ((n = recv(fd, chunk, sizeof(chunk), 0)) > 0) buffer.append(chunk, static_cast<size_t>(n));
+        body.swap(buffer);
+        buffer.clear();
+        close = true;
+        return status;
+    }
+    size_t length = std::strtoull(head.c_str() + length_at + 15, nullptr, 10);
+    while (buffer.size() < length) {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) return -1;
+        buffer.append(chunk, static_cast<size_t>(n));
+    }
+    body = buffer.substr(0, length);
+    buffer.erase(0, length);
+    return status;
+}
+
+int HttpClient::post(const std::string& path, const std::string& body, std::string& response_body) {
+    std::string request = "POST " + path + " HTTP/1.1\r\nHost: " + host + "\r\nContent-Type: application/json\r\n"
+                          "Content-Length: " + std::to_string(body.size()) + "\r\nConnection: keep-alive\r\n\r\n" + body;
+    // A kept-alive connection the server has since closed fails once; retry on a new one
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (fd < 0 && !connect()) return -1;
+        bool close = false;
+        int status = sendAll(request) ? readResponse(response_body, close) : -1;
+        if (status < 0 || close) disconnect();
+        if (status >= 0) return status;
+    }
+    return -1;
+}
+
+void playGames(const Options& options, int client, const ChessBitboard& prototype, ClientStats& stats) {
+    HttpClient http(options.host, options.port);
+    std::mt19937 rng(static_cast<unsigned>(client) * 7919u + 1);
+    ChessBitboard board = prototype;
+    std::string game_id = "loadtest-" + std::to_string(client);
+    std::string fen = START_FEN;
+    stats.games = 1;
+
+    for (int i = 0; i < options.requests; i++) {
+        std::string body = "{\"fen\": " + json::quote(fen) + ", \"game_id\": " + json::quote(game_id);
+        if (options.movetime_ms > 0) body += ", \"movetime_ms\": " + std::to_string(options.movetime_ms);
+        body += "}";
+
+        std::string response;
+        auto start = std::chrono::steady_clock::now();
+        int status = http.post("/api/move", body, response);
+        stats.latencies_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+        std::map<std::string, std::string> fields;
+        bool ok = status == 200 && json::parseObject(response, fields) && !fields.count("error");
+        if (!ok) stats.errors++;
+        auto new_fen = fields.find("new_fen");
+        bool continues = ok && new_fen != fields.end();
+        if (continues) {
+            board.loadFen(new_fen->second);
+            std::vector<Move> replies = board.generateLegalMoves();
+            continues = !replies.empty() && !board.isGameOver();
+            if (continues) {
+                board.makeMove(replies[rng() % replies.size()]);
+                continues = !board.isGameOver();
+            }
+        }
+        if (continues) {
+            fen = board.toFen();
+        } else {
+            fen = START_FEN;
+            stats.games++;
+        }
+    }
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t index = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string flag = argv[i];
+        if (flag == "--json") {
+            options.json = true;
+            continue;
+        }
+        if (i + 1 >= argc) return false;
+        std::string value = argv[++i];
+        try {
+            if (flag == "--host") options.host = value;
+            else if (flag == "--port") options.port = std::stoi(value);
+            else if (flag == "--clients") options.clients = std::max(1, std::stoi(value));
+            else if (flag == "--requests") options.requests = std::max(1, std::stoi(value));
+            else if (flag == "--movetime") options.movetime_ms = std::stoll(value);
+            else return false;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: " << argv[0] << " [--host 127.0.0.1] [--port 8080] [--clients 16] [--requests 20] [--movetime MS] [--json]\n";
+        return 2;
+    }
+
+    ChessBitboard prototype;
+    std::vector<ClientStats> stats(options.clients);
+    std::vector<std::thread> clients;
+    auto start = std::chrono::steady_clock::now();
+    for (int c = 0; c < options.clients; c++) {
+        clients.emplace_back(playGames, std::cref(options), c, std::cref(prototype), std::ref(stats[c]));
+    }
+    for (std::thread& client : clients) client.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> latencies;
+    int errors = 0, games = 0;
+    for (const ClientStats& client : stats) {
+        latencies.insert(latencies.end(), client.latencies_ms.begin(), client.latencies_ms.end());
+        errors += client.errors;
+        games += client.games;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double rate = latencies.size() / seconds;
+    double p50 = percentile(latencies, 50), p90 = percentile(latencies, 90), p99 = percentile(latencies, 99);
+    double worst = latencies.empty() ? 0.0 : latencies.back();
+
+    if (options.json) {
+        std::printf("{\"clients\": %d, \"requests\": %zu, \"errors\": %d, \"games\": %d, \"seconds\": %.3f, "
+                    "\"requests_per_second\": %.2f, \"p50_ms\": %.2f, \"p90_ms\": %.2f, \"p99_ms\": %.2f, \"max_ms\": %.2f}\n",
+                    options.clients, latencies.size(), errors, games, seconds, rate, p50, p90, p99, worst);
+    } else {
+        std::printf("%d clients x %d requests: %zu requests, %d errors, %d games in %.2f s\n",
+                    options.clients, options.requests, latencies.size(), errors, games, seconds);
+        std::printf("%.1f requests/s, latency ms p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n", rate, p50, p90, p99, worst);
+    }
+    return errors == 0 ? 0 : 1;
+}
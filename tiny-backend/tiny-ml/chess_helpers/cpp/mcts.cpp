@@ -0,0 +1,859 @@
+#include "mcts.h"
+#include "instrument.h"
+#include "safetensors.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+namespace {
+
+void softmax(std::vector<float>& scores, float temperature) {
+    if (scores.empty()) return;
+    float max_score = *std::max_element(scores.begin(), scores.end());
+    float sum = 0.0f;
+    for (float& s : scores) {
+        s = std::exp((s - max_score) / temperature);
+        sum += s;
+    }
+    for (float& s : scores) s /= sum;
+}
+
+// Graph search: edge and position values further apart than this trigger a correcting
+// backup instead of a descent (as in Czech et al., Monte-Carlo Graph Search for AlphaZero)
+constexpr float TRANSPOSITION_EPSILON = 0.01f;
+
+// std::atomic<float> has no fetch_add before C++20
+inline void atomicAdd(std::atomic<float>& target, float delta) {
+    float current = target.load(std::memory_order_relaxed);
+    while (!target.compare_exchange_weak(current, current + delta, std::memory_order_relaxed)) {}
+}
+
+inline uint16_t packMove(const Move& move) {
+    return static_cast<uint16_t>(move.getFrom() | move.getTo() << 6 | move.getFlags() << 12);
+}
+
+inline Move unpackMove(const ChessBitboard& board, uint16_t packed) {
+    Square from = packed & 63;
+    return Move(from, (packed >> 6) & 63, board.getPieceAt(from).type(), static_cast<uint8_t>(packed >> 12));
+}
+
+inline float priorValue(uint16_t prior) {
+#ifdef __F16C__
+    return _cvtsh_ss(prior);
+#else
+    return halfToFloat(prior);
+#endif
+}
+
+} // namespace
+
+void HandcraftedEvaluator::evaluate(const std::vector<EvalRequest>& batch, std::vector<EvalResult>& results) {
+    results.resize(batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+        const EvalRequest& request = batch[i];
+        EvalResult& result = results[i];
+        result.priors.resize(request.moves.size());
+        for (size_t j = 0; j < request.moves.size(); j++) {
+            const Move& move = request.moves[j];
+            result.priors[j] = static_cast<float>(request.board.see(move) + (request.board.givesCheck(move) ? 50 : 0));
+        }
+        softmax(result.priors, 100.0f);
+        result.value = std::tanh(request.board.evaluate() / 400.0f);
+    }
+}
+
+NetworkEvaluator::NetworkEvaluator(const std::string& checkpoint_path) {
+    net.load(checkpoint_path);
+}
+
+void NetworkEvaluator::quantize(const float* calibration_inputs, int count) {
+    quantized = std::make_unique<QuantizedChessNet>(net, calibration_inputs, count);
+}
+
+void NetworkEvaluator::evaluate(const std::vector<EvalRequest>& batch, std::vector<EvalResult>& results) {
+    const int plane_size = ChessNet::INPUT_PLANES * 64;
+    int count = static_cast<int>(batch.size());
+    input.resize(static_cast<size_t>(count) * plane_size);
+    logits.resize(static_cast<size_t>(count) * ChessNet::POLICY_SIZE);
+    values.resize(count);
+    {
+        INSTRUMENT_TIMER(ENCODE);
+        for (int i = 0; i < count; i++) {
+            const EvalRequest& request = batch[i];
+            encodePosition(request.board, request.has_previous ? &request.previous : nullptr,
+                           input.data() + static_cast<size_t>(i) * plane_size);
+        }
+    }
+    if (quantized) {
+        quantized->forward(input.data(), count, logits.data(), values.data());
+    } else {
+        net.forward(input.data(), count, logits.data(), values.data());
+    }
+
+    results.resize(count);
+    for (int i = 0; i < count; i++) {
+        const float* row = logits.data() + static_cast<size_t>(i) * ChessNet::POLICY_SIZE;
+        EvalResult& result = results[i];
+        result.priors.resize(batch[i].moves.size());
+        for (size_t j = 0; j < batch[i].moves.size(); j++) result.priors[j] = row[policyIndex(batch[i].moves[j])];
+        softmax(result.priors, 1.0f);
+        result.value = values[i];
+    }
+}
+
+MCTS::Node& MCTS::Node::operator=(const Node& other) {
+    value_sum.store(other.value_sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    visits.store(other.visits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    first_edge.store(other.first_edge.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    first_child.store(other.first_child.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    next_sibling = other.next_sibling;
+    source = other.source;
+    edge = other.edge;
+    num_edges = other.num_edges;
+    terminal_value = other.terminal_value;
+    return *this;
+}
+
+void MCTS::TranspositionTable::reset(size_t min_entries) {
+    size_t size = 1024;
+    while (size < min_entries * 2) size <<= 1;
+    if (size != capacity) {
+        slots = std::make_unique<Slot[]>(size);
+        capacity = size;
+        mask = size - 1;
+        return;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        slots[i].key.store(0, std::memory_order_relaxed);
+        slots[i].node.store(-1, std::memory_order_relaxed);
+    }
+}
+
+int32_t MCTS::TranspositionTable::find(uint64_t hash) const {
+    uint64_t key = hash ? hash : 1;  // 0 marks an empty slot
+    for (size_t i = 0; i < MAX_PROBES; i++) {
+        const Slot& slot = slots[(key + i) & mask];
+        uint64_t stored = slot.key.load(std::memory_order_acquire);
+        if (stored == key) return slot.node.load(std::memory_order_acquire);
+        if (stored == 0) return -1;
+    }
+    return -1;
+}
+
+int32_t MCTS::TranspositionTable::insert(uint64_t hash, int32_t node) {
+    uint64_t key = hash ? hash : 1;
+    for (size_t i = 0; i < MAX_PROBES; i++) {
+        Slot& slot = slots[(key + i) & mask];
+        uint64_t stored = slot.key.load(std::memory_order_acquire);
+        if (stored == 0 && slot.key.compare_exchange_strong(stored, key, std::memory_order_acq_rel)) {
+            slot.node.store(node, std::memory_order_release);
+            return node;
+        }
+        if (stored == key) {
+            // The thread that claimed the slot may not have stored its node yet
+            int32_t existing;
+            while ((existing = slot.node.load(std::memory_order_acquire)) < 0) std::this_thread::yield();
+            return existing;
+        }
+    }
+    return node;
+}
+
+// Leaves from every worker, evaluated together. A worker hands in its leaves and blocks
+// until they are scored; the batch goes to the evaluator once it holds batch_size leaves
+// or every worker still searching is waiting on it. Only one evaluator call runs at a
+// time, but workers keep selecting (and the next batch keeps filling) meanwhile.
+class MCTS::BatchQueue {
+public:
+    BatchQueue(Evaluator& evaluator, int batch_size, int workers)
+        : evaluator(evaluator), batch_size(static_cast<size_t>(batch_size)), workers(static_cast<size_t>(workers)) {}
+
+    // False if an evaluator call threw; the search is then abandoned
+    bool evaluate(std::vector<EvalRequest>& requests, std::vector<EvalResult>& results) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (error) return false;
+        Slot slot{&requests, &results, false};
+        waiting.push_back(&slot);
+        waiting_leaves += requests.size();
+        if (waiting_leaves >= batch_size || waiting.size() == workers) {
+            flush(lock);
+        } else {
+            ready.wait(lock, [&] { return slot.done; });
+        }
+        return !error;
+    }
+
+    // The calling worker has finished; nobody waits for its leaves any more
+    void leave() {
+        std::unique_lock<std::mutex> lock(mutex);
+        workers--;
+        if (!waiting.empty() && waiting.size() == workers) flush(lock);
+    }
+
+    // A worker failed outside the evaluator; the others stop at their next evaluate()
+    void fail(std::exception_ptr failed) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) error = failed;
+    }
+
+    std::exception_ptr failure() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return error;
+    }
+
+private:
+    struct Slot {
+        std::vector<EvalRequest>* requests;
+        std::vector<EvalResult>* results;
+        bool done;
+    };
+
+    Evaluator& evaluator;
+    size_t batch_size;
+    size_t workers;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::vector<Slot*> waiting;
+    size_t waiting_leaves = 0;
+    std::exception_ptr error;
+
+    std::mutex evaluator_mutex;
+    std::vector<EvalRequest> batch;
+    std::vector<EvalResult> results;
+
+    // Called with `lock` held; evaluates the waiting slots without it and wakes their owners
+    void flush(std::unique_lock<std::mutex>& lock) {
+        std::vector<Slot*> slots;
+        slots.swap(waiting);
+        waiting_leaves = 0;
+        lock.unlock();
+
+        std::exception_ptr failed;
+        {
+            std::lock_guard<std::mutex> evaluating(evaluator_mutex);
+            batch.clear();
+            for (Slot* slot : slots) {
+                for (EvalRequest& request : *slot->requests) batch.push_back(std::move(request));
+            }
+            if (!batch.empty()) {
+                INSTRUMENT_COUNT(BATCHES, 1);
+                INSTRUMENT_COUNT(BATCH_POSITIONS, batch.size());
+                INSTRUMENT_COUNT(BATCH_CAPACITY, std::max(batch_size, batch.size()));
+                INSTRUMENT_TIMER(EVALUATE);
+                try {
+                    evaluator.evaluate(batch, results);
+                } catch (...) {
+                    failed = std::current_exception();
+                }
+            }
+            // Hand the requests back: workers expand their leaves with the move lists
+            size_t next = 0;
+            for (Slot* slot : slots) {
+                std::vector<EvalRequest>& requests = *slot->requests;
+                slot->results->resize(requests.size());
+                for (size_t i = 0; i < requests.size(); i++, next++) {
+                    requests[i] = std::move(batch[next]);
+                    if (!failed) (*slot->results)[i] = std::move(results[next]);
+                }
+            }
+        }
+
+        lock.lock();
+        if (failed && !error) error = failed;
+        for (Slot* slot : slots) slot->done = true;
+        ready.notify_all();
+    }
+};
+
+MCTS::MCTS(Evaluator& evaluator, const MCTSConfig& config)
+    : evaluator(evaluator), config(config), rng(config.seed) {}
+
+void MCTS::childrenByEdge(int32_t holder, int32_t* children) const {
+    const Node& parent = nodes[holder];
+    std::fill_n(children, parent.num_edges, -1);
+    for (int32_t c = parent.first_child.load(std::memory_order_acquire); c >= 0; c = nodes[c].next_sibling) {
+        children[nodes[c].edge] = c;
+    }
+}
+
+int32_t MCTS::childFor(int32_t holder, int edge) {
+    Node& parent = nodes[holder];
+    int32_t head = parent.first_child.load(std::memory_order_acquire);
+    int32_t checked = -1;  // the list from here on is known not to hold `edge`
+    int32_t created = -1;
+    for (;;) {
+        for (int32_t c = head; c != checked; c = nodes[c].next_sibling) {
+            // Another worker got there first (a node this thread created is then left unused)
+            if (nodes[c].edge == edge) return c;
+        }
+        if (created < 0) {
+            created = nodes.allocate(1);
+            nodes[created].edge = static_cast<uint16_t>(edge);
+        }
+        nodes[created].next_sibling = head;
+        checked = head;
+        if (parent.first_child.compare_exchange_weak(head, created, std::memory_order_release, std::memory_order_acquire)) {
+            return created;
+        }
+    }
+}
+
+int MCTS::selectEdge(int node, uint32_t parent_visits, int32_t& child) const {
+    int32_t holder = holderOf(node);
+    const Node& parent = nodes[holder];
+    int32_t first = parent.first_edge.load(std::memory_order_acquire);
+    int32_t children[MAX_EDGES];
+    childrenByEdge(holder, children);
+
+    float sqrt_visits = std::sqrt(static_cast<float>(parent_visits));
+    // Parent value for its own side to move; value_sum is stored for the other side
+    const Node& self = nodes[node];
+    uint32_t own_visits = self.visits.load(std::memory_order_relaxed);
+    float parent_q = own_visits ? -self.value_sum.load(std::memory_order_relaxed) / own_visits : 0.0f;
+    float fpu = parent_q - config.fpu_reduction;
+
+    int best = 0;
+    float best_score = -1e30f;
+    for (int i = 0; i < parent.num_edges; i++) {
+        uint32_t visits = 0;
+        float q = fpu;
+        if (children[i] >= 0) {
+            const Node& c = nodes[children[i]];
+            visits = c.visits.load(std::memory_order_relaxed);
+            if (visits) q = c.value_sum.load(std::memory_order_relaxed) / visits;
+        }
+        float score = q + config.c_puct * priorValue(edges[first + i].prior) * sqrt_visits / (1.0f + visits);
+        if (score > best_score) {
+            best_score = score;
+            best = i;
+        }
+    }
+    child = children[best];
+    return best;
+}
+
+void MCTS::childTotals(int32_t holder, uint32_t& visits, float& value_sum) const {
+    visits = 0;
+    value_sum = 0.0f;
+    for (int32_t c = nodes[holder].first_child.load(std::memory_order_acquire); c >= 0; c = nodes[c].next_sibling) {
+        visits += nodes[c].visits.load(std::memory_order_relaxed);
+        value_sum += nodes[c].value_sum.load(std::memory_order_relaxed);
+    }
+}
+
+float MCTS::positionValue(int node) const {
+    const Node& position = nodes[node];
+    if (position.first_edge.load(std::memory_order_acquire) == Node::TERMINAL) return position.terminal_value;
+    uint32_t visits;
+    float value_sum;
+    childTotals(holderOf(node), visits, value_sum);
+    if (visits > 0) return value_sum / visits;
+    // Only the position's own evaluation so far, which its incoming edge holds
+    uint32_t edge_visits = position.visits.load(std::memory_order_relaxed);
+    return edge_visits ? -position.value_sum.load(std::memory_order_relaxed) / edge_visits : 0.0f;
+}
+
+void MCTS::rebuildTranspositions() {
+    std::vector<std::pair<int32_t, ChessBitboard>> stack;
+    std::unordered_set<int32_t> seen;  // holders already walked (shared ones come up again)
+    stack.emplace_back(0, root_board);
+    while (!stack.empty()) {
+        int32_t node = stack.back().first;
+        ChessBitboard board = std::move(stack.back().second);
+        stack.pop_back();
+        int32_t first = nodes[node].first_edge.load(std::memory_order_relaxed);
+        if (first == Node::TERMINAL) transposition_table.insert(board.hash, node);
+        if (first < 0) continue;
+        int32_t holder = holderOf(node);
+        transposition_table.insert(board.hash, holder);
+        if (!seen.insert(holder).second) continue;
+        for (int32_t c = nodes[holder].first_child.load(std::memory_order_relaxed); c >= 0; c = nodes[c].next_sibling) {
+            int32_t child_first = nodes[c].first_edge.load(std::memory_order_relaxed);
+            if (child_first != Node::TERMINAL && child_first < 0) continue;
+            stack.emplace_back(c, board);
+            stack.back().second.makeMove(unpackMove(board, edges[first + nodes[c].edge].move));
+        }
+    }
+}
+
+void MCTS::expand(int node, const std::vector<Move>& moves, const std::vector<float>& priors) {
+    int32_t first = edges.allocate(static_cast<int>(moves.size()));
+    for (size_t i = 0; i < moves.size(); i++) {
+        Edge& edge = edges[first + static_cast<int32_t>(i)];
+        edge.move = packMove(moves[i]);
+        edge.prior = floatToHalf(priors[i]);
+    }
+    nodes[node].num_edges = static_cast<uint16_t>(moves.size());
+    // Publishes the edges to workers that load first_edge with acquire
+    nodes[node].first_edge.store(first, std::memory_order_release);
+}
+
+void MCTS::addNoise(int node) {
+    Node& parent = nodes[node];
+    std::gamma_distribution<float> gamma(config.dirichlet_alpha, 1.0f);
+    std::vector<float> noise(parent.num_edges);
+    float sum = 0.0f;
+    for (float& n : noise) {
+        n = gamma(rng);
+        sum += n;
+    }
+    if (sum <= 0.0f) return;
+    int32_t first = parent.first_edge.load(std::memory_order_relaxed);
+    for (int i = 0; i < parent.num_edges; i++) {
+        Edge& edge = edges[first + i];
+        float prior = (1.0f - config.dirichlet_epsilon) * priorValue(edge.prior) + config.dirichlet_epsilon * noise[i] / sum;
+        edge.prior = floatToHalf(prior);
+    }
+}
+
+void MCTS::backup(const std::vector<int>& path, float value) {
+    // Selection already counted the visit and a virtual loss of 1 on every node
+    float v = value;
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+        atomicAdd(nodes[*it].value_sum, 1.0f - v);
+        v = -v;
+    }
+}
+
+void MCTS::reset() {
+    stopPondering();
+    clear();
+}
+
+void MCTS::clear() {
+    nodes.clear();
+    edges.clear();
+    root_noised = false;
+}
+
+MCTSMemory MCTS::memoryUsage() const {
+    MCTSMemory memory;
+    memory.nodes = nodes.size();
+    memory.edges = edges.size();
+    memory.node_bytes = memory.nodes * sizeof(Node);
+    memory.edge_bytes = memory.edges * sizeof(Edge);
+    memory.table_bytes = transposition_table.bytes();
+    memory.reserved_bytes = nodes.reservedBytes() + edges.reservedBytes() + memory.table_bytes;
+    return memory;
+}
+
+int MCTS::findSubtree(const ChessBitboard& board) const {
+    if (nodes.empty()) return -1;
+    if (root_board.samePosition(board)) return 0;
+    int32_t first = nodes[0].first_edge.load(std::memory_order_relaxed);
+    if (first < 0) return -1;
+    for (int32_t c = nodes[0].first_child.load(std::memory_order_relaxed); c >= 0; c = nodes[c].next_sibling) {
+        ChessBitboard child_board = root_board;
+        child_board.makeMove(unpackMove(root_board, edges[first + nodes[c].edge].move));
+        if (child_board.samePosition(board)) return c;
+        if (nodes[c].first_edge.load(std::memory_order_relaxed) < 0) continue;
+        int32_t holder = holderOf(c);
+        int32_t child_first = nodes[holder].first_edge.load(std::memory_order_relaxed);
+        for (int32_t g = nodes[holder].first_child.load(std::memory_order_relaxed); g >= 0; g = nodes[g].next_sibling) {
+            ChessBitboard grandchild_board = child_board;
+            grandchild_board.makeMove(unpackMove(child_board, edges[child_first + nodes[g].edge].move));
+            if (grandchild_board.samePosition(board)) return g;
+        }
+    }
+    return -1;
+}
+
+void MCTS::promote(int node) {
+    if (node == 0) return;
+    NodeArena kept_nodes;
+    EdgeArena kept_edges;
+    int32_t root = kept_nodes.allocate(1);
+    kept_nodes[root] = nodes[node];
+    // Pairs of (old node, its copy), breadth first
+    std::vector<std::pair<int32_t, int32_t>> queue{{node, root}};
+    // Old holder -> the copy that now holds its edges and children (shared ones are copied once)
+    std::unordered_map<int32_t, int32_t> holders;
+    for (size_t head = 0; head < queue.size(); head++) {
+        auto [old_node, copy] = queue[head];
+        Node& kept = kept_nodes[copy];
+        kept.source = -1;
+        kept.first_child.store(-1, std::memory_order_relaxed);
+        if (kept.first_edge.load(std::memory_order_relaxed) < 0) continue;
+
+        int32_t holder = holderOf(old_node);
+        auto it = holders.find(holder);
+        if (it != holders.end()) {
+            kept.source = it->second;
+            kept.first_edge.store(kept_nodes[it->second].first_edge.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            continue;
+        }
+        holders.emplace(holder, copy);
+        const Node& source = nodes[holder];
+        int32_t first = source.first_edge.load(std::memory_order_relaxed);
+        int32_t kept_first = kept_edges.allocate(source.num_edges);
+        for (int i = 0; i < source.num_edges; i++) kept_edges[kept_first + i] = edges[first + i];
+        kept.first_edge.store(kept_first, std::memory_order_relaxed);
+        kept.num_edges = source.num_edges;
+
+        int32_t previous = -1;
+        for (int32_t c = source.first_child.load(std::memory_order_relaxed); c >= 0; c = nodes[c].next_sibling) {
+            int32_t child = kept_nodes.allocate(1);
+            kept_nodes[child] = nodes[c];
+            kept_nodes[child].next_sibling = -1;
+            if (previous < 0) {
+                kept.first_child.store(child, std::memory_order_relaxed);
+            } else {
+                kept_nodes[previous].next_sibling = child;
+            }
+            previous = child;
+            queue.emplace_back(c, child);
+        }
+    }
+    kept_nodes[root].next_sibling = -1;
+    kept_nodes[root].edge = 0;
+    nodes.swap(kept_nodes);
+    edges.swap(kept_edges);
+    root_noised = false;
+}
+
+bool MCTS::advance(const Move& move) {
+    stopPondering();
+    if (!nodes.empty()) {
+        int32_t first = nodes[0].first_edge.load(std::memory_order_relaxed);
+        for (int32_t c = first >= 0 ? nodes[0].first_child.load(std::memory_order_relaxed) : -1; c >= 0; c = nodes[c].next_sibling) {
+            if (unpackMove(root_board, edges[first + nodes[c].edge].move) == move) {
+                root_board.makeMove(move);
+                promote(c);
+                return true;
+            }
+        }
+    }
+    clear();
+    return false;
+}
+
+bool MCTS::transpositionValue(int node, uint32_t child_visits, float child_value_sum, float& value) const {
+    // Statistics of the edge into `node` without this path's own virtual loss
+    const Node& edge = nodes[node];
+    uint32_t edge_visits = edge.visits.load(std::memory_order_relaxed) - 1;
+    if (edge_visits == 0 || child_visits <= edge_visits) return false;
+    float edge_q = (edge.value_sum.load(std::memory_order_relaxed) + 1.0f) / edge_visits;
+    // The position's value from the edge's side, known from more visits than the edge has
+    float target = -child_value_sum / child_visits;
+    if (std::fabs(target - edge_q) <= TRANSPOSITION_EPSILON) return false;
+    // One backup of this value moves the edge's average exactly onto the target
+    float edge_value = std::max(-1.0f, std::min(1.0f, target + edge_visits * (target - edge_q)));
+    value = -edge_value;
+    return true;
+}
+
+void MCTS::work(BatchQueue& queue, std::atomic<int>& remaining, const ChessBitboard& root, int leaves_per_batch) {
+    try {
+        simulate(queue, remaining, root, leaves_per_batch);
+    } catch (...) {
+        // Helper threads must not let it escape (std::terminate); run() rethrows it
+        queue.fail(std::current_exception());
+    }
+    queue.leave();
+}
+
+void MCTS::simulate(BatchQueue& queue, std::atomic<int>& remaining, const ChessBitboard& root, int leaves_per_batch) {
+    std::vector<EvalRequest> batch;
+    std::vector<EvalResult> results;
+    std::vector<std::vector<int>> paths;
+    std::vector<uint64_t> hashes;  // positions on the current path, graph search only
+    bool graph = config.transpositions;
+    int deepest = 0;
+    for (;;) {
+        batch.clear();
+        paths.clear();
+        bool collided = false;
+        bool exhausted = false;
+        for (int attempt = 0; attempt < leaves_per_batch; attempt++) {
+            if (halt.load(std::memory_order_relaxed)) {
+                exhausted = true;
+                break;
+            }
+            if (remaining.fetch_sub(1, std::memory_order_relaxed) <= 0) {
+                remaining.fetch_add(1, std::memory_order_relaxed);
+                exhausted = true;
+                break;
+            }
+            INSTRUMENT_COUNT(SIMULATIONS, 1);
+            std::vector<int> path{0};
+            ChessBitboard board = root;
+            // Copies only: the default constructor rebuilds the attack tables
+            ChessBitboard parent_board = root;
+            nodes[0].visits.fetch_add(1, std::memory_order_relaxed);
+            atomicAdd(nodes[0].value_sum, -1.0f);
+            if (graph) hashes.assign(1, root.hash);
+            int node = 0;
+            int32_t first;
+            bool scored = false;  // `value` settles this simulation without reaching a leaf
+            float value = 0.0f;
+            {
+                INSTRUMENT_TIMER(SELECT);
+                while ((first = nodes[node].first_edge.load(std::memory_order_acquire)) >= 0) {
+                    uint32_t parent_visits = nodes[node].visits.load(std::memory_order_relaxed);
+                    if (graph) {
+                        float child_value;
+                        childTotals(holderOf(node), parent_visits, child_value);
+                        if (node != 0 && transpositionValue(node, parent_visits, child_value, value)) {
+                            scored = true;
+                            break;
+                        }
+                        parent_visits++;
+                    }
+                    int32_t child;
+                    int edge = selectEdge(node, parent_visits, child);
+                    if (child < 0) child = childFor(holderOf(node), edge);
+                    parent_board = board;
+                    board.makeMove(unpackMove(board, edges[first + edge].move));
+                    node = child;
+                    path.push_back(node);
+                    nodes[node].visits.fetch_add(1, std::memory_order_relaxed);
+                    atomicAdd(nodes[node].value_sum, -1.0f);
+                    if (graph) {
+                        // Shared children make cycles possible; a repetition ends the path as a draw
+                        if (std::find(hashes.begin(), hashes.end(), board.hash) != hashes.end()) {
+                            scored = true;
+                            value = 0.0f;
+                            break;
+                        }
+                        hashes.push_back(board.hash);
+                    }
+                }
+            }
+            deepest = std::max(deepest, static_cast<int>(path.size()) - 1);
+            if (scored) {
+                backup(path, value);
+                continue;
+            }
+
+            Node& leaf = nodes[node];
+            // On failure `first` holds whatever the thread that got there first stored
+            bool owner = first == Node::UNEXPANDED &&
+                         leaf.first_edge.compare_exchange_strong(first, Node::EXPANDING, std::memory_order_acquire);
+            if (owner && graph) {
+                int32_t existing = transposition_table.insert(board.hash, node);
+                if (existing != node) {
+                    const Node& shared = nodes[existing];
+                    int32_t shared_first = shared.first_edge.load(std::memory_order_acquire);
+                    if (shared_first >= 0 || shared_first == Node::TERMINAL) {
+                        // Reached before by another move order: share its edges and children
+                        // instead of evaluating the position again
+                        if (shared_first >= 0) leaf.source = holderOf(existing);
+                        leaf.num_edges = shared.num_edges;
+                        leaf.terminal_value = shared.terminal_value;
+                        leaf.first_edge.store(shared_first, std::memory_order_release);
+                        backup(path, positionValue(existing));
+                        continue;
+                    }
+                    // Still waiting for its evaluation: let go and treat it as a collision
+                    leaf.first_edge.store(Node::UNEXPANDED, std::memory_order_release);
+                    owner = false;
+                    first = Node::EXPANDING;
+                }
+            }
+            if (!owner && first == Node::TERMINAL) {
+                backup(path, leaf.terminal_value);
+                continue;
+            }
+            if (!owner) {
+                // The leaf is already queued for evaluation (by this thread or another): drop
+                // the path and give the simulation back
+                for (int n : path) {
+                    nodes[n].visits.fetch_sub(1, std::memory_order_relaxed);
+                    atomicAdd(nodes[n].value_sum, 1.0f);
+                }
+                remaining.fetch_add(1, std::memory_order_relaxed);
+                collided = true;
+                break;
+            }
+
+            std::vector<Move> moves = board.generateLegalMoves();
+            bool terminal = true;
+            Tablebase::WDL wdl;
+            if (moves.empty()) {
+                leaf.terminal_value = board.isInCheck(board.white_to_move ? Piece::Color::WHITE : Piece::Color::BLACK) ? -1.0f : 0.0f;
+            } else if (board.halfmove_clock >= 100 || board.hasInsufficientMaterial()) {
+                leaf.terminal_value = 0.0f;
+            } else if (tablebase && path.size() > 1 && board.halfmove_clock == 0 && tablebase->canProbe(board) &&
+                       tablebase->probeWdl(board, wdl)) {
+                // Cursed wins and blessed losses are draws under the 50-move rule
+                INSTRUMENT_COUNT(TB_HITS, 1);
+                leaf.terminal_value = wdl == Tablebase::WIN ? 1.0f : wdl == Tablebase::LOSS ? -1.0f : 0.0f;
+            } else {
+                terminal = false;
+            }
+            if (terminal) {
+                leaf.first_edge.store(Node::TERMINAL, std::memory_order_release);
+                backup(path, leaf.terminal_value);
+                continue;
+            }
+            batch.push_back(EvalRequest{board, parent_board, true, std::move(moves)});
+            paths.push_back(std::move(path));
+        }
+
+        // With nothing of its own queued after a collision this just waits for the next
+        // batch, which releases the leaf it ran into
+        if (!batch.empty() || collided) {
+            if (!queue.evaluate(batch, results)) break;
+            INSTRUMENT_TIMER(BACKUP);
+            for (size_t i = 0; i < batch.size(); i++) {
+                expand(paths[i].back(), batch[i].moves, results[i].priors);
+                backup(paths[i], results[i].value);
+            }
+        }
+        if (exhausted) break;
+        if (budgetSpent(remaining)) halt = true;
+    }
+    for (int known = max_depth.load(); deepest > known && !max_depth.compare_exchange_weak(known, deepest);) {}
+}
+
+MCTSResult MCTS::search(const ChessBitboard& root, const ChessBitboard* previous, const SearchLimits& limits) {
+    stopPondering();
+    halt = false;
+    return run(root, previous, limits, false);
+}
+
+void MCTS::ponder(const ChessBitboard& board, const ChessBitboard* previous) {
+    stopPondering();
+    halt = false;
+    SearchLimits limits;
+    limits.nodes = static_cast<uint64_t>(std::max(0, config.ponder_simulations));
+    bool has_previous = previous != nullptr;
+    ChessBitboard previous_board = has_previous ? *previous : board;
+    ponder_thread = std::thread([this, board, previous_board, has_previous, limits] {
+        try {
+            run(board, has_previous ? &previous_board : nullptr, limits, true);
+        } catch (...) {
+            // A failed batch dropped the tree; the next search starts from scratch
+        }
+    });
+}
+
+void MCTS::stopPondering() {
+    if (!ponder_thread.joinable()) return;
+    halt = true;
+    ponder_thread.join();
+}
+
+bool MCTS::budgetSpent(const std::atomic<int>& remaining) const {
+    if (time.pastOptimum()) return true;
+    // A tree that fills its arenas is as big as this search gets
+    if (nodes.nearlyFull() || edges.nearlyFull()) return true;
+    if (!early_stop) return false;
+
+    const Node& root = nodes[0];
+    if (root.num_edges == 1) return true;
+    int64_t left = remaining.load(std::memory_order_relaxed);
+    if (time.timed()) {
+        // Simulations the rest of the optimum time allows at the rate so far
+        int64_t elapsed = std::max<int64_t>(1, time.elapsedMs());
+        int64_t done = root.visits.load(std::memory_order_relaxed) - start_visits;
+        left = std::min(left, done * std::max<int64_t>(0, time.optimumMs() - elapsed) / elapsed);
+    }
+    uint32_t best = 0, second = 0;
+    for (int32_t c = root.first_child.load(std::memory_order_acquire); c >= 0; c = nodes[c].next_sibling) {
+        uint32_t visits = nodes[c].visits.load(std::memory_order_relaxed);
+        if (visits > best) {
+            second = best;
+            best = visits;
+        } else if (visits > second) {
+            second = visits;
+        }
+    }
+    return static_cast<int64_t>(best - second) > left;
+}
+
+MCTSResult MCTS::run(const ChessBitboard& root, const ChessBitboard* previous, const SearchLimits& limits, bool pondering) {
+    time.start(limits);
+    early_stop = config.early_stop && !pondering;
+    MCTSResult result;
+    int reused = config.reuse_tree ? findSubtree(root) : -1;
+    if (reused < 0) {
+        clear();
+        nodes.allocate(1);
+    } else {
+        promote(reused);
+    }
+    uint32_t reused_visits = nodes[0].visits.load(std::memory_order_relaxed);
+    root_board = root;
+
+    if (nodes[0].first_edge.load(std::memory_order_relaxed) < 0) {
+        std::vector<EvalRequest> batch(1);
+        std::vector<EvalResult> results;
+        batch[0].board = root;
+        batch[0].has_previous = previous != nullptr;
+        if (previous) batch[0].previous = *previous;
+        batch[0].moves = root.generateLegalMoves();
+        if (batch[0].moves.empty()) {
+            clear();
+            return result;
+        }
+
+        // The root evaluation counts as the first simulation, as in mcts.py
+        evaluator.evaluate(batch, results);
+        expand(0, batch[0].moves, results[0].priors);
+        nodes[0].visits.store(1, std::memory_order_relaxed);
+        nodes[0].value_sum.store(-results[0].value, std::memory_order_relaxed);
+    }
+    if (config.transpositions) {
+        transposition_table.reset(std::max<size_t>(config.num_simulations, nodes[0].visits.load()));
+        rebuildTranspositions();
+    }
+    if (config.dirichlet_epsilon > 0.0f && !root_noised) {
+        addNoise(0);
+        root_noised = true;
+    }
+
+    int threads = std::max(1, config.threads);
+    int batch_size = std::max(1, config.batch_size);
+    // Each worker queues its share of a batch per round, so the batch fills even when
+    // there are fewer threads than leaves
+    int leaves_per_batch = (batch_size + threads - 1) / threads;
+    // Reused visits count towards the budget; a timed search without a node limit runs
+    // until the time is up
+    start_visits = nodes[0].visits.load();
+    int64_t budget = limits.nodes ? static_cast<int64_t>(std::min<uint64_t>(limits.nodes, INT32_MAX))
+                   : limits.timed() ? INT32_MAX : config.num_simulations;
+    std::atomic<int> remaining(static_cast<int>(std::max<int64_t>(0, budget - start_visits)));
+    max_depth = 0;
+    BatchQueue queue(evaluator, batch_size, threads);
+    std::vector<std::thread> helpers;
+    for (int t = 1; t < threads; t++) {
+        helpers.emplace_back([&] { work(queue, remaining, root, leaves_per_batch); });
+    }
+    work(queue, remaining, root, leaves_per_batch);
+    for (std::thread& helper : helpers) helper.join();
+    if (std::exception_ptr failure = queue.failure()) {
+        // Paths of the failed batch still hold virtual losses
+        clear();
+        std::rethrow_exception(failure);
+    }
+
+    const Node& root_node = nodes[0];
+    result.value = -root_node.value_sum.load() / root_node.visits.load();
+    result.depth = max_depth.load();
+    result.simulations = root_node.visits.load() - reused_visits;
+    uint32_t best_visits = 0;
+    int32_t first = root_node.first_edge.load();
+    int32_t children[MAX_EDGES];
+    childrenByEdge(0, children);
+    for (int i = 0; i < root_node.num_edges; i++) {
+        Move move = unpackMove(root, edges[first + i].move);
+        uint32_t visits = children[i] >= 0 ? nodes[children[i]].visits.load() : 0;
+        result.moves.push_back(move);
+        result.visits.push_back(visits);
+        if (result.best_move.isNone() || visits > best_visits) {
+            best_visits = visits;
+            result.best_move = move;
+        }
+    }
+    return result;
+}
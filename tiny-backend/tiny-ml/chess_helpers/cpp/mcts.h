@@ -0,0 +1,321 @@
+// mcts.h
+#pragma once
+#include "bitboard.h"
+#include "chessnet.h"
+#include "chessnet_int8.h"
+#include "tablebase.h"
+#include "timeman.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A leaf waiting for evaluation. The network also sees the position before it.
+struct EvalRequest {
+    ChessBitboard board;
+    ChessBitboard previous;
+    bool has_previous = false;
+    std::vector<Move> moves;  // legal moves of `board`, never empty
+};
+
+struct EvalResult {
+    std::vector<float> priors;  // aligned with EvalRequest::moves, sums to 1
+    float value = 0.0f;         // [-1, 1] for the side to move
+};
+
+// Scores a batch of leaves for MCTS
+class Evaluator {
+public:
+    virtual ~Evaluator() = default;
+    virtual void evaluate(const std::vector<EvalRequest>& batch, std::vector<EvalResult>& results) = 0;
+};
+
+// Same as classical_evaluate in game_logic.py: priors are a softmax over SEE plus a check
+// bonus, and the value is tanh(evaluation / 400)
+class HandcraftedEvaluator : public Evaluator {
+public:
+    void evaluate(const std::vector<EvalRequest>& batch, std::vector<EvalResult>& results) override;
+};
+
+// ChessNet in native code, one forward pass per batch. The policy is a softmax over the
+// legal moves' logits only.
+class NetworkEvaluator : public Evaluator {
+public:
+    explicit NetworkEvaluator(const std::string& checkpoint_path);
+    void evaluate(const std::vector<EvalRequest>& batch, std::vector<EvalResult>& results) override;
+
+    // Switch to int8 inference, calibrated on [count][25][8][8] encoded positions
+    void quantize(const float* calibration_inputs, int count);
+    bool isQuantized() const { return quantized != nullptr; }
+    const ChessNet& network() const { return net; }
+
+private:
+    ChessNet net;
+    std::unique_ptr<QuantizedChessNet> quantized;
+    std::vector<float> input, logits, values;
+};
+
+struct MCTSConfig {
+    int num_simulations = 800;
+    int batch_size = 8;              // leaves per evaluator call, gathered by all threads together
+    int threads = 1;                 // workers descending the shared tree
+    float c_puct = 1.41f;
+    float fpu_reduction = 0.2f;      // unvisited children start at the parent's value minus this
+    float dirichlet_alpha = 0.3f;
+    float dirichlet_epsilon = 0.25f; // 0 disables root noise
+    uint64_t seed = 0;
+    // Keep the tree between searches: a position matching the previous root, one of its
+    // children or grandchildren continues from that subtree, and its visits count
+    // towards num_simulations
+    bool reuse_tree = true;
+    // Monte-Carlo graph search: move orders reaching the same position share its children
+    // and their statistics instead of evaluating it again. Positions are matched by Zobrist
+    // hash alone, so a shared node keeps the evaluation of whichever history reached it
+    // first; a position repeated on the current path scores as a draw.
+    bool transpositions = false;
+    // Stop once the most visited root move can no longer be overtaken in the remaining
+    // simulations (estimated from the time left on timed searches). Off by default since
+    // self-play trains on the full visit distribution.
+    bool early_stop = false;
+    int ponder_simulations = 200000;  // cap on a ponder search, which bounds its memory
+};
+
+struct MCTSResult {
+    Move best_move;              // most visited root child; none if the root has no legal moves
+    float value = 0.0f;          // root value for the side to move
+    std::vector<Move> moves;     // root children
+    std::vector<uint32_t> visits;
+    int depth = 0;               // longest path a simulation of this search descended, in plies
+    uint32_t simulations = 0;    // run by this search; root visits kept from an earlier tree excluded
+};
+
+// Memory held by an MCTS tree
+struct MCTSMemory {
+    size_t nodes = 0;           // nodes in use (positions visited at least once)
+    size_t edges = 0;           // moves of expanded nodes
+    size_t node_bytes = 0;
+    size_t edge_bytes = 0;
+    size_t table_bytes = 0;     // transposition table (graph search)
+    size_t reserved_bytes = 0;  // everything allocated, including unused arena space
+};
+
+// AlphaZero-style PUCT search like mcts_alphazero in mcts.py, with leaves evaluated in
+// batches. Several threads descend the same tree; every node on a path carries a virtual
+// loss until its leaf has been evaluated, so later selections (by this thread or others)
+// spread out over the tree. Leaves from all threads go to one queue that calls the
+// evaluator, one batch at a time.
+//
+// The tree is kept small: expanding a node stores its moves as 4-byte edges (16-bit move,
+// fp16 prior), and a child node (32 bytes) is only created the first time its edge is
+// visited, so a simulation costs about one node plus the leaf's edges.
+class MCTS {
+public:
+    explicit MCTS(Evaluator& evaluator, const MCTSConfig& config = MCTSConfig());
+    ~MCTS() { stopPondering(); }
+
+    // Runs config.num_simulations, or until `limits` (time, or nodes as simulations) are spent
+    MCTSResult search(const ChessBitboard& root, const ChessBitboard* previous = nullptr,
+                      const SearchLimits& limits = SearchLimits());
+    // Make a running search (or ponder) return as soon as its pending batches are in; safe
+    // from another thread
+    void stop() { halt = true; }
+
+    // Keep searching `board` (normally the position after our move) in the background
+    // until the next search(), advance() or reset(), which pick up the grown tree
+    void ponder(const ChessBitboard& board, const ChessBitboard* previous = nullptr);
+    void stopPondering();
+    bool isPondering() const { return ponder_thread.joinable(); }
+
+    // Make the child reached by `move` the new root, e.g. after playing it. Returns false
+    // (and drops the tree) if the root has no such expanded child.
+    bool advance(const Move& move);
+    // Forget the tree
+    void reset();
+    // Leaves `tablebase` covers right after a capture or pawn move become terminal with
+    // their exact result instead of being evaluated (nullptr = none). Not owned; takes
+    // effect for nodes expanded from then on.
+    void setTablebase(const Tablebase* tablebase) { this->tablebase = tablebase; }
+    // Not meaningful while pondering
+    size_t treeSize() const { return nodes.size(); }
+    MCTSMemory memoryUsage() const;
+
+private:
+    static constexpr int MAX_EDGES = 256;
+
+    // A legal move of an expanded node
+    struct Edge {
+        uint16_t move = 0;   // from | to << 6 | flags << 12; the piece comes from the board
+        uint16_t prior = 0;  // IEEE half precision
+    };
+
+    // Statistics are updated by all workers at once. first_edge doubles as the expansion
+    // state: a worker claims a leaf by swapping UNEXPANDED for EXPANDING and publishes its
+    // edges (or TERMINAL) once they are written. Children created so far form a list,
+    // newest first, that workers prepend to with compare-and-swap.
+    struct Node {
+        static constexpr int32_t UNEXPANDED = -1;
+        static constexpr int32_t EXPANDING = -2;
+        static constexpr int32_t TERMINAL = -3;
+
+        std::atomic<float> value_sum{0.0f};  // for the player who made the move into this node
+        std::atomic<uint32_t> visits{0};
+        std::atomic<int32_t> first_edge{UNEXPANDED};
+        std::atomic<int32_t> first_child{-1};
+        int32_t next_sibling = -1;
+        int32_t source = -1;        // graph search: the node whose edges and children this one shares
+        uint16_t edge = 0;          // index of the move into this node among the parent's edges
+        uint16_t num_edges = 0;
+        float terminal_value = 0.0f;
+
+        Node() = default;
+        // Copies are only made while no search is running
+        Node(const Node& other) { *this = other; }
+        Node& operator=(const Node& other);
+    };
+    static_assert(sizeof(Node) <= 32, "MCTS nodes should stay within 32 bytes");
+
+    // Fixed-size blocks that never move, so workers can walk the tree while another one
+    // allocates. Runs from one allocate() call are contiguous.
+    template <typename T, int BLOCK_BITS>
+    class Arena {
+    public:
+        Arena() = default;
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        T& operator[](int32_t i) { return blocks[i >> BLOCK_BITS][i & (BLOCK_SIZE - 1)]; }
+        const T& operator[](int32_t i) const { return blocks[i >> BLOCK_BITS][i & (BLOCK_SIZE - 1)]; }
+
+        int32_t allocate(int count) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if ((next & (BLOCK_SIZE - 1)) + count > BLOCK_SIZE) next = (next | (BLOCK_SIZE - 1)) + 1;
+            int block = (next + count - 1) >> BLOCK_BITS;
+            if (block >= MAX_BLOCKS) throw std::runtime_error("MCTS tree is out of memory blocks");
+            if (!blocks[block]) blocks[block] = std::make_unique<T[]>(BLOCK_SIZE);
+            int32_t first = next;
+            next += count;
+            for (int32_t i = first; i < next; i++) (*this)[i] = T();
+            return first;
+        }
+        size_t size() const { return static_cast<size_t>(next); }
+        bool empty() const { return next == 0; }
+        // Into the last RESERVE_BLOCKS blocks: room for the leaves still in flight, but the
+        // search should stop before allocate() runs out
+        bool nearlyFull() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return (next >> BLOCK_BITS) >= MAX_BLOCKS - RESERVE_BLOCKS;
+        }
+        // Drops the contents but keeps the blocks for the next tree
+        void clear() { next = 0; }
+        void swap(Arena& other) {
+            blocks.swap(other.blocks);
+            std::swap(next, other.next);
+        }
+        size_t reservedBytes() const {
+            size_t count = 0;
+            for (const auto& block : blocks) count += block != nullptr;
+            return count * BLOCK_SIZE * sizeof(T);
+        }
+
+    private:
+        static constexpr int32_t BLOCK_SIZE = 1 << BLOCK_BITS;
+        static constexpr int MAX_BLOCKS = 4096;
+        static constexpr int RESERVE_BLOCKS = 16;
+
+        mutable std::mutex mutex;
+        std::array<std::unique_ptr<T[]>, MAX_BLOCKS> blocks;
+        int32_t next = 0;
+    };
+    using NodeArena = Arena<Node, 15>;
+    using EdgeArena = Arena<Edge, 17>;
+
+    // Position hash -> first node expanded for it, open addressing. Slots are only ever
+    // added while searching; the table is rebuilt from the tree before each search.
+    class TranspositionTable {
+    public:
+        void reset(size_t min_entries);
+        int32_t find(uint64_t hash) const;
+        // The node already stored for `hash`, else stores and returns `node` (also when the
+        // table is too full to store it)
+        int32_t insert(uint64_t hash, int32_t node);
+        size_t bytes() const { return capacity * sizeof(Slot); }
+
+    private:
+        struct Slot {
+            std::atomic<uint64_t> key{0};
+            std::atomic<int32_t> node{-1};
+        };
+        static constexpr int MAX_PROBES = 64;
+        std::unique_ptr<Slot[]> slots;
+        size_t mask = 0;
+        size_t capacity = 0;
+    };
+
+    class BatchQueue;
+
+    Evaluator& evaluator;
+    MCTSConfig config;
+    const Tablebase* tablebase = nullptr;
+    std::mt19937_64 rng;
+    NodeArena nodes;
+    EdgeArena edges;
+    TranspositionTable transposition_table;
+    ChessBitboard root_board;    // position at nodes[0] while nodes is not empty
+    bool root_noised = false;
+    std::atomic<bool> halt{false};
+    TimeManager time;
+    bool early_stop = false;     // config.early_stop, except while pondering
+    uint32_t start_visits = 0;   // root visits when the current search started
+    std::atomic<int> max_depth{0};
+    std::thread ponder_thread;
+
+    void clear();
+    MCTSResult run(const ChessBitboard& root, const ChessBitboard* previous, const SearchLimits& limits, bool pondering);
+    // True once the time is up, the arenas are nearly full or, with early stopping, the
+    // best root move is settled
+    bool budgetSpent(const std::atomic<int>& remaining) const;
+
+    // The node holding the edges and children of `node` (itself unless it shares another's)
+    int32_t holderOf(int32_t node) const {
+        int32_t source = nodes[node].source;
+        return source >= 0 ? source : node;
+    }
+    // Child created for each edge of `holder` so far, -1 where none
+    void childrenByEdge(int32_t holder, int32_t* children) const;
+    // The child of `holder` for `edge`, created if no worker has yet
+    int32_t childFor(int32_t holder, int edge);
+    // Index of the PUCT-best edge below `node`; `child` is its node or -1
+    int selectEdge(int node, uint32_t parent_visits, int32_t& child) const;
+    // Sums of the children's visits and value_sum, i.e. the position's own statistics when
+    // its children are shared
+    void childTotals(int32_t holder, uint32_t& visits, float& value_sum) const;
+    // Value for the side to move at an expanded or terminal node, from its children if
+    // they have been visited
+    float positionValue(int node) const;
+    // Register every expanded position of the current tree
+    void rebuildTranspositions();
+    // Index of the node holding `board` within two plies of the root, or -1
+    int findSubtree(const ChessBitboard& board) const;
+    // Move the subtree under `node` to the front of the arenas as the new root, dropping
+    // everything else
+    void promote(int node);
+    void expand(int node, const std::vector<Move>& moves, const std::vector<float>& priors);
+    void addNoise(int node);
+    // Graph search: when the position under `node` has more visits (through other parents)
+    // than its edge and their values disagree, the value for the side to move at `node`
+    // that pulls the edge's average onto the position's
+    bool transpositionValue(int node, uint32_t child_visits, float child_value_sum, float& value) const;
+    // Selection, evaluation and backup until `remaining` simulations have been claimed.
+    // work() is what each thread runs: it hands any exception to `queue` instead of letting
+    // it escape, and then leaves the queue.
+    void work(BatchQueue& queue, std::atomic<int>& remaining, const ChessBitboard& root, int leaves_per_batch);
+    void simulate(BatchQueue& queue, std::atomic<int>& remaining, const ChessBitboard& root, int leaves_per_batch);
+    // `value` is for the side to move at the last node of `path`
+    void backup(const std::vector<int>& path, float value);
+};
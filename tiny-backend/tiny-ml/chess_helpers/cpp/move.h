@@ -29,4 +29,21 @@ public:
     Square getTo() const { return to_square; }
     Piece::Type getPieceType() const { return piece_type; }
     uint8_t getFlags() const { return flags; }
+    bool isNone() const { return piece_type == Piece::Type::NONE; }
+    bool isPromotion() const { return flags >= PROMOTION_KNIGHT_FLAG; }
+    Piece::Type getPromotionType() const {
+        switch (flags) {
+            case PROMOTION_QUEEN_FLAG:  return Piece::Type::QUEEN;
+            case PROMOTION_ROOK_FLAG:   return Piece::Type::ROOK;
+            case PROMOTION_BISHOP_FLAG: return Piece::Type::BISHOP;
+            case PROMOTION_KNIGHT_FLAG: return Piece::Type::KNIGHT;
+            default:                    return Piece::Type::NONE;
+        }
+    }
+
+    bool operator==(const Move& other) const {
+        return from_square == other.from_square && to_square == other.to_square &&
+               piece_type == other.piece_type && flags == other.flags;
+    }
+    bool operator!=(const Move& other) const { return !(*this == other); }
 };
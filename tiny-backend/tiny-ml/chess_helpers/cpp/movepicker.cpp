@@ -0,0 +1,205 @@
+#include "movepicker.h"
+#include <cstdlib>
+#include <cstring>
+
+void HistoryTable::clear() {
+    std::memset(scores, 0, sizeof(scores));
+}
+
+void HistoryTable::update(bool white, const Move& move, int bonus) {
+    int& entry = scores[white ? 0 : 1][move.getFrom()][move.getTo()];
+    if (bonus > MAX_SCORE) bonus = MAX_SCORE;
+    if (bonus < -MAX_SCORE) bonus = -MAX_SCORE;
+    entry += bonus - entry * std::abs(bonus) / MAX_SCORE;
+}
+
+void KillerTable::clear() {
+    for (int ply = 0; ply < MAX_PLY; ply++) {
+        moves[ply][0] = moves[ply][1] = Move();
+    }
+}
+
+void KillerTable::update(int ply, const Move& move) {
+    if (ply >= MAX_PLY || moves[ply][0] == move) return;
+    moves[ply][1] = moves[ply][0];
+    moves[ply][0] = move;
+}
+
+MovePicker::MovePicker(const ChessBitboard& board, const Move& tt_move,
+                       const Move* killers, const HistoryTable* history)
+    : board(board), tt_move(tt_move), history(history), stage(TT_MOVE), current(0) {
+    if (killers) {
+        this->killers[0] = killers[0];
+        this->killers[1] = killers[1];
+    }
+    bool in_check = board.isInCheck(board.white_to_move ? Piece::Color::WHITE : Piece::Color::BLACK);
+    stage = in_check ? EVASION_TT_MOVE : TT_MOVE;
+    if (this->tt_move.isNone() || !board.isPseudoLegal(this->tt_move)) {
+        this->tt_move = Move();
+        stage = in_check ? GEN_EVASIONS : GEN_CAPTURES;
+    }
+}
+
+MovePicker::MovePicker(const ChessBitboard& board, Quiescence)
+    : board(board), history(nullptr), stage(QS_GEN_CAPTURES), current(0) {
+    if (board.isInCheck(board.white_to_move ? Piece::Color::WHITE : Piece::Color::BLACK)) {
+        stage = GEN_EVASIONS;
+    }
+}
+
+Move MovePicker::nextMove() {
+    switch (stage) {
+        case TT_MOVE:
+            stage = GEN_CAPTURES;
+            return tt_move;
+
+        case GEN_CAPTURES:
+            scoreCaptures();
+            stage = GOOD_CAPTURES;
+            [[fallthrough]];
+
+        case GOOD_CAPTURES:
+            while (current < moves.size()) {
+                Move move = pickBest();
+                if (move == tt_move) continue;
+                // Losing captures wait until every quiet move has been tried
+                if (board.seeGE(move, 0)) return move;
+                bad_captures.push_back(move);
+            }
+            stage = KILLER_1;
+            [[fallthrough]];
+
+        case KILLER_1:
+        case KILLER_2:
+            while (stage == KILLER_1 || stage == KILLER_2) {
+                const Move& killer = killers[stage == KILLER_1 ? 0 : 1];
+                bool repeated = (stage == KILLER_2 && killer == killers[0]);
+                stage = (stage == KILLER_1) ? KILLER_2 : GEN_QUIETS;
+                if (!killer.isNone() && !repeated && killer != tt_move &&
+                    board.isPseudoLegal(killer) && !board.isCapture(killer) && !killer.isPromotion()) {
+                    return killer;
+                }
+            }
+            [[fallthrough]];
+
+        case GEN_QUIETS:
+            scoreQuiets();
+            stage = QUIETS;
+            [[fallthrough]];
+
+        case QUIETS:
+            while (current < moves.size()) {
+                Move move = pickBest();
+                if (move != tt_move && !isKiller(move)) return move;
+            }
+            current = 0;
+            stage = BAD_CAPTURES;
+            [[fallthrough]];
+
+        case BAD_CAPTURES:
+            if (current < bad_captures.size()) return bad_captures[current++];
+            stage = DONE;
+            return Move();
+
+        case QS_GEN_CAPTURES:
+            scoreCaptures();
+            stage = QS_CAPTURES;
+            [[fallthrough]];
+
+        case QS_CAPTURES:
+            while (current < moves.size()) {
+                Move move = pickBest();
+                if (board.seeGE(move, 0)) return move;
+            }
+            stage = DONE;
+            return Move();
+
+        case EVASION_TT_MOVE:
+            stage = GEN_EVASIONS;
+            return tt_move;
+
+        case GEN_EVASIONS:
+            scoreEvasions();
+            stage = EVASIONS;
+            [[fallthrough]];
+
+        case EVASIONS:
+            while (current < moves.size()) {
+                Move move = pickBest();
+                if (move != tt_move) return move;
+            }
+            stage = DONE;
+            [[fallthrough]];
+
+        case DONE:
+            return Move();
+    }
+    return Move();
+}
+
+void MovePicker::scoreCaptures() {
+    std::vector<Move> generated;
+    generated.reserve(64);
+    board.generateCaptures(generated);
+
+    moves.clear();
+    current = 0;
+    for (const Move& move : generated) {
+        moves.push_back({move, mvvLva(move)});
+    }
+}
+
+int MovePicker::mvvLva(const Move& move) const {
+    // The most valuable victim first, then the cheapest attacker
+    int victim = (move.getFlags() == Move::EN_PASSANT_FLAG)
+        ? ChessBitboard::SEE_VALUE[Piece::Type::PAWN]
+        : ChessBitboard::SEE_VALUE[board.getPieceAt(move.getTo()).type()];
+    int score = victim * 8 - move.getPieceType();
+    if (move.isPromotion()) score += ChessBitboard::SEE_VALUE[move.getPromotionType()] * 8;
+    return score;
+}
+
+void MovePicker::scoreEvasions() {
+    std::vector<Move> generated;
+    generated.reserve(32);
+    board.generateEvasions(generated);
+
+    moves.clear();
+    current = 0;
+    for (const Move& move : generated) {
+        // Captures of the checker go first, everything else by history
+        int score;
+        if (board.isCapture(move) || move.isPromotion()) {
+            score = (1 << 28) + mvvLva(move);
+        } else {
+            score = history ? history->get(board.white_to_move, move) : 0;
+        }
+        moves.push_back({move, score});
+    }
+}
+
+void MovePicker::scoreQuiets() {
+    std::vector<Move> generated;
+    generated.reserve(128);
+    board.generateQuiets(generated);
+
+    moves.clear();
+    current = 0;
+    for (const Move& move : generated) {
+        int score = history ? history->get(board.white_to_move, move) : 0;
+        moves.push_back({move, score});
+    }
+}
+
+Move MovePicker::pickBest() {
+    size_t best = current;
+    for (size_t i = current + 1; i < moves.size(); i++) {
+        if (moves[i].score > moves[best].score) best = i;
+    }
+    std::swap(moves[current], moves[best]);
+    return moves[current++].move;
+}
+
+bool MovePicker::isKiller(const Move& move) const {
+    return move == killers[0] || move == killers[1];
+}
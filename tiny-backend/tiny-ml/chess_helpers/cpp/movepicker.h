@@ -0,0 +1,80 @@
+// movepicker.h
+#pragma once
+#include "bitboard.h"
+#include <vector>
+
+// Butterfly history: how often a quiet move from -> to caused a cutoff, per side to move
+struct HistoryTable {
+    static constexpr int MAX_SCORE = 16384;
+    int scores[2][64][64];
+
+    HistoryTable() { clear(); }
+    void clear();
+    int get(bool white, const Move& move) const { return scores[white ? 0 : 1][move.getFrom()][move.getTo()]; }
+    // Gravity update keeps every entry inside [-MAX_SCORE, MAX_SCORE]
+    void update(bool white, const Move& move, int bonus);
+};
+
+// Two quiet moves per ply that recently caused a beta cutoff
+struct KillerTable {
+    static constexpr int MAX_PLY = 128;
+    Move moves[MAX_PLY][2];
+
+    void clear();
+    void update(int ply, const Move& move);
+};
+
+// Staged, lazy move ordering. Moves are handed out one at a time as:
+//   1. the transposition table move
+//   2. captures and promotions that do not lose material (MVV-LVA order, SEE >= 0)
+//   3. killer moves
+//   4. quiet moves by history score
+//   5. the losing captures held back in stage 2
+// A stage is only generated once the previous one is exhausted, so a search that
+// cuts off on the TT move or a good capture never generates quiet moves at all.
+// In check the picker only hands out the TT move and then the evasions, captures first.
+// Moves are pseudo-legal; the caller still has to check isLegal().
+class MovePicker {
+public:
+    // Tag for the quiescence picker: only captures and promotions that do not lose
+    // material, best first (or every evasion when in check)
+    struct Quiescence {};
+
+    MovePicker(const ChessBitboard& board, const Move& tt_move = Move(),
+               const Move* killers = nullptr, const HistoryTable* history = nullptr);
+    MovePicker(const ChessBitboard& board, Quiescence);
+
+    // Returns a none move (Move::isNone()) once every stage is exhausted
+    Move nextMove();
+
+private:
+    enum Stage {
+        TT_MOVE, GEN_CAPTURES, GOOD_CAPTURES, KILLER_1, KILLER_2, GEN_QUIETS, QUIETS, BAD_CAPTURES,
+        EVASION_TT_MOVE, GEN_EVASIONS, EVASIONS,
+        QS_GEN_CAPTURES, QS_CAPTURES,
+        DONE
+    };
+
+    struct ScoredMove {
+        Move move;
+        int score;
+    };
+
+    const ChessBitboard& board;
+    Move tt_move;
+    Move killers[2];
+    const HistoryTable* history;
+    Stage stage;
+
+    std::vector<ScoredMove> moves;
+    std::vector<Move> bad_captures;
+    size_t current;
+
+    void scoreCaptures();
+    void scoreQuiets();
+    void scoreEvasions();
+    int mvvLva(const Move& move) const;
+    // Selection sort step: swaps the best remaining move to the front and returns it
+    Move pickBest();
+    bool isKiller(const Move& move) const;
+};
@@ -0,0 +1,281 @@
+#include "nnue.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__AVX2__) || defined(__AVX512BW__)
+#include <immintrin.h>
+#endif
+
+namespace NNUE {
+
+namespace {
+
+inline Piece::Color perspectiveColor(int perspective) {
+    return perspective == 0 ? Piece::Color::WHITE : Piece::Color::BLACK;
+}
+
+inline Square kingSquare(const ChessBitboard& board, int perspective) {
+    return __builtin_ctzll(board.getPieces(perspective == 0 ? Piece::Color::WHITE : Piece::Color::BLACK,
+                                           Piece::Type::KING));
+}
+
+inline void addRow(int16_t* values, const int16_t* row) {
+#if defined(__AVX512BW__)
+    for (int i = 0; i < HALF_DIMS; i += 32) {
+        __m512i v = _mm512_loadu_si512(values + i);
+        _mm512_storeu_si512(values + i, _mm512_add_epi16(v, _mm512_loadu_si512(row + i)));
+    }
+#elif defined(__AVX2__)
+    for (int i = 0; i < HALF_DIMS; i += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + i), _mm256_add_epi16(v, w));
+    }
+#else
+    for (int i = 0; i < HALF_DIMS; i++) values[i] += row[i];
+#endif
+}
+
+inline void subRow(int16_t* values, const int16_t* row) {
+#if defined(__AVX512BW__)
+    for (int i = 0; i < HALF_DIMS; i += 32) {
+        __m512i v = _mm512_loadu_si512(values + i);
+        _mm512_storeu_si512(values + i, _mm512_sub_epi16(v, _mm512_loadu_si512(row + i)));
+    }
+#elif defined(__AVX2__)
+    for (int i = 0; i < HALF_DIMS; i += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + i), _mm256_sub_epi16(v, w));
+    }
+#else
+    for (int i = 0; i < HALF_DIMS; i++) values[i] -= row[i];
+#endif
+}
+
+// Clamp one side's accumulator to [0, 127] as the uint8 input of the first dense layer
+inline void clippedHalf(const int16_t* values, uint8_t* out) {
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    for (int i = 0; i < HALF_DIMS; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i + 16));
+        // packs saturates to [-128, 127] but interleaves the 128-bit lanes; permute restores order
+        __m256i packed = _mm256_max_epi8(_mm256_packs_epi16(a, b), zero);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+#else
+    for (int i = 0; i < HALF_DIMS; i++) {
+        out[i] = static_cast<uint8_t>(std::clamp<int>(values[i], 0, 127));
+    }
+#endif
+}
+
+// output[i] = biases[i] + sum_j weights[i][j] * input[j]
+void affine(const uint8_t* input, const int8_t* weights, const int32_t* biases,
+            int32_t* output, int in_dims, int out_dims) {
+    for (int i = 0; i < out_dims; i++) {
+        const int8_t* row = weights + i * in_dims;
+        int32_t sum = biases[i];
+        int j = 0;
+#if defined(__AVX512BW__)
+        if (in_dims % 64 == 0) {
+            __m512i acc = _mm512_setzero_si512();
+            for (; j < in_dims; j += 64) {
+                __m512i a = _mm512_loadu_si512(input + j);
+                __m512i w = _mm512_loadu_si512(row + j);
+#if defined(__AVX512VNNI__)
+                acc = _mm512_dpbusd_epi32(acc, a, w);
+#else
+                __m512i products = _mm512_maddubs_epi16(a, w);
+                acc = _mm512_add_epi32(acc, _mm512_madd_epi16(products, _mm512_set1_epi16(1)));
+#endif
+            }
+            sum += _mm512_reduce_add_epi32(acc);
+        }
+#endif
+#if defined(__AVX2__)
+        if (j == 0 && in_dims % 32 == 0) {
+            __m256i acc = _mm256_setzero_si256();
+            for (; j < in_dims; j += 32) {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + j));
+                __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + j));
+                // Inputs are <= 127, so the pairwise int16 sums cannot saturate
+                __m256i products = _mm256_maddubs_epi16(a, w);
+                acc = _mm256_add_epi32(acc, _mm256_madd_epi16(products, _mm256_set1_epi16(1)));
+            }
+            __m128i half = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+            half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+            half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+            sum += _mm_cvtsi128_si32(half);
+        }
+#endif
+        for (; j < in_dims; j++) sum += static_cast<int32_t>(input[j]) * row[j];
+        output[i] = sum;
+    }
+}
+
+inline void clippedRelu(const int32_t* input, uint8_t* output, int dims) {
+    for (int i = 0; i < dims; i++) {
+        output[i] = static_cast<uint8_t>(std::clamp(input[i] >> WEIGHT_SHIFT, 0, 127));
+    }
+}
+
+template <typename T>
+void readArray(std::ifstream& in, std::vector<T>& out, size_t count) {
+    out.resize(count);
+    in.read(reinterpret_cast<char*>(out.data()), static_cast<std::streamsize>(count * sizeof(T)));
+}
+
+uint32_t readU32(std::ifstream& in) {
+    uint32_t value = 0;
+    in.read(reinterpret_cast<char*>(&value), sizeof(value));
+    return value;
+}
+
+} // namespace
+
+int featureIndex(int perspective, Square king_square, Piece piece, Square square) {
+    // Black sees the board rotated by 180 degrees, so both sides use "white" features
+    int flip = perspective == 0 ? 0 : 63;
+    bool friendly = piece.color() == perspectiveColor(perspective);
+    int piece_index = 1 + (piece.type() - Piece::Type::PAWN) * 128 + (friendly ? 0 : 64);
+    return (square ^ flip) + piece_index + PS_END * (king_square ^ flip);
+}
+
+void Network::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot open NNUE file: " + path);
+
+    if (readU32(in) != FILE_VERSION) throw std::runtime_error("Not a HalfKP NNUE file: " + path);
+    readU32(in); // architecture hash
+    uint32_t desc_size = readU32(in);
+    if (!in || desc_size > (1u << 20)) throw std::runtime_error("Corrupt NNUE header: " + path);
+    desc.resize(desc_size);
+    in.read(&desc[0], desc_size);
+
+    readU32(in); // feature transformer hash
+    readArray(in, ft_biases, HALF_DIMS);
+    readArray(in, ft_weights, static_cast<size_t>(INPUT_DIMS) * HALF_DIMS);
+
+    readU32(in); // network hash
+    readArray(in, l1_biases, L1_DIMS);
+    readArray(in, l1_weights, L1_DIMS * 2 * HALF_DIMS);
+    readArray(in, l2_biases, L2_DIMS);
+    readArray(in, l2_weights, L2_DIMS * L1_DIMS);
+    std::vector<int32_t> out_biases;
+    readArray(in, out_biases, 1);
+    readArray(in, out_weights, L2_DIMS);
+
+    if (!in || in.peek() != std::char_traits<char>::eof()) {
+        ft_weights.clear();
+        throw std::runtime_error("NNUE file has the wrong size for HalfKP 256x2-32-32: " + path);
+    }
+    out_bias = out_biases[0];
+}
+
+void Network::refreshPerspective(const ChessBitboard& board, int perspective, int16_t* values) const {
+    std::memcpy(values, ft_biases.data(), sizeof(int16_t) * HALF_DIMS);
+    Square king = kingSquare(board, perspective);
+    Bitboard pieces = board.getAllPieces() & ~(board.white_king | board.black_king);
+    for (; pieces; pieces &= pieces - 1) {
+        Square sq = __builtin_ctzll(pieces);
+        int index = featureIndex(perspective, king, board.getPieceAt(sq), sq);
+        addRow(values, &ft_weights[static_cast<size_t>(index) * HALF_DIMS]);
+    }
+}
+
+void Network::refresh(const ChessBitboard& board, Accumulator& acc) const {
+    refreshPerspective(board, 0, acc.values[0]);
+    refreshPerspective(board, 1, acc.values[1]);
+}
+
+void Network::update(const ChessBitboard& board, const Accumulator& parent, Accumulator& acc) const {
+    for (int perspective = 0; perspective < 2; perspective++) {
+        Piece own_king(perspectiveColor(perspective), Piece::Type::KING);
+        bool king_moved = false;
+        for (int i = 0; i < board.dirty_count; i++) {
+            if (board.dirty[i].piece == own_king) king_moved = true;
+        }
+        // Every feature of this side depends on its king square
+        if (king_moved) {
+            refreshPerspective(board, perspective, acc.values[perspective]);
+            continue;
+        }
+
+        int16_t* values = acc.values[perspective];
+        std::memcpy(values, parent.values[perspective], sizeof(int16_t) * HALF_DIMS);
+        Square king = kingSquare(board, perspective);
+        for (int i = 0; i < board.dirty_count; i++) {
+            const DirtyPiece& dp = board.dirty[i];
+            if (dp.piece.type() == Piece::Type::KING) continue;
+            const int16_t* row = &ft_weights[static_cast<size_t>(featureIndex(perspective, king, dp.piece, dp.square)) * HALF_DIMS];
+            if (dp.added) addRow(values, row);
+            else subRow(values, row);
+        }
+    }
+}
+
+int Network::evaluate(const ChessBitboard& board, const Accumulator& acc) const {
+    alignas(64) uint8_t transformed[2 * HALF_DIMS];
+    alignas(64) int32_t l1_out[L1_DIMS];
+    alignas(64) uint8_t l1_act[L1_DIMS];
+    alignas(64) int32_t l2_out[L2_DIMS];
+    alignas(64) uint8_t l2_act[L2_DIMS];
+
+    // Side to move first, then the opponent
+    int us = board.white_to_move ? 0 : 1;
+    clippedHalf(acc.values[us], transformed);
+    clippedHalf(acc.values[1 - us], transformed + HALF_DIMS);
+
+    affine(transformed, l1_weights.data(), l1_biases.data(), l1_out, 2 * HALF_DIMS, L1_DIMS);
+    clippedRelu(l1_out, l1_act, L1_DIMS);
+    affine(l1_act, l2_weights.data(), l2_biases.data(), l2_out, L1_DIMS, L2_DIMS);
+    clippedRelu(l2_out, l2_act, L2_DIMS);
+
+    int32_t output;
+    affine(l2_act, out_weights.data(), &out_bias, &output, L2_DIMS, 1);
+    return output / FV_SCALE;
+}
+
+int Network::evaluate(const ChessBitboard& board) const {
+    Accumulator acc;
+    refresh(board, acc);
+    return evaluate(board, acc);
+}
+
+void AccumulatorStack::reset(const Network* network, const ChessBitboard& root) {
+    this->network = network;
+    if (entries.empty()) entries.resize(128);
+    top = 0;
+    entries[0].board = &root;
+    entries[0].computed = false;
+}
+
+void AccumulatorStack::push(const ChessBitboard& board) {
+    top++;
+    if (top >= entries.size()) entries.resize(entries.size() * 2);
+    entries[top].board = &board;
+    entries[top].computed = false;
+}
+
+int AccumulatorStack::evaluate() {
+    compute(top);
+    return network->evaluate(*entries[top].board, entries[top].acc);
+}
+
+void AccumulatorStack::compute(size_t index) {
+    Entry& entry = entries[index];
+    if (entry.computed) return;
+    if (index == 0 || entry.board->dirty_count > ChessBitboard::MAX_DIRTY) {
+        network->refresh(*entry.board, entry.acc);
+    } else {
+        compute(index - 1);
+        network->update(*entry.board, entries[index - 1].acc, entry.acc);
+    }
+    entry.computed = true;
+}
+
+} // namespace NNUE
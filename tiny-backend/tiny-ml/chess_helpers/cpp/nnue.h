@@ -0,0 +1,89 @@
+// nnue.h
+#pragma once
+#include "bitboard.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Efficiently updatable evaluation network, HalfKP(Friend)[41024->256x2]-32-32-1.
+//
+// Each side has 256 accumulators over the sparse (king square, piece, square) features
+// of the non-king pieces. A move only touches two or three features, so an accumulator
+// is updated from its parent's with a few row adds instead of being recomputed, except
+// for that side's own king moves. The dense layers are int8 with int32 biases and run
+// on AVX-512 / AVX2 when the module is compiled for them, with a scalar fallback.
+//
+// The weight file uses the Stockfish 12 HalfKP layout (see chess_helpers/nnue_export.py),
+// so nets exported from our training stack and existing HalfKP nets load the same way.
+namespace NNUE {
+    constexpr int PS_END = 641;                 // 10 piece kinds x 64 squares + 1
+    constexpr int INPUT_DIMS = 64 * PS_END;     // 41024 features per side
+    constexpr int HALF_DIMS = 256;
+    constexpr int L1_DIMS = 32;
+    constexpr int L2_DIMS = 32;
+    constexpr int WEIGHT_SHIFT = 6;             // hidden weights are scaled by 64
+    constexpr int FV_SCALE = 16;                // output units per centipawn
+    constexpr uint32_t FILE_VERSION = 0x7AF32F16u;
+
+    struct alignas(64) Accumulator {
+        int16_t values[2][HALF_DIMS];           // [WHITE, BLACK] perspective
+    };
+
+    class Network {
+    public:
+        // Throws std::runtime_error on a missing, truncated or mismatched file
+        void load(const std::string& path);
+        bool isLoaded() const { return !ft_weights.empty(); }
+        const std::string& description() const { return desc; }
+
+        // Full evaluation from scratch, centipawns for the side to move
+        int evaluate(const ChessBitboard& board) const;
+        int evaluate(const ChessBitboard& board, const Accumulator& acc) const;
+
+        void refresh(const ChessBitboard& board, Accumulator& acc) const;
+        // acc = parent + the pieces `board` changed in its last makeMove
+        // (board.dirty_count <= MAX_DIRTY is the caller's responsibility)
+        void update(const ChessBitboard& board, const Accumulator& parent, Accumulator& acc) const;
+
+    private:
+        std::string desc;
+        std::vector<int16_t> ft_biases;         // [HALF_DIMS]
+        std::vector<int16_t> ft_weights;        // [INPUT_DIMS][HALF_DIMS]
+        std::vector<int32_t> l1_biases;         // [L1_DIMS]
+        std::vector<int8_t> l1_weights;         // [L1_DIMS][2 * HALF_DIMS]
+        std::vector<int32_t> l2_biases;         // [L2_DIMS]
+        std::vector<int8_t> l2_weights;         // [L2_DIMS][L1_DIMS]
+        int32_t out_bias = 0;
+        std::vector<int8_t> out_weights;        // [L2_DIMS]
+
+        void refreshPerspective(const ChessBitboard& board, int perspective, int16_t* values) const;
+    };
+
+    // Feature index of `piece` on `square` as seen by `perspective` (0 = white, 1 = black)
+    // with that side's king on `king_square`
+    int featureIndex(int perspective, Square king_square, Piece piece, Square square);
+
+    // One accumulator per search ply. Pushing a board after makeMove and popping it when
+    // the child returns gives make/unmake semantics on top of the copy-make boards.
+    // Accumulators are filled lazily on evaluate(), from the parent's where possible, so
+    // nodes that are cut off before evaluating cost nothing.
+    class AccumulatorStack {
+    public:
+        void reset(const Network* network, const ChessBitboard& root);
+        void push(const ChessBitboard& board);
+        void pop() { top--; }
+        int evaluate();
+
+    private:
+        struct Entry {
+            Accumulator acc;
+            const ChessBitboard* board;
+            bool computed;
+        };
+        const Network* network = nullptr;
+        std::vector<Entry> entries;
+        size_t top = 0;
+
+        void compute(size_t index);
+    };
+}
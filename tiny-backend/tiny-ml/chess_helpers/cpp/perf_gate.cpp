@@ -0,0 +1,322 @@
+// perf_gate.cpp
+// Performance regression gate (chess_engine_perf_gate, see build.sh). Runs a fixed,
+// deterministic workload and compares it with a stored baseline:
+//   perft   the standard perft suite, nodes/sec
+//   search  fixed-depth alpha-beta on a set of positions, nodes/sec
+//   mcts    single-threaded MCTS with a cheap stub evaluator, simulations/sec
+// Every workload also yields a signature (perft and search node counts, a hash of the
+// MCTS root visits) that must match the baseline exactly, so a change in search
+// behaviour fails the gate even when the speed is unchanged. Throughput is the best of
+// --repetitions runs, since other load on the machine only ever slows a run down; it
+// regresses when it falls below the baseline by more than both --tolerance and --sigmas
+// standard deviations of the two measurements combined, the latter capped at --max-noise
+// so a noisy baseline cannot hide a large slowdown.
+//
+//     ./chess_engine_perf_gate --baseline perf_baseline.json          exit 1 on regression
+//     ./chess_engine_perf_gate --write-baseline perf_baseline.json    after a deliberate change
+//
+// Throughput baselines are per machine; regenerate them on the machine that runs the gate.
+// --signatures-only checks the signatures alone, which hold everywhere.
+#include "bitboard.h"
+#include "json.h"
+#include "mcts.h"
+#include "search.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct PerftCase {
+    const char* fen;
+    int depth;
+    uint64_t nodes;
+};
+
+// PERFT_SUITE from test_engine.py at shallower depths
+const PerftCase PERFT_SUITE[] = {
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 4, 197281},
+    {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 3, 97862},
+    {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624},
+    {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 3, 9467},
+    {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 3, 62379},
+    {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 3, 89890},
+};
+
+const char* const BENCH_POSITIONS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r1bqkbnr/pppp1ppp/2n5/1B2p3/4P3/5N2/PPPP1PPP/RNBQK2R b KQkq - 3 3",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 1",
+};
+constexpr int SEARCH_DEPTH = 6;
+constexpr int MCTS_SIMULATIONS = 3000;
+
+// Uniform priors and a value drawn from the position hash: deterministic, and cheap
+// enough that the MCTS workload measures the tree rather than an evaluator
+class StubEvaluator : public Evaluator {
+public:
+    void evaluate(const std::vector<EvalRequest>& batch, std::vector<EvalResult>& results) override {
+        results.resize(batch.size());
+        for (size_t i = 0; i < batch.size(); i++) {
+            results[i].priors.assign(batch[i].moves.size(), 1.0f / batch[i].moves.size());
+            uint64_t mixed = batch[i].board.hash * 0x9E3779B97F4A7C15ULL;
+            results[i].value = static_cast<float>(mixed >> 40) / static_cast<float>(1 << 24) - 0.5f;
+        }
+    }
+};
+
+struct Measurement {
+    uint64_t signature = 0;
+    double rate = 0.0;    // best work per second
+    double stddev = 0.0;  // over the repetitions
+};
+
+struct Workload {
+    const char* name;
+    const char* unit;
+    // Does the work once: sets the signature and returns the amount of work done
+    uint64_t (*run)(const ChessBitboard& prototype, uint64_t& signature);
+};
+
+uint64_t runPerft(const ChessBitboard& prototype, uint64_t& signature) {
+    uint64_t total = 0;
+    for (const PerftCase& test : PERFT_SUITE) {
+        ChessBitboard board = prototype;
+        board.loadFen(test.fen);
+        uint64_t nodes = board.perft(test.depth);
+        if (nodes != test.nodes) {
+            throw std::runtime_error(std::string("perft ") + test.fen + " depth " + std::to_string(test.depth) + ": " +
+                                     std::to_string(nodes) + " nodes, expected " + std::to_string(test.nodes));
+        }
+        total += nodes;
+    }
+    signature = total;
+    return total;
+}
+
+uint64_t runSearch(const ChessBitboard& prototype, uint64_t& signature) {
+    uint64_t total = 0;
+    for (const char* fen : BENCH_POSITIONS) {
+        ChessBitboard board = prototype;
+        board.loadFen(fen);
+        Search search;  // fresh tables, so every position searches the same tree every time
+        total += search.run(board, SEARCH_DEPTH).nodes;
+    }
+    signature = total;
+    return total;
+}
+
+uint64_t runMcts(const ChessBitboard& prototype, uint64_t& signature) {
+    StubEvaluator evaluator;
+    MCTSConfig config;
+    config.num_simulations = MCTS_SIMULATIONS;
+    config.dirichlet_epsilon = 0.0f;
+    config.threads = 1;
+    uint64_t total = 0;
+    uint64_t hash = 1469598103934665603ULL;  // FNV-1a over every root move and its visits
+    auto mix = [&hash](uint64_t value) {
+        for (int i = 0; i < 8; i++, value >>= 8) hash = (hash ^ (value & 0xFF)) * 1099511628211ULL;
+    };
+    for (const char* fen : BENCH_POSITIONS) {
+        ChessBitboard board = prototype;
+        board.loadFen(fen);
+        MCTS mcts(evaluator, config);
+        MCTSResult result = mcts.search(board);
+        for (size_t i = 0; i < result.moves.size(); i++) {
+            mix(result.moves[i].getFrom() | result.moves[i].getTo() << 6 | result.moves[i].getFlags() << 12);
+            mix(result.visits[i]);
+            total += result.visits[i];
+        }
+    }
+    signature = hash & ((1ULL << 48) - 1);  // exact as a JSON number in any reader
+    return total;
+}
+
+const Workload WORKLOADS[] = {
+    {"perft", "nodes/s", runPerft},
+    {"search", "nodes/s", runSearch},
+    {"mcts", "simulations/s", runMcts},
+};
+
+Measurement measure(const Workload& workload, const ChessBitboard& prototype, int repetitions) {
+    Measurement result;
+    std::vector<double> rates;
+    for (int r = 0; r < repetitions; r++) {
+        uint64_t signature = 0;
+        auto start = std::chrono::steady_clock::now();
+        uint64_t work = workload.run(prototype, signature);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (r > 0 && signature != result.signature) {
+            throw std::runtime_error(std::string(workload.name) + " is not deterministic: signature " +
+                                     std::to_string(signature) + " after " + std::to_string(result.signature));
+        }
+        result.signature = signature;
+        rates.push_back(work / std::max(seconds, 1e-9));
+    }
+    result.rate = *std::max_element(rates.begin(), rates.end());
+    double mean = 0.0, squares = 0.0;
+    for (double rate : rates) mean += rate;
+    mean /= rates.size();
+    for (double rate : rates) squares += (rate - mean) * (rate - mean);
+    result.stddev = rates.size() > 1 ? std::sqrt(squares / (rates.size() - 1)) : 0.0;
+    return result;
+}
+
+struct Options {
+    std::string baseline;
+    std::string write_baseline;
+    int repetitions = 5;
+    double tolerance = 0.05;  // relative slowdown always accepted
+    double sigmas = 3.0;      // slowdowns within this much measurement noise are accepted too
+    double max_noise = 0.10;  // ...but never more than this relative slowdown
+    bool signatures_only = false;
+    bool json = false;
+};
+
+std::map<std::string, Measurement> readBaseline(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("Cannot open baseline " + path);
+    std::stringstream text;
+    text << in.rdbuf();
+    std::map<std::string, std::string> top, fields;
+    if (!json::parseObject(text.str(), top)) throw std::runtime_error("Malformed baseline " + path);
+    std::map<std::string, Measurement> baseline;
+    for (const Workload& workload : WORKLOADS) {
+        auto entry = top.find(workload.name);
+        fields.clear();
+        if (entry == top.end() || !json::parseObject(entry->second, fields) || !fields.count("signature") ||
+            !fields.count("rate") || !fields.count("stddev")) {
+            throw std::runtime_error(std::string("Baseline ") + path + " has no complete \"" + workload.name + "\" entry");
+        }
+        Measurement& measurement = baseline[workload.name];
+        measurement.signature = std::stoull(fields["signature"]);
+        measurement.rate = std::stod(fields["rate"]);
+        measurement.stddev = std::stod(fields["stddev"]);
+    }
+    return baseline;
+}
+
+void writeBaseline(const std::string& path, const std::map<std::string, Measurement>& results) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) throw std::runtime_error("Cannot write baseline " + path);
+    out << "{\n";
+    for (size_t i = 0; i < std::size(WORKLOADS); i++) {
+        const Workload& workload = WORKLOADS[i];
+        const Measurement& m = results.at(workload.name);
+        char line[256];
+        std::snprintf(line, sizeof(line), "  \"%s\": {\"signature\": %llu, \"rate\": %.1f, \"stddev\": %.1f, \"unit\": \"%s\"}%s\n",
+                      workload.name, static_cast<unsigned long long>(m.signature), m.rate, m.stddev, workload.unit,
+                      i + 1 < std::size(WORKLOADS) ? "," : "");
+        out << line;
+    }
+    out << "}\n";
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string flag = argv[i];
+        if (flag == "--signatures-only") {
+            options.signatures_only = true;
+            continue;
+        }
+        if (flag == "--json") {
+            options.json = true;
+            continue;
+        }
+        if (i + 1 >= argc) return false;
+        std::string value = argv[++i];
+        try {
+            if (flag == "--baseline") options.baseline = value;
+            else if (flag == "--write-baseline") options.write_baseline = value;
+            else if (flag == "--repetitions") options.repetitions = std::max(1, std::stoi(value));
+            else if (flag == "--tolerance") options.tolerance = std::stod(value);
+            else if (flag == "--sigmas") options.sigmas = std::stod(value);
+            else if (flag == "--max-noise") options.max_noise = std::stod(value);
+            else return false;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return !options.baseline.empty() || !options.write_baseline.empty();
+}
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: " << argv[0] << " (--baseline FILE | --write-baseline FILE) [--repetitions 5]"
+                     " [--tolerance 0.05] [--sigmas 3] [--max-noise 0.1] [--signatures-only] [--json]\n";
+        return 2;
+    }
+
+    ChessBitboard prototype;  // copied instead of constructing boards (which rebuilds tables)
+    std::map<std::string, Measurement> baseline, results;
+    try {
+        if (!options.baseline.empty()) baseline = readBaseline(options.baseline);
+        int repetitions = options.signatures_only ? 1 : options.repetitions;
+        for (const Workload& workload : WORKLOADS) results[workload.name] = measure(workload, prototype, repetitions);
+        if (!options.write_baseline.empty()) writeBaseline(options.write_baseline, results);
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+
+    bool failed = false;
+    std::string report;
+    for (const Workload& workload : WORKLOADS) {
+        const Measurement& now = results[workload.name];
+        bool signature_ok = true, speed_ok = true;
+        double change = 0.0;
+        if (!baseline.empty()) {
+            const Measurement& before = baseline[workload.name];
+            signature_ok = now.signature == before.signature;
+            change = before.rate > 0 ? now.rate / before.rate - 1.0 : 0.0;
+            double noise = options.sigmas * std::sqrt(before.stddev * before.stddev + now.stddev * now.stddev);
+            double allowed = std::max(options.tolerance, std::min(noise / before.rate, options.max_noise)) * before.rate;
+            speed_ok = options.signatures_only || now.rate >= before.rate - allowed;
+        }
+        failed |= !signature_ok || !speed_ok;
+        char line[512];
+        if (options.json) {
+            std::snprintf(line, sizeof(line), "%s\"%s\": {\"signature\": %llu, \"signature_ok\": %s, \"rate\": %.1f, "
+                          "\"stddev\": %.1f, \"change\": %.4f, \"speed_ok\": %s}",
+                          report.empty() ? "{" : ", ", workload.name, static_cast<unsigned long long>(now.signature),
+                          signature_ok ? "true" : "false", now.rate, now.stddev, change, speed_ok ? "true" : "false");
+        } else if (baseline.empty()) {
+            std::snprintf(line, sizeof(line), "%-7s signature %-16llu %14.0f %s (sd %.0f)\n", workload.name,
+                          static_cast<unsigned long long>(now.signature), now.rate, workload.unit, now.stddev);
+        } else {
+            const Measurement& before = baseline[workload.name];
+            std::string signature_text = signature_ok ? "signature ok" : "SIGNATURE " + std::to_string(now.signature) +
+                                                                         " != " + std::to_string(before.signature);
+            std::string speed_text;
+            if (!options.signatures_only) {
+                char speed[160];
+                std::snprintf(speed, sizeof(speed), "%.0f %s vs %.0f (%+.1f%%)%s", now.rate, workload.unit, before.rate,
+                              change * 100.0, speed_ok ? "" : " REGRESSION");
+                speed_text = speed;
+            }
+            std::snprintf(line, sizeof(line), "%-7s %-40s %s\n", workload.name, signature_text.c_str(), speed_text.c_str());
+        }
+        report += line;
+    }
+    if (options.json) report += std::string(", \"passed\": ") + (failed ? "false" : "true") + "}\n";
+    std::fputs(report.c_str(), stdout);
+    if (!options.json && !baseline.empty()) std::puts(failed ? "FAILED" : "passed");
+    return failed ? 1 : 0;
+}
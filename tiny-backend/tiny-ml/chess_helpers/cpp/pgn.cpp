@@ -0,0 +1,487 @@
+// pgn.cpp
+#include "pgn.h"
+#include "bitmasks.h"
+#include "chessnet.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+inline bool isFile(char c) { return c >= 'a' && c <= 'h'; }
+inline bool isRank(char c) { return c >= '1' && c <= '8'; }
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+inline bool isSpace(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+Piece::Type pieceFromLetter(char c) {
+    switch (c) {
+        case 'N': return Piece::Type::KNIGHT;
+        case 'B': return Piece::Type::BISHOP;
+        case 'R': return Piece::Type::ROOK;
+        case 'Q': return Piece::Type::QUEEN;
+        case 'K': return Piece::Type::KING;
+        default:  return Piece::Type::NONE;
+    }
+}
+
+uint8_t promotionFlag(Piece::Type type) {
+    switch (type) {
+        case Piece::Type::KNIGHT: return Move::PROMOTION_KNIGHT_FLAG;
+        case Piece::Type::BISHOP: return Move::PROMOTION_BISHOP_FLAG;
+        case Piece::Type::ROOK:   return Move::PROMOTION_ROOK_FLAG;
+        default:                  return Move::PROMOTION_QUEEN_FLAG;
+    }
+}
+
+std::string squareName(Square square) {
+    return {static_cast<char>('a' + square % 8), static_cast<char>('1' + square / 8)};
+}
+
+int resultFromText(std::string_view text) {
+    if (text == "1-0") return 1;
+    if (text == "0-1") return -1;
+    if (text == "1/2-1/2") return 0;
+    return Pgn::NO_RESULT;
+}
+
+// Index just past the end of the line holding `pos`
+size_t lineEnd(std::string_view text, size_t pos) {
+    size_t end = text.find('\n', pos);
+    return end == std::string_view::npos ? text.size() : end + 1;
+}
+
+// Reads one game's text into `game`, starting from `initial` unless it has a FEN tag.
+// With `rows`, every mainline position is also added there (and taken out again if the
+// game has no result and unfinished games are not wanted).
+void parseGame(std::string_view text, const ChessBitboard& initial, PgnGame& game,
+               PositionBatch* rows, uint64_t index, bool include_unfinished) {
+    game.tags.clear();
+    game.moves.clear();
+    game.error.clear();
+    game.result = Pgn::NO_RESULT;
+    game.start = initial;
+    size_t pos = 0, n = text.size();
+
+    // Tag pairs: [Name "Value"], one per line
+    for (;;) {
+        while (pos < n && isSpace(text[pos])) pos++;
+        if (pos < n && text[pos] == '%') {  // escape line
+            pos = lineEnd(text, pos);
+            continue;
+        }
+        if (pos >= n || text[pos] != '[') break;
+        size_t end = lineEnd(text, pos);
+        std::string_view line = text.substr(pos + 1, end - pos - 1);
+        pos = end;
+        size_t open = line.find('"');
+        if (open == std::string_view::npos) continue;
+        size_t name_end = std::min(line.find_first_of(" \t"), open);
+        std::string value;
+        for (size_t i = open + 1; i < line.size() && line[i] != '"'; i++) {
+            if (line[i] == '\\' && i + 1 < line.size()) i++;
+            value += line[i];
+        }
+        game.tags.emplace_back(std::string(line.substr(0, name_end)), std::move(value));
+    }
+    for (const auto& [name, value] : game.tags) {
+        if (name == "Result") game.result = resultFromText(value);
+        if (name != "FEN") continue;
+        if (!game.start.tryLoadFen(value)) {
+            game.error = "bad FEN tag: " + value;
+            return;
+        }
+    }
+
+    ChessBitboard board = game.start;
+    size_t first_row = rows ? rows->size() : 0;
+    while (pos < n) {
+        char c = text[pos];
+        if (isSpace(c)) {
+            pos++;
+        } else if (c == '{') {
+            size_t close = text.find('}', pos);
+            pos = close == std::string_view::npos ? n : close + 1;
+        } else if (c == ';' || (c == '%' && (pos == 0 || text[pos - 1] == '\n'))) {
+            pos = lineEnd(text, pos);
+        } else if (c == '(') {
+            // Variations, possibly nested, with comments of their own
+            int depth = 0;
+            while (pos < n) {
+                char v = text[pos];
+                if (v == '{') {
+                    size_t close = text.find('}', pos);
+                    pos = close == std::string_view::npos ? n : close + 1;
+                    continue;
+                }
+                if (v == ';') {
+                    pos = lineEnd(text, pos);
+                    continue;
+                }
+                pos++;
+                if (v == '(') depth++;
+                if (v == ')' && --depth == 0) break;
+            }
+        } else if (c == '$') {  // numeric annotation glyph
+            pos++;
+            while (pos < n && isDigit(text[pos])) pos++;
+        } else if (c == ')' || c == '}') {  // unbalanced
+            pos++;
+        } else {
+            size_t end = pos;
+            while (end < n && !isSpace(text[end]) && !std::strchr("{}();$", text[end])) end++;
+            std::string_view token = text.substr(pos, end - pos);
+            pos = end;
+            if (token == "*") break;
+            int token_result = resultFromText(token);
+            if (token_result != Pgn::NO_RESULT) {
+                game.result = token_result;
+                break;
+            }
+            // Move numbers, alone ("12." "12...") or run into the move ("12.e4")
+            size_t digits = 0;
+            while (digits < token.size() && isDigit(token[digits])) digits++;
+            if (digits == token.size() || token[digits] == '.') {
+                while (digits < token.size() && token[digits] == '.') digits++;
+                token.remove_prefix(digits);
+                if (token.empty()) continue;
+            }
+            // Past a bad move only the result is still of interest
+            if (!game.error.empty()) continue;
+            Move move = Pgn::parseSan(board, token);
+            if (move.isNone()) {
+                game.error = "illegal or unreadable move " + std::string(token) + " at ply " +
+                             std::to_string(game.moves.size() + 1);
+                continue;
+            }
+            if (rows) rows->add(board, move, 0, index);
+            game.moves.push_back(move);
+            board.makeMove(move);
+        }
+    }
+
+    if (!rows) return;
+    if (game.result == Pgn::NO_RESULT && !include_unfinished) {
+        rows->truncate(first_row);
+        return;
+    }
+    int white_result = game.result == Pgn::NO_RESULT ? 0 : game.result;
+    for (size_t row = first_row; row < rows->size(); row++) {
+        rows->result[row] = static_cast<int8_t>(rows->white_to_move[row] ? white_result : -white_result);
+    }
+}
+
+// Runs work(begin, end, worker) over [0, count) split into contiguous ranges
+template <typename Work>
+void parallelRanges(size_t count, int threads, Work work) {
+    size_t workers = std::max<size_t>(1, std::min<size_t>(threads, count));
+    std::vector<std::thread> pool;
+    for (size_t w = 1; w < workers; w++) {
+        pool.emplace_back(work, count * w / workers, count * (w + 1) / workers, w);
+    }
+    work(0, count / workers, 0);
+    for (std::thread& thread : pool) thread.join();
+}
+
+} // namespace
+
+Move Pgn::parseSan(const ChessBitboard& board, std::string_view san) {
+    while (!san.empty() && std::strchr("+#!?", san.back())) san.remove_suffix(1);
+    if (san.empty()) return Move();
+    Piece::Color us = board.white_to_move ? Piece::Color::WHITE : Piece::Color::BLACK;
+
+    if (san[0] == 'O' || san[0] == '0') {
+        bool queenside = san == "O-O-O" || san == "0-0-0";
+        if (!queenside && san != "O-O" && san != "0-0") return Move();
+        Square from = board.white_to_move ? 4 : 60;
+        Move move(from, queenside ? from - 2 : from + 2, Piece::Type::KING, Move::CASTLE_FLAG);
+        return board.isPseudoLegal(move) && board.isLegal(move) ? move : Move();
+    }
+
+    Piece::Type type = pieceFromLetter(san[0]);
+    if (type != Piece::Type::NONE || san[0] == 'P') san.remove_prefix(1);
+    if (type == Piece::Type::NONE) type = Piece::Type::PAWN;
+
+    // A trailing letter can only be a promotion piece ("e8=Q", "e8Q", or e7e8q as in UCI)
+    Piece::Type promotion = Piece::Type::NONE;
+    if (!san.empty() && !isDigit(san.back())) {
+        promotion = pieceFromLetter(static_cast<char>(std::toupper(static_cast<unsigned char>(san.back()))));
+        if (type != Piece::Type::PAWN || promotion == Piece::Type::NONE || promotion == Piece::Type::KING) return Move();
+        san.remove_suffix(1);
+        if (!san.empty() && san.back() == '=') san.remove_suffix(1);
+    }
+    if (san.size() < 2 || !isFile(san[san.size() - 2]) || !isRank(san.back())) return Move();
+    Square to = static_cast<Square>((san.back() - '1') * 8 + (san[san.size() - 2] - 'a'));
+    san.remove_suffix(2);
+    int from_file = -1, from_rank = -1;
+    for (char c : san) {
+        if (isFile(c)) {
+            from_file = c - 'a';
+        } else if (isRank(c)) {
+            from_rank = c - '1';
+        } else if (c != 'x' && c != ':' && c != '-') {
+            return Move();
+        }
+    }
+
+    Bitboard occupancy = board.getAllPieces();
+    Bitboard own = board.white_to_move ? board.getWhitePieces() : board.getBlackPieces();
+    if (own & (1ULL << to)) return Move();
+    Bitboard candidates = 0;
+    if (type == Piece::Type::PAWN) {
+        int forward = board.white_to_move ? 8 : -8;
+        Bitboard pawns = board.getPieces(us, Piece::Type::PAWN);
+        int behind = to - forward;
+        if (behind < 0 || behind > 63) return Move();
+        if (from_file >= 0 && from_file != to % 8) {
+            if (std::abs(from_file - to % 8) != 1) return Move();
+            candidates = pawns & (1ULL << (behind + from_file - to % 8));
+        } else if (pawns & (1ULL << behind)) {
+            candidates = 1ULL << behind;
+        } else if (!(occupancy & (1ULL << behind)) && behind - forward >= 0 && behind - forward < 64) {
+            candidates = pawns & (1ULL << (behind - forward));
+        }
+    } else {
+        Bitboard reach = type == Piece::Type::KNIGHT ? board.knight_attacks[to]
+                       : type == Piece::Type::KING   ? board.king_attacks[to]
+                       : board.getAttacks(to, type, occupancy);
+        candidates = reach & board.getPieces(us, type);
+        if (from_file >= 0) candidates &= Bitmasks::FILE_A << from_file;
+    }
+    if (from_rank >= 0) candidates &= Bitmasks::RANK_1 << (8 * from_rank);
+
+    Move found;
+    for (; candidates; candidates &= candidates - 1) {
+        Square from = static_cast<Square>(__builtin_ctzll(candidates));
+        uint8_t flags = Move::NO_FLAG;
+        if (type == Piece::Type::PAWN) {
+            if (to == board.en_passant_square && from % 8 != to % 8) flags = Move::EN_PASSANT_FLAG;
+            if (to / 8 == 0 || to / 8 == 7) {
+                flags = promotionFlag(promotion);  // a missing piece means a queen
+            } else if (promotion != Piece::Type::NONE) {
+                return Move();
+            }
+        }
+        Move move(from, to, type, flags);
+        if (!board.isPseudoLegal(move) || !board.isLegal(move)) continue;
+        if (!found.isNone()) return Move();  // ambiguous
+        found = move;
+    }
+    return found;
+}
+
+std::string Pgn::toSan(const ChessBitboard& board, const Move& move) {
+    std::string san;
+    Square from = move.getFrom(), to = move.getTo();
+    if (move.getFlags() == Move::CASTLE_FLAG) {
+        san = to > from ? "O-O" : "O-O-O";
+    } else {
+        Piece::Type type = move.getPieceType();
+        bool capture = board.isCapture(move);
+        if (type == Piece::Type::PAWN) {
+            if (capture) san += static_cast<char>('a' + from % 8);
+        } else {
+            san += "?PNBRQK"[type];
+            // Name the file, else the rank, else both, when another piece of the type can go there
+            bool clash = false, same_file = false, same_rank = false;
+            for (const Move& other : board.generateLegalMoves()) {
+                if (other.getPieceType() != type || other.getTo() != to || other.getFrom() == from) continue;
+                clash = true;
+                same_file |= other.getFrom() % 8 == from % 8;
+                same_rank |= other.getFrom() / 8 == from / 8;
+            }
+            if (clash && (!same_file || same_rank)) san += static_cast<char>('a' + from % 8);
+            if (clash && same_file) san += static_cast<char>('1' + from / 8);
+        }
+        if (capture) san += 'x';
+        san += squareName(to);
+        if (move.isPromotion()) {
+            san += '=';
+            san += "?PNBRQK"[move.getPromotionType()];
+        }
+    }
+    ChessBitboard after = board;
+    after.makeMove(move);
+    if (after.isInCheck(after.white_to_move ? Piece::Color::WHITE : Piece::Color::BLACK)) {
+        san += after.generateLegalMoves().empty() ? '#' : '+';
+    }
+    return san;
+}
+
+std::string PgnGame::tag(const std::string& name) const {
+    for (const auto& [key, value] : tags) {
+        if (key == name) return value;
+    }
+    return "";
+}
+
+void PositionBatch::clear() {
+    bitboards.clear();
+    white_to_move.clear();
+    castling_rights.clear();
+    en_passant.clear();
+    halfmove_clock.clear();
+    moves.clear();
+    policy.clear();
+    result.clear();
+    game.clear();
+}
+
+void PositionBatch::truncate(size_t rows) {
+    bitboards.resize(std::min(bitboards.size(), rows * 12));
+    white_to_move.resize(std::min(white_to_move.size(), rows));
+    castling_rights.resize(std::min(castling_rights.size(), rows));
+    en_passant.resize(std::min(en_passant.size(), rows));
+    halfmove_clock.resize(std::min(halfmove_clock.size(), rows));
+    moves.resize(std::min(moves.size(), rows));
+    policy.resize(std::min(policy.size(), rows));
+    result.resize(std::min(result.size(), rows));
+    game.resize(std::min(game.size(), rows));
+}
+
+void PositionBatch::add(const ChessBitboard& board, const Move& move, int white_result, uint64_t game_index) {
+    bitboards.insert(bitboards.end(), {board.white_pawns, board.white_knights, board.white_bishops,
+                                       board.white_rooks, board.white_queens, board.white_king,
+                                       board.black_pawns, board.black_knights, board.black_bishops,
+                                       board.black_rooks, board.black_queens, board.black_king});
+    white_to_move.push_back(board.white_to_move);
+    castling_rights.push_back(static_cast<uint8_t>(board.castling_rights));
+    en_passant.push_back(static_cast<int8_t>(board.en_passant_square));
+    halfmove_clock.push_back(static_cast<uint16_t>(std::min(board.halfmove_clock, 0xFFFF)));
+    moves.push_back(static_cast<uint16_t>(move.getFrom() | move.getTo() << 6 | move.getFlags() << 12));
+    policy.push_back(policyIndex(move));
+    result.push_back(static_cast<int8_t>(board.white_to_move ? white_result : -white_result));
+    game.push_back(game_index);
+}
+
+void PositionBatch::append(const PositionBatch& other) {
+    bitboards.insert(bitboards.end(), other.bitboards.begin(), other.bitboards.end());
+    white_to_move.insert(white_to_move.end(), other.white_to_move.begin(), other.white_to_move.end());
+    castling_rights.insert(castling_rights.end(), other.castling_rights.begin(), other.castling_rights.end());
+    en_passant.insert(en_passant.end(), other.en_passant.begin(), other.en_passant.end());
+    halfmove_clock.insert(halfmove_clock.end(), other.halfmove_clock.begin(), other.halfmove_clock.end());
+    moves.insert(moves.end(), other.moves.begin(), other.moves.end());
+    policy.insert(policy.end(), other.policy.begin(), other.policy.end());
+    result.insert(result.end(), other.result.begin(), other.result.end());
+    game.insert(game.end(), other.game.begin(), other.game.end());
+}
+
+PgnReader::PgnReader(const std::string& path, int threads) : PgnReader(threads) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open PGN file: " + path);
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot read PGN file: " + path);
+    }
+    length = info.st_size;
+    if (length) {
+        void* base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (base == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Cannot map PGN file: " + path);
+        }
+        madvise(base, length, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(base);
+        mapped = true;
+    }
+    close(fd);
+    rewind();
+}
+
+PgnReader::PgnReader(int threads)
+    : threads(threads > 0 ? threads : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()))) {
+    prototype.setStartingPosition();
+}
+
+std::unique_ptr<PgnReader> PgnReader::fromText(std::string text, int threads) {
+    std::unique_ptr<PgnReader> reader(new PgnReader(threads));
+    reader->owned = std::move(text);
+    reader->data = reader->owned.data();
+    reader->length = reader->owned.size();
+    reader->rewind();
+    return reader;
+}
+
+PgnReader::~PgnReader() {
+    if (mapped) munmap(const_cast<char*>(data), length);
+}
+
+void PgnReader::rewind() {
+    cursor = length >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0 ? 3 : 0;  // UTF-8 byte order mark
+    games_read = 0;
+    error_count = 0;
+}
+
+std::vector<std::string_view> PgnReader::split(size_t max_games) {
+    std::vector<std::string_view> games;
+    while (games.size() < max_games && cursor < length) {
+        // A game runs until a tag line that follows its movetext
+        size_t start = cursor, pos = cursor;
+        bool movetext = false;
+        while (pos < length) {
+            const char* newline = static_cast<const char*>(std::memchr(data + pos, '\n', length - pos));
+            size_t end = newline ? newline - data + 1 : length;
+            size_t first = pos;
+            while (first < end && (data[first] == ' ' || data[first] == '\t' || data[first] == '\r')) first++;
+            if (first < end && data[first] == '[') {
+                if (movetext) break;
+            } else if (first < end && data[first] != '\n' && data[first] != '%') {
+                movetext = true;
+            }
+            pos = end;
+        }
+        cursor = pos;
+        std::string_view text(data + start, pos - start);
+        bool blank = std::all_of(text.begin(), text.end(), isSpace);
+        if (!blank) games.push_back(text);
+    }
+    return games;
+}
+
+bool PgnReader::nextGames(std::vector<PgnGame>& games, size_t max_games) {
+    std::vector<std::string_view> texts = split(max_games);
+    PgnGame blank;
+    blank.start = prototype;
+    games.assign(texts.size(), blank);
+    parallelRanges(texts.size(), threads, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; i++) parseGame(texts[i], prototype, games[i], nullptr, 0, false);
+    });
+    for (const PgnGame& game : games) error_count += !game.error.empty();
+    games_read += games.size();
+    return !games.empty();
+}
+
+bool PgnReader::nextPositions(PositionBatch& batch, size_t max_games, bool include_unfinished) {
+    batch.clear();
+    std::vector<std::string_view> texts = split(max_games);
+    size_t workers = std::max<size_t>(1, std::min<size_t>(threads, texts.size()));
+    std::vector<PositionBatch> parts(workers);
+    std::vector<uint64_t> errors(workers, 0);
+    uint64_t first_index = games_read;
+    parallelRanges(texts.size(), threads, [&](size_t begin, size_t end, size_t worker) {
+        PgnGame game;
+        game.start = prototype;
+        PositionBatch& rows = parts[worker];
+        for (size_t i = begin; i < end; i++) {
+            parseGame(texts[i], prototype, game, &rows, first_index + i, include_unfinished);
+            errors[worker] += !game.error.empty();
+        }
+    });
+    for (size_t w = 0; w < workers; w++) {
+        if (w == 0) {
+            batch = std::move(parts[0]);
+        } else {
+            batch.append(parts[w]);
+        }
+        error_count += errors[w];
+    }
+    games_read += texts.size();
+    return !texts.empty();
+}
@@ -0,0 +1,101 @@
+// pgn.h
+#pragma once
+#include "bitboard.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Reading games in PGN: tag pairs, movetext in SAN (comments, variations, NAGs and
+// move numbers skipped) and the game result.
+namespace Pgn {
+
+// PgnGame::result when neither the Result tag nor the movetext settles it ("*")
+constexpr int NO_RESULT = 2;
+
+// The legal move `san` names in this position, Move() if it names none or is ambiguous.
+// Accepts check/annotation suffixes (+ # ! ?), 0-0 castling, promotions with or without
+// '=' and fully qualified moves such as Ng1f3 or e2e4.
+Move parseSan(const ChessBitboard& board, std::string_view san);
+// Standard algebraic notation of a legal move, with + or # when it gives check or mate
+std::string toSan(const ChessBitboard& board, const Move& move);
+
+} // namespace Pgn
+
+struct PgnGame {
+    std::vector<std::pair<std::string, std::string>> tags;
+    ChessBitboard start;      // FEN tag position, or the standard start
+    std::vector<Move> moves;  // mainline, up to the first move that failed to resolve
+    int result = Pgn::NO_RESULT;  // white's point of view: 1, 0, -1, or NO_RESULT
+    std::string error;        // why the movetext stopped early; empty if it was all read
+
+    // Value of a tag, empty if the game does not have it
+    std::string tag(const std::string& name) const;
+};
+
+// Positions of parsed games as flat columns, one row per mainline move: the position
+// before the move, the move and how the game ended for the side to move
+struct PositionBatch {
+    std::vector<uint64_t> bitboards;     // 12 per row: white pawns ... king, then black
+    std::vector<uint8_t> white_to_move;
+    std::vector<uint8_t> castling_rights;
+    std::vector<int8_t> en_passant;      // square, -1 if none
+    std::vector<uint16_t> halfmove_clock;
+    std::vector<uint16_t> moves;         // from | to << 6 | flags << 12
+    std::vector<int32_t> policy;         // policyIndex of the move
+    std::vector<int8_t> result;          // 1 win, 0 draw, -1 loss for the side to move
+    std::vector<uint64_t> game;          // index of the game in the file
+
+    size_t size() const { return white_to_move.size(); }
+    void clear();
+    // Keeps the first `rows` rows
+    void truncate(size_t rows);
+    void add(const ChessBitboard& board, const Move& move, int white_result, uint64_t game_index);
+    void append(const PositionBatch& other);
+};
+
+// Streams games out of a PGN file that stays memory-mapped, so multi-gigabyte dumps are
+// read straight from the page cache. Each call takes the next games in file order, splits
+// them at their tag sections and parses them on `threads` workers.
+class PgnReader {
+public:
+    // threads = 0 uses every core. Throws std::runtime_error if the file cannot be mapped.
+    explicit PgnReader(const std::string& path, int threads = 0);
+    // Reads PGN held in memory instead of a file
+    static std::unique_ptr<PgnReader> fromText(std::string text, int threads = 0);
+    ~PgnReader();
+    PgnReader(const PgnReader&) = delete;
+    PgnReader& operator=(const PgnReader&) = delete;
+
+    size_t bytes() const { return length; }
+    size_t offset() const { return cursor; }
+    bool done() const { return cursor >= length; }
+    uint64_t gamesRead() const { return games_read; }
+    // Games whose movetext stopped at an unreadable or illegal move
+    uint64_t errors() const { return error_count; }
+    void rewind();
+
+    // Up to max_games further games; false (and `games` empty) at the end of the file
+    bool nextGames(std::vector<PgnGame>& games, size_t max_games);
+    // Positions of up to max_games further games. Games without a result are skipped
+    // unless include_unfinished, in which case their rows count as draws.
+    bool nextPositions(PositionBatch& batch, size_t max_games, bool include_unfinished = false);
+
+private:
+    explicit PgnReader(int threads);
+
+    std::string owned;  // fromText
+    const char* data = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    size_t cursor = 0;
+    int threads;
+    uint64_t games_read = 0;
+    uint64_t error_count = 0;
+    ChessBitboard prototype;  // copied instead of constructing boards (which rebuilds tables)
+
+    // Text of up to max_games games from the cursor on, advancing it past them
+    std::vector<std::string_view> split(size_t max_games);
+};
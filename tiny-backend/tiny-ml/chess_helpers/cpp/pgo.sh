@@ -0,0 +1,12 @@
+#!/bin/bash
+# Profile-guided build of the Python extension: build instrumented variants, run the
+# bench workload through every variant this CPU can execute (pgo_train.py), then rebuild
+# with the recorded profiles. Variants the CPU cannot run (v4 without AVX-512) are still
+# rebuilt, just without a profile. Honours CHESS_VARIANTS like setup.py.
+set -e
+cd "$(dirname "$0")"
+rm -rf pgo-data
+rm -f chess_engine.*.so  # a stale single-module build would shadow the chess_engine.py loader
+CHESS_PGO=generate python3 setup.py build_ext --inplace --force
+python3 pgo_train.py
+CHESS_PGO=use python3 setup.py build_ext --inplace --force
@@ -0,0 +1,66 @@
+"""PGO training run for pgo.sh: the bench workload of chess_engine_perf_gate (perft,
+fixed-depth search, MCTS) driven through the Python module, once per built variant this
+CPU can execute. Each run happens in its own process with CHESS_ENGINE_VARIANT set, so
+every variant writes its own profile."""
+import glob
+import os
+import subprocess
+import sys
+
+PERFT_SUITE = [
+    ("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 4),
+    ("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 3),
+    ("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 4),
+    ("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 3),
+    ("rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 3),
+]
+
+BENCH_POSITIONS = [
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r1bqkbnr/pppp1ppp/2n5/1B2p3/4P3/5N2/PPPP1PPP/RNBQK2R b KQkq - 3 3",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+]
+
+
+def train():
+    import chess_engine
+
+    board = chess_engine.ChessBitboard()
+    for fen, depth in PERFT_SUITE:
+        board.load_fen(fen)
+        board.perft(depth)
+    for fen in BENCH_POSITIONS:
+        board.load_fen(fen)
+        chess_engine.Search().run(board, 6)
+        # Self-play shaped MCTS: one and two threads, with and without graph search
+        for threads, transpositions in ((1, False), (2, True)):
+            config = chess_engine.MCTSConfig()
+            config.num_simulations = 2000
+            config.threads = threads
+            config.transpositions = transpositions
+            mcts = chess_engine.MCTS(chess_engine.HandcraftedEvaluator(), config)
+            result = mcts.search(board)
+            if not result.best_move.is_none():
+                mcts.advance(result.best_move)
+    print(f"trained {chess_engine.variant}")
+
+
+def main():
+    if len(sys.argv) > 1 and sys.argv[1] == "--run":
+        train()
+        return
+    here = os.path.dirname(os.path.abspath(__file__))
+    built = {os.path.basename(path).split(".")[0][len("_chess_engine_"):] for path in glob.glob(os.path.join(here, "_chess_engine_*.so"))}
+    for variant in sorted(built):
+        env = dict(os.environ, CHESS_ENGINE_VARIANT=variant)
+        status = subprocess.run([sys.executable, os.path.abspath(__file__), "--run"], cwd=here, env=env)
+        if status.returncode != 0:
+            # Usually a variant this CPU cannot run; it is rebuilt without a profile
+            print(f"no profile for {variant}")
+
+
+if __name__ == "__main__":
+    main()
@@ -2,11 +2,100 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <pybind11/operators.h>
+#include <pybind11/numpy.h>
 #include "bitboard.h"
+#include "movepicker.h"
+#include "search.h"
+#include "nnue.h"
+#include "chessnet.h"
+#include "chessnet_int8.h"
+#include "mcts.h"
+#include "tablebase.h"
+#include "book.h"
+#include "pgn.h"
+#include "shards.h"
+#include "replay.h"
+#include "instrument.h"
 
 namespace py = pybind11;
 
-PYBIND11_MODULE(chess_engine, m) {
+// setup.py builds one module per CPU variant (_chess_engine_v3, ...) and chess_engine.py
+// loads the right one
+#ifndef CHESS_ENGINE_MODULE
+#define CHESS_ENGINE_MODULE chess_engine
+#endif
+
+using PlaneBatch = py::array_t<float, py::array::c_style | py::array::forcecast>;
+
+// Number of positions in a [batch, 25, 8, 8] (or [batch, 1600]) plane array
+static int checkPlaneBatch(const PlaneBatch& planes) {
+    if (planes.ndim() == 0 || planes.size() == 0 || planes.size() != planes.shape(0) * ChessNet::INPUT_PLANES * 64) {
+        throw std::invalid_argument("expected planes shaped [batch, 25, 8, 8]");
+    }
+    return static_cast<int>(planes.shape(0));
+}
+
+template <typename Forward>
+static py::tuple forwardBatch(const PlaneBatch& planes, Forward forward) {
+    int batch = checkPlaneBatch(planes);
+    py::array_t<float> logits({batch, ChessNet::POLICY_SIZE});
+    py::array_t<float> values(batch);
+    float* logits_data = logits.mutable_data();
+    float* values_data = values.mutable_data();
+    {
+        py::gil_scoped_release release;
+        forward(planes.data(), batch, logits_data, values_data);
+    }
+    return py::make_tuple(logits, values);
+}
+
+// Hands a vector's buffer to numpy without copying; the array owns it from then on
+template <typename T>
+static py::array_t<T> toArray(std::vector<T>&& values, std::vector<py::ssize_t> shape) {
+    auto* owner = new std::vector<T>(std::move(values));
+    py::capsule free_owner(owner, [](void* pointer) { delete static_cast<std::vector<T>*>(pointer); });
+    return py::array_t<T>(shape, owner->data(), free_owner);
+}
+
+static py::dict positionArrays(PositionBatch&& batch) {
+    py::ssize_t rows = static_cast<py::ssize_t>(batch.size());
+    py::dict arrays;
+    arrays["bitboards"] = toArray(std::move(batch.bitboards), {rows, 12});
+    arrays["white_to_move"] = toArray(std::move(batch.white_to_move), {rows});
+    arrays["castling_rights"] = toArray(std::move(batch.castling_rights), {rows});
+    arrays["en_passant"] = toArray(std::move(batch.en_passant), {rows});
+    arrays["halfmove_clock"] = toArray(std::move(batch.halfmove_clock), {rows});
+    arrays["moves"] = toArray(std::move(batch.moves), {rows});
+    arrays["policy"] = toArray(std::move(batch.policy), {rows});
+    arrays["result"] = toArray(std::move(batch.result), {rows});
+    arrays["game"] = toArray(std::move(batch.game), {rows});
+    return arrays;
+}
+
+// add_game of ShardWriter and ReplayBuffer: policies as a [moves, 4672] array or None
+template <typename Target>
+static void addGameSamples(Target& target, const ChessBitboard& start, const std::vector<Move>& moves, int result,
+                           py::object policies) {
+    if (policies.is_none()) {
+        target.addGame(start, moves, result);
+        return;
+    }
+    auto dense = policies.cast<py::array_t<float, py::array::c_style | py::array::forcecast>>();
+    if (static_cast<size_t>(dense.size()) != moves.size() * ChessNet::POLICY_SIZE) {
+        throw std::invalid_argument("expected policies shaped [moves, 4672]");
+    }
+    py::gil_scoped_release release;
+    target.addGame(start, moves, result, dense.data());
+}
+
+// `for batch in reader.batches(n)`: position arrays of the next n games until the file ends
+struct PgnBatches {
+    PgnReader* reader;
+    size_t games;
+    bool include_unfinished;
+};
+
+PYBIND11_MODULE(CHESS_ENGINE_MODULE, m) {
     m.doc() = "Fast chess engine with magic bitboards";
 
     py::enum_<Piece::Type>(m, "PieceType")
@@ -38,13 +127,21 @@ PYBIND11_MODULE(chess_engine, m) {
         .def("get_from", &Move::getFrom)
         .def("get_to", &Move::getTo)
         .def("get_piece_type", &Move::getPieceType)
-        .def("get_flags", &Move::getFlags);
+        .def("get_flags", &Move::getFlags)
+        .def("is_none", &Move::isNone)
+        .def(py::self == py::self);
     
     // Auto-convert camelCase to snake_case
     py::class_<ChessBitboard>(m, "ChessBitboard", py::dynamic_attr())
         .def(py::init<>())
         .def("set_starting_position", &ChessBitboard::setStartingPosition)
         .def("load_fen", &ChessBitboard::loadFen, "Load a position from a FEN string")
+        .def("try_load_fen", &ChessBitboard::tryLoadFen, py::arg("fen"),
+             "Load a FEN only if it is well formed; returns False and leaves the board unchanged otherwise")
+        .def("to_fen", &ChessBitboard::toFen)
+        .def("flip_vertical", &ChessBitboard::flipVertical, "Turn the board round: ranks reversed, colours exchanged")
+        .def("mirror_horizontal", &ChessBitboard::mirrorHorizontal,
+             "Reverse the files; False (and no change) while castling rights remain")
         .def("get_piece_at", &ChessBitboard::getPieceAt)
         .def("generate_legal_moves", &ChessBitboard::generateLegalMoves)
         .def("make_move", &ChessBitboard::makeMove)
@@ -57,8 +154,12 @@ PYBIND11_MODULE(chess_engine, m) {
         .def("perft", &ChessBitboard::perft)
         .def("perft_divide", &ChessBitboard::perft_divide)
         .def("has_insufficient_material", &ChessBitboard::hasInsufficientMaterial)
+        .def("see", &ChessBitboard::see, "Static exchange evaluation of a move, in centipawns")
+        .def("see_ge", &ChessBitboard::seeGE, py::arg("move"), py::arg("threshold") = 0)
+        .def("evaluate", &ChessBitboard::evaluate, "Hand-crafted evaluation in centipawns for the side to move")
         .def_readonly("halfmove_clock", &ChessBitboard::halfmove_clock) 
-        .def_readwrite("white_to_move", &ChessBitboard::white_to_move)
+        .def_property("white_to_move", [](const ChessBitboard& b) { return b.white_to_move; },
+                      [](ChessBitboard& b, bool white) { b.white_to_move = white; b.hash = b.computeHash(); })
         .def_readwrite("fullmove_number", &ChessBitboard::fullmove_number)
         .def_readonly("en_passant_square", &ChessBitboard::en_passant_square)
         .def_readonly("white_pawns", &ChessBitboard::white_pawns)
@@ -73,9 +174,20 @@ PYBIND11_MODULE(chess_engine, m) {
         .def_readonly("black_rooks", &ChessBitboard::black_rooks)
         .def_readonly("black_queens", &ChessBitboard::black_queens)
         .def_readonly("black_king", &ChessBitboard::black_king)
+        .def_readonly("hash", &ChessBitboard::hash, "Zobrist hash of the position")
+        .def("same_position", &ChessBitboard::samePosition, py::arg("other"))
         .def("is_game_over", &ChessBitboard::isGameOver)
         .def("get_result", &ChessBitboard::getResult)
         .def("update_mailbox", &ChessBitboard::updateMailbox)
+        .def("is_legal", &ChessBitboard::isLegal)
+        .def("is_pseudo_legal", &ChessBitboard::isPseudoLegal)
+        .def("is_capture", &ChessBitboard::isCapture)
+        .def("gives_check", &ChessBitboard::givesCheck)
+        .def("generate_pseudo_legal_moves", &ChessBitboard::generatePseudoLegalMoves)
+        .def("generate_captures", [](const ChessBitboard& b) { std::vector<Move> moves; b.generateCaptures(moves); return moves; })
+        .def("generate_quiets", [](const ChessBitboard& b) { std::vector<Move> moves; b.generateQuiets(moves); return moves; })
+        .def("generate_evasions", [](const ChessBitboard& b) { std::vector<Move> moves; b.generateEvasions(moves); return moves; })
+        .def("generate_quiet_checks", [](const ChessBitboard& b) { std::vector<Move> moves; b.generateQuietChecks(moves); return moves; })
         .def(py::pickle(
             [](const ChessBitboard &b) { // __getstate__ method
                 // This function returns a tuple containing all the necessary state
@@ -113,4 +225,507 @@ PYBIND11_MODULE(chess_engine, m) {
                 return b;
             }
         ));
-}
\ No newline at end of file
+
+    // Yields pseudo-legal moves in search order; holds a reference to the board
+    py::class_<MovePicker>(m, "MovePicker")
+        .def(py::init<const ChessBitboard&, const Move&>(), py::arg("board"), py::arg("tt_move") = Move(),
+             py::keep_alive<1, 2>())
+        .def("next_move", &MovePicker::nextMove)
+        .def("__iter__", [](MovePicker& picker) -> MovePicker& { return picker; }, py::return_value_policy::reference_internal)
+        .def("__next__", [](MovePicker& picker) {
+            Move move = picker.nextMove();
+            if (move.isNone()) throw py::stop_iteration();
+            return move;
+        });
+
+    py::class_<SearchResult>(m, "SearchResult")
+        .def_readonly("best_move", &SearchResult::best_move)
+        .def_readonly("score", &SearchResult::score)
+        .def_readonly("depth", &SearchResult::depth)
+        .def_readonly("nodes", &SearchResult::nodes)
+        .def_readonly("tb_hits", &SearchResult::tb_hits)
+        .def_readonly("time_ms", &SearchResult::time_ms)
+        .def_readonly("pv", &SearchResult::pv);
+
+    // Zero fields are unlimited
+    py::class_<SearchLimits>(m, "SearchLimits")
+        .def(py::init<>())
+        .def_readwrite("movetime_ms", &SearchLimits::movetime_ms)
+        .def_readwrite("time_left_ms", &SearchLimits::time_left_ms)
+        .def_readwrite("increment_ms", &SearchLimits::increment_ms)
+        .def_readwrite("moves_to_go", &SearchLimits::moves_to_go)
+        .def_readwrite("move_overhead_ms", &SearchLimits::move_overhead_ms)
+        .def_readwrite("nodes", &SearchLimits::nodes)
+        .def("timed", &SearchLimits::timed);
+
+    // Exposed so Python searches budget their time the same way
+    py::class_<TimeManager>(m, "TimeManager")
+        .def(py::init<>())
+        .def("start", &TimeManager::start, py::arg("limits"))
+        .def("timed", &TimeManager::timed)
+        .def("elapsed_ms", &TimeManager::elapsedMs)
+        .def("optimum_ms", &TimeManager::optimumMs)
+        .def("maximum_ms", &TimeManager::maximumMs);
+
+    // HalfKP network; load() raises RuntimeError on a bad file
+    py::class_<NNUE::Network>(m, "NNUENetwork")
+        .def(py::init<>())
+        .def(py::init([](const std::string& path) {
+            auto network = std::make_unique<NNUE::Network>();
+            network->load(path);
+            return network;
+        }), py::arg("path"))
+        .def("load", &NNUE::Network::load, py::arg("path"))
+        .def("is_loaded", &NNUE::Network::isLoaded)
+        .def_property_readonly("description", &NNUE::Network::description)
+        .def("evaluate", py::overload_cast<const ChessBitboard&>(&NNUE::Network::evaluate, py::const_),
+             "NNUE evaluation in centipawns for the side to move")
+        .def("evaluate", py::overload_cast<const ChessBitboard&, const NNUE::Accumulator&>(&NNUE::Network::evaluate, py::const_),
+             py::arg("board"), py::arg("accumulator"))
+        .def("refresh", [](const NNUE::Network& network, const ChessBitboard& board) {
+            NNUE::Accumulator acc;
+            network.refresh(board, acc);
+            return acc;
+        }, py::arg("board"), "Accumulator of `board` computed from scratch")
+        .def("update", [](const NNUE::Network& network, const ChessBitboard& board, const NNUE::Accumulator& parent) {
+            if (board.dirty_count > ChessBitboard::MAX_DIRTY) throw std::invalid_argument("board was not reached by make_move");
+            NNUE::Accumulator acc;
+            network.update(board, parent, acc);
+            return acc;
+        }, py::arg("board"), py::arg("parent"), "Accumulator of `board` from its parent's and the pieces its last move changed");
+
+    py::class_<NNUE::Accumulator>(m, "NNUEAccumulator")
+        .def_property_readonly("values", [](const NNUE::Accumulator& acc) {
+            std::vector<int16_t> values(&acc.values[0][0], &acc.values[0][0] + 2 * NNUE::HALF_DIMS);
+            return toArray(std::move(values), {2, NNUE::HALF_DIMS});
+        }, "Feature transformer outputs, [white, black] perspective x 256");
+
+    // The search's per-ply accumulators. Boards are referenced, not copied: push each one
+    // after its make_move and leave it unchanged until it is popped.
+    py::class_<NNUE::AccumulatorStack>(m, "NNUEAccumulatorStack")
+        .def(py::init<>())
+        .def("reset", &NNUE::AccumulatorStack::reset, py::arg("network"), py::arg("root"),
+             py::keep_alive<1, 2>(), py::keep_alive<1, 3>())
+        .def("push", &NNUE::AccumulatorStack::push, py::arg("board"), py::keep_alive<1, 2>())
+        .def("pop", &NNUE::AccumulatorStack::pop)
+        .def("evaluate", &NNUE::AccumulatorStack::evaluate);
+
+    // Syzygy tables from ':'-separated directories, mapped on first use. Probes return None
+    // where the tables cannot answer (castling rights, too many pieces, missing files).
+    py::class_<Tablebase>(m, "Tablebase")
+        .def(py::init<const std::string&>(), py::arg("paths"))
+        .def_property_readonly("paths", &Tablebase::paths)
+        .def_property_readonly("num_tables", &Tablebase::numTables)
+        .def_property_readonly("max_pieces", &Tablebase::maxPieces)
+        .def_property("probe_limit", &Tablebase::probeLimit, &Tablebase::setProbeLimit)
+        .def("can_probe", &Tablebase::canProbe, py::arg("board"))
+        .def("probe_wdl", [](const Tablebase& tablebase, const ChessBitboard& board) -> py::object {
+            Tablebase::WDL wdl;
+            if (!tablebase.probeWdl(board, wdl)) return py::none();
+            return py::int_(static_cast<int>(wdl));
+        }, py::arg("board"), "-2 loss, -1 blessed loss, 0 draw, 1 cursed win, 2 win for the side to move")
+        .def("probe_dtz", [](const Tablebase& tablebase, const ChessBitboard& board) -> py::object {
+            int dtz;
+            if (!tablebase.probeDtz(board, dtz)) return py::none();
+            return py::int_(dtz);
+        }, py::arg("board"), "Plies to the next capture or pawn move, signed like the result")
+        .def("adjudicate", [](const Tablebase& tablebase, const ChessBitboard& board) -> py::object {
+            int result;
+            if (!tablebase.adjudicate(board, result)) return py::none();
+            return py::int_(result);
+        }, py::arg("board"), "Result like ChessBitboard.get_result once the tables settle the game");
+
+    m.def("set_adjudication_tablebase", [m](py::object tablebase) mutable {
+        ChessBitboard::setAdjudicationTablebase(tablebase.is_none() ? nullptr : tablebase.cast<const Tablebase*>());
+        // The boards keep a plain pointer; the module holds the reference
+        m.attr("_adjudication_tablebase") = tablebase;
+    }, py::arg("tablebase"), "Let is_game_over/get_result end games the tablebase settles (None to stop)");
+
+    // Polyglot-layout opening book, memory-mapped; lookups return None out of book
+    py::class_<OpeningBook>(m, "OpeningBook")
+        .def(py::init<const std::string&>(), py::arg("path"))
+        .def_property_readonly("path", &OpeningBook::path)
+        .def("__len__", &OpeningBook::size)
+        .def("probe", [](const OpeningBook& book, const ChessBitboard& board) {
+            py::list entries;
+            for (const OpeningBook::Entry& entry : book.probe(board)) entries.append(py::make_tuple(entry.move, entry.weight, entry.learn));
+            return entries;
+        }, py::arg("board"), "(move, weight, learn) for each book move, highest weight first")
+        .def("pick", [](const OpeningBook& book, const ChessBitboard& board, py::object seed) -> py::object {
+            static thread_local std::mt19937_64 shared_rng(std::random_device{}());
+            std::mt19937_64 seeded_rng(seed.is_none() ? 0 : seed.cast<uint64_t>());
+            Move move = book.pick(board, seed.is_none() ? shared_rng : seeded_rng);
+            return move.isNone() ? py::none() : py::cast(move);
+        }, py::arg("board"), py::arg("seed") = py::none(), "Book move drawn in proportion to its weight")
+        .def("best", [](const OpeningBook& book, const ChessBitboard& board) -> py::object {
+            Move move = book.best(board);
+            return move.isNone() ? py::none() : py::cast(move);
+        }, py::arg("board"))
+        .def_static("key", &OpeningBook::key, py::arg("board"));
+
+    // Builds a book from finished games (self-play records, parsed PGN)
+    py::class_<OpeningBookBuilder>(m, "OpeningBookBuilder")
+        .def(py::init<int>(), py::arg("max_ply") = 30)
+        .def("add_game", &OpeningBookBuilder::addGame, py::arg("start"), py::arg("moves"), py::arg("result"),
+             "Record a game played from `start`; result is from white's point of view like get_result")
+        .def("add", &OpeningBookBuilder::add, py::arg("board"), py::arg("move"), py::arg("score"))
+        .def_property_readonly("positions", &OpeningBookBuilder::positions)
+        .def("write", &OpeningBookBuilder::write, py::arg("path"), py::arg("min_games") = 1,
+             "Write the book; returns the number of entries");
+
+    m.def("parse_san", [](const ChessBitboard& board, const std::string& san) -> py::object {
+        Move move = Pgn::parseSan(board, san);
+        return move.isNone() ? py::none() : py::cast(move);
+    }, py::arg("board"), py::arg("san"), "The legal move a SAN string names, None if none or ambiguous");
+    m.def("to_san", &Pgn::toSan, py::arg("board"), py::arg("move"));
+
+    py::class_<PgnGame>(m, "PgnGame")
+        .def_property_readonly("tags", [](const PgnGame& game) {
+            py::dict tags;
+            for (const auto& [name, value] : game.tags) tags[py::str(name)] = value;
+            return tags;
+        })
+        .def_readonly("start", &PgnGame::start)
+        .def_readonly("moves", &PgnGame::moves)
+        .def_readonly("result", &PgnGame::result, "1, 0, -1 from white's point of view, 2 if unfinished")
+        .def_readonly("error", &PgnGame::error)
+        .def("tag", &PgnGame::tag, py::arg("name"));
+
+    // Memory-mapped PGN parsed on worker threads, read as games or as columns of positions
+    py::class_<PgnReader>(m, "PgnReader")
+        .def(py::init<const std::string&, int>(), py::arg("path"), py::arg("threads") = 0)
+        .def_static("from_text", &PgnReader::fromText, py::arg("text"), py::arg("threads") = 0)
+        .def_property_readonly("bytes", &PgnReader::bytes)
+        .def_property_readonly("offset", &PgnReader::offset)
+        .def_property_readonly("done", &PgnReader::done)
+        .def_property_readonly("games_read", &PgnReader::gamesRead)
+        .def_property_readonly("errors", &PgnReader::errors)
+        .def("rewind", &PgnReader::rewind)
+        .def("read_games", [](PgnReader& reader, size_t max_games) {
+            std::vector<PgnGame> games;
+            {
+                py::gil_scoped_release release;
+                reader.nextGames(games, max_games);
+            }
+            return games;
+        }, py::arg("max_games") = 1024, "Up to max_games further games; empty at the end of the file")
+        .def("read_positions", [](PgnReader& reader, size_t max_games, bool include_unfinished) {
+            PositionBatch batch;
+            {
+                py::gil_scoped_release release;
+                reader.nextPositions(batch, max_games, include_unfinished);
+            }
+            return positionArrays(std::move(batch));
+        }, py::arg("max_games") = 1024, py::arg("include_unfinished") = false,
+           "Dict of numpy columns (bitboards [n, 12], moves, policy, result, ...) for the next games")
+        .def("batches", [](PgnReader& reader, size_t games, bool include_unfinished) {
+            return PgnBatches{&reader, games, include_unfinished};
+        }, py::arg("games_per_batch") = 1024, py::arg("include_unfinished") = false, py::keep_alive<0, 1>());
+
+    py::class_<PgnBatches>(m, "PgnBatches")
+        .def("__iter__", [](PgnBatches& batches) -> PgnBatches& { return batches; }, py::return_value_policy::reference_internal)
+        .def("__next__", [](PgnBatches& batches) {
+            PositionBatch batch;
+            bool more;
+            {
+                py::gil_scoped_release release;
+                more = batches.reader->nextPositions(batch, batches.games, batches.include_unfinished);
+            }
+            if (!more) throw py::stop_iteration();
+            return positionArrays(std::move(batch));
+        });
+
+    // Shuffled fixed-size training shards from self-play games or PGN
+    py::class_<ShardWriter>(m, "ShardWriter")
+        .def(py::init<const std::string&, size_t, size_t, uint64_t, const std::string&>(), py::arg("directory"),
+             py::arg("samples_per_shard") = 65536, py::arg("shuffle_window") = 262144, py::arg("seed") = 0,
+             py::arg("prefix") = "shard")
+        .def("add_game", &addGameSamples<ShardWriter>, py::arg("start"), py::arg("moves"), py::arg("result"),
+             py::arg("policies") = py::none(),
+             "Record a game played from `start` (result from white's point of view like get_result); "
+             "policies are the search distributions per move, or None for the moves played")
+        .def("add_pgn", &ShardWriter::addPgn, py::arg("reader"), py::arg("games_per_batch") = 4096,
+             py::arg("include_unfinished") = false, py::call_guard<py::gil_scoped_release>(),
+             "Every game left in a PgnReader; returns the number of samples")
+        .def("flush", &ShardWriter::flush, py::call_guard<py::gil_scoped_release>())
+        .def_property_readonly("samples", &ShardWriter::samples)
+        .def_property_readonly("shards", &ShardWriter::shards)
+        .def_static("list", &ShardWriter::list, py::arg("directory"), py::arg("prefix") = "shard");
+
+    // Background decoding of shards: iterating yields (planes [n, 25, 8, 8], policies [n, 4672], values [n, 1])
+    py::class_<ShardLoader>(m, "ShardLoader")
+        .def(py::init([](std::vector<std::string> paths, size_t batch_size, int threads, size_t prefetch,
+                         uint64_t seed, bool loop, bool flip, bool mirror) {
+            ShardLoaderConfig config;
+            config.batch_size = batch_size;
+            config.threads = threads;
+            config.prefetch = prefetch;
+            config.seed = seed;
+            config.loop = loop;
+            config.symmetries = (flip ? Symmetry::FLIP : 0) | (mirror ? Symmetry::MIRROR : 0);
+            return std::make_unique<ShardLoader>(std::move(paths), config);
+        }), py::arg("paths"), py::arg("batch_size") = 256, py::arg("threads") = 0, py::arg("prefetch") = 4,
+            py::arg("seed") = 0, py::arg("loop") = true, py::arg("flip") = false, py::arg("mirror") = false,
+            "flip/mirror turn or mirror each sample at random (mirror only without castling rights)")
+        .def_property_readonly("samples", &ShardLoader::samples)
+        .def_property_readonly("batch_size", &ShardLoader::batchSize)
+        .def("__iter__", [](ShardLoader& loader) -> ShardLoader& { return loader; }, py::return_value_policy::reference_internal)
+        .def("__next__", [](ShardLoader& loader) {
+            std::unique_ptr<LoaderBatch> batch;
+            {
+                py::gil_scoped_release release;
+                batch = loader.next();
+            }
+            if (!batch) throw py::stop_iteration();
+            py::ssize_t rows = static_cast<py::ssize_t>(batch->size);
+            return py::make_tuple(toArray(std::move(batch->planes), {rows, ChessNet::INPUT_PLANES, 8, 8}),
+                                  toArray(std::move(batch->policies), {rows, ChessNet::POLICY_SIZE}),
+                                  toArray(std::move(batch->values), {rows, 1}));
+        });
+
+    // Replay ring in a shared file: self-play processes append, the trainer samples
+    py::class_<ReplayBuffer>(m, "ReplayBuffer")
+        .def(py::init<const std::string&, uint64_t, float, uint64_t>(), py::arg("path"), py::arg("capacity") = 0,
+             py::arg("alpha") = 0.6f, py::arg("seed") = 0,
+             "Create the buffer at path (e.g. under /dev/shm) or attach to it; capacity 0 only attaches")
+        .def_property_readonly("path", &ReplayBuffer::path)
+        .def_property_readonly("capacity", &ReplayBuffer::capacity)
+        .def_property_readonly("added", &ReplayBuffer::added)
+        .def("__len__", &ReplayBuffer::size)
+        .def("add_game", &addGameSamples<ReplayBuffer>, py::arg("start"), py::arg("moves"), py::arg("result"),
+             py::arg("policies") = py::none(), "Same as ShardWriter.add_game; safe from any process")
+        .def("sample", [](ReplayBuffer& buffer, size_t batch_size, bool prioritized, float beta, bool flip, bool mirror) {
+            LoaderBatch batch;
+            std::vector<uint64_t> slots;
+            std::vector<float> weights;
+            {
+                py::gil_scoped_release release;
+                buffer.sample(batch_size, prioritized, batch, slots, weights, beta,
+                              (flip ? Symmetry::FLIP : 0) | (mirror ? Symmetry::MIRROR : 0));
+            }
+            py::ssize_t rows = static_cast<py::ssize_t>(batch_size);
+            return py::make_tuple(toArray(std::move(batch.planes), {rows, ChessNet::INPUT_PLANES, 8, 8}),
+                                  toArray(std::move(batch.policies), {rows, ChessNet::POLICY_SIZE}),
+                                  toArray(std::move(batch.values), {rows, 1}),
+                                  toArray(std::move(slots), {rows}),
+                                  toArray(std::move(weights), {rows, 1}));
+        }, py::arg("batch_size"), py::arg("prioritized") = false, py::arg("beta") = 0.4f, py::arg("flip") = false,
+           py::arg("mirror") = false,
+           "(planes, policies, values, slots, importance weights) of batch_size records, uniform or by priority")
+        .def("update_priorities", &ReplayBuffer::updatePriorities, py::arg("slots"), py::arg("priorities"))
+        .def("checkpoint", &ReplayBuffer::checkpoint, py::arg("path"), py::call_guard<py::gil_scoped_release>(),
+             "Append the records added since the last checkpoint; returns how many")
+        .def("restore", &ReplayBuffer::restore, py::arg("path"), py::call_guard<py::gil_scoped_release>());
+
+    // Alpha-beta over the hand-crafted evaluation, or a network once set; keeps history between calls
+    py::class_<Search>(m, "Search")
+        .def(py::init<>())
+        .def("run", py::overload_cast<const ChessBitboard&, int>(&Search::run), py::arg("board"), py::arg("depth"),
+             py::call_guard<py::gil_scoped_release>())
+        .def("run", py::overload_cast<const ChessBitboard&, const SearchLimits&, int>(&Search::run),
+             py::arg("board"), py::arg("limits"), py::arg("depth") = Search::MAX_PLY - 1,
+             py::call_guard<py::gil_scoped_release>())
+        .def("stop", &Search::stop)
+        .def("set_hash_size", &Search::setHashSize, py::arg("megabytes"))
+        .def("hashfull", &Search::hashfull)
+        .def("set_game_history", &Search::setGameHistory, py::arg("hashes"),
+             "Hashes of the game's positions before the root, oldest first; repeating one scores as a draw")
+        .def("set_network", &Search::setNetwork, py::arg("network"), py::keep_alive<1, 2>())
+        .def("set_tablebase", &Search::setTablebase, py::arg("tablebase"), py::arg("probe_depth") = 1,
+             py::keep_alive<1, 2>())
+        .def("clear", &Search::clear);
+
+    // Native ChessNet inference straight from the training checkpoint
+    py::class_<ChessNet>(m, "NativeChessNet")
+        .def(py::init([](const std::string& path) {
+            auto net = std::make_unique<ChessNet>();
+            net->load(path);
+            return net;
+        }), py::arg("path"))
+        .def("predict", [](const ChessNet& net, const ChessBitboard& board, const ChessBitboard* previous) {
+            std::vector<float> planes(ChessNet::INPUT_PLANES * 64), policy(ChessNet::POLICY_SIZE);
+            float value;
+            encodePosition(board, previous, planes.data());
+            {
+                py::gil_scoped_release release;
+                net.forward(planes.data(), 1, policy.data(), &value);
+            }
+            return py::make_tuple(policy, value);
+        }, py::arg("board"), py::arg("previous") = nullptr,
+           "Raw policy logits (4672) and tanh value for the side to move")
+        .def("forward", [](const ChessNet& net, PlaneBatch planes) {
+            return forwardBatch(planes, [&](const float* input, int batch, float* logits, float* values) {
+                net.forward(input, batch, logits, values);
+            });
+        }, py::arg("planes"), "Batched forward over [batch, 25, 8, 8] planes -> (logits [batch, 4672], values [batch])");
+
+    // Int8 copy of a NativeChessNet, calibrated on encoded positions
+    py::class_<QuantizedChessNet>(m, "QuantizedChessNet")
+        .def(py::init([](const ChessNet& net, PlaneBatch calibration) {
+            int count = checkPlaneBatch(calibration);
+            return std::make_unique<QuantizedChessNet>(net, calibration.data(), count);
+        }), py::arg("net"), py::arg("calibration_planes"))
+        .def("forward", [](const QuantizedChessNet& net, PlaneBatch planes) {
+            return forwardBatch(planes, [&](const float* input, int batch, float* logits, float* values) {
+                net.forward(input, batch, logits, values);
+            });
+        }, py::arg("planes"));
+
+    py::class_<QuantizationReport>(m, "QuantizationReport")
+        .def_readonly("positions", &QuantizationReport::positions)
+        .def_readonly("policy_top1_agreement", &QuantizationReport::policy_top1_agreement)
+        .def_readonly("value_mae", &QuantizationReport::value_mae)
+        .def_readonly("value_max_error", &QuantizationReport::value_max_error);
+
+    m.def("compare_quantized", [](const ChessNet& net, const QuantizedChessNet& quantized, PlaneBatch planes) {
+        int count = checkPlaneBatch(planes);
+        py::gil_scoped_release release;
+        return compareQuantized(net, quantized, planes.data(), count);
+    }, py::arg("net"), py::arg("quantized"), py::arg("planes"));
+
+    m.def("policy_index", &policyIndex, py::arg("move"), "Same index as game_logic.move_to_policy_index");
+    m.def("policy_permutation", [](bool flip, bool mirror) {
+        int symmetry = (flip ? Symmetry::FLIP : 0) | (mirror ? Symmetry::MIRROR : 0);
+        py::array_t<int32_t> permutation(ChessNet::POLICY_SIZE);
+        int32_t* data = permutation.mutable_data();
+        for (int i = 0; i < ChessNet::POLICY_SIZE; i++) data[i] = transformPolicyIndex(i, symmetry);
+        return permutation;
+    }, py::arg("flip") = false, py::arg("mirror") = false,
+       "permutation[i]: policy index of move i after flip_vertical and/or mirror_horizontal");
+
+    py::class_<Evaluator>(m, "Evaluator");
+    py::class_<HandcraftedEvaluator, Evaluator>(m, "HandcraftedEvaluator")
+        .def(py::init<>());
+    py::class_<NetworkEvaluator, Evaluator>(m, "NetworkEvaluator")
+        .def(py::init<const std::string&>(), py::arg("checkpoint_path"))
+        .def("quantize", [](NetworkEvaluator& evaluator, PlaneBatch calibration) {
+            int count = checkPlaneBatch(calibration);
+            evaluator.quantize(calibration.data(), count);
+        }, py::arg("calibration_planes"), "Switch to int8 inference calibrated on [n, 25, 8, 8] planes")
+        .def("is_quantized", &NetworkEvaluator::isQuantized);
+
+    py::class_<EvalCache::Stats>(m, "EvalCacheStats")
+        .def_readonly("hits", &EvalCache::Stats::hits)
+        .def_readonly("misses", &EvalCache::Stats::misses)
+        .def_readonly("inserts", &EvalCache::Stats::inserts)
+        .def_readonly("evictions", &EvalCache::Stats::evictions)
+        .def_readonly("entries", &EvalCache::Stats::entries)
+        .def_readonly("bytes", &EvalCache::Stats::bytes)
+        .def_readonly("max_bytes", &EvalCache::Stats::max_bytes)
+        .def_property_readonly("hit_rate", [](const EvalCache::Stats& s) {
+            uint64_t lookups = s.hits + s.misses;
+            return lookups ? static_cast<double>(s.hits) / lookups : 0.0;
+        });
+
+    // Shared, memory-capped cache of evaluator results keyed by position + previous position
+    py::class_<EvalCache>(m, "EvalCache")
+        .def(py::init<size_t, int>(), py::arg("max_bytes") = 64ULL << 20, py::arg("shards") = 64)
+        .def("stats", &EvalCache::stats)
+        .def("clear", &EvalCache::clear)
+        .def("set_max_bytes", &EvalCache::setMaxBytes, py::arg("max_bytes"))
+        // For searches outside C++ (mcts.py): priors are in the order of the legal moves
+        .def("lookup", [](EvalCache& cache, const ChessBitboard& board, const ChessBitboard* previous,
+                          size_t num_moves) -> py::object {
+            EvalResult result;
+            if (!cache.lookup(EvalCache::key(board.hash, previous ? previous->hash : 0), num_moves, result)) {
+                return py::none();
+            }
+            return py::make_tuple(std::move(result.priors), result.value);
+        }, py::arg("board"), py::arg("previous"), py::arg("num_moves"),
+           "(priors, value) stored for the position after `previous` (None if unknown), or None")
+        .def("insert", [](EvalCache& cache, const ChessBitboard& board, const ChessBitboard* previous,
+                          std::vector<float> priors, float value) {
+            EvalResult result;
+            result.priors = std::move(priors);
+            result.value = value;
+            cache.insert(EvalCache::key(board.hash, previous ? previous->hash : 0), result);
+        }, py::arg("board"), py::arg("previous"), py::arg("priors"), py::arg("value"));
+
+    py::class_<CachedEvaluator, Evaluator>(m, "CachedEvaluator")
+        .def(py::init<Evaluator&, EvalCache&>(), py::arg("inner"), py::arg("cache"),
+             py::keep_alive<1, 2>(), py::keep_alive<1, 3>());
+
+    py::class_<MCTSConfig>(m, "MCTSConfig")
+        .def(py::init<>())
+        .def_readwrite("num_simulations", &MCTSConfig::num_simulations)
+        .def_readwrite("batch_size", &MCTSConfig::batch_size)
+        .def_readwrite("threads", &MCTSConfig::threads)
+        .def_readwrite("c_puct", &MCTSConfig::c_puct)
+        .def_readwrite("fpu_reduction", &MCTSConfig::fpu_reduction)
+        .def_readwrite("dirichlet_alpha", &MCTSConfig::dirichlet_alpha)
+        .def_readwrite("dirichlet_epsilon", &MCTSConfig::dirichlet_epsilon)
+        .def_readwrite("seed", &MCTSConfig::seed)
+        .def_readwrite("reuse_tree", &MCTSConfig::reuse_tree)
+        .def_readwrite("transpositions", &MCTSConfig::transpositions)
+        .def_readwrite("early_stop", &MCTSConfig::early_stop)
+        .def_readwrite("ponder_simulations", &MCTSConfig::ponder_simulations);
+
+    py::class_<MCTSResult>(m, "MCTSResult")
+        .def_readonly("best_move", &MCTSResult::best_move)
+        .def_readonly("value", &MCTSResult::value)
+        .def_readonly("moves", &MCTSResult::moves)
+        .def_readonly("visits", &MCTSResult::visits)
+        .def_readonly("depth", &MCTSResult::depth)
+        .def_readonly("simulations", &MCTSResult::simulations);
+
+    py::class_<MCTSMemory>(m, "MCTSMemory")
+        .def_readonly("nodes", &MCTSMemory::nodes)
+        .def_readonly("edges", &MCTSMemory::edges)
+        .def_readonly("node_bytes", &MCTSMemory::node_bytes)
+        .def_readonly("edge_bytes", &MCTSMemory::edge_bytes)
+        .def_readonly("table_bytes", &MCTSMemory::table_bytes)
+        .def_readonly("reserved_bytes", &MCTSMemory::reserved_bytes)
+        .def("__repr__", [](const MCTSMemory& memory) {
+            return "<MCTSMemory nodes=" + std::to_string(memory.nodes) + " edges=" + std::to_string(memory.edges) +
+                   " reserved=" + std::to_string(memory.reserved_bytes >> 20) + "MB>";
+        });
+
+    // Batched PUCT search; the evaluator must outlive it
+    py::class_<MCTS>(m, "MCTS")
+        .def(py::init<Evaluator&, const MCTSConfig&>(), py::arg("evaluator"), py::arg("config") = MCTSConfig(),
+             py::keep_alive<1, 2>())
+        .def("search", &MCTS::search, py::arg("board"), py::arg("previous") = nullptr,
+             py::arg("limits") = SearchLimits(), py::call_guard<py::gil_scoped_release>())
+        .def("stop", &MCTS::stop)
+        .def("ponder", &MCTS::ponder, py::arg("board"), py::arg("previous") = nullptr,
+             "Search `board` in the background until the next search, advance or reset")
+        .def("stop_pondering", &MCTS::stopPondering, py::call_guard<py::gil_scoped_release>())
+        .def("is_pondering", &MCTS::isPondering)
+        .def("advance", &MCTS::advance, py::arg("move"), "Keep the subtree under the played move",
+             py::call_guard<py::gil_scoped_release>())
+        .def("reset", &MCTS::reset, py::call_guard<py::gil_scoped_release>())
+        .def("set_tablebase", &MCTS::setTablebase, py::arg("tablebase"), py::keep_alive<1, 2>())
+        .def_property_readonly("tree_size", &MCTS::treeSize)
+        .def("memory_usage", &MCTS::memoryUsage);
+
+    // Only counts anything in builds with CHESS_INSTRUMENT=1 (see instrument.h)
+    m.attr("instrumentation_enabled") = instrument::enabled();
+    m.def("instrumentation", [] {
+        instrument::Snapshot snapshot = instrument::snapshot();
+        py::dict counters, timers, result;
+        for (int i = 0; i < instrument::COUNTER_COUNT; i++) {
+            counters[instrument::name(static_cast<instrument::Counter>(i))] = snapshot.counters[i];
+        }
+        for (int i = 0; i < instrument::PHASE_COUNT; i++) {
+            py::dict timer;
+            timer["calls"] = snapshot.calls[i];
+            timer["cycles"] = snapshot.cycles[i];
+            timer["ms"] = snapshot.cycles[i] / snapshot.cycles_per_ns / 1e6;
+            timers[instrument::name(static_cast<instrument::Phase>(i))] = timer;
+        }
+        auto ratio = [](uint64_t part, uint64_t whole) { return whole ? static_cast<double>(part) / whole : 0.0; };
+        result["enabled"] = instrument::enabled();
+        result["counters"] = counters;
+        result["timers"] = timers;
+        result["batch_fill_ratio"] = ratio(snapshot.counters[instrument::BATCH_POSITIONS], snapshot.counters[instrument::BATCH_CAPACITY]);
+        result["tt_hit_rate"] = ratio(snapshot.counters[instrument::TT_HITS], snapshot.counters[instrument::TT_PROBES]);
+        result["cache_hit_rate"] = ratio(snapshot.counters[instrument::CACHE_HITS], snapshot.counters[instrument::CACHE_PROBES]);
+        result["cycles_per_ns"] = snapshot.cycles_per_ns;
+        return result;
+    }, "Counters and phase timers summed over all threads since the last reset_instrumentation()");
+    m.def("reset_instrumentation", &instrument::reset);
+    m.def("instrumentation_json", [] { return instrument::toJson(instrument::snapshot()); });
+    m.def("start_instrumentation_dump", &instrument::startDump, py::arg("path"), py::arg("interval_ms") = 1000,
+          "Rewrite `path` with instrumentation_json() every interval_ms until stop_instrumentation_dump()");
+    m.def("stop_instrumentation_dump", &instrument::stopDump, py::call_guard<py::gil_scoped_release>());
+}
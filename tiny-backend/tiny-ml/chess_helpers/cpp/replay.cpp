@@ -0,0 +1,290 @@
+// replay.cpp
+#include "replay.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct ReplayBuffer::Header {
+    char magic[8];
+    uint32_t record_size;
+    uint32_t reserved;
+    uint64_t capacity;
+    uint64_t generation;  // random id of this buffer, so checkpoints know which one they follow
+    alignas(64) std::atomic<uint64_t> next;  // tickets handed out
+};
+
+namespace {
+
+constexpr char MAGIC[8] = {'C', 'H', 'R', 'E', 'P', 'L', 'Y', '1'};
+constexpr char CHECKPOINT_MAGIC[8] = {'C', 'H', 'R', 'E', 'P', 'C', 'K', '1'};
+
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t record_size;
+    uint32_t reserved;
+    uint64_t generation;
+    uint64_t ticket;  // the next record to append is this buffer's ticket
+    uint64_t count;
+};
+
+bool readCheckpointHeader(const std::string& path, CheckpointHeader& header) {
+    std::ifstream in(path, std::ios::binary);
+    return in.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+           std::memcmp(header.magic, CHECKPOINT_MAGIC, 8) == 0 && header.record_size == sizeof(TrainingSample);
+}
+
+} // namespace
+
+ReplayBuffer::ReplayBuffer(const std::string& path, uint64_t capacity, float alpha, uint64_t seed)
+    : file_path(path), alpha(alpha), rng(seed) {
+    int fd = open(path.c_str(), capacity > 0 ? O_RDWR | O_CREAT : O_RDWR, 0644);
+    if (fd < 0) throw std::runtime_error("Cannot open replay buffer: " + path);
+    // Whoever gets here first creates the buffer; the others wait and attach
+    flock(fd, LOCK_EX);
+    auto fail = [&](const std::string& message) {
+        flock(fd, LOCK_UN);
+        close(fd);
+        throw std::runtime_error(message + ": " + path);
+    };
+    struct stat info;
+    if (fstat(fd, &info) != 0) fail("Cannot read replay buffer");
+    Header existing{};
+    bool valid = static_cast<size_t>(info.st_size) >= sizeof(Header) &&
+                 pread(fd, &existing, sizeof(Header), 0) == static_cast<ssize_t>(sizeof(Header)) &&
+                 std::memcmp(existing.magic, MAGIC, 8) == 0 && existing.record_size == sizeof(TrainingSample) &&
+                 static_cast<size_t>(info.st_size) == sizeof(Header) + existing.capacity * sizeof(Slot);
+    // Only an empty file or a buffer of another capacity is replaced
+    if (!valid && (info.st_size > 0 || capacity == 0)) fail("Not a replay buffer");
+    bool create = !valid || (capacity > 0 && existing.capacity != capacity);
+    slot_count = create ? capacity : existing.capacity;
+    mapped_size = sizeof(Header) + slot_count * sizeof(Slot);
+    if (create && (ftruncate(fd, 0) != 0 || ftruncate(fd, mapped_size) != 0)) fail("Cannot size replay buffer");
+    base = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        base = nullptr;
+        fail("Cannot map replay buffer");
+    }
+    header = static_cast<Header*>(base);
+    slots = reinterpret_cast<Slot*>(static_cast<char*>(base) + sizeof(Header));
+    if (create) {
+        // The file starts zeroed: no tickets, every slot empty
+        header->record_size = sizeof(TrainingSample);
+        header->capacity = slot_count;
+        header->generation = std::random_device{}() ^
+                             static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+        std::memcpy(header->magic, MAGIC, 8);
+        msync(base, sizeof(Header), MS_SYNC);
+    }
+    flock(fd, LOCK_UN);
+    close(fd);
+
+    tree_leaves = 1;
+    while (tree_leaves < slot_count) tree_leaves *= 2;
+    tree.assign(2 * tree_leaves, 0.0);
+}
+
+ReplayBuffer::~ReplayBuffer() {
+    if (base) munmap(base, mapped_size);
+}
+
+uint64_t ReplayBuffer::added() const {
+    return header->next.load(std::memory_order_acquire);
+}
+
+uint64_t ReplayBuffer::size() const {
+    return std::min(added(), slot_count);
+}
+
+void ReplayBuffer::add(const TrainingSample& sample) {
+    uint64_t ticket = header->next.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots[ticket % slot_count];
+    slot.sequence.store(2 * ticket + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&slot.sample, &sample, sizeof(TrainingSample));
+    slot.sequence.store(2 * ticket + 2, std::memory_order_release);
+}
+
+void ReplayBuffer::addGame(const ChessBitboard& start, const std::vector<Move>& moves, int white_result,
+                           const float* policies) {
+    for (const TrainingSample& sample : gameSamples(start, moves, white_result, policies)) add(sample);
+}
+
+bool ReplayBuffer::read(uint64_t slot, TrainingSample& out) const {
+    const Slot& source = slots[slot];
+    uint64_t before = source.sequence.load(std::memory_order_acquire);
+    if (before == 0 || (before & 1)) return false;
+    std::memcpy(&out, &source.sample, sizeof(TrainingSample));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return source.sequence.load(std::memory_order_relaxed) == before;
+}
+
+void ReplayBuffer::setPriority(uint64_t slot, double value) {
+    size_t node = tree_leaves + slot;
+    tree[node] = value;
+    for (node /= 2; node >= 1; node /= 2) tree[node] = tree[2 * node] + tree[2 * node + 1];
+}
+
+void ReplayBuffer::sync() {
+    uint64_t next = added();
+    uint64_t from = std::max(synced, next > slot_count ? next - slot_count : 0);
+    double initial = std::pow(max_priority, alpha);
+    for (uint64_t ticket = from; ticket < next; ticket++) setPriority(ticket % slot_count, initial);
+    synced = next;
+}
+
+void ReplayBuffer::sample(size_t batch_size, bool prioritized, LoaderBatch& batch, std::vector<uint64_t>& sampled,
+                          std::vector<float>& weights, float beta, int symmetries) {
+    sync();
+    uint64_t count = size();
+    if (count == 0) throw std::runtime_error("Replay buffer is empty: " + file_path);
+    batch.size = batch_size;
+    batch.planes.resize(batch_size * ChessNet::INPUT_PLANES * 64);
+    batch.policies.resize(batch_size * ChessNet::POLICY_SIZE);
+    batch.values.resize(batch_size);
+    sampled.resize(batch_size);
+    weights.resize(batch_size);
+
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    double total = tree[1];
+    size_t attempts = 0;
+    TrainingSample record;
+    for (size_t i = 0; i < batch_size; i++) {
+        uint64_t slot = 0;
+        double probability = 1.0 / count;
+        for (bool first = true;; first = false) {
+            // Records still being written are skipped, but not forever
+            if (++attempts > 1000 * (batch_size + 1)) {
+                throw std::runtime_error("No finished records in the replay buffer: " + file_path);
+            }
+            if (prioritized && total > 0.0) {
+                // One draw from each of batch_size equal slices of the total, then anywhere
+                double target = first ? (i + uniform(rng)) * total / batch_size : uniform(rng) * total;
+                size_t node = 1;
+                while (node < tree_leaves) {
+                    if (target < tree[2 * node] || tree[2 * node + 1] <= 0.0) {
+                        node = 2 * node;
+                    } else {
+                        target -= tree[2 * node];
+                        node = 2 * node + 1;
+                    }
+                }
+                slot = node - tree_leaves;
+                probability = tree[node] / total;
+            } else {
+                slot = rng() % count;
+            }
+            if (slot < count && probability > 0.0 && read(slot, record)) break;
+        }
+        if (symmetries) {
+            int symmetry = static_cast<int>(rng()) & symmetries;
+            if (record.castling_rights) symmetry &= ~Symmetry::MIRROR;
+            if (symmetry) record.transform(symmetry);
+        }
+        record.encodePlanes(&batch.planes[i * ChessNet::INPUT_PLANES * 64]);
+        record.encodePolicy(&batch.policies[i * ChessNet::POLICY_SIZE]);
+        batch.values[i] = record.value;
+        sampled[i] = slot;
+        weights[i] = prioritized ? static_cast<float>(std::pow(count * probability, -beta)) : 1.0f;
+    }
+    float largest = *std::max_element(weights.begin(), weights.end());
+    for (float& weight : weights) weight /= largest;
+}
+
+void ReplayBuffer::updatePriorities(const std::vector<uint64_t>& sampled, const std::vector<float>& priorities) {
+    if (sampled.size() != priorities.size()) throw std::runtime_error("updatePriorities needs one priority per slot");
+    sync();
+    for (size_t i = 0; i < sampled.size(); i++) {
+        if (sampled[i] >= slot_count) throw std::runtime_error("Replay buffer slot out of range");
+        double priority = std::max<double>(priorities[i], 1e-6);
+        max_priority = std::max(max_priority, priority);
+        setPriority(sampled[i], std::pow(priority, alpha));
+    }
+}
+
+uint64_t ReplayBuffer::checkpoint(const std::string& path) {
+    uint64_t next = added();
+    uint64_t oldest = next > slot_count ? next - slot_count : 0;
+    CheckpointHeader file{};
+    bool append = readCheckpointHeader(path, file) && file.generation == header->generation;
+    uint64_t from = append ? std::max(file.ticket, oldest) : oldest;
+    if (append && file.count + (next - from) > 2 * slot_count) {
+        append = false;
+        from = oldest;
+    }
+
+    // Stops at the first record still being written; the next checkpoint starts there
+    std::vector<TrainingSample> records;
+    records.reserve(next - from);
+    uint64_t end = from;
+    for (; end < next; end++) {
+        const Slot& slot = slots[end % slot_count];
+        uint64_t expected = 2 * end + 2;
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence > expected) continue;  // overwritten meanwhile
+        TrainingSample record;
+        if (sequence < expected || !read(end % slot_count, record)) break;
+        if (slot.sequence.load(std::memory_order_acquire) != expected) continue;
+        records.push_back(record);
+    }
+
+    if (append) {
+        std::fstream out(path, std::ios::binary | std::ios::in | std::ios::out);
+        out.seekp(0, std::ios::end);
+        out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(TrainingSample));
+        file.ticket = end;
+        file.count += records.size();
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&file), sizeof(file));
+        if (!out) throw std::runtime_error("Cannot write replay checkpoint: " + path);
+    } else {
+        std::memcpy(file.magic, CHECKPOINT_MAGIC, 8);
+        file.record_size = sizeof(TrainingSample);
+        file.generation = header->generation;
+        file.ticket = end;
+        file.count = records.size();
+        std::string partial = path + ".tmp";
+        {
+            std::ofstream out(partial, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(&file), sizeof(file));
+            out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(TrainingSample));
+            if (!out) throw std::runtime_error("Cannot write replay checkpoint: " + path);
+        }
+        std::error_code ec;
+        std::filesystem::rename(partial, path, ec);
+        if (ec) throw std::runtime_error("Cannot write replay checkpoint: " + path);
+    }
+    return records.size();
+}
+
+uint64_t ReplayBuffer::restore(const std::string& path) {
+    CheckpointHeader file{};
+    if (!readCheckpointHeader(path, file)) throw std::runtime_error("Not a replay checkpoint: " + path);
+    uint64_t count = std::min(file.count, slot_count);
+    std::fstream in(path, std::ios::binary | std::ios::in | std::ios::out);
+    in.seekg(sizeof(CheckpointHeader) + (file.count - count) * sizeof(TrainingSample));
+    std::vector<TrainingSample> chunk(std::min<uint64_t>(count, 4096));
+    for (uint64_t done = 0; done < count;) {
+        size_t n = std::min<uint64_t>(chunk.size(), count - done);
+        if (!in.read(reinterpret_cast<char*>(chunk.data()), n * sizeof(TrainingSample))) {
+            throw std::runtime_error("Truncated replay checkpoint: " + path);
+        }
+        for (size_t i = 0; i < n; i++) add(chunk[i]);
+        done += n;
+    }
+    // The file now continues this buffer: its last records are the ones just added
+    file.generation = header->generation;
+    file.ticket = added();
+    in.seekp(0);
+    in.write(reinterpret_cast<const char*>(&file), sizeof(file));
+    if (!in) throw std::runtime_error("Cannot write replay checkpoint: " + path);
+    return count;
+}
@@ -0,0 +1,88 @@
+// replay.h
+#pragma once
+#include "shards.h"
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Self-play replay buffer in a shared memory-mapped file (normally under /dev/shm), so
+// self-play processes append to it while a training process samples from it.
+//
+// The file holds a header and a ring of TrainingSample slots. Appending is lock-free:
+// a producer takes a ticket with one fetch_add and writes slot ticket % capacity under a
+// per-slot sequence number (odd while it writes, 2 * ticket + 2 once done), so readers
+// skip slots being written and retry torn reads. Priorities for prioritized sampling live
+// in the trainer's own memory as a sum tree; records it has not seen yet get the highest
+// priority so far.
+class ReplayBuffer {
+public:
+    // Creates the buffer in `path`, or attaches to the one there if it has this capacity
+    // (capacity 0 attaches to whatever is there); a buffer of another capacity is replaced.
+    // alpha shapes priorities as p^alpha. Throws std::runtime_error if the file cannot be
+    // created or mapped, or exists and is not a buffer.
+    ReplayBuffer(const std::string& path, uint64_t capacity = 0, float alpha = 0.6f, uint64_t seed = 0);
+    ~ReplayBuffer();
+    ReplayBuffer(const ReplayBuffer&) = delete;
+    ReplayBuffer& operator=(const ReplayBuffer&) = delete;
+
+    const std::string& path() const { return file_path; }
+    uint64_t capacity() const { return slot_count; }
+    // Records ever appended, by every process; all but the last `capacity` are overwritten
+    uint64_t added() const;
+    uint64_t size() const;
+
+    // Safe from any number of threads and processes at once
+    void add(const TrainingSample& sample);
+    void addGame(const ChessBitboard& start, const std::vector<Move>& moves, int white_result,
+                 const float* policies = nullptr);
+
+    // The rest is for the trainer: one thread of one process.
+
+    // batch_size records into `batch` and the slots they came from into `slots`, drawn
+    // uniformly or in proportion to priority. `weights` gets the importance-sampling weights
+    // (size * P(slot))^-beta scaled so the largest is 1 (all 1 when uniform). `symmetries`
+    // augments like ShardLoaderConfig::symmetries. Throws std::runtime_error while empty.
+    void sample(size_t batch_size, bool prioritized, LoaderBatch& batch, std::vector<uint64_t>& slots,
+                std::vector<float>& weights, float beta = 0.4f, int symmetries = 0);
+    // New priorities for sampled slots, e.g. their absolute errors
+    void updatePriorities(const std::vector<uint64_t>& slots, const std::vector<float>& priorities);
+
+    // Appends the records added since the last checkpoint to the file at `path`, rewriting
+    // it with just the live records once it would hold more than twice the capacity.
+    // Returns the number of records written.
+    uint64_t checkpoint(const std::string& path);
+    // Adds the newest `capacity` records of a checkpoint, before producers start; returns
+    // how many. Later checkpoints to the same file continue from them.
+    uint64_t restore(const std::string& path);
+
+private:
+    struct Header;
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        TrainingSample sample;
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "slots are shared between processes");
+
+    std::string file_path;
+    void* base = nullptr;
+    size_t mapped_size = 0;
+    Header* header = nullptr;
+    Slot* slots = nullptr;
+    uint64_t slot_count = 0;
+
+    // Trainer state
+    float alpha;
+    std::mt19937_64 rng;
+    std::vector<double> tree;  // sum tree over p^alpha, leaves from tree_leaves on
+    size_t tree_leaves = 0;
+    double max_priority = 1.0;
+    uint64_t synced = 0;       // tickets given their initial priority
+
+    // Copies a finished record out of `slot`; false if it is empty or being written
+    bool read(uint64_t slot, TrainingSample& out) const;
+    void setPriority(uint64_t slot, double value);
+    // Gives records added since the last call the highest priority so far
+    void sync();
+};
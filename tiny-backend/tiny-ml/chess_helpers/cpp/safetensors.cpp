@@ -0,0 +1,278 @@
+#include "safetensors.h"
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// Just enough JSON for safetensors headers: objects, arrays, strings and integers
+class HeaderParser {
+public:
+    explicit HeaderParser(const std::string& text) : text(text), pos(0) {}
+
+    struct Entry {
+        std::string dtype;
+        std::vector<int64_t> shape;
+        uint64_t begin = 0, end = 0;
+    };
+
+    std::map<std::string, Entry> parse() {
+        std::map<std::string, Entry> entries;
+        expect('{');
+        if (peek() == '}') { pos++; return entries; }
+        while (true) {
+            std::string name = parseString();
+            expect(':');
+            if (name == "__metadata__") {
+                skipValue();
+            } else {
+                entries[name] = parseEntry();
+            }
+            if (peek() == ',') { pos++; continue; }
+            expect('}');
+            return entries;
+        }
+    }
+
+private:
+    const std::string& text;
+    size_t pos;
+
+    [[noreturn]] void fail(const std::string& what) const {
+        throw std::runtime_error("Malformed safetensors header at byte " + std::to_string(pos) + ": " + what);
+    }
+
+    char peek() {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) pos++;
+        if (pos >= text.size()) fail("unexpected end");
+        return text[pos];
+    }
+
+    void expect(char c) {
+        if (peek() != c) fail(std::string("expected '") + c + "'");
+        pos++;
+    }
+
+    std::string parseString() {
+        expect('"');
+        std::string out;
+        while (pos < text.size() && text[pos] != '"') {
+            if (text[pos] == '\\' && pos + 1 < text.size()) pos++;
+            out += text[pos++];
+        }
+        if (pos >= text.size()) fail("unterminated string");
+        pos++;
+        return out;
+    }
+
+    int64_t parseInt() {
+        peek();
+        size_t start = pos;
+        if (text[pos] == '-') pos++;
+        while (pos < text.size() && std::isdigit(static_cast<unsigned char>(text[pos]))) pos++;
+        if (start == pos) fail("expected a number");
+        return std::stoll(text.substr(start, pos - start));
+    }
+
+    std::vector<int64_t> parseIntArray() {
+        std::vector<int64_t> values;
+        expect('[');
+        if (peek() == ']') { pos++; return values; }
+        while (true) {
+            values.push_back(parseInt());
+            if (peek() == ',') { pos++; continue; }
+            expect(']');
+            return values;
+        }
+    }
+
+    Entry parseEntry() {
+        Entry entry;
+        expect('{');
+        while (true) {
+            std::string key = parseString();
+            expect(':');
+            if (key == "dtype") {
+                entry.dtype = parseString();
+            } else if (key == "shape") {
+                entry.shape = parseIntArray();
+            } else if (key == "data_offsets") {
+                std::vector<int64_t> offsets = parseIntArray();
+                if (offsets.size() != 2 || offsets[0] < 0 || offsets[1] < offsets[0]) fail("bad data_offsets");
+                entry.begin = static_cast<uint64_t>(offsets[0]);
+                entry.end = static_cast<uint64_t>(offsets[1]);
+            } else {
+                skipValue();
+            }
+            if (peek() == ',') { pos++; continue; }
+            expect('}');
+            return entry;
+        }
+    }
+
+    void skipValue() {
+        char c = peek();
+        if (c == '"') { parseString(); return; }
+        if (c == '{' || c == '[') {
+            char close = (c == '{') ? '}' : ']';
+            pos++;
+            if (peek() == close) { pos++; return; }
+            while (true) {
+                if (c == '{') { parseString(); expect(':'); }
+                skipValue();
+                if (peek() == ',') { pos++; continue; }
+                expect(close);
+                return;
+            }
+        }
+        // number, true, false or null
+        while (pos < text.size() && text[pos] != ',' && text[pos] != '}' && text[pos] != ']') pos++;
+    }
+};
+
+size_t dtypeSize(const std::string& dtype) {
+    if (dtype == "F32" || dtype == "I32") return 4;
+    if (dtype == "F16" || dtype == "BF16") return 2;
+    if (dtype == "I64") return 8;
+    throw std::runtime_error("Unsupported safetensors dtype: " + dtype);
+}
+
+} // namespace
+
+float halfToFloat(uint16_t h) {
+    uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1F;
+    uint32_t mantissa = h & 0x3FF;
+    uint32_t bits;
+    if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign;
+        } else {
+            // Subnormal: normalize the mantissa
+            exponent = 127 - 15 + 1;
+            while (!(mantissa & 0x400)) { mantissa <<= 1; exponent--; }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+        }
+    } else if (exponent == 0x1F) {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+    float out;
+    std::memcpy(&out, &bits, sizeof(out));
+    return out;
+}
+
+uint16_t floatToHalf(float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    uint32_t exponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if (exponent == 0xFF) return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+    int half_exponent = static_cast<int>(exponent) - 127 + 15;
+    if (half_exponent >= 0x1F) return sign | 0x7C00;
+    if (half_exponent <= 0) {
+        // Subnormal (or zero): shift the implicit bit in, rounding to nearest even
+        if (half_exponent < -10) return sign;
+        mantissa |= 0x800000;
+        int shift = 14 - half_exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) half++;
+        return sign | static_cast<uint16_t>(half);
+    }
+    uint32_t half = (static_cast<uint32_t>(half_exponent) << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFF;
+    // A carry out of the mantissa correctly bumps the exponent
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++;
+    return sign | static_cast<uint16_t>(half);
+}
+
+float bfloat16ToFloat(uint16_t h) {
+    uint32_t bits = static_cast<uint32_t>(h) << 16;
+    float out;
+    std::memcpy(&out, &bits, sizeof(out));
+    return out;
+}
+
+std::map<std::string, TensorData> SafeTensors::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot open safetensors file: " + path);
+
+    uint64_t header_size = 0;
+    in.read(reinterpret_cast<char*>(&header_size), sizeof(header_size));
+    if (!in || header_size > (100u << 20)) throw std::runtime_error("Bad safetensors header size: " + path);
+    std::string header(header_size, '\0');
+    in.read(&header[0], static_cast<std::streamsize>(header_size));
+    if (!in) throw std::runtime_error("Truncated safetensors header: " + path);
+
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    const std::string data = buffer.str();
+
+    std::map<std::string, TensorData> tensors;
+    for (const auto& [name, entry] : HeaderParser(header).parse()) {
+        size_t elem = dtypeSize(entry.dtype);
+        size_t count = 1;
+        for (int64_t dim : entry.shape) count *= static_cast<size_t>(dim);
+        if (entry.end > data.size() || entry.end - entry.begin != count * elem) {
+            throw std::runtime_error("Tensor " + name + " has inconsistent data_offsets in " + path);
+        }
+
+        TensorData tensor;
+        tensor.shape = entry.shape;
+        tensor.values.resize(count);
+        const char* src = data.data() + entry.begin;
+        for (size_t i = 0; i < count; i++) {
+            if (entry.dtype == "F32") {
+                std::memcpy(&tensor.values[i], src + 4 * i, 4);
+            } else if (entry.dtype == "I32") {
+                int32_t raw;
+                std::memcpy(&raw, src + 4 * i, 4);
+                tensor.values[i] = static_cast<float>(raw);
+            } else if (entry.dtype == "I64") {
+                int64_t raw;
+                std::memcpy(&raw, src + 8 * i, 8);
+                tensor.values[i] = static_cast<float>(raw);
+            } else {
+                uint16_t raw;
+                std::memcpy(&raw, src + 2 * i, 2);
+                tensor.values[i] = (entry.dtype == "F16") ? halfToFloat(raw) : bfloat16ToFloat(raw);
+            }
+        }
+        tensors.emplace(name, std::move(tensor));
+    }
+    return tensors;
+}
+
+void SafeTensors::save(const std::string& path, const std::map<std::string, TensorData>& tensors) {
+    std::string header = "{";
+    uint64_t offset = 0;
+    for (const auto& [name, tensor] : tensors) {
+        if (header.size() > 1) header += ",";
+        header += "\"" + name + "\":{\"dtype\":\"F32\",\"shape\":[";
+        for (size_t i = 0; i < tensor.shape.size(); i++) {
+            header += (i ? "," : "") + std::to_string(tensor.shape[i]);
+        }
+        uint64_t bytes = tensor.values.size() * sizeof(float);
+        header += "],\"data_offsets\":[" + std::to_string(offset) + "," + std::to_string(offset + bytes) + "]}";
+        offset += bytes;
+    }
+    header += "}";
+    // Pad the header so the data section stays 8-byte aligned, as safe_save does
+    while (header.size() % 8) header += ' ';
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) throw std::runtime_error("Cannot write safetensors file: " + path);
+    uint64_t header_size = header.size();
+    out.write(reinterpret_cast<const char*>(&header_size), sizeof(header_size));
+    out.write(header.data(), static_cast<std::streamsize>(header.size()));
+    for (const auto& [name, tensor] : tensors) {
+        out.write(reinterpret_cast<const char*>(tensor.values.data()),
+                  static_cast<std::streamsize>(tensor.values.size() * sizeof(float)));
+    }
+}
@@ -0,0 +1,29 @@
+// safetensors.h
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Reader for the .safetensors files tinygrad writes with safe_save: an 8-byte little-endian
+// header length, a JSON header mapping names to dtype/shape/data_offsets, then raw data.
+// Every tensor is converted to fp32 on load (F32, F16, BF16, and I32/I64 for BatchNorm's
+// num_batches_tracked).
+struct TensorData {
+    std::vector<int64_t> shape;
+    std::vector<float> values;
+
+    size_t numel() const { return values.size(); }
+};
+
+class SafeTensors {
+public:
+    // Throws std::runtime_error on I/O errors, malformed headers or unsupported dtypes
+    static std::map<std::string, TensorData> load(const std::string& path);
+    static void save(const std::string& path, const std::map<std::string, TensorData>& tensors);
+};
+
+float halfToFloat(uint16_t h);
+// Rounds to nearest even; overflow becomes infinity
+uint16_t floatToHalf(float f);
+float bfloat16ToFloat(uint16_t h);
@@ -0,0 +1,308 @@
+#include "search.h"
+#include "instrument.h"
+#include <algorithm>
+
+namespace {
+inline Piece::Color sideToMove(const ChessBitboard& board) {
+    return board.white_to_move ? Piece::Color::WHITE : Piece::Color::BLACK;
+}
+
+// Mate and tablebase scores are stored relative to the node, not the root
+inline int scoreToTable(int score, int ply) {
+    if (score >= Search::TB_WIN_SCORE - Search::MAX_PLY) return score + ply;
+    if (score <= -Search::TB_WIN_SCORE + Search::MAX_PLY) return score - ply;
+    return score;
+}
+
+inline int scoreFromTable(int score, int ply) {
+    if (score >= Search::TB_WIN_SCORE - Search::MAX_PLY) return score - ply;
+    if (score <= -Search::TB_WIN_SCORE + Search::MAX_PLY) return score + ply;
+    return score;
+}
+}
+
+void Search::clear() {
+    history.clear();
+    killers.clear();
+    tt.clear();
+}
+
+SearchResult Search::run(const ChessBitboard& board, int depth) {
+    return run(board, SearchLimits(), depth);
+}
+
+SearchResult Search::run(const ChessBitboard& board, const SearchLimits& limits, int depth) {
+    SearchResult result;
+    nodes = 0;
+    max_nodes = limits.nodes;
+    time.start(limits);
+    stop_requested = false;
+    stopped = false;
+    prev_pv.clear();
+    killers.clear();
+    tt.newSearch();
+    tb_hits = 0;
+    keys = game_history;
+    if (probeRoot(board, result)) {
+        result.time_ms = time.elapsedMs();
+        if (on_iteration) on_iteration(result);
+        return result;
+    }
+    if (network) accumulators.reset(network, board);
+
+    depth = std::min(depth, MAX_PLY - 1);
+    for (int d = 1; d <= depth; d++) {
+        int score = negamax(board, d, -INF, INF, 0);
+        if (stopped) {
+            // Keep the last completed iteration; a first one cut short still has a move
+            if (result.best_move.isNone() && pv_length[0] > 0) {
+                result.pv.assign(pv_table[0], pv_table[0] + pv_length[0]);
+                result.best_move = result.pv[0];
+            }
+            break;
+        }
+        if (pv_length[0] == 0) break; // no legal moves at the root
+
+        result.score = score;
+        result.depth = d;
+        result.pv.assign(pv_table[0], pv_table[0] + pv_length[0]);
+        result.best_move = result.pv[0];
+        prev_pv = result.pv;
+        if (on_iteration) {
+            result.nodes = nodes;
+            result.tb_hits = tb_hits;
+            result.time_ms = time.elapsedMs();
+            on_iteration(result);
+        }
+
+        // A forced mate will not change with more depth
+        if (score >= MATE_SCORE - MAX_PLY || score <= -MATE_SCORE + MAX_PLY) break;
+        // The next iteration takes several times as long as this one did
+        if (time.timed() && time.elapsedMs() * 2 >= time.optimumMs()) break;
+    }
+    result.nodes = nodes;
+    result.tb_hits = tb_hits;
+    result.time_ms = time.elapsedMs();
+    return result;
+}
+
+bool Search::probeRoot(const ChessBitboard& board, SearchResult& result) {
+    if (!tablebase || !tablebase->canProbe(board)) return false;
+    // Rank each move by the result it keeps under the 50-move rule: mates first, then
+    // wins that zero the counter soonest, draws, and losses that hold out longest
+    Move best;
+    int best_rank = 0;
+    for (const Move& move : board.generateLegalMoves()) {
+        ChessBitboard child = board;
+        child.makeMove(move);
+        int rank;
+        if (child.generateLegalMoves().empty()) {
+            rank = child.isInCheck(sideToMove(child)) ? 2000 : 0;
+        } else {
+            int dtz;
+            if (!tablebase->probeDtz(child, dtz)) return false;
+            int plies = std::abs(dtz) + child.halfmove_clock;
+            if (dtz < 0) {
+                rank = plies <= 100 ? 1000 - plies : 1;  // a cursed win still beats a draw
+            } else if (dtz > 0) {
+                rank = plies <= 100 ? -1000 + plies : -1;
+            } else {
+                rank = 0;
+            }
+        }
+        if (best.isNone() || rank > best_rank) {
+            best_rank = rank;
+            best = move;
+        }
+    }
+    if (best.isNone()) return false;
+    tb_hits++;
+    result.best_move = best;
+    result.score = best_rank > 1 ? TB_WIN_SCORE - 1 : best_rank < -1 ? -TB_WIN_SCORE + 1 : 0;
+    if (best_rank == 2000) result.score = MATE_SCORE - 1;
+    result.depth = 1;
+    result.tb_hits = tb_hits;
+    result.pv = {result.best_move};
+    return true;
+}
+
+bool Search::countNode() {
+    if (stopped) return true;
+    nodes++;
+    INSTRUMENT_COUNT(SEARCH_NODES, 1);
+    if ((nodes & 2047) == 0) {
+        if (stop_requested.load(std::memory_order_relaxed) || time.pastMaximum()) stopped = true;
+    }
+    if (max_nodes && nodes >= max_nodes) stopped = true;
+    return stopped;
+}
+
+int Search::evaluate(const ChessBitboard& board) {
+    int score = network ? accumulators.evaluate() : board.evaluate();
+    // Keep static scores clear of the mate range
+    return std::clamp(score, -TB_WIN_SCORE + MAX_PLY + 1, TB_WIN_SCORE - MAX_PLY - 1);
+}
+
+void Search::updatePv(int ply, const Move& move) {
+    pv_table[ply][ply] = move;
+    for (int i = ply + 1; i < pv_length[ply + 1]; i++) {
+        pv_table[ply][i] = pv_table[ply + 1][i];
+    }
+    pv_length[ply] = pv_length[ply + 1];
+}
+
+bool Search::isRepetition(const ChessBitboard& board) const {
+    // Same side to move, at least four plies back
+    int oldest = std::max(0, static_cast<int>(keys.size()) - board.halfmove_clock);
+    for (int i = static_cast<int>(keys.size()) - 4; i >= oldest; i -= 2) {
+        if (keys[i] == board.hash) return true;
+    }
+    return false;
+}
+
+int Search::negamax(const ChessBitboard& board, int depth, int alpha, int beta, int ply) {
+    pv_length[ply] = ply;
+    if (ply > 0 && isRepetition(board)) return 0;
+    Piece::Color us = sideToMove(board);
+    bool in_check = board.isInCheck(us);
+    if (in_check) depth++; // check extension
+
+    if (depth <= 0) return quiescence(board, alpha, beta, ply);
+    if (countNode()) return 0;
+
+    if (ply > 0 && (board.halfmove_clock >= 100 || board.hasInsufficientMaterial())) return 0;
+    if (ply >= MAX_PLY - 1) return evaluate(board);
+
+    Move hint = ply < static_cast<int>(prev_pv.size()) ? prev_pv[ply] : Move();
+    const TranspositionTable::Entry* entry = tt.probe(board.hash);
+    INSTRUMENT_COUNT(TT_PROBES, 1);
+    INSTRUMENT_COUNT(TT_HITS, entry != nullptr);
+    if (entry) {
+        Move tt_move = TranspositionTable::unpackMove(board, entry->move);
+        if (!tt_move.isNone()) hint = tt_move;
+        if (ply > 0 && beta - alpha == 1 && entry->depth >= depth) {
+            int score = scoreFromTable(entry->score, ply);
+            if (entry->bound == TranspositionTable::EXACT ||
+                (entry->bound == TranspositionTable::LOWER && score >= beta) ||
+                (entry->bound == TranspositionTable::UPPER && score <= alpha)) {
+                return score;
+            }
+        }
+    }
+    // Right after a capture or pawn move the tables give the exact result under the
+    // 50-move rule (cursed wins and blessed losses are draws)
+    if (tablebase && ply > 0 && board.halfmove_clock == 0 && tablebase->canProbe(board) &&
+        (depth >= tb_probe_depth || __builtin_popcountll(board.getAllPieces()) < tablebase->probeLimit())) {
+        Tablebase::WDL wdl;
+        if (tablebase->probeWdl(board, wdl)) {
+            tb_hits++;
+            INSTRUMENT_COUNT(TB_HITS, 1);
+            int score = wdl == Tablebase::WIN ? TB_WIN_SCORE - ply : wdl == Tablebase::LOSS ? -TB_WIN_SCORE + ply : 0;
+            tt.store(board.hash, std::min(depth + 6, MAX_PLY - 1), scoreToTable(score, ply), TranspositionTable::EXACT, Move());
+            return score;
+        }
+    }
+    MovePicker picker(board, hint, killers.moves[ply], &history);
+
+    int original_alpha = alpha;
+    int best_score = -INF;
+    Move best_move;
+    int legal = 0;
+    std::vector<Move> quiets_tried;
+    keys.push_back(board.hash);
+    for (Move move = picker.nextMove(); !move.isNone(); move = picker.nextMove()) {
+        ChessBitboard child = board;
+        child.makeMove(move);
+        if (child.isInCheck(us)) continue;
+        legal++;
+        if (network) accumulators.push(child);
+
+        int score;
+        if (legal == 1) {
+            score = -negamax(child, depth - 1, -beta, -alpha, ply + 1);
+        } else {
+            // Null window first; only re-search when the move might beat the PV
+            score = -negamax(child, depth - 1, -alpha - 1, -alpha, ply + 1);
+            if (score > alpha && score < beta) {
+                score = -negamax(child, depth - 1, -beta, -alpha, ply + 1);
+            }
+        }
+        if (network) accumulators.pop();
+        if (stopped) {
+            keys.pop_back();
+            return 0;
+        }
+
+        bool quiet = !board.isCapture(move) && !move.isPromotion();
+        if (score > best_score) {
+            best_score = score;
+            best_move = move;
+            if (score > alpha) {
+                alpha = score;
+                updatePv(ply, move);
+                if (alpha >= beta) {
+                    if (quiet) {
+                        int bonus = depth * depth;
+                        killers.update(ply, move);
+                        history.update(board.white_to_move, move, bonus);
+                        for (const Move& tried : quiets_tried) {
+                            history.update(board.white_to_move, tried, -bonus);
+                        }
+                    }
+                    break;
+                }
+            }
+        }
+        if (quiet) quiets_tried.push_back(move);
+    }
+    keys.pop_back();
+
+    if (legal == 0) return in_check ? -MATE_SCORE + ply : 0;
+    TranspositionTable::Bound bound = best_score >= beta ? TranspositionTable::LOWER
+                                    : best_score > original_alpha ? TranspositionTable::EXACT
+                                    : TranspositionTable::UPPER;
+    tt.store(board.hash, depth, scoreToTable(best_score, ply), bound,
+             bound == TranspositionTable::UPPER ? Move() : best_move);
+    return best_score;
+}
+
+int Search::quiescence(const ChessBitboard& board, int alpha, int beta, int ply) {
+    pv_length[ply] = ply;
+    if (countNode()) return 0;
+    if (ply >= MAX_PLY - 1) return evaluate(board);
+
+    Piece::Color us = sideToMove(board);
+    bool in_check = board.isInCheck(us);
+    int best_score = -INF;
+    if (!in_check) {
+        // Stand pat: the side to move is never forced to capture
+        best_score = evaluate(board);
+        if (best_score >= beta) return best_score;
+        if (best_score > alpha) alpha = best_score;
+    }
+
+    MovePicker picker(board, MovePicker::Quiescence{});
+    int legal = 0;
+    for (Move move = picker.nextMove(); !move.isNone(); move = picker.nextMove()) {
+        ChessBitboard child = board;
+        child.makeMove(move);
+        if (child.isInCheck(us)) continue;
+        legal++;
+        if (network) accumulators.push(child);
+
+        int score = -quiescence(child, -beta, -alpha, ply + 1);
+        if (network) accumulators.pop();
+        if (stopped) return 0;
+        if (score > best_score) {
+            best_score = score;
+            if (score > alpha) {
+                alpha = score;
+                updatePv(ply, move);
+                if (alpha >= beta) break;
+            }
+        }
+    }
+
+    if (in_check && legal == 0) return -MATE_SCORE + ply;
+    return best_score;
+}
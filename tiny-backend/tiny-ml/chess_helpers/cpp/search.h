@@ -0,0 +1,101 @@
+// search.h
+#pragma once
+#include "bitboard.h"
+#include "movepicker.h"
+#include "nnue.h"
+#include "tablebase.h"
+#include "timeman.h"
+#include "tt.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+struct SearchResult {
+    Move best_move;      // none if the root has no legal moves
+    int score = 0;       // centipawns for the side to move; mates are +/-(MATE_SCORE - plies),
+                         // tablebase wins +/-(TB_WIN_SCORE - plies)
+    int depth = 0;
+    uint64_t nodes = 0;
+    uint64_t tb_hits = 0;
+    int64_t time_ms = 0;
+    std::vector<Move> pv;
+};
+
+// Iterative-deepening principal variation search on top of the hand-crafted evaluation,
+// or an NNUE network once one is set.
+// Boards are copied per node (the engine has no unmake), moves come from MovePicker fed
+// with the transposition table (or previous iteration's PV) move, killers and history,
+// and leaves are resolved by a quiescence search over captures that do not lose material.
+// Table cutoffs are only taken at null-window nodes so the PV stays complete.
+// A position that repeats one earlier in the game or on the search path scores as a draw.
+// With a tablebase, positions it covers right after a capture or pawn move are scored
+// from it instead of searched, and a root it covers is played from the DTZ tables.
+// With limits, an iteration is only started while it is likely to finish before the
+// optimum time, and one that reaches the maximum time or node count is abandoned in
+// favour of the last completed one.
+class Search {
+public:
+    static constexpr int INF = 32001;
+    static constexpr int MATE_SCORE = 32000;
+    static constexpr int MAX_PLY = KillerTable::MAX_PLY;
+    // Tablebase wins rank below mates and above every evaluation
+    static constexpr int TB_WIN_SCORE = MATE_SCORE - 2 * MAX_PLY;
+
+    SearchResult run(const ChessBitboard& board, int depth);
+    SearchResult run(const ChessBitboard& board, const SearchLimits& limits, int depth = MAX_PLY - 1);
+    // Make a running search return as soon as possible (safe from another thread)
+    void stop() { stop_requested = true; }
+    // Evaluate leaves with `network` (nullptr = hand-crafted evaluation). Not owned.
+    void setNetwork(const NNUE::Network* network) { this->network = network; }
+    // Score tablebase positions from `tablebase` (nullptr = none). Positions with as many
+    // pieces as its probe limit are only probed with at least `probe_depth` plies left,
+    // smaller ones always. Not owned.
+    void setTablebase(const Tablebase* tablebase, int probe_depth = 1) {
+        this->tablebase = tablebase;
+        tb_probe_depth = probe_depth;
+    }
+    // Zobrist hashes of the game's positions before the root, oldest first, for repetition
+    // detection; kept for later searches until replaced
+    void setGameHistory(std::vector<uint64_t> hashes) { game_history = std::move(hashes); }
+    // Called after every completed iteration with the result so far, e.g. for UCI info lines
+    void setIterationCallback(std::function<void(const SearchResult&)> callback) { on_iteration = std::move(callback); }
+    // Resize (and clear) the transposition table
+    void setHashSize(size_t megabytes) { tt.resize(megabytes); }
+    int hashfull() const { return tt.hashfull(); }
+    // Forget history scores and the transposition table, e.g. between games
+    void clear();
+
+private:
+    KillerTable killers;
+    HistoryTable history;
+    TranspositionTable tt;
+    std::function<void(const SearchResult&)> on_iteration;
+    uint64_t nodes = 0;
+    uint64_t max_nodes = 0;
+    TimeManager time;
+    std::atomic<bool> stop_requested{false};
+    bool stopped = false;  // the current iteration was abandoned
+    const NNUE::Network* network = nullptr;
+    const Tablebase* tablebase = nullptr;
+    int tb_probe_depth = 1;
+    uint64_t tb_hits = 0;
+    NNUE::AccumulatorStack accumulators;
+    std::vector<Move> prev_pv;
+    std::vector<uint64_t> game_history;
+    std::vector<uint64_t> keys;  // game history, then the positions on the current search path
+    Move pv_table[MAX_PLY][MAX_PLY];
+    int pv_length[MAX_PLY];
+
+    // Fills `result` from the DTZ tables if they cover the root
+    bool probeRoot(const ChessBitboard& board, SearchResult& result);
+    int negamax(const ChessBitboard& board, int depth, int alpha, int beta, int ply);
+    int quiescence(const ChessBitboard& board, int alpha, int beta, int ply);
+    void updatePv(int ply, const Move& move);
+    // The position occurred before, since the last capture or pawn move
+    bool isRepetition(const ChessBitboard& board) const;
+    // Counts a node and checks the limits every few thousand; true once the search must stop
+    bool countNode();
+    // Static evaluation of the board on top of the accumulator stack
+    int evaluate(const ChessBitboard& board);
+};
@@ -0,0 +1,887 @@
+// server.cpp
+// Native HTTP/JSON move service (chess_engine_server, see build.sh) with the endpoints
+// and JSON schema of server.py: POST /api/move, POST /api/reset, GET /api/status, GET /.
+// One thread runs an epoll HTTP/1.1 loop (keep-alive, one request in flight per
+// connection) and queues /api/move requests for a pool of search workers, each running
+// MCTS for one game at a time. Every worker evaluates through one SharedBatchEvaluator,
+// so the leaves of concurrent games share network batches, and each merged batch goes
+// through an EvalCache (--cache-mb) so positions already scored by any game skip the network.
+// A request may carry a "game_id" to keep a search tree per game; without one they all
+// share a single game, like server.py. Positions in the --book opening book are answered
+// with a book move straight away.
+//
+//     ./chess_engine_server --port 8080 --workers 8 --weights models/chess_net_checkpoint.safetensors
+#include "bitboard.h"
+#include "book.h"
+#include "evalcache.h"
+#include "json.h"
+#include "mcts.h"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+constexpr const char* START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+constexpr size_t MAX_HEADER_BYTES = 16 << 10;
+constexpr size_t MAX_BODY_BYTES = 64 << 10;
+
+struct Options {
+    int port = 8080;
+    int workers = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    int simulations = 800;
+    int64_t movetime_ms = 0;       // default budget when a request has none; 0 = simulations only
+    size_t max_batch = 64;         // positions per shared network evaluation
+    int batch_window_us = 2000;    // longest a leaf waits for other games to fill a batch
+    size_t max_games = 1024;       // search trees kept, least recently used dropped first
+    size_t max_queue = 4096;       // waiting moves before requests are turned away with 503
+    std::string weights;           // ChessNet checkpoint; empty = hand-crafted evaluation
+    std::string book;              // Polyglot-layout opening book; empty = always search
+    size_t cache_mb = 256;         // evaluation cache shared by all games; 0 = none
+};
+
+// Evaluator decorator that merges concurrent evaluate() calls of several searches into
+// one call of `inner`. A batch is flushed once every participating search is waiting on
+// it, it holds max_batch positions, or its oldest caller has waited `window`.
+class SharedBatchEvaluator : public Evaluator {
+public:
+    SharedBatchEvaluator(Evaluator& inner, size_t max_batch, std::chrono::microseconds window)
+        : inner(inner), max_batch(std::max<size_t>(1, max_batch)), window(window) {}
+
+    // Bracket a search that may call evaluate()
+    void join();
+    void leave();
+    void evaluate(const std::vector<EvalRequest>& batch, std::vector<EvalResult>& results) override;
+
+    uint64_t batches() const { return batch_count; }
+    uint64_t positions() const { return position_count; }
+
+private:
+    struct Pending {
+        const std::vector<EvalRequest>* batch;
+        std::vector<EvalResult>* results;
+        bool done = false;
+        std::exception_ptr error;
+    };
+
+    Evaluator& inner;
+    size_t max_batch;
+    std::chrono::microseconds window;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<Pending*> waiting;
+    size_t waiting_positions = 0;
+    std::chrono::steady_clock::time_point oldest;
+    int participants = 0;
+    bool flushing = false;
+    std::vector<EvalRequest> combined;  // only touched by the flushing thread
+    std::vector<EvalResult> combined_results;
+    std::atomic<uint64_t> batch_count{0};
+    std::atomic<uint64_t> position_count{0};
+
+    bool full() const { return waiting_positions >= max_batch || static_cast<int>(waiting.size()) >= participants; }
+    void flush(std::unique_lock<std::mutex>& lock);
+};
+
+void SharedBatchEvaluator::join() {
+    std::lock_guard<std::mutex> lock(mutex);
+    participants++;
+}
+
+void SharedBatchEvaluator::leave() {
+    std::lock_guard<std::mutex> lock(mutex);
+    participants--;
+    // The searches still waiting may now be all there is
+    changed.notify_all();
+}
+
+void SharedBatchEvaluator::evaluate(const std::vector<EvalRequest>& batch, std::vector<EvalResult>& results) {
+    Pending pending{&batch, &results, false, nullptr};
+    std::unique_lock<std::mutex> lock(mutex);
+    if (waiting.empty()) oldest = std::chrono::steady_clock::now();
+    waiting.push_back(&pending);
+    waiting_positions += batch.size();
+    while (!pending.done) {
+        if (flushing) {
+            changed.wait(lock);
+        } else if (full() || std::chrono::steady_clock::now() >= oldest + window) {
+            flush(lock);
+        } else {
+            changed.wait_until(lock, oldest + window);
+        }
+    }
+    if (pending.error) std::rethrow_exception(pending.error);
+}
+
+void SharedBatchEvaluator::flush(std::unique_lock<std::mutex>& lock) {
+    std::vector<Pending*> taken;
+    taken.swap(waiting);
+    waiting_positions = 0;
+    flushing = true;
+    lock.unlock();
+
+    combined.clear();
+    for (const Pending* pending : taken) combined.insert(combined.end(), pending->batch->begin(), pending->batch->end());
+    std::exception_ptr error;
+    try {
+        inner.evaluate(combined, combined_results);
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    lock.lock();
+    size_t offset = 0;
+    for (Pending* pending : taken) {
+        size_t count = pending->batch->size();
+        if (error) {
+            pending->error = error;
+        } else {
+            pending->results->assign(combined_results.begin() + offset, combined_results.begin() + offset + count);
+        }
+        offset += count;
+        pending->done = true;
+    }
+    batch_count++;
+    position_count += combined.size();
+    flushing = false;
+    changed.notify_all();
+}
+
+// One game's search tree and the position after our last move in it
+struct Game {
+    explicit Game(const ChessBitboard& prototype) : after_move(prototype) {}
+
+    std::mutex mutex;
+    std::unique_ptr<MCTS> mcts;
+    ChessBitboard after_move;
+    bool has_move = false;
+    std::string fen = START_FEN;  // latest position, for /api/status
+    uint64_t last_used = 0;
+};
+
+// Games by id, dropping the least recently used beyond max_games (a game being searched
+// lives on until its worker is done with it)
+class GameTable {
+public:
+    GameTable(const ChessBitboard& prototype, size_t max_games) : prototype(prototype), max_games(max_games) {}
+
+    std::shared_ptr<Game> acquire(const std::string& id);
+    void erase(const std::string& id);
+    std::string fen(const std::string& id);
+    size_t size();
+
+private:
+    const ChessBitboard& prototype;
+    size_t max_games;
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<Game>> games;
+    uint64_t clock = 0;
+};
+
+std::shared_ptr<Game> GameTable::acquire(const std::string& id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<Game>& game = games[id];
+    if (!game) {
+        game = std::make_shared<Game>(prototype);
+        if (games.size() > max_games) {
+            auto victim = games.end();
+            for (auto it = games.begin(); it != games.end(); ++it) {
+                if (it->first != id && (victim == games.end() || it->second->last_used < victim->second->last_used)) victim = it;
+            }
+            if (victim != games.end()) games.erase(victim);
+        }
+    }
+    std::shared_ptr<Game> acquired = games[id];
+    acquired->last_used = ++clock;
+    return acquired;
+}
+
+void GameTable::erase(const std::string& id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    games.erase(id);
+}
+
+std::string GameTable::fen(const std::string& id) {
+    std::shared_ptr<Game> game;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = games.find(id);
+        if (it == games.end()) return START_FEN;
+        game = it->second;
+    }
+    std::lock_guard<std::mutex> lock(game->mutex);
+    return game->fen;
+}
+
+size_t GameTable::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return games.size();
+}
+
+struct HttpRequest {
+    std::string method;
+    std::string path;
+    std::string body;
+    bool keep_alive = true;
+};
+
+struct HttpResponse {
+    int status = 200;
+    std::string body;
+};
+
+// Parses one request from the front of `buffer`. Returns 0 while incomplete, the bytes
+// consumed once complete, or -status for a request to reject (and close on).
+long parseRequest(const std::string& buffer, HttpRequest& request) {
+    size_t header_end = buffer.find("\r\n\r\n");
+    if (header_end == std::string::npos) return buffer.size() > MAX_HEADER_BYTES ? -431 : 0;
+
+    size_t line_end = buffer.find("\r\n");
+    std::string line = buffer.substr(0, line_end);
+    size_t first_space = line.find(' ');
+    size_t second_space = line.find(' ', first_space + 1);
+    if (first_space == std::string::npos || second_space == std::string::npos) return -400;
+    request.method = line.substr(0, first_space);
+    request.path = line.substr(first_space + 1, second_space - first_space - 1);
+    request.path = request.path.substr(0, request.path.find('?'));
+    std::string version = line.substr(second_space + 1);
+    request.keep_alive = version == "HTTP/1.1";
+
+    size_t content_length = 0;
+    for (size_t pos = line_end + 2; pos < header_end;) {
+        size_t end = buffer.find("\r\n", pos);
+        std::string header = buffer.substr(pos, end - pos);
+        pos = end + 2;
+        size_t colon = header.find(':');
+        if (colon == std::string::npos) continue;
+        std::string name = header.substr(0, colon);
+        std::string value = header.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+        if (name == "content-length") {
+            char* end_ptr = nullptr;
+            content_length = std::strtoull(value.c_str(), &end_ptr, 10);
+            if (end_ptr == value.c_str()) return -400;
+        } else if (name == "connection") {
+            if (value == "close") request.keep_alive = false;
+            if (value == "keep-alive") request.keep_alive = true;
+        } else if (name == "transfer-encoding") {
+            return -411;  // chunked bodies are not supported; send Content-Length
+        }
+    }
+    if (content_length > MAX_BODY_BYTES) return -413;
+    size_t total = header_end + 4 + content_length;
+    if (buffer.size() < total) return 0;
+    request.body = buffer.substr(header_end + 4, content_length);
+    return static_cast<long>(total);
+}
+
+const char* statusText(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 411: return "Length Required";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default:  return "Error";
+    }
+}
+
+std::string serialize(const HttpResponse& response, bool keep_alive) {
+    std::string head = "HTTP/1.1 " + std::to_string(response.status) + " " + statusText(response.status) + "\r\n";
+    // Same cross-origin policy as flask_cors in server.py
+    head += "Access-Control-Allow-Origin: *\r\n";
+    if (response.status == 204) {
+        head += "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\nAccess-Control-Allow-Headers: Content-Type\r\n";
+    } else {
+        head += "Content-Type: application/json\r\n";
+    }
+    head += "Content-Length: " + std::to_string(response.body.size()) + "\r\n";
+    head += keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    return head + response.body;
+}
+
+HttpResponse errorResponse(int status, const std::string& error, const std::string& message = "") {
+    std::string body = "{\"error\": " + json::quote(error);
+    if (!message.empty()) body += ", \"message\": " + json::quote(message);
+    return {status, body + "}"};
+}
+
+std::string squareName(Square square) {
+    return {static_cast<char>('a' + square % 8), static_cast<char>('1' + square / 8)};
+}
+
+const char* boolText(bool value) { return value ? "true" : "false"; }
+
+struct MoveJob {
+    uint64_t connection;
+    int fd;
+    bool keep_alive;
+    std::string game_id;
+    std::string fen;
+    SearchLimits limits;
+};
+
+struct Completion {
+    uint64_t connection;
+    int fd;
+    std::string data;
+    bool close;
+};
+
+class MoveServer {
+public:
+    MoveServer(const Options& options, Evaluator& evaluator);
+    // Serves until SIGINT/SIGTERM
+    void run();
+    void requestStop();
+
+private:
+    struct Connection {
+        uint64_t id;
+        std::string in;
+        std::string out;
+        bool busy = false;         // a move is with the workers; later requests wait
+        bool close_after = false;  // close once `out` is written
+        bool writing = false;      // registered for EPOLLOUT
+        bool eof = false;          // the client shut down its side; no longer registered for EPOLLIN
+    };
+
+    const Options options;
+    ChessBitboard prototype;  // copied instead of constructing boards (which rebuilds tables)
+    std::unique_ptr<OpeningBook> book;
+    EvalCache cache;
+    CachedEvaluator cached;    // only called by the thread flushing a shared batch
+    SharedBatchEvaluator evaluator;
+    GameTable games;
+
+    int listen_fd = -1;
+    int epoll_fd = -1;
+    int wake_fd = -1;
+    std::atomic<bool> stopping{false};
+    std::unordered_map<int, Connection> connections;
+    uint64_t next_connection = 1;
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_changed;
+    std::deque<MoveJob> jobs;
+    std::vector<std::thread> workers;
+
+    std::mutex completion_mutex;
+    std::vector<Completion> completions;
+
+    // Searches in progress, so shutdown can halt them instead of waiting them out
+    std::mutex searching_mutex;
+    std::unordered_set<MCTS*> searching;
+    std::atomic<int> live_workers{0};
+
+    std::atomic<uint64_t> moves_served{0};
+
+    void listen();
+    void accept();
+    void read(int fd);
+    void process(int fd);
+    void write(int fd);
+    void close(int fd);
+    void drainCompletions();
+    HttpResponse route(int fd, Connection& connection, const HttpRequest& request, bool& queued);
+
+    void work();
+    HttpResponse move(const MoveJob& job);
+};
+
+MoveServer::MoveServer(const Options& options, Evaluator& inner)
+    : options(options),
+      cache(options.cache_mb << 20),
+      cached(inner, cache),
+      evaluator(options.cache_mb ? static_cast<Evaluator&>(cached) : inner, options.max_batch,
+                std::chrono::microseconds(options.batch_window_us)),
+      games(prototype, options.max_games) {
+    prototype.setStartingPosition();
+    if (!options.book.empty()) book = std::make_unique<OpeningBook>(options.book);
+}
+
+void MoveServer::requestStop() {
+    stopping = true;
+    uint64_t one = 1;
+    if (wake_fd >= 0 && ::write(wake_fd, &one, sizeof(one)) < 0) {}
+}
+
+void MoveServer::listen() {
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+    int on = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(static_cast<uint16_t>(options.port));
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(listen_fd, SOMAXCONN) < 0) {
+        throw std::runtime_error("Cannot listen on port " + std::to_string(options.port) + ": " + std::strerror(errno));
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || wake_fd < 0) throw std::runtime_error(std::string("epoll: ") + std::strerror(errno));
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = listen_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+    event.data.fd = wake_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+}
+
+void MoveServer::run() {
+    listen();
+    live_workers = options.workers;
+    for (int i = 0; i < options.workers; i++) workers.emplace_back(&MoveServer::work, this);
+
+    std::vector<epoll_event> events(256);
+    while (!stopping) {
+        int count = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), 1000);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            uint32_t flags = events[i].events;
+            if (fd == listen_fd) {
+                accept();
+            } else if (fd == wake_fd) {
+                uint64_t value;
+                while (::read(wake_fd, &value, sizeof(value)) > 0) {}
+                drainCompletions();
+            } else {
+                if (flags & (EPOLLERR | EPOLLHUP)) {
+                    close(fd);
+                    continue;
+                }
+                if (flags & EPOLLIN) read(fd);
+                if ((flags & EPOLLOUT) && connections.count(fd)) write(fd);
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        jobs.clear();
+    }
+    queue_changed.notify_all();
+    // A stop that lands just before a search starts is lost, so keep halting until every
+    // worker has returned
+    while (live_workers > 0) {
+        {
+            std::lock_guard<std::mutex> lock(searching_mutex);
+            for (MCTS* search : searching) search->stop();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    for (std::thread& worker : workers) worker.join();
+    while (!connections.empty()) close(connections.begin()->first);
+    ::close(listen_fd);
+    ::close(wake_fd);
+    ::close(epoll_fd);
+}
+
+void MoveServer::accept() {
+    for (;;) {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;  // EAGAIN, or a connection that went away while queued
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.fd = fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+        Connection& connection = connections[fd];
+        connection = Connection();
+        connection.id = next_connection++;
+    }
+}
+
+void MoveServer::read(int fd) {
+    auto it = connections.find(fd);
+    if (it == connections.end()) return;
+    char buffer[16384];
+    for (;;) {
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            it->second.in.append(buffer, static_cast<size_t>(received));
+            continue;
+        }
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (received < 0 && errno == EINTR) continue;
+        if (received < 0) {
+            close(fd);
+            return;
+        }
+        // The client is done sending but may still read: answer what it sent, then close.
+        // Stop watching for input, which would otherwise stay readable.
+        it->second.eof = true;
+        epoll_event event{};
+        event.events = it->second.writing ? static_cast<uint32_t>(EPOLLOUT) : 0u;
+        event.data.fd = fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
+        break;
+    }
+    process(fd);
+}
+
+void MoveServer::process(int fd) {
+    Connection& connection = connections[fd];
+    while (!connection.busy && !connection.close_after && !connection.in.empty()) {
+        HttpRequest request;
+        long consumed = parseRequest(connection.in, request);
+        if (consumed == 0) break;
+        if (consumed < 0) {
+            int status = static_cast<int>(-consumed);
+            connection.out += serialize(errorResponse(status, statusText(status)), false);
+            connection.close_after = true;
+            break;
+        }
+        connection.in.erase(0, static_cast<size_t>(consumed));
+        bool queued = false;
+        HttpResponse response = route(fd, connection, request, queued);
+        if (queued) {
+            connection.busy = true;
+            break;
+        }
+        connection.out += serialize(response, request.keep_alive);
+        if (!request.keep_alive) connection.close_after = true;
+    }
+    // Nothing more will arrive to complete a partial request
+    if (connection.eof && !connection.busy) connection.close_after = true;
+    write(fd);
+}
+
+void MoveServer::write(int fd) {
+    auto it = connections.find(fd);
+    if (it == connections.end()) return;
+    Connection& connection = it->second;
+    while (!connection.out.empty()) {
+        ssize_t sent = send(fd, connection.out.data(), connection.out.size(), MSG_NOSIGNAL);
+        if (sent > 0) {
+            connection.out.erase(0, static_cast<size_t>(sent));
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        close(fd);
+        return;
+    }
+
+    bool pending = !connection.out.empty();
+    if (pending != connection.writing) {
+        epoll_event event{};
+        event.events = (connection.eof ? 0u : static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP)) |
+                       (pending ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+        event.data.fd = fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
+        connection.writing = pending;
+    }
+    if (!pending && connection.close_after) close(fd);
+}
+
+void MoveServer::close(int fd) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    connections.erase(fd);
+}
+
+void MoveServer::drainCompletions() {
+    std::vector<Completion> done;
+    {
+        std::lock_guard<std::mutex> lock(completion_mutex);
+        done.swap(completions);
+    }
+    for (Completion& completion : done) {
+        auto it = connections.find(completion.fd);
+        // The client may have gone, and its descriptor been reused, while we searched
+        if (it == connections.end() || it->second.id != completion.connection) continue;
+        Connection& connection = it->second;
+        connection.out += completion.data;
+        connection.busy = false;
+        if (completion.close) connection.close_after = true;
+        process(completion.fd);
+    }
+}
+
+HttpResponse MoveServer::route(int fd, Connection& connection, const HttpRequest& request, bool& queued) {
+    if (request.method == "OPTIONS") return {204, ""};
+
+    std::map<std::string, std::string> fields;
+    if (request.method == "POST" && !request.body.empty() && !json::parseObject(request.body, fields)) {
+        return errorResponse(400, "Invalid JSON body");
+    }
+    auto field = [&](const char* name) {
+        auto it = fields.find(name);
+        return it == fields.end() || it->second == "null" ? std::string() : it->second;
+    };
+    auto number = [&](const char* name) { return std::strtoll(field(name).c_str(), nullptr, 10); };
+
+    if (request.path == "/api/move" && request.method == "POST") {
+        std::string fen = field("fen");
+        if (fen.empty()) return errorResponse(400, "FEN string is required");
+        MoveJob job{connection.id, fd, request.keep_alive, field("game_id"), fen, SearchLimits()};
+        job.limits.movetime_ms = number("movetime_ms");
+        job.limits.time_left_ms = number("time_left_ms");
+        job.limits.increment_ms = number("increment_ms");
+        job.limits.moves_to_go = static_cast<int>(number("moves_to_go"));
+        if (!job.limits.timed()) job.limits.movetime_ms = options.movetime_ms;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            if (jobs.size() >= options.max_queue) return errorResponse(503, "Server busy", "Too many moves waiting; retry later");
+            jobs.push_back(std::move(job));
+        }
+        queue_changed.notify_one();
+        queued = true;
+        return {};
+    }
+    if (request.path == "/api/reset" && request.method == "POST") {
+        games.erase(field("game_id"));
+        return {200, "{\"message\": \"Game reset successfully\", \"fen\": " + json::quote(START_FEN) + "}"};
+    }
+    if (request.path == "/api/status" && request.method == "GET") {
+        uint64_t batches = evaluator.batches(), positions = evaluator.positions();
+        size_t queued_moves;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            queued_moves = jobs.size();
+        }
+        char mean_batch[32], hit_rate[32];
+        std::snprintf(mean_batch, sizeof(mean_batch), "%.2f", batches ? static_cast<double>(positions) / batches : 0.0);
+        EvalCache::Stats cache_stats = cache.stats();
+        uint64_t lookups = cache_stats.hits + cache_stats.misses;
+        std::snprintf(hit_rate, sizeof(hit_rate), "%.4f", lookups ? static_cast<double>(cache_stats.hits) / lookups : 0.0);
+        return {200, "{\"status\": \"running\", \"message\": \"Chess bot server is active\", \"current_fen\": " +
+                     json::quote(games.fen("")) + ", \"games\": " + std::to_string(games.size()) +
+                     ", \"workers\": " + std::to_string(options.workers) + ", \"queued_moves\": " + std::to_string(queued_moves) +
+                     ", \"moves_served\": " + std::to_string(moves_served.load()) +
+                     ", \"evaluation_batches\": " + std::to_string(batches) + ", \"mean_batch\": " + mean_batch +
+                     ", \"cache_entries\": " + std::to_string(cache_stats.entries) + ", \"cache_hit_rate\": " + hit_rate + "}"};
+    }
+    if (request.path == "/" && request.method == "GET") {
+        return {200, "{\"message\": \"Chess Bot Backend Server\", \"status\": \"running\", \"endpoints\": {"
+                     "\"POST /api/move\": \"Submit a move and get AI response\", "
+                     "\"POST /api/reset\": \"Reset the game\", "
+                     "\"GET /api/status\": \"Get server status\"}}"};
+    }
+    return errorResponse(404, "Not found", request.method + " " + request.path);
+}
+
+void MoveServer::work() {
+    for (;;) {
+        MoveJob job;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_changed.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping) {
+                live_workers--;
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        HttpResponse response;
+        try {
+            response = move(job);
+        } catch (const std::exception& e) {
+            response = errorResponse(500, "Server error", e.what());
+        }
+        {
+            std::lock_guard<std::mutex> lock(completion_mutex);
+            completions.push_back({job.connection, job.fd, serialize(response, job.keep_alive), !job.keep_alive});
+        }
+        uint64_t one = 1;
+        if (::write(wake_fd, &one, sizeof(one)) < 0) {}
+    }
+}
+
+HttpResponse MoveServer::move(const MoveJob& job) {
+    ChessBitboard board = prototype;
+    // Untrusted input: checked before it touches the board
+    if (!board.tryLoadFen(job.fen)) return errorResponse(400, "Invalid FEN", job.fen);
+    Piece::Color them = board.white_to_move ? Piece::Color::BLACK : Piece::Color::WHITE;
+    if (board.isInCheck(them)) return errorResponse(400, "Invalid FEN", job.fen);
+
+    std::shared_ptr<Game> game = games.acquire(job.game_id);
+    std::lock_guard<std::mutex> lock(game->mutex);
+    game->fen = job.fen;
+    if (board.isGameOver()) return {200, "{\"message\": \"Game is over\", \"game_over\": true}"};
+
+    // Positions in the book are answered without a search
+    Move best;
+    if (book) {
+        static thread_local std::mt19937_64 rng(std::random_device{}());
+        best = book->pick(board, rng);
+    }
+    if (best.isNone()) {
+        if (!game->mcts) {
+            MCTSConfig config;
+            config.num_simulations = options.simulations;
+            config.dirichlet_epsilon = 0.0f;
+            config.early_stop = true;
+            game->mcts = std::make_unique<MCTS>(evaluator, config);
+        }
+        // The network also sees the position before the opponent's reply when we know it
+        const ChessBitboard* previous = nullptr;
+        if (game->has_move) {
+            for (const Move& reply : game->after_move.generateLegalMoves()) {
+                ChessBitboard child = game->after_move;
+                child.makeMove(reply);
+                if (child.samePosition(board)) {
+                    previous = &game->after_move;
+                    break;
+                }
+            }
+        }
+
+        MCTS* search = game->mcts.get();
+        {
+            std::lock_guard<std::mutex> lock(searching_mutex);
+            searching.insert(search);
+        }
+        evaluator.join();
+        MCTSResult result;
+        try {
+            result = search->search(board, previous, job.limits);
+        } catch (...) {
+            evaluator.leave();
+            std::lock_guard<std::mutex> lock(searching_mutex);
+            searching.erase(search);
+            throw;
+        }
+        evaluator.leave();
+        {
+            std::lock_guard<std::mutex> lock(searching_mutex);
+            searching.erase(search);
+        }
+        if (result.best_move.isNone()) {
+            return {200, "{\"message\": \"Game is over or AI has no legal moves.\", \"game_over\": true}"};
+        }
+        best = result.best_move;
+    }
+    board.makeMove(best);
+    game->after_move = board;
+    game->has_move = true;
+    game->fen = board.toFen();
+    moves_served++;
+
+    const char* promotion = nullptr;
+    switch (best.getPromotionType()) {
+        case Piece::Type::QUEEN:  promotion = "\"q\""; break;
+        case Piece::Type::ROOK:   promotion = "\"r\""; break;
+        case Piece::Type::BISHOP: promotion = "\"b\""; break;
+        case Piece::Type::KNIGHT: promotion = "\"n\""; break;
+        default: break;
+    }
+    bool no_moves = board.generateLegalMoves().empty();
+    bool check = board.isInCheck(them);
+    bool checkmate = check && no_moves;
+    bool stalemate = !check && no_moves;
+    std::string result_text = "null";
+    if (checkmate) result_text = board.white_to_move ? "\"Checkmate! Black wins!\"" : "\"Checkmate! White wins!\"";
+    if (stalemate) result_text = "\"Stalemate! Game is a draw.\"";
+
+    return {200, "{\"next_move\": {\"from\": \"" + squareName(best.getFrom()) + "\", \"to\": \"" + squareName(best.getTo()) +
+                 "\", \"promotion\": " + (promotion ? promotion : "null") + "}, \"message\": \"AI move successful\", " +
+                 "\"new_fen\": " + json::quote(game->fen) + ", \"game_state\": {\"is_check\": " + boolText(check) +
+                 ", \"is_checkmate\": " + boolText(checkmate) + ", \"is_stalemate\": " + boolText(stalemate) +
+                 ", \"is_game_over\": " + boolText(checkmate || stalemate) + ", \"result\": " + result_text +
+                 ", \"turn\": \"" + (board.white_to_move ? "white" : "black") + "\"}}"};
+}
+
+MoveServer* running_server = nullptr;
+
+void onSignal(int) {
+    if (running_server) running_server->requestStop();
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc) return false;
+        std::string value = argv[++i];
+        try {
+            if (flag == "--port") options.port = std::stoi(value);
+            else if (flag == "--workers") options.workers = std::max(1, std::stoi(value));
+            else if (flag == "--sims") options.simulations = std::max(1, std::stoi(value));
+            else if (flag == "--movetime") options.movetime_ms = std::stoll(value);
+            else if (flag == "--max-batch") options.max_batch = std::stoul(value);
+            else if (flag == "--batch-window-us") options.batch_window_us = std::stoi(value);
+            else if (flag == "--max-games") options.max_games = std::stoul(value);
+            else if (flag == "--max-queue") options.max_queue = std::stoul(value);
+            else if (flag == "--weights") options.weights = value;
+            else if (flag == "--book") options.book = value;
+            else if (flag == "--cache-mb") options.cache_mb = std::stoul(value);
+            else return false;
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: " << argv[0] << " [--port 8080] [--workers N] [--sims 800] [--movetime MS] [--max-batch 64]\n"
+                     "       [--batch-window-us 2000] [--max-games 1024] [--max-queue 4096] [--weights checkpoint.safetensors]\n"
+                     "       [--book book.bin] [--cache-mb 256]\n";
+        return 2;
+    }
+
+    std::unique_ptr<Evaluator> evaluator;
+    try {
+        if (options.weights.empty()) {
+            evaluator = std::make_unique<HandcraftedEvaluator>();
+        } else {
+            evaluator = std::make_unique<NetworkEvaluator>(options.weights);
+        }
+        MoveServer server(options, *evaluator);
+        running_server = &server;
+        std::signal(SIGINT, onSignal);
+        std::signal(SIGTERM, onSignal);
+        std::cout << "Serving on http://0.0.0.0:" << options.port << " with " << options.workers << " workers, "
+                  << (options.weights.empty() ? "hand-crafted evaluation" : "ChessNet " + options.weights) << std::endl;
+        server.run();
+        running_server = nullptr;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
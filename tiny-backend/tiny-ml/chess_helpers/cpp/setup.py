@@ -1,21 +1,104 @@
-from pybind11.setup_helpers import Pybind11Extension, build_ext
+import os
+import platform
+
+from pybind11.setup_helpers import ParallelCompile, Pybind11Extension, build_ext, has_flag
 from setuptools import setup
 
-ext_modules = [
-    Pybind11Extension(
-        "chess_engine",
-        [
-            "magicmoves.cpp",         # Renamed from .c to .cpp
-            "bitboard.cpp",
-            "python_bindings.cpp"
-        ],
-        cxx_std=17,
-        define_macros=[("MINIMIZE_MAGIC", None)],  # Use compact magic tables
-    ),
+sources = [
+    "magicmoves.cpp",         # Renamed from .c to .cpp
+    "bitboard.cpp",
+    "zobrist.cpp",
+    "movepicker.cpp",
+    "evaluate.cpp",
+    "search.cpp",
+    "timeman.cpp",
+    "tt.cpp",
+    "nnue.cpp",
+    "safetensors.cpp",
+    "gemm.cpp",
+    "chessnet.cpp",
+    "chessnet_int8.cpp",
+    "mcts.cpp",
+    "evalcache.cpp",
+    "tablebase.cpp",
+    "book.cpp",
+    "pgn.cpp",
+    "shards.cpp",
+    "replay.cpp",
+    "instrument.cpp",
+    "python_bindings.cpp"
 ]
 
+define_macros = [("MINIMIZE_MAGIC", None)]  # Use compact magic tables
+# CHESS_INSTRUMENT=1 compiles in the hot-path counters and timers (instrument.h)
+if os.environ.get("CHESS_INSTRUMENT") == "1":
+    define_macros.append(("CHESS_INSTRUMENT", None))
+
+# The extension is built once per CPU level as _chess_engine_<variant>; chess_engine.py
+# imports the best one the running CPU supports. CHESS_VARIANTS=v3 (comma-separated)
+# builds a subset, e.g. for quicker development builds.
+VARIANT_FLAGS = {
+    "generic": [],
+    "v2": ["-march=x86-64-v2"],  # SSE4.2, POPCNT
+    "v3": ["-march=x86-64-v3"],  # AVX2, BMI2, FMA, F16C
+    "v4": ["-march=x86-64-v4"],  # AVX-512
+}
+x86 = platform.machine().lower() in ("x86_64", "amd64")
+variants = os.environ.get("CHESS_VARIANTS", "generic,v2,v3,v4" if x86 else "generic")
+variants = [variant.strip() for variant in variants.split(",") if variant.strip()]
+
+# Profile-guided optimisation, driven by pgo.sh: CHESS_PGO=generate builds instrumented
+# variants, CHESS_PGO=use rebuilds them with the profiles recorded in pgo-data/<variant>
+pgo = os.environ.get("CHESS_PGO", "")
+
+
+def extension(variant):
+    name = "_chess_engine_" + variant
+    flags = ["-O3", "-flto=auto"] + VARIANT_FLAGS[variant]
+    profile = os.path.abspath(os.path.join("pgo-data", variant))
+    if pgo == "generate":
+        flags += ["-fprofile-generate=" + profile, "-fprofile-update=atomic"]
+    elif pgo == "use":
+        flags += ["-fprofile-use=" + profile, "-fprofile-correction", "-Wno-missing-profile"]
+    return Pybind11Extension(
+        name,
+        sources,
+        cxx_std=17,
+        define_macros=define_macros + [("CHESS_ENGINE_MODULE", name)],
+        extra_compile_args=flags,
+        extra_link_args=flags,
+    )
+
+
+class VariantBuild(build_ext):
+    """Skips variants the compiler cannot target and compiles each variant into its own
+    directory, so their objects (and PGO profiles) never mix."""
+
+    def build_extensions(self):
+        buildable = []
+        for ext in self.extensions:
+            march = [flag for flag in ext.extra_compile_args if flag.startswith("-march=")]
+            if march and not has_flag(self.compiler, march[0]):
+                print(f"skipping {ext.name}: the compiler does not support {march[0]}")
+                continue
+            buildable.append(ext)
+        self.extensions = buildable
+        super().build_extensions()
+
+    def build_extension(self, ext):
+        build_temp = self.build_temp
+        self.build_temp = os.path.join(build_temp, ext.name)
+        try:
+            super().build_extension(ext)
+        finally:
+            self.build_temp = build_temp
+
+
+# Compile each variant's sources in parallel (CHESS_BUILD_JOBS, default: every core)
+ParallelCompile("CHESS_BUILD_JOBS").install()
+
 setup(
     name="chess_engine",
-    ext_modules=ext_modules,
-    cmdclass={"build_ext": build_ext},
-)
\ No newline at end of file
+    ext_modules=[extension(variant) for variant in variants],
+    cmdclass={"build_ext": VariantBuild},
+)
@@ -0,0 +1,374 @@
+// shards.cpp
+#include "shards.h"
+#include "bitmasks.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+constexpr char MAGIC[8] = {'C', 'H', 'S', 'H', 'A', 'R', 'D', '1'};
+constexpr size_t HEADER_SIZE = 24;
+
+void fillBitboards(const ChessBitboard& board, uint64_t* out) {
+    const Bitboard bitboards[12] = {
+        board.white_pawns, board.white_knights, board.white_bishops, board.white_rooks, board.white_queens, board.white_king,
+        board.black_pawns, board.black_knights, board.black_bishops, board.black_rooks, board.black_queens, board.black_king,
+    };
+    std::copy(bitboards, bitboards + 12, out);
+}
+
+// Keeps the MAX_POLICY heaviest moves of a dense distribution, weights out of 65535
+void sparsePolicy(const float* policy, TrainingSample& sample) {
+    std::pair<float, uint16_t> moves[ChessNet::POLICY_SIZE];
+    int count = 0;
+    for (int i = 0; i < ChessNet::POLICY_SIZE; i++) {
+        if (policy[i] > 0.0f) moves[count++] = {policy[i], static_cast<uint16_t>(i)};
+    }
+    if (count > TrainingSample::MAX_POLICY) {
+        std::nth_element(moves, moves + TrainingSample::MAX_POLICY - 1, moves + count,
+                         [](const auto& a, const auto& b) { return a.first > b.first; });
+        count = TrainingSample::MAX_POLICY;
+    }
+    float total = 0.0f;
+    for (int i = 0; i < count; i++) total += moves[i].first;
+    sample.policy_size = static_cast<uint8_t>(count);
+    for (int i = 0; i < count; i++) {
+        sample.policy_index[i] = moves[i].second;
+        sample.policy_weight[i] = static_cast<uint16_t>(std::lround(moves[i].first / total * 65535.0f));
+    }
+}
+
+void onePolicy(int index, TrainingSample& sample) {
+    sample.policy_size = 1;
+    sample.policy_index[0] = static_cast<uint16_t>(index);
+    sample.policy_weight[0] = 65535;
+}
+
+// Index of <prefix>-NNNNN.shard, -1 for any other name
+long shardNumber(const std::string& name, const std::string& prefix) {
+    const std::string suffix = ".shard";
+    if (name.size() <= prefix.size() + 1 + suffix.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+        name[prefix.size()] != '-' || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+        return -1;
+    }
+    std::string digits = name.substr(prefix.size() + 1, name.size() - prefix.size() - 1 - suffix.size());
+    if (!std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; })) return -1;
+    return std::stol(digits);
+}
+
+} // namespace
+
+void TrainingSample::encodePlanes(float* planes) const {
+    for (int h = 0; h < HISTORY; h++) {
+        for (int p = 0; p < 12; p++) {
+            uint64_t bits = bitboards[h][p];
+            float* out = planes + (h * 12 + p) * 64;
+            for (int i = 0; i < 64; i++) out[i] = static_cast<float>((bits >> (63 - i)) & 1ULL);
+        }
+    }
+    std::fill(planes + 12 * HISTORY * 64, planes + ChessNet::INPUT_PLANES * 64, white_to_move ? 1.0f : 0.0f);
+}
+
+void TrainingSample::encodePolicy(float* policy) const {
+    std::fill(policy, policy + ChessNet::POLICY_SIZE, 0.0f);
+    for (int i = 0; i < policy_size; i++) policy[policy_index[i]] = policy_weight[i] * (1.0f / 65535.0f);
+}
+
+void TrainingSample::transform(int symmetry) {
+    if (symmetry & Symmetry::FLIP) {
+        for (auto& position : bitboards) {
+            for (int p = 0; p < 6; p++) {
+                uint64_t white = position[p];
+                position[p] = Bitmasks::flipVertical(position[p + 6]);
+                position[p + 6] = Bitmasks::flipVertical(white);
+            }
+        }
+        white_to_move = !white_to_move;
+        castling_rights = static_cast<uint8_t>(((castling_rights & 3) << 2) | ((castling_rights >> 2) & 3));
+        if (en_passant >= 0) en_passant ^= 56;
+    }
+    if (symmetry & Symmetry::MIRROR) {
+        for (auto& position : bitboards) {
+            for (uint64_t& bitboard : position) bitboard = Bitmasks::mirrorHorizontal(bitboard);
+        }
+        if (en_passant >= 0) en_passant ^= 7;
+    }
+    for (int i = 0; i < policy_size; i++) {
+        policy_index[i] = static_cast<uint16_t>(transformPolicyIndex(policy_index[i], symmetry));
+    }
+}
+
+std::vector<TrainingSample> gameSamples(const ChessBitboard& start, const std::vector<Move>& moves,
+                                        int white_result, const float* policies) {
+    std::vector<TrainingSample> samples(moves.size());
+    ChessBitboard board = start;
+    for (size_t ply = 0; ply < moves.size(); ply++) {
+        TrainingSample& sample = samples[ply];
+        fillBitboards(board, sample.bitboards[0]);
+        if (ply > 0) std::copy(samples[ply - 1].bitboards[0], samples[ply - 1].bitboards[0] + 12, sample.bitboards[1]);
+        sample.value = static_cast<float>(board.white_to_move ? white_result : -white_result);
+        sample.white_to_move = board.white_to_move;
+        sample.castling_rights = static_cast<uint8_t>(board.castling_rights);
+        sample.en_passant = static_cast<int8_t>(board.en_passant_square);
+        if (policies) {
+            sparsePolicy(policies + ply * ChessNet::POLICY_SIZE, sample);
+        } else {
+            onePolicy(policyIndex(moves[ply]), sample);
+        }
+        board.makeMove(moves[ply]);
+    }
+    return samples;
+}
+
+ShardWriter::ShardWriter(const std::string& directory, size_t samples_per_shard, size_t shuffle_window,
+                         uint64_t seed, const std::string& prefix)
+    : directory(directory), prefix(prefix), samples_per_shard(std::max<size_t>(1, samples_per_shard)),
+      shuffle_window(shuffle_window), rng(seed) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) throw std::runtime_error("Cannot create shard directory: " + directory);
+    for (const std::string& path : list(directory, prefix)) {
+        long number = shardNumber(std::filesystem::path(path).filename().string(), prefix);
+        next_index = std::max(next_index, static_cast<size_t>(number) + 1);
+    }
+    window.reserve(shuffle_window);
+    pending.reserve(this->samples_per_shard);
+}
+
+void ShardWriter::add(const TrainingSample& sample) {
+    sample_count++;
+    if (window.size() < shuffle_window) {
+        window.push_back(sample);
+        return;
+    }
+    if (shuffle_window == 0) {
+        pending.push_back(sample);
+    } else {
+        TrainingSample& slot = window[rng() % window.size()];
+        pending.push_back(slot);
+        slot = sample;
+    }
+    if (pending.size() == samples_per_shard) {
+        writeShard(pending.data(), pending.size());
+        pending.clear();
+    }
+}
+
+void ShardWriter::addGame(const ChessBitboard& start, const std::vector<Move>& moves, int white_result,
+                          const float* policies) {
+    for (const TrainingSample& sample : gameSamples(start, moves, white_result, policies)) add(sample);
+}
+
+void ShardWriter::addPositions(const PositionBatch& batch) {
+    TrainingSample sample{};
+    for (size_t row = 0; row < batch.size(); row++) {
+        const uint64_t* current = &batch.bitboards[row * 12];
+        std::copy(current, current + 12, sample.bitboards[0]);
+        if (row > 0 && batch.game[row - 1] == batch.game[row]) {
+            std::copy(current - 12, current, sample.bitboards[1]);
+        } else {
+            std::fill(sample.bitboards[1], sample.bitboards[1] + 12, 0);
+        }
+        sample.value = batch.result[row];
+        sample.white_to_move = batch.white_to_move[row];
+        sample.castling_rights = batch.castling_rights[row];
+        sample.en_passant = batch.en_passant[row];
+        onePolicy(batch.policy[row], sample);
+        add(sample);
+    }
+}
+
+uint64_t ShardWriter::addPgn(PgnReader& reader, size_t games_per_batch, bool include_unfinished) {
+    uint64_t added = 0;
+    PositionBatch batch;
+    while (reader.nextPositions(batch, games_per_batch, include_unfinished)) {
+        addPositions(batch);
+        added += batch.size();
+    }
+    return added;
+}
+
+void ShardWriter::flush() {
+    pending.insert(pending.end(), window.begin(), window.end());
+    window.clear();
+    std::shuffle(pending.begin(), pending.end(), rng);
+    for (size_t begin = 0; begin < pending.size(); begin += samples_per_shard) {
+        writeShard(pending.data() + begin, std::min(samples_per_shard, pending.size() - begin));
+    }
+    pending.clear();
+}
+
+void ShardWriter::writeShard(const TrainingSample* samples, size_t count) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "-%05zu.shard", next_index++);
+    std::string path = (std::filesystem::path(directory) / (prefix + name)).string();
+    // Written under a temporary name so a loader listing the directory never sees half a shard
+    std::string partial = path + ".tmp";
+    {
+        std::ofstream out(partial, std::ios::binary | std::ios::trunc);
+        uint32_t record_size = sizeof(TrainingSample), reserved = 0;
+        uint64_t records = count;
+        out.write(MAGIC, sizeof(MAGIC));
+        out.write(reinterpret_cast<const char*>(&record_size), 4);
+        out.write(reinterpret_cast<const char*>(&reserved), 4);
+        out.write(reinterpret_cast<const char*>(&records), 8);
+        out.write(reinterpret_cast<const char*>(samples), count * sizeof(TrainingSample));
+        if (!out) throw std::runtime_error("Cannot write shard: " + path);
+    }
+    std::error_code ec;
+    std::filesystem::rename(partial, path, ec);
+    if (ec) throw std::runtime_error("Cannot write shard: " + path);
+    written.push_back(path);
+}
+
+std::vector<std::string> ShardWriter::list(const std::string& directory, const std::string& prefix) {
+    std::vector<std::string> paths;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+        if (entry.is_regular_file() && shardNumber(entry.path().filename().string(), prefix) >= 0) {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+ShardLoader::ShardLoader(std::vector<std::string> shard_paths, const ShardLoaderConfig& loader_config)
+    : paths(std::move(shard_paths)), config(loader_config) {
+    if (paths.empty()) throw std::runtime_error("ShardLoader needs at least one shard");
+    if (config.batch_size == 0) throw std::runtime_error("ShardLoader batch_size must be positive");
+    config.prefetch = std::max<size_t>(1, config.prefetch);
+    for (const std::string& path : paths) {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) throw std::runtime_error("Cannot open shard: " + path);
+        uint64_t file_size = in.tellg();
+        char magic[8];
+        uint32_t record_size = 0;
+        uint64_t records = 0;
+        in.seekg(0);
+        in.read(magic, 8);
+        in.read(reinterpret_cast<char*>(&record_size), 4);
+        in.seekg(16);
+        in.read(reinterpret_cast<char*>(&records), 8);
+        if (!in || std::memcmp(magic, MAGIC, 8) != 0 || record_size != sizeof(TrainingSample) ||
+            file_size != HEADER_SIZE + records * sizeof(TrainingSample)) {
+            throw std::runtime_error("Not a training shard: " + path);
+        }
+        counts.push_back(records);
+        total_samples += records;
+    }
+    int threads = config.threads > 0 ? config.threads : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    threads = static_cast<int>(std::min<size_t>(threads, paths.size()));
+    running = threads;
+    for (int w = 0; w < threads; w++) workers.emplace_back(&ShardLoader::work, this, w);
+}
+
+ShardLoader::~ShardLoader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    space.notify_all();
+    ready.notify_all();
+    for (std::thread& worker : workers) worker.join();
+}
+
+std::unique_ptr<LoaderBatch> ShardLoader::next() {
+    std::unique_lock<std::mutex> lock(mutex);
+    ready.wait(lock, [&] { return !queue.empty() || error || running == 0; });
+    if (!queue.empty()) {
+        std::unique_ptr<LoaderBatch> batch = std::move(queue.front());
+        queue.pop_front();
+        space.notify_one();
+        return batch;
+    }
+    if (error) std::rethrow_exception(error);
+    return nullptr;
+}
+
+long ShardLoader::takeShard() {
+    if (total_samples == 0) return -1;
+    if (order_pos == order.size()) {
+        if (!config.loop && epoch > 0) return -1;
+        order.resize(paths.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::mt19937_64 rng(config.seed + epoch);
+        std::shuffle(order.begin(), order.end(), rng);
+        order_pos = 0;
+        epoch++;
+    }
+    return static_cast<long>(order[order_pos++]);
+}
+
+void ShardLoader::work(int worker) {
+    const size_t batch_size = config.batch_size;
+    std::mt19937_64 rng(config.seed * 0x9E3779B97F4A7C15ULL + worker + 1);
+    auto fresh = [&] {
+        auto batch = std::make_unique<LoaderBatch>();
+        batch->size = batch_size;
+        batch->planes.resize(batch_size * ChessNet::INPUT_PLANES * 64);
+        batch->policies.resize(batch_size * ChessNet::POLICY_SIZE);
+        batch->values.resize(batch_size);
+        return batch;
+    };
+    std::unique_ptr<LoaderBatch> batch = fresh();
+    size_t filled = 0;
+    std::vector<TrainingSample> records;
+    std::vector<uint32_t> shuffled;
+    try {
+        while (true) {
+            long shard;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                shard = stopping ? -1 : takeShard();
+            }
+            if (shard < 0) break;
+            records.resize(counts[shard]);
+            std::ifstream in(paths[shard], std::ios::binary);
+            in.seekg(HEADER_SIZE);
+            in.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(TrainingSample));
+            if (!in) throw std::runtime_error("Cannot read shard: " + paths[shard]);
+            shuffled.resize(records.size());
+            std::iota(shuffled.begin(), shuffled.end(), 0);
+            std::shuffle(shuffled.begin(), shuffled.end(), rng);
+
+            bool stopped = false;
+            for (uint32_t index : shuffled) {
+                TrainingSample& sample = records[index];
+                if (config.symmetries) {
+                    int symmetry = static_cast<int>(rng()) & config.symmetries;
+                    if (sample.castling_rights) symmetry &= ~Symmetry::MIRROR;
+                    if (symmetry) sample.transform(symmetry);
+                }
+                sample.encodePlanes(&batch->planes[filled * ChessNet::INPUT_PLANES * 64]);
+                sample.encodePolicy(&batch->policies[filled * ChessNet::POLICY_SIZE]);
+                batch->values[filled] = sample.value;
+                if (++filled < batch_size) continue;
+                std::unique_lock<std::mutex> lock(mutex);
+                space.wait(lock, [&] { return stopping || queue.size() < config.prefetch; });
+                if (stopping) {
+                    stopped = true;
+                    break;
+                }
+                queue.push_back(std::move(batch));
+                ready.notify_one();
+                lock.unlock();
+                batch = fresh();
+                filled = 0;
+            }
+            if (stopped) break;
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) error = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    running--;
+    ready.notify_all();
+}
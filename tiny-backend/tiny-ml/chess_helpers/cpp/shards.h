@@ -0,0 +1,153 @@
+// shards.h
+#pragma once
+#include "bitboard.h"
+#include "chessnet.h"
+#include "pgn.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Training data as shuffled shards of fixed-size records, written from self-play games or
+// PGN and read back by a background loader straight into network-ready batches.
+//
+// Shard file: "CHSHARD1", uint32 record size, uint32 reserved, uint64 record count, then
+// the records in host byte order.
+
+// One training position: the current and previous positions (ChessNet's 25 input planes),
+// the side to move, a sparse policy target and the game result for the side to move
+struct TrainingSample {
+    static constexpr int HISTORY = 2;
+    static constexpr int MAX_POLICY = 64;  // largest policies keep their heaviest moves
+
+    uint64_t bitboards[HISTORY][12];  // white pawns ... king, then black; zeros before the start
+    float value;
+    uint8_t white_to_move;
+    uint8_t castling_rights;
+    int8_t en_passant;
+    uint8_t policy_size;
+    uint16_t policy_index[MAX_POLICY];
+    uint16_t policy_weight[MAX_POLICY];  // out of 65535 in total
+
+    // Writes ChessNet::INPUT_PLANES * 64 floats laid out like encodePosition
+    void encodePlanes(float* planes) const;
+    // Writes ChessNet::POLICY_SIZE floats
+    void encodePolicy(float* policy) const;
+    // Applies Symmetry flags to the positions and the policy like the ChessBitboard
+    // transforms; the value stays, being the side to move's. Mirror only without castling rights.
+    void transform(int symmetry);
+};
+static_assert(12 * TrainingSample::HISTORY + 1 == ChessNet::INPUT_PLANES, "samples hold the network's history");
+static_assert(sizeof(TrainingSample) == 456, "shard records have a fixed layout");
+
+// One sample per move of a game played from `start`; white_result as
+// ChessBitboard::getResult. `policies` holds ChessNet::POLICY_SIZE floats per move (search
+// visit distributions), or is null to train on the moves played.
+std::vector<TrainingSample> gameSamples(const ChessBitboard& start, const std::vector<Move>& moves,
+                                        int white_result, const float* policies = nullptr);
+
+// Collects samples into a shuffle window and writes them out as shards of
+// samples_per_shard records. Once the window is full each new sample takes the place of a
+// random one, which goes to the shard being filled, so a shard mixes games from far apart.
+class ShardWriter {
+public:
+    // Shards are named <directory>/<prefix>-00000.shard, numbered on from any already there.
+    // Throws std::runtime_error if the directory cannot be created.
+    ShardWriter(const std::string& directory, size_t samples_per_shard = 65536,
+                size_t shuffle_window = 262144, uint64_t seed = 0, const std::string& prefix = "shard");
+    ShardWriter(const ShardWriter&) = delete;
+    ShardWriter& operator=(const ShardWriter&) = delete;
+
+    void add(const TrainingSample& sample);
+    // The samples of gameSamples
+    void addGame(const ChessBitboard& start, const std::vector<Move>& moves, int white_result,
+                 const float* policies = nullptr);
+    // Rows of PgnReader::nextPositions; consecutive rows of one game supply the history
+    void addPositions(const PositionBatch& batch);
+    // Every game still in the reader; returns the number of samples added
+    uint64_t addPgn(PgnReader& reader, size_t games_per_batch = 4096, bool include_unfinished = false);
+    // Shuffles whatever is buffered and writes it out, the last shard possibly short.
+    // Samples still buffered when the writer goes away are not written.
+    void flush();
+
+    uint64_t samples() const { return sample_count; }
+    const std::vector<std::string>& shards() const { return written; }
+
+    // Shard files of a directory in name order
+    static std::vector<std::string> list(const std::string& directory, const std::string& prefix = "shard");
+
+private:
+    std::string directory, prefix;
+    size_t samples_per_shard, shuffle_window;
+    std::mt19937_64 rng;
+    std::vector<TrainingSample> window, pending;
+    size_t next_index = 0;
+    uint64_t sample_count = 0;
+    std::vector<std::string> written;
+
+    void writeShard(const TrainingSample* samples, size_t count);
+};
+
+struct ShardLoaderConfig {
+    size_t batch_size = 256;
+    int threads = 0;        // decoding workers, 0 for every core
+    size_t prefetch = 4;    // batches decoded ahead of the trainer
+    uint64_t seed = 0;
+    bool loop = true;       // start another epoch in a new order instead of ending
+    // Symmetry flags to augment with: each sample gets each of them with probability 1/2,
+    // mirroring only when it has no castling rights
+    int symmetries = 0;
+};
+
+// A decoded batch: planes [size][25][64], dense policies [size][4672], values [size]
+struct LoaderBatch {
+    size_t size = 0;
+    std::vector<float> planes, policies, values;
+};
+
+// Reads shards on worker threads into a bounded queue of decoded batches. Shards are
+// visited in a shuffled order each epoch and their records in a shuffled order; a worker
+// fills batches from one shard after another, so batches are always full and an epoch's
+// remainder smaller than a batch per worker is left out.
+class ShardLoader {
+public:
+    // Checks every shard's header; throws std::runtime_error on a missing or foreign file
+    ShardLoader(std::vector<std::string> paths, const ShardLoaderConfig& config = ShardLoaderConfig());
+    ~ShardLoader();
+    ShardLoader(const ShardLoader&) = delete;
+    ShardLoader& operator=(const ShardLoader&) = delete;
+
+    // Next batch, waiting for one if none is ready; null once a non-looping loader has
+    // read every shard. Rethrows a worker's read error.
+    std::unique_ptr<LoaderBatch> next();
+    // Records in all shards, i.e. samples per epoch
+    uint64_t samples() const { return total_samples; }
+    size_t batchSize() const { return config.batch_size; }
+
+private:
+    std::vector<std::string> paths;
+    std::vector<uint64_t> counts;
+    ShardLoaderConfig config;
+    uint64_t total_samples = 0;
+
+    std::mutex mutex;
+    std::condition_variable ready, space;
+    std::deque<std::unique_ptr<LoaderBatch>> queue;
+    std::vector<size_t> order;   // shard indices of the current epoch
+    size_t order_pos = 0;
+    uint64_t epoch = 0;
+    int running = 0;
+    bool stopping = false;
+    std::exception_ptr error;
+    std::vector<std::thread> workers;
+
+    // Next shard to read, -1 when a non-looping loader is out of them; holds `mutex`
+    long takeShard();
+    void work(int worker);
+};
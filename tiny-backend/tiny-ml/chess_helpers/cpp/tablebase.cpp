@@ -0,0 +1,800 @@
+// tablebase.cpp
+// Syzygy probing. The file layout and index encoding follow the Syzygy generator (as
+// documented by the Stockfish and Fathom probers): every position of a material
+// signature maps to an index, and each table stores one value per index, compressed with
+// recursive pairing (pairs of symbols replaced by new symbols) and a canonical Huffman
+// code over the final symbols, in blocks reachable through a sparse index.
+#include "tablebase.h"
+#include <algorithm>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint8_t WDL_MAGIC[4] = {0x71, 0xE8, 0x23, 0x5D};
+constexpr uint8_t DTZ_MAGIC[4] = {0xD7, 0x66, 0x0C, 0xA5};
+
+// Per-table flags in the file
+enum : uint8_t { STM = 1, MAPPED = 2, WIN_PLIES = 4, LOSS_PLIES = 8, WIDE = 16, SINGLE_VALUE = 128 };
+
+inline uint16_t read16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | p[1] << 8); }
+inline uint32_t read32(const uint8_t* p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+inline uint32_t read32BigEndian(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+inline uint64_t read64BigEndian(const uint8_t* p) {
+    return static_cast<uint64_t>(read32BigEndian(p)) << 32 | read32BigEndian(p + 4);
+}
+
+inline int fileOf(int square) { return square & 7; }
+inline int rankOf(int square) { return square >> 3; }
+// Negative below the a1-h8 diagonal, 0 on it
+inline int offDiagonal(int square) { return rankOf(square) - fileOf(square); }
+inline int edgeDistance(int file) { return std::min(file, 7 - file); }
+inline int popLsb(Bitboard& b) {
+    int square = __builtin_ctzll(b);
+    b &= b - 1;
+    return square;
+}
+
+// Index tables shared by every table
+struct Encoding {
+    int map_pawns[64] = {};         // a2-h7 -> 0..47, higher nearer the edge and rank 2
+    int map_b1h1h7[64] = {};        // squares below the a1-h8 diagonal -> 0..27
+    int map_a1d1d4[64] = {};        // a1-d1-d4 triangle -> 0..9, diagonal squares last
+    int map_kk[10][64] = {};        // the 462 king pairs with the first in a1-d1-d4
+    int binomial[6][64] = {};       // [k][n]: ways to choose k of n
+    int lead_pawn_idx[6][64] = {};  // [lead pawns][square of the leading one]
+    int lead_pawns_size[6][4] = {}; // [lead pawns][file a-d]
+
+    Encoding() {
+        int code = 0;
+        for (int s = 0; s < 64; s++) {
+            if (offDiagonal(s) < 0) map_b1h1h7[s] = code++;
+        }
+
+        std::vector<int> diagonal;
+        code = 0;
+        for (int s = 0; s <= 27; s++) {  // a1..d4
+            if (offDiagonal(s) < 0 && fileOf(s) <= 3) {
+                map_a1d1d4[s] = code++;
+            } else if (offDiagonal(s) == 0 && fileOf(s) <= 3) {
+                diagonal.push_back(s);
+            }
+        }
+        for (int s : diagonal) map_a1d1d4[s] = code++;
+
+        // King pairs: adjacent kings are illegal, and with the first king on the diagonal the
+        // second stays on or below it. Pairs with both on the diagonal come last.
+        std::vector<std::pair<int, int>> both_on_diagonal;
+        code = 0;
+        for (int idx = 0; idx < 10; idx++) {
+            for (int s1 = 0; s1 <= 27; s1++) {
+                if (map_a1d1d4[s1] != idx || (idx == 0 && s1 != 1)) continue;  // b1 is 0
+                for (int s2 = 0; s2 < 64; s2++) {
+                    if (std::abs(fileOf(s1) - fileOf(s2)) <= 1 && std::abs(rankOf(s1) - rankOf(s2)) <= 1) continue;
+                    if (offDiagonal(s1) == 0 && offDiagonal(s2) > 0) continue;
+                    if (offDiagonal(s1) == 0 && offDiagonal(s2) == 0) {
+                        both_on_diagonal.emplace_back(idx, s2);
+                    } else {
+                        map_kk[idx][s2] = code++;
+                    }
+                }
+            }
+        }
+        for (const auto& pair : both_on_diagonal) map_kk[pair.first][pair.second] = code++;
+
+        binomial[0][0] = 1;
+        for (int n = 1; n < 64; n++) {
+            for (int k = 0; k < 6 && k <= n; k++) {
+                binomial[k][n] = (k > 0 ? binomial[k - 1][n - 1] : 0) + (k < n ? binomial[k][n - 1] : 0);
+            }
+        }
+
+        // The leading pawn is the one with the highest map_pawns; every other pawn then has
+        // map_pawns[leading] squares left
+        int available = 47;
+        for (int lead = 1; lead <= 5; lead++) {
+            for (int file = 0; file < 4; file++) {
+                int idx = 0;
+                for (int rank = 1; rank <= 6; rank++) {
+                    int square = rank * 8 + file;
+                    if (lead == 1) {
+                        map_pawns[square] = available--;
+                        map_pawns[square ^ 7] = available--;
+                    }
+                    lead_pawn_idx[lead][square] = idx;
+                    idx += binomial[lead - 1][map_pawns[square]];
+                }
+                lead_pawns_size[lead][file] = idx;
+            }
+        }
+    }
+};
+
+const Encoding& encoding() {
+    static const Encoding tables;
+    return tables;
+}
+
+// One compressed value stream: a side to move and, with pawns, a leading pawn file
+struct PairsData {
+    uint8_t flags = 0;
+    int max_sym_len = 0;
+    int min_sym_len = 0;             // the value itself for SINGLE_VALUE tables
+    uint32_t num_blocks = 0;
+    uint64_t block_size = 0;         // bytes
+    uint64_t span = 0;               // values between sparse index entries
+    size_t sparse_index_size = 0;
+    size_t block_length_size = 0;
+    const uint8_t* sparse_index = nullptr;  // 6-byte entries: block (u32), offset in it (u16)
+    const uint8_t* block_length = nullptr;  // u16 per block: values in it minus one
+    const uint8_t* data = nullptr;
+    const uint8_t* lowest_sym = nullptr;    // u16 per code length
+    const uint8_t* btree = nullptr;         // 3 bytes per symbol: left and right 12-bit children
+    std::vector<uint64_t> base64;           // lowest code of each length, left-aligned
+    std::vector<uint8_t> symlen;            // values a symbol expands to, minus one
+    uint8_t pieces[Tablebase::MAX_PIECES] = {};
+    uint64_t group_idx[Tablebase::MAX_PIECES + 1] = {};
+    int group_len[Tablebase::MAX_PIECES + 1] = {};
+    uint16_t map_idx[4] = {};               // DTZ: value maps for win, loss, cursed win, blessed loss
+
+    int left(int sym) const { return ((btree[3 * sym + 1] & 0xF) << 8) | btree[3 * sym]; }
+    int right(int sym) const { return (btree[3 * sym + 2] << 4) | (btree[3 * sym + 1] >> 4); }
+};
+
+}  // namespace
+
+struct Tablebase::Table {
+    std::string path;
+    bool dtz = false;
+    uint64_t key = 0;   // material with the stronger side (first in the file name) as white
+    uint64_t key2 = 0;  // ... and as black
+    int piece_count = 0;
+    bool has_pawns = false;
+    bool has_unique_pieces = false;
+    uint8_t pawn_count[2] = {};  // leading colour, other colour
+
+    std::atomic<bool> mapped{false};  // set once the file was looked at, usable or not
+    bool usable = false;
+    void* base = nullptr;
+    size_t size = 0;
+    const uint8_t* value_map = nullptr;  // DTZ
+    PairsData items[2][4];               // [side to move (WDL only)][leading pawn file]
+
+    PairsData* get(int stm, int file) { return &items[dtz ? 0 : stm][has_pawns ? file : 0]; }
+
+    ~Table() {
+        if (base) munmap(base, size);
+    }
+};
+
+namespace {
+
+using Table = Tablebase::Table;
+
+// Groups of pieces encoded together: normally pieces of one type and colour, except the
+// leading group, which is the pawns of the leading colour, three unique pieces, or the
+// two kings. Also works out each group's multiplier in the index; `order` gives the
+// position of the leading group (and the other colour's pawns) in that product.
+void setGroups(const Table& table, PairsData* d, const int order[2], int file) {
+    const Encoding& enc = encoding();
+    int n = 0;
+    int first_len = table.has_pawns ? 0 : table.has_unique_pieces ? 3 : 2;
+    d->group_len[n] = 1;
+    for (int i = 1; i < table.piece_count; i++) {
+        if (--first_len > 0 || d->pieces[i] == d->pieces[i - 1]) {
+            d->group_len[n]++;
+        } else {
+            d->group_len[++n] = 1;
+        }
+    }
+    d->group_len[++n] = 0;
+
+    bool pawns_on_both_sides = table.has_pawns && table.pawn_count[1];
+    int next = pawns_on_both_sides ? 2 : 1;
+    int free_squares = 64 - d->group_len[0] - (pawns_on_both_sides ? d->group_len[1] : 0);
+    uint64_t idx = 1;
+    for (int k = 0; next < n || k == order[0] || k == order[1]; k++) {
+        if (k == order[0]) {
+            d->group_idx[0] = idx;
+            idx *= table.has_pawns ? enc.lead_pawns_size[d->group_len[0]][file] : table.has_unique_pieces ? 31332 : 462;
+        } else if (k == order[1]) {
+            d->group_idx[1] = idx;
+            idx *= enc.binomial[d->group_len[1]][48 - d->group_len[0]];
+        } else {
+            d->group_idx[next] = idx;
+            idx *= enc.binomial[d->group_len[next]][free_squares];
+            free_squares -= d->group_len[next++];
+        }
+    }
+    d->group_idx[n] = idx;
+}
+
+// Values a symbol expands to, minus one, by walking its pair tree
+uint8_t setSymlen(PairsData* d, int sym, std::vector<bool>& visited) {
+    visited[sym] = true;
+    int right = d->right(sym);
+    if (right == 0xFFF) return 0;  // a leaf: the symbol is a value
+    int left = d->left(sym);
+    if (!visited[left]) d->symlen[left] = setSymlen(d, left, visited);
+    if (!visited[right]) d->symlen[right] = setSymlen(d, right, visited);
+    return static_cast<uint8_t>(d->symlen[left] + d->symlen[right] + 1);
+}
+
+// Reads the compression header of one value stream; returns the byte after it, or
+// nullptr if it runs past `end`
+const uint8_t* setSizes(PairsData* d, const uint8_t* data, const uint8_t* end) {
+    if (data + 2 > end) return nullptr;
+    d->flags = *data++;
+    if (d->flags & SINGLE_VALUE) {
+        d->min_sym_len = *data++;
+        return data;
+    }
+    if (data + 10 > end) return nullptr;
+
+    // The last group multiplier is the number of positions
+    uint64_t positions = d->group_idx[std::find(d->group_len, d->group_len + Tablebase::MAX_PIECES, 0) - d->group_len];
+    d->block_size = 1ULL << *data++;
+    d->span = 1ULL << *data++;
+    d->sparse_index_size = static_cast<size_t>((positions + d->span - 1) / d->span);
+    int padding = *data++;
+    d->num_blocks = read32(data);
+    data += 4;
+    d->block_length_size = d->num_blocks + padding;  // keeps the sparse index in range
+    d->max_sym_len = *data++;
+    d->min_sym_len = *data++;
+    if (d->max_sym_len < d->min_sym_len || d->min_sym_len == 0 || d->max_sym_len > 32) return nullptr;
+    d->lowest_sym = data;
+    d->base64.assign(d->max_sym_len - d->min_sym_len + 1, 0);
+    if (data + d->base64.size() * 2 + 2 > end) return nullptr;
+
+    // Canonical Huffman: longer codes have lower values, so base64[i] >= base64[i + 1] once
+    // each is left-aligned to 64 bits, and a code of length i sits between the two
+    for (int i = static_cast<int>(d->base64.size()) - 2; i >= 0; i--) {
+        d->base64[i] = (d->base64[i + 1] + read16(d->lowest_sym + 2 * i) - read16(d->lowest_sym + 2 * (i + 1))) / 2;
+    }
+    for (size_t i = 0; i < d->base64.size(); i++) d->base64[i] <<= 64 - i - d->min_sym_len;
+
+    data += d->base64.size() * 2;
+    d->symlen.assign(read16(data), 0);
+    data += 2;
+    d->btree = data;
+    if (data + d->symlen.size() * 3 > end) return nullptr;
+    std::vector<bool> visited(d->symlen.size());
+    for (size_t sym = 0; sym < d->symlen.size(); sym++) {
+        if (d->right(static_cast<int>(sym)) != 0xFFF &&
+            (static_cast<size_t>(d->left(static_cast<int>(sym))) >= d->symlen.size() ||
+             static_cast<size_t>(d->right(static_cast<int>(sym))) >= d->symlen.size())) {
+            return nullptr;
+        }
+    }
+    for (size_t sym = 0; sym < d->symlen.size(); sym++) {
+        if (!visited[sym]) d->symlen[sym] = setSymlen(d, static_cast<int>(sym), visited);
+    }
+    return data + d->symlen.size() * 3 + (d->symlen.size() & 1);
+}
+
+// The value at position `idx` of a stream
+int decompress(const PairsData* d, uint64_t idx) {
+    if (d->flags & SINGLE_VALUE) return d->min_sym_len;
+
+    // Sparse index entry k describes value k * span + span / 2: its block and its offset
+    // there. Walk the block lengths from it to the block holding idx.
+    uint32_t k = static_cast<uint32_t>(idx / d->span);
+    uint32_t block = read32(d->sparse_index + 6 * k);
+    int offset = read16(d->sparse_index + 6 * k + 4);
+    offset += static_cast<int>(idx % d->span) - static_cast<int>(d->span / 2);
+    while (offset < 0) offset += read16(d->block_length + 2 * --block) + 1;
+    while (offset > read16(d->block_length + 2 * block)) offset -= read16(d->block_length + 2 * block++) + 1;
+
+    // Decode symbols from the start of the block until the one covering `offset`
+    const uint8_t* ptr = d->data + block * d->block_size;
+    uint64_t buffer = read64BigEndian(ptr);
+    ptr += 8;
+    int buffered = 64;
+    int sym;
+    while (true) {
+        int len = 0;
+        while (buffer < d->base64[len]) len++;
+        sym = static_cast<int>((buffer - d->base64[len]) >> (64 - len - d->min_sym_len));
+        sym += read16(d->lowest_sym + 2 * len);
+        if (offset < d->symlen[sym] + 1) break;
+        offset -= d->symlen[sym] + 1;
+        len += d->min_sym_len;
+        buffer <<= len;
+        buffered -= len;
+        if (buffered <= 32) {
+            buffered += 32;
+            buffer |= static_cast<uint64_t>(read32BigEndian(ptr)) << (64 - buffered);
+            ptr += 4;
+        }
+    }
+
+    // Expand pairs towards the value at `offset`
+    while (d->symlen[sym]) {
+        int left = d->left(sym);
+        if (offset < d->symlen[left] + 1) {
+            sym = left;
+        } else {
+            offset -= d->symlen[left] + 1;
+            sym = d->right(sym);
+        }
+    }
+    return d->left(sym);
+}
+
+// DTZ tables store distances by frequency rank, and often in whole moves; turn a stored
+// value into plies
+int dtzPlies(Table& table, int file, int value, Tablebase::WDL wdl) {
+    static constexpr int MAP_INDEX[] = {1, 3, 0, 2, 0};  // by wdl + 2
+    const PairsData* d = table.get(0, file);
+    if (d->flags & MAPPED) {
+        uint16_t start = d->map_idx[MAP_INDEX[wdl + 2]];
+        value = (d->flags & WIDE) ? read16(table.value_map + 2 * (start + value)) : table.value_map[start + value];
+    }
+    if ((wdl == Tablebase::WIN && !(d->flags & WIN_PLIES)) || (wdl == Tablebase::LOSS && !(d->flags & LOSS_PLIES)) ||
+        wdl == Tablebase::CURSED_WIN || wdl == Tablebase::BLESSED_LOSS) {
+        value *= 2;
+    }
+    return value + 1;
+}
+
+// Lays the PairsData of a freshly mapped table over its file; false if it is malformed
+bool setup(Table& table, const uint8_t* base, size_t size) {
+    const uint8_t* end = base + size;
+    const uint8_t* data = base + 4;  // after the magic
+    enum { SPLIT = 1, HAS_PAWNS = 2 };
+    if (bool(*data & HAS_PAWNS) != table.has_pawns || bool(*data & SPLIT) != (table.key != table.key2)) return false;
+    data++;
+
+    int sides = !table.dtz && table.key != table.key2 ? 2 : 1;
+    int max_file = table.has_pawns ? 3 : 0;
+    bool pawns_on_both_sides = table.has_pawns && table.pawn_count[1];
+    auto align = [&](size_t to) { data = base + ((data - base + to - 1) & ~(to - 1)); };
+
+    for (int f = 0; f <= max_file; f++) {
+        for (int i = 0; i < sides; i++) *table.get(i, f) = PairsData();
+        int order[2][2] = {{*data & 0xF, pawns_on_both_sides ? *(data + 1) & 0xF : 0xF},
+                           {*data >> 4, pawns_on_both_sides ? *(data + 1) >> 4 : 0xF}};
+        data += 1 + pawns_on_both_sides;
+        for (int k = 0; k < table.piece_count; k++, data++) {
+            for (int i = 0; i < sides; i++) table.get(i, f)->pieces[k] = i ? *data >> 4 : *data & 0xF;
+        }
+        for (int i = 0; i < sides; i++) setGroups(table, table.get(i, f), order[i], f);
+    }
+    align(2);
+
+    for (int f = 0; f <= max_file; f++) {
+        for (int i = 0; i < sides; i++) {
+            data = setSizes(table.get(i, f), data, end);
+            if (!data) return false;
+        }
+    }
+
+    if (table.dtz) {
+        table.value_map = data;
+        for (int f = 0; f <= max_file; f++) {
+            PairsData* d = table.get(0, f);
+            if (!(d->flags & MAPPED)) continue;
+            if (d->flags & WIDE) {
+                align(2);
+                for (int i = 0; i < 4; i++) {
+                    d->map_idx[i] = static_cast<uint16_t>((data - table.value_map) / 2 + 1);
+                    data += 2 * read16(data) + 2;
+                }
+            } else {
+                for (int i = 0; i < 4; i++) {
+                    d->map_idx[i] = static_cast<uint16_t>(data - table.value_map + 1);
+                    data += *data + 1;
+                }
+            }
+            if (data > end) return false;
+        }
+        align(2);
+    }
+
+    for (int f = 0; f <= max_file; f++) {
+        for (int i = 0; i < sides; i++) {
+            PairsData* d = table.get(i, f);
+            d->sparse_index = data;
+            data += d->sparse_index_size * 6;
+        }
+    }
+    for (int f = 0; f <= max_file; f++) {
+        for (int i = 0; i < sides; i++) {
+            PairsData* d = table.get(i, f);
+            d->block_length = data;
+            data += d->block_length_size * 2;
+        }
+    }
+    if (data > end) return false;
+    // Tables made of single-value streams end before the last alignment
+    for (int f = 0; f <= max_file; f++) {
+        for (int i = 0; i < sides; i++) {
+            align(64);
+            PairsData* d = table.get(i, f);
+            d->data = data;
+            data += d->num_blocks * d->block_size;
+            if (d->num_blocks && data > end) return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+Tablebase::Tablebase(const std::string& paths) : search_paths(paths) {
+    size_t start = 0;
+    while (start <= paths.size()) {
+        size_t colon = paths.find(':', start);
+        if (colon == std::string::npos) colon = paths.size();
+        std::string directory = paths.substr(start, colon - start);
+        start = colon + 1;
+        if (directory.empty()) continue;
+        DIR* dir = opendir(directory.c_str());
+        if (!dir) continue;
+        std::vector<std::string> names;
+        while (dirent* entry = readdir(dir)) names.push_back(entry->d_name);
+        closedir(dir);
+        std::sort(names.begin(), names.end());
+        for (const std::string& name : names) addTable(directory, name);
+    }
+    probe_limit = max_pieces;
+}
+
+Tablebase::~Tablebase() = default;
+
+void Tablebase::setProbeLimit(int pieces) {
+    probe_limit = std::clamp(pieces, 0, max_pieces);
+}
+
+uint64_t Tablebase::materialKey(const ChessBitboard& board) {
+    const Bitboard white[5] = {board.white_pawns, board.white_knights, board.white_bishops, board.white_rooks, board.white_queens};
+    const Bitboard black[5] = {board.black_pawns, board.black_knights, board.black_bishops, board.black_rooks, board.black_queens};
+    uint64_t key = 0;
+    for (int type = 0; type < 5; type++) {
+        key |= static_cast<uint64_t>(__builtin_popcountll(white[type])) << (4 * type);
+        key |= static_cast<uint64_t>(__builtin_popcountll(black[type])) << (20 + 4 * type);
+    }
+    return key;
+}
+
+void Tablebase::addTable(const std::string& directory, const std::string& name) {
+    static const std::string LETTERS = "PNBRQ";
+    size_t dot = name.size() >= 5 ? name.size() - 5 : 0;
+    if (name.size() < 8 || name.compare(dot, 5, ".rtbw") != 0) return;
+    std::string code = name.substr(0, dot);
+    size_t v = code.find('v');
+    if (v == std::string::npos || code[0] != 'K' || v + 1 >= code.size() || code[v + 1] != 'K') return;
+
+    // Counts per side for the file's first (stronger) and second side
+    int counts[2][5] = {};
+    int pieces = 0;
+    for (size_t i = 0; i < code.size(); i++) {
+        if (i == v) continue;
+        int side = i > v;
+        if (code[i] == 'K') {
+            if (i != 0 && i != v + 1) return;
+        } else {
+            size_t type = LETTERS.find(code[i]);
+            if (type == std::string::npos) return;
+            counts[side][type]++;
+        }
+        pieces++;
+    }
+    if (pieces > MAX_PIECES) return;
+
+    auto table = std::make_unique<Table>();
+    table->path = directory + "/" + name;
+    for (int type = 0; type < 5; type++) {
+        table->key |= static_cast<uint64_t>(counts[0][type]) << (4 * type) | static_cast<uint64_t>(counts[1][type]) << (20 + 4 * type);
+        table->key2 |= static_cast<uint64_t>(counts[1][type]) << (4 * type) | static_cast<uint64_t>(counts[0][type]) << (20 + 4 * type);
+        // A single piece of a type makes a unique piece (kings do not count)
+        if (counts[0][type] == 1 || counts[1][type] == 1) table->has_unique_pieces = true;
+    }
+    if (index.count(table->key)) return;  // already found in an earlier directory
+    table->piece_count = pieces;
+    table->has_pawns = counts[0][0] || counts[1][0];
+    // The leading colour is the one with fewer pawns (but some), white on a tie
+    bool white_leads = !counts[1][0] || (counts[0][0] && counts[1][0] >= counts[0][0]);
+    table->pawn_count[0] = static_cast<uint8_t>(counts[white_leads ? 0 : 1][0]);
+    table->pawn_count[1] = static_cast<uint8_t>(counts[white_leads ? 1 : 0][0]);
+
+    auto dtz = std::make_unique<Table>();
+    dtz->path = directory + "/" + code + ".rtbz";
+    dtz->dtz = true;
+    dtz->key = table->key;
+    dtz->key2 = table->key2;
+    dtz->piece_count = table->piece_count;
+    dtz->has_pawns = table->has_pawns;
+    dtz->has_unique_pieces = table->has_unique_pieces;
+    dtz->pawn_count[0] = table->pawn_count[0];
+    dtz->pawn_count[1] = table->pawn_count[1];
+
+    index[table->key] = tables.size();
+    index[table->key2] = tables.size();
+    max_pieces = std::max(max_pieces, pieces);
+    tables.push_back(std::move(table));
+    dtz_tables.push_back(std::move(dtz));
+}
+
+bool Tablebase::ready(Table& table) const {
+    if (table.mapped.load(std::memory_order_acquire)) return table.usable;
+    std::lock_guard<std::mutex> lock(map_mutex);
+    if (table.mapped.load(std::memory_order_relaxed)) return table.usable;
+
+    int fd = open(table.path.c_str(), O_RDONLY);
+    struct stat info;
+    // Valid files are a multiple of 64 bytes plus 16
+    if (fd >= 0 && fstat(fd, &info) == 0 && info.st_size % 64 == 16) {
+        void* base = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (base != MAP_FAILED) {
+            madvise(base, info.st_size, MADV_RANDOM);
+            table.base = base;
+            table.size = info.st_size;
+            const uint8_t* bytes = static_cast<const uint8_t*>(base);
+            table.usable = std::memcmp(bytes, table.dtz ? DTZ_MAGIC : WDL_MAGIC, 4) == 0 && setup(table, bytes, table.size);
+        }
+    }
+    if (fd >= 0) close(fd);
+    table.mapped.store(true, std::memory_order_release);
+    return table.usable;
+}
+
+int Tablebase::probeTable(const ChessBitboard& board, bool dtz, WDL wdl, ProbeState& state) const {
+    Bitboard occupied = board.getAllPieces();
+    if (__builtin_popcountll(occupied) == 2) return DRAW;  // KvK
+
+    uint64_t key = materialKey(board);
+    auto found = index.find(key);
+    if (found == index.end()) {
+        state = FAIL;
+        return 0;
+    }
+    Table& table = dtz ? *dtz_tables[found->second] : *tables[found->second];
+    if (!ready(table)) {
+        state = FAIL;
+        return 0;
+    }
+
+    const Encoding& enc = encoding();
+    int squares[MAX_PIECES];
+    uint8_t pieces[MAX_PIECES];
+    int size = 0, lead_pawns_count = 0, tb_file = 0;
+    Bitboard lead_pawns = 0;
+
+    // Tables are stored with the stronger side as white, and symmetric ones (same material
+    // on both sides) only with white to move: otherwise swap the colours and mirror the ranks
+    int side = board.white_to_move ? 0 : 1;
+    bool flip = (table.key == table.key2 && side == 1) || key != table.key;
+    int flip_color = flip ? 8 : 0;
+    int flip_squares = flip ? 56 : 0;
+    int stm = flip ^ side;
+
+    // With pawns there is one table per file of the leading pawn (a-d after mirroring):
+    // the pawn nearest the edge, and the lowest of those
+    auto pawns_before = [&enc](int a, int b) { return enc.map_pawns[a] < enc.map_pawns[b]; };
+    if (table.has_pawns) {
+        uint8_t lead = table.get(0, 0)->pieces[0] ^ flip_color;
+        Bitboard b = lead_pawns = board.getPieces(static_cast<Piece::Color>(lead & 8), Piece::Type::PAWN);
+        while (b) squares[size++] = popLsb(b) ^ flip_squares;
+        lead_pawns_count = size;
+        std::swap(squares[0], *std::max_element(squares, squares + size, pawns_before));
+        tb_file = edgeDistance(fileOf(squares[0]));
+    }
+
+    // DTZ tables hold a single side to move
+    if (table.dtz && (table.get(0, tb_file)->flags & STM) != stm && !(table.key == table.key2 && !table.has_pawns)) {
+        state = CHANGE_STM;
+        return 0;
+    }
+
+    for (Bitboard b = occupied ^ lead_pawns; b;) {
+        int square = popLsb(b);
+        squares[size] = square ^ flip_squares;
+        pieces[size++] = board.mailbox[square].raw() ^ flip_color;
+    }
+    const PairsData* d = table.get(stm, tb_file);
+
+    // Order the pieces like the table does
+    for (int i = lead_pawns_count; i < size - 1; i++) {
+        for (int j = i + 1; j < size; j++) {
+            if (d->pieces[i] == pieces[j]) {
+                std::swap(pieces[i], pieces[j]);
+                std::swap(squares[i], squares[j]);
+                break;
+            }
+        }
+    }
+
+    // Mirror the files to bring the first piece onto files a-d
+    if (fileOf(squares[0]) > 3) {
+        for (int i = 0; i < size; i++) squares[i] ^= 7;
+    }
+
+    uint64_t idx;
+    if (table.has_pawns) {
+        idx = enc.lead_pawn_idx[lead_pawns_count][squares[0]];
+        std::stable_sort(squares + 1, squares + lead_pawns_count, pawns_before);
+        for (int i = 1; i < lead_pawns_count; i++) idx += enc.binomial[i][enc.map_pawns[squares[i]]];
+    } else {
+        // Without pawns, also mirror the ranks, then the a1-h8 diagonal, to bring the first
+        // piece into the a1-d1-d4 triangle
+        if (rankOf(squares[0]) > 3) {
+            for (int i = 0; i < size; i++) squares[i] ^= 56;
+        }
+        for (int i = 0; i < d->group_len[0]; i++) {
+            if (!offDiagonal(squares[i])) continue;
+            if (offDiagonal(squares[i]) > 0) {
+                for (int j = i; j < size; j++) squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+            }
+            break;
+        }
+
+        if (table.has_unique_pieces) {
+            // Three unique pieces together: the first in the triangle, the others on the 63
+            // and 62 squares left, with the cases of pieces on the diagonal counted apart
+            int adjust1 = squares[1] > squares[0];
+            int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+            if (offDiagonal(squares[0])) {
+                idx = (enc.map_a1d1d4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+            } else if (offDiagonal(squares[1])) {
+                idx = (6 * 63 + rankOf(squares[0]) * 28 + enc.map_b1h1h7[squares[1]]) * 62 + squares[2] - adjust2;
+            } else if (offDiagonal(squares[2])) {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + rankOf(squares[0]) * 7 * 28 +
+                      (rankOf(squares[1]) - adjust1) * 28 + enc.map_b1h1h7[squares[2]];
+            } else {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + rankOf(squares[0]) * 7 * 6 +
+                      (rankOf(squares[1]) - adjust1) * 6 + (rankOf(squares[2]) - adjust2);
+            }
+        } else {
+            idx = enc.map_kk[enc.map_a1d1d4[squares[0]]][squares[1]];
+        }
+    }
+
+    // The remaining groups, each as a combination of the squares the earlier groups left
+    idx *= d->group_idx[0];
+    int* group = squares + d->group_len[0];
+    bool remaining_pawns = table.has_pawns && table.pawn_count[1];
+    for (int next = 1; d->group_len[next]; next++) {
+        std::stable_sort(group, group + d->group_len[next]);
+        uint64_t n = 0;
+        for (int i = 0; i < d->group_len[next]; i++) {
+            int adjust = static_cast<int>(std::count_if(squares, group, [&](int s) { return group[i] > s; }));
+            n += enc.binomial[i + 1][group[i] - adjust - 8 * remaining_pawns];
+        }
+        remaining_pawns = false;
+        idx += n * d->group_idx[next];
+        group += d->group_len[next];
+    }
+
+    int value = decompress(d, idx);
+    return table.dtz ? dtzPlies(table, tb_file, value, wdl) : value - 2;
+}
+
+// The generator stores "don't care" values where the side to move has a winning capture
+// (whatever compresses best), may store a loss where a capture draws, and ignores en
+// passant, so the table value only counts together with the captures. DTZ tables in
+// addition skip positions where the best move is a capture or pawn move (`zeroing`).
+Tablebase::WDL Tablebase::search(const ChessBitboard& board, bool zeroing, ProbeState& state) const {
+    std::vector<Move> moves = board.generateLegalMoves();
+    int best = LOSS;
+    size_t searched = 0;
+    for (const Move& move : moves) {
+        if (!board.isCapture(move) && (!zeroing || board.getPieceAt(move.getFrom()).type() != Piece::Type::PAWN)) continue;
+        searched++;
+        ChessBitboard child = board;
+        child.makeMove(move);
+        int value = -search(child, false, state);
+        if (state == FAIL) return DRAW;
+        if (value > best) {
+            best = value;
+            if (value >= WIN) {
+                state = ZEROING_BEST_MOVE;
+                return WIN;
+            }
+        }
+    }
+
+    // With every legal move searched the table is not needed (and may be wrong, e.g. when
+    // en passant is the only move)
+    bool all_searched = searched && searched == moves.size();
+    int value;
+    if (all_searched) {
+        value = best;
+    } else {
+        value = probeTable(board, false, DRAW, state);
+        if (state == FAIL) return DRAW;
+    }
+    if (best >= value) {
+        state = best > DRAW || all_searched ? ZEROING_BEST_MOVE : OK;
+        return static_cast<WDL>(best);
+    }
+    state = OK;
+    return static_cast<WDL>(value);
+}
+
+namespace {
+// DTZ of a position whose best move zeroes the counter
+int dtzBeforeZeroing(Tablebase::WDL wdl) {
+    switch (wdl) {
+        case Tablebase::WIN:          return 1;
+        case Tablebase::CURSED_WIN:   return 101;
+        case Tablebase::BLESSED_LOSS: return -101;
+        case Tablebase::LOSS:         return -1;
+        default:                      return 0;
+    }
+}
+
+inline int signOf(int value) { return (value > 0) - (value < 0); }
+}  // namespace
+
+int Tablebase::dtz(const ChessBitboard& board, ProbeState& state) const {
+    state = OK;
+    WDL wdl = search(board, true, state);
+    if (state == FAIL || wdl == DRAW) return 0;  // DTZ tables do not store draws
+    if (state == ZEROING_BEST_MOVE) return dtzBeforeZeroing(wdl);
+
+    int value = probeTable(board, true, wdl, state);
+    if (state == FAIL) return 0;
+    if (state != CHANGE_STM) return (value + 100 * (wdl == BLESSED_LOSS || wdl == CURSED_WIN)) * signOf(wdl);
+
+    // The table holds the other side to move: take the best reply by one ply of search
+    int best = 0xFFFF;
+    for (const Move& move : board.generateLegalMoves()) {
+        bool zeroing_move = board.isCapture(move) || board.getPieceAt(move.getFrom()).type() == Piece::Type::PAWN;
+        ChessBitboard child = board;
+        child.makeMove(move);
+        // A zeroing move counts by its result alone; otherwise it is the reply's DTZ plus one
+        int child_dtz = zeroing_move ? -dtzBeforeZeroing(search(child, false, state)) : -dtz(child, state);
+        if (state == FAIL) return 0;
+        Piece::Color them = child.white_to_move ? Piece::Color::WHITE : Piece::Color::BLACK;
+        if (child_dtz == 1 && child.isInCheck(them) && child.generateLegalMoves().empty()) best = 1;  // mates
+        if (!zeroing_move) child_dtz += signOf(child_dtz);
+        if (child_dtz < best && signOf(child_dtz) == signOf(wdl)) best = child_dtz;
+    }
+    return best == 0xFFFF ? -1 : best;  // no legal moves: mated
+}
+
+bool Tablebase::probeWdl(const ChessBitboard& board, WDL& wdl) const {
+    if (!canProbe(board)) return false;
+    if (board.generateLegalMoves().empty()) {
+        Piece::Color us = board.white_to_move ? Piece::Color::WHITE : Piece::Color::BLACK;
+        wdl = board.isInCheck(us) ? LOSS : DRAW;
+        return true;
+    }
+    ProbeState state = OK;
+    wdl = search(board, false, state);
+    return state != FAIL;
+}
+
+bool Tablebase::probeDtz(const ChessBitboard& board, int& plies) const {
+    if (!canProbe(board)) return false;
+    ProbeState state = OK;
+    plies = dtz(board, state);
+    return state != FAIL;
+}
+
+bool Tablebase::adjudicate(const ChessBitboard& board, int& result) const {
+    WDL wdl;
+    if (!probeWdl(board, wdl)) return false;
+    int sign = board.white_to_move ? 1 : -1;
+    // A running clock can only turn wins into draws
+    if (wdl != WIN && wdl != LOSS) {
+        result = 0;
+        return true;
+    }
+    if (board.halfmove_clock > 0) {
+        int plies;
+        if (!probeDtz(board, plies) || std::abs(plies) + board.halfmove_clock > 100) return false;
+    }
+    result = wdl == WIN ? sign : -sign;
+    return true;
+}
@@ -0,0 +1,85 @@
+// tablebase.h
+#pragma once
+#include "bitboard.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Syzygy endgame tablebases (.rtbw win/draw/loss and .rtbz distance-to-zeroing files) for
+// up to 7 pieces. The constructor only lists the directories; each file is memory-mapped
+// the first time a position needs it, so opening a full set is cheap and only the tables
+// actually reached take address space. Probing is safe from several threads at once.
+//
+// Tables know nothing about castling, so positions with castling rights are never probed.
+// Results assume the 50-move counter was just reset: a win that takes more than 100
+// plies to convert is a CURSED_WIN (a draw under the 50-move rule), its mirror a
+// BLESSED_LOSS.
+class Tablebase {
+public:
+    enum WDL : int { LOSS = -2, BLESSED_LOSS = -1, DRAW = 0, CURSED_WIN = 1, WIN = 2 };
+    static constexpr int MAX_PIECES = 7;
+
+    // `paths` lists directories separated by ':'. Unreadable directories and files that are
+    // not named like KQvKR.rtbw are skipped; use numTables() to see what was found.
+    explicit Tablebase(const std::string& paths);
+    ~Tablebase();
+    Tablebase(const Tablebase&) = delete;
+    Tablebase& operator=(const Tablebase&) = delete;
+
+    const std::string& paths() const { return search_paths; }
+    // WDL tables found (each with its DTZ table, when present)
+    size_t numTables() const { return tables.size(); }
+    // Pieces, kings included, of the largest table found; 0 without tables
+    int maxPieces() const { return max_pieces; }
+    // Positions with more pieces than this are not probed (defaults to maxPieces())
+    int probeLimit() const { return probe_limit; }
+    void setProbeLimit(int pieces);
+
+    // Worth probing: no castling rights and at most probeLimit() pieces
+    bool canProbe(const ChessBitboard& board) const {
+        return board.castling_rights == 0 && __builtin_popcountll(board.getAllPieces()) <= probe_limit;
+    }
+    // Result for the side to move. False if the position cannot be probed or a table it
+    // needs (including those of the positions after captures) is missing or unreadable.
+    bool probeWdl(const ChessBitboard& board, WDL& wdl) const;
+    // Plies to the next capture or pawn move on the best line, positive when the side to
+    // move wins, negative when it loses, 0 for draws; values beyond 100 mark cursed wins
+    // and blessed losses. May be one ply too long where a table stores whole moves.
+    bool probeDtz(const ChessBitboard& board, int& dtz) const;
+    // Game result as ChessBitboard::getResult reports it (1 white wins, -1 black wins,
+    // 0 draw) if the tables settle it under the 50-move rule from the current halfmove
+    // clock. Decisive results on a running clock need the DTZ table.
+    bool adjudicate(const ChessBitboard& board, int& result) const;
+
+    // Material signature: 4 bits per piece count, kings left out
+    static uint64_t materialKey(const ChessBitboard& board);
+
+    struct Table;
+
+private:
+    enum ProbeState { FAIL, OK, CHANGE_STM, ZEROING_BEST_MOVE };
+
+    std::string search_paths;
+    int max_pieces = 0;
+    int probe_limit = 0;
+    // WDL tables, with their DTZ tables at the same index (unusable if the file is missing)
+    std::vector<std::unique_ptr<Table>> tables;
+    std::vector<std::unique_ptr<Table>> dtz_tables;
+    // Material key (either colour as the stronger side) -> index into tables
+    std::unordered_map<uint64_t, size_t> index;
+    mutable std::mutex map_mutex;
+
+    void addTable(const std::string& directory, const std::string& name);
+    // Maps the table's file on first use; false if it is missing or corrupt
+    bool ready(Table& table) const;
+    // Raw table lookup for the position, without resolving captures
+    int probeTable(const ChessBitboard& board, bool dtz, WDL wdl, ProbeState& state) const;
+    // Best of the table value and the captures (plus pawn moves when `zeroing`); see
+    // tablebase.cpp for why the table alone is not enough
+    WDL search(const ChessBitboard& board, bool zeroing, ProbeState& state) const;
+    int dtz(const ChessBitboard& board, ProbeState& state) const;
+};
@@ -1,3 +1,6 @@
+import multiprocessing
+import time
+
 import pytest
 import chess_engine
 
@@ -145,6 +148,51 @@ def test_perft_suite(board, fen, depth, nodes):
     board.load_fen(fen)
     assert board.perft(depth) == nodes
 
+@pytest.mark.parametrize("fen", [fen for fen, _, _ in PERFT_SUITE])
+def test_to_fen_round_trip(board, fen):
+    """to_fen writes back the position load_fen read."""
+    board.load_fen(fen)
+    assert board.to_fen() == fen
+
+MALFORMED_FENS = [
+    "8p/8/8/8/8/8/8/7K w - - 0 1",                                   # nine files
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR/K w - - 0 1",       # nine ranks
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP w KQkq - 0 1",               # seven ranks
+    "rnbqkbnr/ppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",       # short rank
+    "rnbqkbnr/pppppppp/9/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",      # bad digit
+    "rnbqkbnr/pppxpppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",      # bad piece
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQ1BNR w kq - 0 1",        # no white king
+    "rnbqkbnP/pppppppp/8/8/8/8/PPPPPPP1/RNBQKBNR w KQkq - 0 1",      # pawn on the last rank
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR x KQkq - 0 1",      # side
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkx - 0 1",      # castling
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KKkq - 0 1",
+    "4k3/8/8/8/8/8/8/K7 w K - 0 1",                                   # castling king not at home
+    "r3k3/8/8/8/8/8/8/4K2R w KQq - 0 1",                             # castling rook not at home
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq e9 0 1",     # en passant
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq e3 0 1",
+    "4k3/8/8/8/8/8/8/4K3 w - d6 0 1",                                # en passant without a pawn
+    "4k3/8/8/3P4/8/8/8/4K3 w - d6 0 1",                              # pawn of the side to move
+    "4k3/3p4/8/3p4/8/8/8/4K3 w - d6 0 1",                            # pawn could not have come from d7
+    "4k3/8/3n4/3p4/8/8/8/4K3 w - d6 0 1",                            # en passant square occupied
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - x 1",      # counters
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq",            # missing fields
+    "",
+]
+
+@pytest.mark.parametrize("fen", MALFORMED_FENS)
+def test_try_load_fen_rejects_malformed(board, fen):
+    board.set_starting_position()
+    before = board.to_fen()
+    assert not board.try_load_fen(fen)
+    assert board.to_fen() == before
+
+def test_try_load_fen_accepts_valid(board):
+    for fen, _, _ in PERFT_SUITE:
+        assert board.try_load_fen(fen) and board.to_fen() == fen
+    # Counters may be left out
+    assert board.try_load_fen("4k3/8/8/3pP3/8/8/8/4K3 w - d6")
+    assert board.to_fen() == "4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1"
+
 def test_castling(board):
     """Test legal castling moves."""
     # Setup for white kingside castling
@@ -225,4 +273,870 @@ def test_promotion(board):
     promoted_piece = board.get_piece_at(63)
     assert promoted_piece.type() == chess_engine.PieceType.QUEEN
     assert promoted_piece.color() == chess_engine.Color.WHITE
-    assert board.get_piece_at(55).is_empty()
\ No newline at end of file
+    assert board.get_piece_at(55).is_empty()
+
+def find_move(board, from_sq, to_sq):
+    return next((m for m in board.generate_legal_moves() if m.get_from() == from_sq and m.get_to() == to_sq), None)
+
+def test_see_undefended_capture(board):
+    """Rook takes an undefended pawn and simply wins it."""
+    board.load_fen("1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1")
+    move = find_move(board, 4, 36) # Re1xe5
+    assert board.see(move) == 100
+    assert board.see_ge(move, 0)
+    assert not board.see_ge(move, 101)
+
+def test_see_losing_capture(board):
+    """Queen takes a pawn defended by a pawn and loses the exchange."""
+    board.load_fen("4k3/8/3p4/4p3/8/8/8/4QK2 w - - 0 1")
+    move = find_move(board, 4, 36) # Qe1xe5
+    assert board.see(move) == -800
+    assert not board.see_ge(move, 0)
+
+def test_see_xray(board):
+    """A rook behind the capturing rook joins the exchange once the first one moves."""
+    board.load_fen("4r1k1/8/8/4p3/8/8/4R3/4RK2 w - - 0 1")
+    move = find_move(board, 12, 36) # Re2xe5, backed up by Re1
+    assert board.see(move) == 100
+    assert board.see_ge(move, 100)
+
+def test_move_picker_yields_every_move_once(board):
+    """The staged picker covers exactly the pseudo-legal moves, TT move first."""
+    board.load_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1")
+    legal = board.generate_legal_moves()
+    tt_move = legal[len(legal) // 2]
+
+    picked = list(chess_engine.MovePicker(board, tt_move))
+    assert picked[0] == tt_move
+
+    def key(m):
+        return (m.get_from(), m.get_to(), m.get_flags())
+    legal_keys = sorted(key(m) for m in legal)
+    picked_legal = sorted(key(m) for m in picked if m in legal)
+    assert picked_legal == legal_keys
+    assert len(set(key(m) for m in picked)) == len(picked)
+
+def test_move_picker_orders_captures_first(board):
+    """Winning captures come before quiet moves, losing captures come last."""
+    board.load_fen("4k3/8/3p4/4p3/8/2n5/8/1N2QK2 w - - 0 1")
+    picked = list(chess_engine.MovePicker(board))
+    assert (picked[0].get_from(), picked[0].get_to()) == (1, 18) # Nb1xc3 wins a knight
+    assert (picked[-1].get_from(), picked[-1].get_to()) == (4, 36) # Qe1xe5 loses the queen
+
+def move_keys(moves):
+    return sorted((m.get_from(), m.get_to(), m.get_flags()) for m in moves)
+
+@pytest.mark.parametrize("fen", [fen for fen, _, _ in PERFT_SUITE])
+def test_captures_and_quiets_partition_pseudo_legal(board, fen):
+    """Captures (with promotions) and quiets together are exactly the pseudo-legal moves."""
+    board.load_fen(fen)
+    captures = board.generate_captures()
+    quiets = board.generate_quiets()
+    assert all(board.is_capture(m) or m.get_flags() >= 8 for m in captures)
+    assert not any(board.is_capture(m) or m.get_flags() >= 8 for m in quiets)
+    assert move_keys(captures + quiets) == move_keys(board.generate_pseudo_legal_moves())
+
+def test_evasions_cover_legal_moves(board):
+    """In check, the legal evasions are exactly the legal moves."""
+    board.load_fen("4k3/8/8/8/1b6/8/3P4/R3K2R w KQ - 0 1") # Bb4+ against the king on e1
+    assert board.is_in_check(chess_engine.Color.WHITE)
+    evasions = board.generate_evasions()
+    assert move_keys([m for m in evasions if board.is_legal(m)]) == move_keys(board.generate_legal_moves())
+    assert not any(m.get_flags() == 2 for m in evasions) # no castling out of check
+
+def test_quiet_checks(board):
+    """Quiet checks include direct and discovered checks and nothing else."""
+    board.load_fen("4k3/8/8/8/8/8/4N3/4RK2 w - - 0 1") # the knight blocks the rook's file
+    checks = board.generate_quiet_checks()
+    assert all(board.gives_check(m) for m in checks)
+    # Every knight move uncovers the rook
+    knight_moves = [m for m in board.generate_quiets() if m.get_from() == 12]
+    assert move_keys(knight_moves) == move_keys([m for m in checks if m.get_from() == 12])
+    # Re1 cannot check directly through its own knight, Kf1 never checks
+    assert not any(m.get_from() in (4, 5) for m in checks)
+
+# Checks the perft positions (and one ply on) never give: castling, en passant (direct and
+# discovered), promotion and underpromotion, discovered by knight, and a push that uncovers nothing
+CHECK_POSITIONS = [
+    "5k2/8/8/8/8/8/8/4K2R w K - 0 1",
+    "3k4/8/8/8/8/8/8/R3K3 w Q - 0 1",
+    "4k2r/8/8/8/8/8/8/5K2 b k - 0 1",
+    "8/2k5/8/3pP3/8/8/8/4K3 w - d6 0 1",
+    "8/8/8/R2pP2k/8/8/8/4K3 w - d6 0 1",
+    "2k5/4P3/8/8/8/8/8/4K3 w - - 0 1",
+    "8/4P3/5k2/8/8/8/8/4K3 w - - 0 1",
+    "7k/8/8/8/8/2N5/8/B3K3 w - - 0 1",
+    "4k3/8/8/8/8/4P3/8/4RK2 w - - 0 1",
+]
+
+@pytest.mark.parametrize("fen", [fen for fen, _, _ in PERFT_SUITE] + CHECK_POSITIONS)
+def test_checks_match_make_move(board, fen):
+    """gives_check and generate_quiet_checks agree with playing every move, here and one ply on."""
+    scratch = chess_engine.ChessBitboard()
+    board.load_fen(fen)
+    positions = [fen]
+    for move in board.generate_legal_moves():
+        scratch.load_fen(fen)
+        scratch.make_move(move)
+        positions.append(scratch.to_fen())
+    for position in positions:
+        board.load_fen(position)
+        them = chess_engine.Color.BLACK if board.white_to_move else chess_engine.Color.WHITE
+        def checks(move):
+            scratch.load_fen(position)
+            scratch.make_move(move)
+            return scratch.is_in_check(them)
+        for move in board.generate_pseudo_legal_moves():
+            assert board.gives_check(move) == checks(move), (position, move_keys([move]))
+        # Every quiet check is generated, and every generated move checks
+        assert move_keys(board.generate_quiet_checks()) == move_keys([m for m in board.generate_quiets() if checks(m)]), position
+
+def test_evaluate_is_symmetric(board):
+    """Mirroring the position and the side to move leaves the evaluation unchanged."""
+    board.load_fen("r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4")
+    mirrored = chess_engine.ChessBitboard()
+    mirrored.load_fen("rnbqk2r/pppp1ppp/5n2/2b1p3/4P3/2N2N2/PPPP1PPP/R1BQKB1R b KQkq - 4 4")
+    assert board.evaluate() == mirrored.evaluate()
+
+def test_evaluate_tracks_material_incrementally(board):
+    """Pieces added with set_piece show up in the evaluation without a rescan."""
+    board.load_fen("4k3/8/8/8/8/8/8/4K3 w - - 0 1")
+    before = board.evaluate()
+    board.set_piece(27, chess_engine.Piece(chess_engine.Color.WHITE, chess_engine.PieceType.QUEEN))
+    assert board.evaluate() > before + 800
+    board.clear_square(27)
+    assert board.evaluate() == before
+
+def test_search_finds_mate_in_one(board):
+    board.load_fen("6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1")
+    result = chess_engine.Search().run(board, 3)
+    assert (result.best_move.get_from(), result.best_move.get_to()) == (3, 59) # Rd1-d8#
+    assert result.score > 30000
+
+def test_search_fills_transposition_table(board):
+    board.set_starting_position()
+    search = chess_engine.Search()
+    search.set_hash_size(1)
+    assert search.hashfull() == 0
+    result = search.run(board, 5)
+    assert not result.best_move.is_none() and search.hashfull() > 0
+    search.clear()
+    assert search.hashfull() == 0
+
+def test_search_scores_repetition_as_draw(board):
+    """A queen down, White shuffles the king back into a position the game has already seen."""
+    board.load_fen("7k/8/8/q7/8/8/8/7K w - - 0 1")
+    history = []
+    for from_sq, to_sq in [(7, 6), (63, 62), (6, 7), (62, 63)]: # Kg1 Kg8 Kh1 Kh8
+        history.append(board.hash)
+        board.make_move(find_move(board, from_sq, to_sq))
+    search = chess_engine.Search()
+    assert search.run(board, 4).score < -500
+    search.clear()
+    search.set_game_history(history)
+    result = search.run(board, 4)
+    assert result.score == 0
+    assert (result.best_move.get_from(), result.best_move.get_to()) == (7, 6)
+
+def test_nnue_rejects_bad_file(tmp_path):
+    path = tmp_path / "bad.nnue"
+    path.write_bytes(b"not a network")
+    with pytest.raises(RuntimeError):
+        chess_engine.NNUENetwork(str(path))
+
+def test_nnue_export_round_trip(tmp_path, board):
+    """A net whose only non-zero weight is the output bias evaluates every position to that bias."""
+    np = pytest.importorskip("numpy")
+    import os, sys
+    sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+    from nnue_export import export_nnue
+    weights = {
+        "ft.weight": np.zeros((41024, 256)), "ft.bias": np.zeros(256),
+        "l1.weight": np.zeros((32, 512)), "l1.bias": np.zeros(32),
+        "l2.weight": np.zeros((32, 32)), "l2.bias": np.zeros(32),
+        "out.weight": np.zeros((1, 32)), "out.bias": np.array([0.5]),
+    }
+    path = tmp_path / "flat.nnue"
+    export_nnue(weights, str(path))
+    network = chess_engine.NNUENetwork(str(path))
+    board.set_starting_position()
+    assert network.evaluate(board) == 300
+    search = chess_engine.Search()
+    search.set_network(network)
+    assert not search.run(board, 2).best_move.is_none()
+
+NNUE_LINE = ("e2e4 d7d5 e4d5 d8d5 b1c3 d5a5 g1f3 c8g4 f1e2 b8c6 e1g1 e8c8 d2d4 g4f3 e2f3 c6d4 "
+             "g1h1 d4f3 d1f3 c8b8 g2g4 h7h6 g4g5 f7f5 g5f6").split() # captures, both castlings, king moves, en passant
+
+def test_nnue_matches_reference_and_incremental_updates(tmp_path):
+    """A random net evaluates like a NumPy reference, and updated accumulators equal refreshed ones."""
+    np = pytest.importorskip("numpy")
+    import os, sys
+    sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+    from nnue_export import export_nnue, _quantize, ACTIVATION_SCALE, WEIGHT_SCALE, FV_SCALE, NNUE_TO_CP
+    rng = np.random.default_rng(0)
+    weights = {
+        "ft.weight": rng.normal(0, 0.05, (41024, 256)), "ft.bias": rng.uniform(0, 0.5, 256),
+        "l1.weight": rng.normal(0, 0.1, (32, 512)), "l1.bias": rng.normal(0, 0.1, 32),
+        "l2.weight": rng.normal(0, 0.3, (32, 32)), "l2.bias": rng.normal(0, 0.1, 32),
+        "out.weight": rng.normal(0, 0.3, (1, 32)), "out.bias": rng.normal(0, 0.1, 1),
+    }
+    path = tmp_path / "random.nnue"
+    export_nnue(weights, str(path))
+    network = chess_engine.NNUENetwork(str(path))
+
+    q = lambda name, scale, dtype: _quantize(weights[name], scale, dtype).astype(np.int64)
+    ft_weight, ft_bias = q("ft.weight", ACTIVATION_SCALE, np.int16), q("ft.bias", ACTIVATION_SCALE, np.int16)
+    out_scale = NNUE_TO_CP * FV_SCALE
+    kinds = [chess_engine.PieceType.PAWN, chess_engine.PieceType.KNIGHT, chess_engine.PieceType.BISHOP,
+             chess_engine.PieceType.ROOK, chess_engine.PieceType.QUEEN, chess_engine.PieceType.KING]
+    def reference(board):
+        pieces = [(sq, p.color() == chess_engine.Color.WHITE, kinds.index(p.type()))
+                  for sq in range(64) for p in [board.get_piece_at(sq)] if not p.is_empty()]
+        halves = []
+        for perspective, flip in ((True, 0), (False, 63)): # white, then black seeing the board rotated
+            king = next(sq for sq, white, kind in pieces if kind == 5 and white == perspective)
+            rows = [(sq ^ flip) + 1 + kind * 128 + (0 if white == perspective else 64) + 641 * (king ^ flip)
+                    for sq, white, kind in pieces if kind != 5]
+            halves.append(ft_bias + ft_weight[rows].sum(axis=0))
+        us = 0 if board.white_to_move else 1
+        x = np.clip(np.concatenate([halves[us], halves[1 - us]]), 0, 127)
+        for layer in ("l1", "l2"):
+            x = q(layer + ".bias", ACTIVATION_SCALE * WEIGHT_SCALE, np.int32) + q(layer + ".weight", WEIGHT_SCALE, np.int8) @ x
+            x = np.clip(x >> 6, 0, 127)
+        out = q("out.bias", out_scale, np.int32)[0] + q("out.weight", out_scale / ACTIVATION_SCALE, np.int8)[0] @ x
+        return int(out / FV_SCALE), np.stack(halves)
+
+    boards = [chess_engine.ChessBitboard()]
+    boards[0].set_starting_position()
+    accumulator = network.refresh(boards[0])
+    stack = chess_engine.NNUEAccumulatorStack()
+    stack.reset(network, boards[0])
+    scores = []
+    for ply, name in enumerate(NNUE_LINE):
+        board = chess_engine.ChessBitboard()
+        board.load_fen(boards[-1].to_fen())
+        board.make_move(next(m for m in board.generate_legal_moves() if move_name(m) == name))
+        boards.append(board)
+        score, halves = reference(board)
+        assert network.evaluate(board) == score, name
+        assert (network.refresh(board).values == halves).all(), name
+        accumulator = network.update(board, accumulator)
+        assert (accumulator.values == halves).all(), name
+        assert network.evaluate(board, accumulator) == score
+        stack.push(board)
+        if ply % 2: # every other ply, so some entries are filled lazily from two plies back
+            assert stack.evaluate() == score, name
+        scores.append(score)
+    assert len(set(scores)) > len(scores) // 2 # the net is not close to constant
+
+def test_native_chessnet_rejects_bad_file(tmp_path):
+    path = tmp_path / "bad.safetensors"
+    path.write_bytes(b"\x08\x00\x00\x00\x00\x00\x00\x00not json")
+    with pytest.raises(RuntimeError):
+        chess_engine.NativeChessNet(str(path))
+
+def test_policy_index_matches_python(board):
+    pytest.importorskip("numpy")
+    pytest.importorskip("tinygrad")
+    import os, sys
+    sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.dirname(os.path.abspath(__file__)))))
+    from chess_helpers.game_logic import move_to_policy_index
+    board.load_fen("r3k2r/pPppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1")
+    for move in board.generate_legal_moves():
+        assert chess_engine.policy_index(move) == move_to_policy_index(move)
+
+def test_native_mcts_finds_mate_in_one(board):
+    board.load_fen("6k1/5ppp/8/8/8/8/5PPP/R5K1 w - - 0 1")
+    config = chess_engine.MCTSConfig()
+    config.num_simulations = 200
+    config.dirichlet_epsilon = 0.0
+    mcts = chess_engine.MCTS(chess_engine.HandcraftedEvaluator(), config)
+    result = mcts.search(board)
+    assert (result.best_move.get_from(), result.best_move.get_to()) == (0, 56)
+    assert sum(result.visits) == config.num_simulations - 1
+
+def write_random_chessnet(path, np):
+    """A randomly initialised checkpoint with model.py's ChessNet state-dict layout."""
+    rng = np.random.default_rng(0)
+    tensors = {}
+    def conv(name, bn, cin, cout, k):
+        tensors[name + ".weight"] = rng.normal(0, (2 / (cin * k * k)) ** 0.5, (cout, cin, k, k))
+        tensors[bn + ".weight"] = rng.uniform(0.5, 1.5, cout)
+        tensors[bn + ".bias"] = rng.uniform(-0.1, 0.1, cout)
+        tensors[bn + ".running_mean"] = rng.uniform(-0.1, 0.1, cout)
+        tensors[bn + ".running_var"] = rng.uniform(0.5, 1.5, cout)
+    def linear(name, cin, cout):
+        tensors[name + ".weight"] = rng.normal(0, cin ** -0.5, (cout, cin))
+        tensors[name + ".bias"] = rng.normal(0, 0.1, cout)
+    conv("resnet_body.conv1", "resnet_body.bn1", 25, 64, 3)
+    cin = 64
+    for layer, width in enumerate([64, 128, 256, 512]):
+        for i in range(2):
+            p = f"resnet_body.layer{layer + 1}.{i}."
+            conv(p + "conv1", p + "bn1", cin, width, 3)
+            conv(p + "conv2", p + "bn2", width, width, 3)
+            if cin != width:
+                conv(p + "downsample.0", p + "downsample.1", cin, width, 1)
+            cin = width
+    linear("policy_fc", 512, 4672)
+    linear("value_fc1", 512, 256)
+    linear("value_fc2", 256, 1)
+
+    import json, struct
+    header, blobs, offset = {}, [], 0
+    for name, value in tensors.items():
+        data = value.astype("<f4").tobytes()
+        header[name] = {"dtype": "F32", "shape": list(value.shape), "data_offsets": [offset, offset + len(data)]}
+        blobs.append(data)
+        offset += len(data)
+    header_bytes = json.dumps(header).encode()
+    header_bytes += b" " * (-len(header_bytes) % 8)
+    with open(path, "wb") as f:
+        f.write(struct.pack("<Q", len(header_bytes)) + header_bytes + b"".join(blobs))
+
+def test_quantized_chessnet_tracks_float(tmp_path, board):
+    np = pytest.importorskip("numpy")
+    path = tmp_path / "random.safetensors"
+    write_random_chessnet(path, np)
+    net = chess_engine.NativeChessNet(str(path))
+    board.set_starting_position()
+    logits, value = net.predict(board)
+    assert len(logits) == 4672 and -1.0 <= value <= 1.0
+    rng = np.random.default_rng(1)
+    planes = np.zeros((8, 25, 8, 8), dtype=np.float32)
+    planes[:, :24] = rng.random((8, 24, 8, 8)) < 0.05
+    planes[:, 24] = 1.0
+    quantized = chess_engine.QuantizedChessNet(net, planes)
+    report = chess_engine.compare_quantized(net, quantized, planes)
+    assert report.positions == 8
+    assert report.value_mae < 0.05
+    assert report.policy_top1_agreement >= 0.75
+
+def test_zobrist_hash_transposition(board):
+    board.set_starting_position()
+    start_hash = board.hash
+    for from_sq, to_sq in [(6, 21), (62, 45), (21, 6), (45, 62)]:
+        board.make_move(find_move(board, from_sq, to_sq))
+    assert board.hash == start_hash
+    board.make_move(find_move(board, 12, 28))
+    # No black pawn can take on e3, so the en passant square does not change the hash
+    fen_board = chess_engine.ChessBitboard()
+    fen_board.load_fen("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1")
+    assert board.hash == fen_board.hash
+
+def test_eval_cache_serves_repeat_search(board):
+    board.set_starting_position()
+    cache = chess_engine.EvalCache(1 << 20)
+    evaluator = chess_engine.CachedEvaluator(chess_engine.HandcraftedEvaluator(), cache)
+    config = chess_engine.MCTSConfig()
+    config.num_simulations = 100
+    config.dirichlet_epsilon = 0.0
+    mcts = chess_engine.MCTS(evaluator, config)
+    mcts.search(board)
+    misses = cache.stats().misses
+    mcts.reset()
+    mcts.search(board)
+    stats = cache.stats()
+    assert stats.misses == misses and stats.hits >= 99
+    assert stats.bytes <= stats.max_bytes
+
+def test_eval_cache_lookup_from_python(board):
+    board.set_starting_position()
+    previous = chess_engine.ChessBitboard()
+    previous.load_fen(board.to_fen())
+    board.make_move(board.generate_legal_moves()[0])
+    cache = chess_engine.EvalCache(1 << 20)
+    assert cache.lookup(board, previous, 20) is None
+    cache.insert(board, previous, [3.0] + [1.0] * 19, -0.25)
+    priors, value = cache.lookup(board, previous, 20)
+    assert value == pytest.approx(-0.25) and priors[0] == pytest.approx(3 / 22, abs=1e-3)
+    # The network also sees the previous position, so it is part of the key
+    assert cache.lookup(board, None, 20) is None and cache.lookup(board, previous, 19) is None
+    assert cache.stats().hits == 1
+
+def test_mcts_reuses_subtree_after_move(board):
+    board.set_starting_position()
+    config = chess_engine.MCTSConfig()
+    config.num_simulations = 200
+    config.dirichlet_epsilon = 0.0
+    mcts = chess_engine.MCTS(chess_engine.HandcraftedEvaluator(), config)
+    result = mcts.search(board)
+    assert result.simulations == config.num_simulations
+    size = mcts.tree_size
+    assert mcts.advance(result.best_move)
+    assert 0 < mcts.tree_size < size
+    board.make_move(result.best_move)
+    result = mcts.search(board)
+    assert sum(result.visits) == config.num_simulations - 1
+    # Visits carried over with the subtree are not this search's work
+    assert 0 < result.simulations < config.num_simulations
+    assert not mcts.advance(chess_engine.Move())
+    assert mcts.tree_size == 0
+
+@pytest.mark.parametrize("threads", [2, 4])
+def test_parallel_mcts_matches_simulation_budget(board, threads):
+    board.load_fen("6k1/5ppp/8/8/8/8/5PPP/R5K1 w - - 0 1")
+    config = chess_engine.MCTSConfig()
+    config.num_simulations = 300
+    config.batch_size = 16
+    config.threads = threads
+    config.dirichlet_epsilon = 0.0
+    mcts = chess_engine.MCTS(chess_engine.HandcraftedEvaluator(), config)
+    result = mcts.search(board)
+    assert (result.best_move.get_from(), result.best_move.get_to()) == (0, 56)
+    assert sum(result.visits) == config.num_simulations - 1
+
+def test_graph_search_shares_transpositions(board):
+    board.load_fen("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1")
+    config = chess_engine.MCTSConfig()
+    config.num_simulations = 2000
+    config.dirichlet_epsilon = 0.0
+    evaluations = []
+    for transpositions in (False, True):
+        config.transpositions = transpositions
+        cache = chess_engine.EvalCache()
+        mcts = chess_engine.MCTS(chess_engine.CachedEvaluator(chess_engine.HandcraftedEvaluator(), cache), config)
+        result = mcts.search(board)
+        assert sum(result.visits) == config.num_simulations - 1
+        stats = cache.stats()
+        evaluations.append(stats.hits + stats.misses)
+    assert evaluations[1] < evaluations[0]
+
+def test_mcts_memory_usage(board):
+    board.set_starting_position()
+    config = chess_engine.MCTSConfig()
+    config.num_simulations = 1000
+    mcts = chess_engine.MCTS(chess_engine.HandcraftedEvaluator(), config)
+    mcts.search(board)
+    memory = mcts.memory_usage()
+    # One node per simulation, edges only for expanded nodes
+    assert 0 < memory.nodes <= config.num_simulations
+    assert memory.node_bytes <= 32 * memory.nodes and memory.edge_bytes == 4 * memory.edges
+    assert memory.reserved_bytes >= memory.node_bytes + memory.edge_bytes
+
+def test_search_respects_time_and_node_limits(board):
+    board.set_starting_position()
+    limits = chess_engine.SearchLimits()
+    limits.movetime_ms = 200
+    result = chess_engine.Search().run(board, limits)
+    assert not result.best_move.is_none() and result.time_ms < 300
+    limits = chess_engine.SearchLimits()
+    limits.nodes = 5000
+    result = chess_engine.Search().run(board, limits)
+    assert not result.best_move.is_none() and result.nodes <= limits.nodes
+
+def test_mcts_movetime_and_early_stop(board):
+    board.load_fen("6k1/5ppp/8/8/8/8/5PPP/R5K1 w - - 0 1")
+    config = chess_engine.MCTSConfig()
+    config.num_simulations = 1000000
+    config.dirichlet_epsilon = 0.0
+    mcts = chess_engine.MCTS(chess_engine.HandcraftedEvaluator(), config)
+    limits = chess_engine.SearchLimits()
+    limits.movetime_ms = 200
+    start = time.perf_counter()
+    result = mcts.search(board, None, limits)
+    assert time.perf_counter() - start < 0.3
+    assert (result.best_move.get_from(), result.best_move.get_to()) == (0, 56)
+    # With early stopping the mate is settled long before the budget runs out
+    config.num_simulations = 2000
+    config.early_stop = True
+    result = chess_engine.MCTS(chess_engine.HandcraftedEvaluator(), config).search(board)
+    assert (result.best_move.get_from(), result.best_move.get_to()) == (0, 56)
+    assert sum(result.visits) < config.num_simulations - 1
+
+def test_mcts_ponder_grows_reused_tree(board):
+    board.set_starting_position()
+    config = chess_engine.MCTSConfig()
+    config.num_simulations = 200
+    config.ponder_simulations = 2000
+    config.dirichlet_epsilon = 0.0
+    mcts = chess_engine.MCTS(chess_engine.HandcraftedEvaluator(), config)
+    result = mcts.search(board)
+    board.make_move(result.best_move)
+    mcts.ponder(board)
+    time.sleep(0.2)
+    assert mcts.is_pondering()
+    mcts.stop_pondering()
+    assert not mcts.is_pondering() and mcts.tree_size > config.num_simulations
+    reply = board.generate_legal_moves()[0]
+    board.make_move(reply)
+    result = mcts.search(board)
+    assert sum(result.visits) >= config.num_simulations - 1
+
+def test_instrumentation_counts_search_work(board, tmp_path):
+    board.set_starting_position()
+    chess_engine.reset_instrumentation()
+    chess_engine.Search().run(board, 4)
+    config = chess_engine.MCTSConfig()
+    config.num_simulations = 200
+    chess_engine.MCTS(chess_engine.HandcraftedEvaluator(), config).search(board)
+    stats = chess_engine.instrumentation()
+    assert stats["enabled"] == chess_engine.instrumentation_enabled
+    assert set(stats["timers"]) == {"movegen", "legality", "encode", "select", "evaluate", "backup"}
+    if not stats["enabled"]:
+        # Compiled out: nothing is ever counted
+        assert not any(stats["counters"].values())
+        return
+    counters = stats["counters"]
+    assert counters["search_nodes"] > 0 and counters["simulations"] == config.num_simulations - 1
+    assert 0 < counters["tt_hits"] <= counters["tt_probes"]
+    assert 0 < stats["batch_fill_ratio"] <= 1.0 and stats["timers"]["select"]["calls"] > 0
+    path = tmp_path / "instrumentation.json"
+    chess_engine.start_instrumentation_dump(str(path), 10)
+    time.sleep(0.05)
+    chess_engine.stop_instrumentation_dump()
+    assert '"simulations": %d' % counters["simulations"] in path.read_text()
+
+def test_loader_picks_a_supported_variant():
+    # chess_engine.py replaces itself with the best CPU variant that was built
+    assert chess_engine.variant in ("generic", "v2", "v3", "v4")
+    assert chess_engine.__name__.endswith("_chess_engine_" + chess_engine.variant)
+
+def write_single_value_krvk(directory):
+    # Smallest valid Syzygy WDL table: KRvK where every position holds one value per side
+    # to move (the side with the rook wins), as the generator writes trivially won endings
+    (directory / "KRvK.rtbw").write_bytes(bytes.fromhex("71e8235d01006644ee00800480000000"))
+
+def test_tablebase_probes_and_adjudicates(board, tmp_path):
+    write_single_value_krvk(tmp_path)
+    tablebase = chess_engine.Tablebase(str(tmp_path))
+    assert tablebase.num_tables == 1 and tablebase.max_pieces == 3
+    board.load_fen("4k3/8/8/8/8/8/8/R3K3 w - - 0 1")
+    assert tablebase.probe_wdl(board) == 2 and tablebase.adjudicate(board) == 1
+    board.load_fen("4k3/8/8/8/8/8/8/R3K3 b - - 0 1")
+    assert tablebase.probe_wdl(board) == -2
+    # Castling rights are outside the tables; a running clock needs the missing DTZ table
+    board.load_fen("4k3/8/8/8/8/8/8/R3K3 w Q - 0 1")
+    assert not tablebase.can_probe(board) and tablebase.probe_wdl(board) is None
+    board.load_fen("4k3/8/8/8/8/8/8/R3K3 w - - 7 20")
+    assert tablebase.probe_wdl(board) == 2 and tablebase.adjudicate(board) is None
+    # The black king takes the undefended rook: bare kings, a draw
+    board.load_fen("8/8/8/8/8/8/1k6/R6K b - - 0 1")
+    assert tablebase.probe_wdl(board) == 0
+    board.load_fen("4k3/8/8/8/8/8/8/R3K3 w - - 0 1")
+    assert not board.is_game_over()
+    chess_engine.set_adjudication_tablebase(tablebase)
+    try:
+        assert board.is_game_over() and board.get_result() == 1
+    finally:
+        chess_engine.set_adjudication_tablebase(None)
+
+def test_search_uses_tablebase(board, tmp_path):
+    write_single_value_krvk(tmp_path)
+    search = chess_engine.Search()
+    search.set_tablebase(chess_engine.Tablebase(str(tmp_path)))
+    # Rook trade into the won KRvK: scored from the table instead of searched out
+    board.load_fen("4k3/8/8/8/8/8/r7/R3K3 w - - 0 1")
+    result = search.run(board, 4)
+    assert result.tb_hits > 0 and result.score > 30000
+
+def move_name(move):
+    return "".join("abcdefgh"[square % 8] + str(square // 8 + 1) for square in (move.get_from(), move.get_to()))
+
+def test_opening_book_round_trip(board, tmp_path):
+    board.set_starting_position()
+    builder = chess_engine.OpeningBookBuilder(max_ply=4)
+    line = ["e2e4", "e7e5", "g1f3", "b8c6"]
+    def play(names):
+        game = chess_engine.ChessBitboard()
+        game.set_starting_position()
+        moves = []
+        for name in names:
+            move = next(m for m in game.generate_legal_moves() if move_name(m) == name)
+            game.make_move(move)
+            moves.append(move)
+        return moves
+    builder.add_game(board, play(line), 1)
+    builder.add_game(board, play(["d2d4", "d7d5"]), 0)
+    builder.add_game(board, play(["a2a4"]), -1)
+    # Moves of the losing side score nothing and stay out: e4, Nf3 (won), d4, d5 (drawn)
+    path = tmp_path / "book.bin"
+    assert builder.write(str(path)) == 4 and path.stat().st_size == 4 * 16
+    book = chess_engine.OpeningBook(str(path))
+    assert len(book) == 4
+    entries = book.probe(board)
+    assert [(move_name(move), weight) for move, weight, _ in entries] == [("e2e4", 2), ("d2d4", 1)]
+    assert move_name(book.best(board)) == "e2e4"
+    picks = {move_name(book.pick(board, seed)) for seed in range(50)}
+    assert picks == {"e2e4", "d2d4"}
+    for move in play(line[:2]):
+        board.make_move(move)
+    assert move_name(book.best(board)) == "g1f3"
+    board.load_fen("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1")
+    assert book.pick(board) is None and book.probe(board) == []
+
+def test_opening_book_keys_match_polyglot(board):
+    # The reference keys from the Polyglot book format description
+    board.set_starting_position()
+    assert chess_engine.OpeningBook.key(board) == 0x463B96181691FC9C
+    line = [("e2e4", 0x823C9B50FD114196), ("d7d5", 0x0756B94461C50FB0), ("e4e5", 0x662FAFB965DB29D4),
+            ("f7f5", 0x22A48B5A8E47FF78), ("e1e2", 0x652A607CA3F242C1), ("e8f7", 0x00FDD303C946BDD9)]
+    for name, key in line:
+        board.make_move(next(m for m in board.generate_legal_moves() if move_name(m) == name))
+        assert chess_engine.OpeningBook.key(board) == key
+    board.set_starting_position()
+    line = [("a2a4", None), ("b7b5", None), ("h2h4", None), ("b5b4", None), ("c2c4", 0x3C8123EA7B067637),
+            ("b4c3", None), ("a1a3", 0x5C3F9B829B279560)]
+    for name, key in line:
+        board.make_move(next(m for m in board.generate_legal_moves() if move_name(m) == name))
+        assert key is None or chess_engine.OpeningBook.key(board) == key
+
+def test_opening_book_rejects_bad_file(tmp_path):
+    path = tmp_path / "bad.bin"
+    path.write_bytes(b"not a book")
+    with pytest.raises(RuntimeError):
+        chess_engine.OpeningBook(str(path))
+
+def test_san_round_trip(board):
+    fens = [
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "6k1/8/8/Q7/8/8/8/Q3Q2K w - - 0 1",
+    ]
+    for fen in fens:
+        board.load_fen(fen)
+        for move in board.generate_legal_moves():
+            assert move_name(chess_engine.parse_san(board, chess_engine.to_san(board, move))) == move_name(move)
+    board.set_starting_position()
+    assert chess_engine.to_san(board, chess_engine.parse_san(board, "Nf3")) == "Nf3"
+    assert move_name(chess_engine.parse_san(board, "e4!?")) == "e2e4"
+    assert chess_engine.parse_san(board, "e5") is None and chess_engine.parse_san(board, "Qxh7") is None
+    # Three queens reach c3: a file, a rank and both are needed to tell them apart
+    board.load_fen("6k1/8/8/Q7/8/8/8/Q3Q2K w - - 0 1")
+    assert chess_engine.parse_san(board, "Qc3") is None
+    assert move_name(chess_engine.parse_san(board, "Qa1c3")) == "a1c3"
+    assert move_name(chess_engine.parse_san(board, "Qec3")) == "e1c3"
+    assert move_name(chess_engine.parse_san(board, "Q5a3")) == "a5a3"
+    board.load_fen("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1")
+    assert move_name(chess_engine.parse_san(board, "0-0-0")) == "e1c1"
+
+PGN_GAMES = """[Event "a"]
+[White "Someone \\"Quoted\\""]
+[Result "1-0"]
+
+1. e4 {a comment; with (brackets)} e5 2. Nf3 (2. Bc4 Nf6 (2... Bc5)) Nc6 $1
+3. Bb5 a6 1-0
+
+[Event "b"]
+[Result "*"]
+
+1. d4 d5 *
+
+[Event "c"]
+[Result "0-1"]
+
+1. e4 Ke7?? 0-1
+"""
+
+def test_pgn_reader_games(tmp_path):
+    path = tmp_path / "games.pgn"
+    path.write_text(PGN_GAMES)
+    for threads in (1, 3):
+        reader = chess_engine.PgnReader(str(path), threads)
+        games = reader.read_games(10)
+        assert [game.tag("Event") for game in games] == ["a", "b", "c"]
+        assert games[0].tags["White"] == 'Someone "Quoted"'
+        assert [move_name(move) for move in games[0].moves] == ["e2e4", "e7e5", "g1f3", "b8c6", "f1b5", "a7a6"]
+        assert [game.result for game in games] == [1, 2, -1]
+        assert games[0].error == "" and len(games[2].moves) == 1 and "Ke7" in games[2].error
+        assert reader.done and reader.games_read == 3 and reader.errors == 1
+        assert reader.read_games(10) == []
+        reader.rewind()
+        assert len(reader.read_games(2)) == 2 and len(reader.read_games(2)) == 1
+    with pytest.raises(RuntimeError):
+        chess_engine.PgnReader(str(tmp_path / "missing.pgn"))
+
+def test_pgn_reader_rejects_bad_fen_tag():
+    text = ('[Event "x"]\n[SetUp "1"]\n[FEN "8p/8/8/8/8/8/8/7K w - - 0 1"]\n\n1. Kg2 *\n\n'
+            '[Event "y"]\n[SetUp "1"]\n[FEN "4k3/8/8/8/8/8/8/4K3 w - - 0 1"]\n\n1. Kd2 *\n')
+    reader = chess_engine.PgnReader.from_text(text)
+    games = reader.read_games(10)
+    assert games[0].error.startswith("bad FEN tag") and games[0].moves == []
+    assert games[1].error == "" and [move_name(move) for move in games[1].moves] == ["e1d2"]
+    assert reader.errors == 1
+
+def test_pgn_reader_position_batches(board):
+    pytest.importorskip("numpy")
+    reader = chess_engine.PgnReader.from_text(PGN_GAMES, 2)
+    batch = reader.read_positions(10)
+    # The unfinished game is left out; the broken one keeps the move before its error
+    assert batch["bitboards"].shape == (7, 12) and list(batch["game"]) == [0] * 6 + [2]
+    assert list(batch["result"]) == [1, -1, 1, -1, 1, -1, -1]
+    assert list(batch["white_to_move"]) == [1, 0, 1, 0, 1, 0, 1]
+    board.set_starting_position()
+    assert int(batch["policy"][0]) == chess_engine.policy_index(chess_engine.parse_san(board, "e4"))
+    assert int(batch["moves"][0]) == 12 | 28 << 6 and batch["castling_rights"][0] == 15
+    reader.rewind()
+    batches = list(reader.batches(games_per_batch=2, include_unfinished=True))
+    assert [len(b["result"]) for b in batches] == [8, 1] and list(batches[0]["result"][6:]) == [0, 0]
+
+def bitboard_planes(board, np):
+    bitboards = [board.white_pawns, board.white_knights, board.white_bishops, board.white_rooks, board.white_queens, board.white_king,
+                 board.black_pawns, board.black_knights, board.black_bishops, board.black_rooks, board.black_queens, board.black_king]
+    return np.array([[(b >> (63 - i)) & 1 for i in range(64)] for b in bitboards], dtype=np.float32).reshape(12, 8, 8)
+
+def test_training_shards_round_trip(board, tmp_path):
+    np = pytest.importorskip("numpy")
+    directory = str(tmp_path / "shards")
+    writer = chess_engine.ShardWriter(directory, samples_per_shard=4, shuffle_window=3, seed=1)
+    assert writer.add_pgn(chess_engine.PgnReader.from_text(PGN_GAMES)) == 7
+    board.set_starting_position()
+    game = chess_engine.ChessBitboard()
+    game.set_starting_position()
+    moves, policies = [], np.zeros((2, 4672), dtype=np.float32)
+    for ply, san in enumerate(["Nf3", "Nf6"]):
+        move = chess_engine.parse_san(game, san)
+        policies[ply, chess_engine.policy_index(move)] = 3.0
+        policies[ply, 0] = 1.0
+        moves.append(move)
+        game.make_move(move)
+    writer.add_game(board, moves, -1, policies)
+    with pytest.raises(ValueError):
+        writer.add_game(board, moves, -1, policies[:1])
+    writer.flush()
+    # One full shard once the window overflowed, then the remaining five
+    assert writer.samples == 9 and len(writer.shards) == 3
+    assert chess_engine.ShardWriter.list(directory) == writer.shards
+
+    loader = chess_engine.ShardLoader(writer.shards, batch_size=9, threads=1, loop=False)
+    assert loader.samples == 9
+    batches = list(loader)
+    assert len(batches) == 1
+    planes, targets, values = batches[0]
+    assert planes.shape == (9, 25, 8, 8) and targets.shape == (9, 4672) and values.shape == (9, 1)
+    np.testing.assert_allclose(targets.sum(axis=1), 1.0, atol=1e-3)
+    # The self-play start position: no history, white to move, 3:1 policy, lost for white
+    start = bitboard_planes(board, np)
+    row = next(i for i in range(9) if np.array_equal(planes[i, :12], start) and targets[i, 0] > 0)
+    assert not planes[row, 12:24].any() and planes[row, 24].all() and values[row, 0] == -1
+    assert targets[row, chess_engine.policy_index(moves[0])] == pytest.approx(0.75, abs=1e-4)
+    assert sorted(values[:, 0].tolist()) == [-1] * 5 + [1] * 4
+
+    looping = chess_engine.ShardLoader(writer.shards, batch_size=4, threads=2, seed=3)
+    assert all(next(looping)[0].shape == (4, 25, 8, 8) for _ in range(10))
+    (tmp_path / "bad.shard").write_bytes(b"not a shard")
+    with pytest.raises(RuntimeError):
+        chess_engine.ShardLoader([str(tmp_path / "bad.shard")])
+
+def test_board_symmetries(board):
+    np = pytest.importorskip("numpy")
+    board.load_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w Kq - 0 1")
+    flipped = chess_engine.ChessBitboard()
+    flipped.load_fen(board.to_fen())
+    flipped.flip_vertical()
+    assert flipped.to_fen() == "r3k2r/pppbbppp/2n2q1P/1P2p3/3pn3/BN2PNP1/P1PPQPB1/R3K2R b Qk - 0 1"
+    assert flipped.perft(3) == board.perft(3)
+    assert not flipped.mirror_horizontal()
+    permutation = chess_engine.policy_permutation(flip=True)
+    flipped_moves = {(m.get_from(), m.get_to(), m.get_flags()): m for m in flipped.generate_legal_moves()}
+    for move in board.generate_legal_moves():
+        image = flipped_moves[(move.get_from() ^ 56, move.get_to() ^ 56, move.get_flags())]
+        assert permutation[chess_engine.policy_index(move)] == chess_engine.policy_index(image)
+    for flip in (False, True):
+        for mirror in (False, True):
+            assert sorted(chess_engine.policy_permutation(flip, mirror)) == list(range(4672))
+
+    board.load_fen("8/8/8/3pP3/8/8/8/K6k w - d6 0 1")
+    assert board.mirror_horizontal()
+    assert board.to_fen() == "8/8/8/3Pp3/8/8/8/k6K w - e6 0 1"
+    assert move_name(chess_engine.parse_san(board, "dxe6")) == "d5e6"
+
+def test_shard_loader_augments(board, tmp_path):
+    np = pytest.importorskip("numpy")
+    writer = chess_engine.ShardWriter(str(tmp_path), shuffle_window=0)
+    board.set_starting_position()
+    writer.add_game(board, [chess_engine.parse_san(board, "e4")], 1)
+    board.load_fen("4k3/8/8/8/8/8/8/4K2R w - - 0 1")
+    writer.add_game(board, [chess_engine.parse_san(board, "Rh7")], 1)
+    writer.flush()
+    variants = {}
+    loader = chess_engine.ShardLoader(writer.shards, batch_size=1, threads=1, seed=7, flip=True, mirror=True)
+    for _ in range(400):
+        planes, policy, value = next(loader)
+        assert value[0, 0] == 1 and policy.sum() == pytest.approx(1.0)
+        start = planes[0, 0].any()  # only the starting position has pawns
+        variants.setdefault(start, set()).add((int(policy[0].argmax()), bool(planes[0, 24, 0, 0])))
+    # The starting position keeps its castling rights, so it is only ever turned round
+    assert len(variants[True]) == 2 and len(variants[False]) == 4
+
+def test_replay_buffer_sampling_and_checkpoints(board, tmp_path):
+    np = pytest.importorskip("numpy")
+    path = str(tmp_path / "replay.bin")
+    buffer = chess_engine.ReplayBuffer(path, capacity=8, seed=1)
+    board.set_starting_position()
+    game = chess_engine.ChessBitboard()
+    game.set_starting_position()
+    moves = []
+    for san in ["e4", "e5", "Nf3"]:
+        moves.append(chess_engine.parse_san(game, san))
+        game.make_move(moves[-1])
+    buffer.add_game(board, moves, 1)
+    # Another handle on the file, as a self-play process would open it
+    producer = chess_engine.ReplayBuffer(path)
+    assert producer.capacity == 8
+    producer.add_game(board, moves, 0)
+    assert buffer.added == 6 and len(buffer) == 6
+
+    planes, policies, values, slots, weights = buffer.sample(16)
+    assert planes.shape == (16, 25, 8, 8) and policies.shape == (16, 4672) and values.shape == (16, 1)
+    assert set(slots.tolist()) <= set(range(6)) and (weights == 1).all()
+    np.testing.assert_allclose(policies.sum(axis=1), 1.0, atol=1e-3)
+    buffer.update_priorities(list(range(6)), [1e-3] * 5 + [100.0])
+    _, _, values, slots, weights = buffer.sample(64, prioritized=True)
+    assert (slots == 5).mean() > 0.9 and weights.max() == 1
+    assert (values[slots == 5] == 0).all()
+
+    checkpoint = str(tmp_path / "replay.ckpt")
+    assert buffer.checkpoint(checkpoint) == 6
+    producer.add_game(board, moves[:1], -1)
+    # Only what was added since goes to the file
+    assert buffer.checkpoint(checkpoint) == 1
+    restored = chess_engine.ReplayBuffer(str(tmp_path / "restored.bin"), capacity=4)
+    assert restored.restore(checkpoint) == 4 and len(restored) == 4
+    restored.add_game(board, moves[:1], 1)
+    assert restored.checkpoint(checkpoint) == 1
+    with pytest.raises(RuntimeError):
+        chess_engine.ReplayBuffer(checkpoint)
+
+def fill_replay_buffer(path, games):
+    board = chess_engine.ChessBitboard()
+    board.set_starting_position()
+    buffer = chess_engine.ReplayBuffer(path)
+    move = chess_engine.parse_san(board, "d4")
+    for _ in range(games):
+        buffer.add_game(board, [move], 1)
+
+def test_replay_buffer_parallel_producers(tmp_path):
+    pytest.importorskip("numpy")
+    path = str(tmp_path / "replay.bin")
+    buffer = chess_engine.ReplayBuffer(path, capacity=256)
+    context = multiprocessing.get_context("fork")
+    producers = [context.Process(target=fill_replay_buffer, args=(path, 500)) for _ in range(4)]
+    for producer in producers:
+        producer.start()
+    for producer in producers:
+        producer.join()
+    assert all(producer.exitcode == 0 for producer in producers)
+    assert buffer.added == 2000 and len(buffer) == 256
+    planes, _, values, _, _ = buffer.sample(256, prioritized=True)
+    assert (values == 1).all() and planes[:, 24].all()
+
+def test_perf_gate_fails_on_halved_throughput(tmp_path):
+    """A 2x slowdown is a regression however noisy the baseline claims to be."""
+    import json, os, subprocess
+    gate = os.path.join(os.path.dirname(os.path.abspath(__file__)), "chess_engine_perf_gate")
+    if not os.path.exists(gate):
+        pytest.skip("chess_engine_perf_gate not built (build.sh)")
+    path = tmp_path / "baseline.json"
+    subprocess.run([gate, "--write-baseline", str(path), "--repetitions", "1"], check=True, capture_output=True)
+    baseline = json.loads(path.read_text())
+    for entry in baseline.values():
+        entry["rate"] *= 2
+        entry["stddev"] = entry["rate"]
+    path.write_text(json.dumps(baseline))
+    run = subprocess.run([gate, "--baseline", str(path), "--repetitions", "1", "--json"], capture_output=True, text=True)
+    report = json.loads(run.stdout)
+    assert run.returncode == 1 and not report["passed"]
+    assert not any(report[name]["speed_ok"] for name in baseline)
@@ -0,0 +1,24 @@
+#include "timeman.h"
+#include <algorithm>
+
+void TimeManager::start(const SearchLimits& limits) {
+    start_time = std::chrono::steady_clock::now();
+    is_timed = limits.timed();
+    optimum_ms = maximum_ms = 0;
+    if (limits.movetime_ms > 0) {
+        optimum_ms = maximum_ms = std::max<int64_t>(1, limits.movetime_ms - limits.move_overhead_ms);
+    } else if (limits.time_left_ms > 0) {
+        int64_t available = std::max<int64_t>(1, limits.time_left_ms - limits.move_overhead_ms);
+        int moves = limits.moves_to_go > 0 ? std::min(limits.moves_to_go, DEFAULT_MOVES_TO_GO) : DEFAULT_MOVES_TO_GO;
+        // An even share of the clock plus most of the increment; the maximum allows an
+        // unstable search to take a few shares, but never the whole clock
+        optimum_ms = available / moves + limits.increment_ms * 3 / 4;
+        maximum_ms = std::min(optimum_ms * 3, moves == 1 ? available : available / 2);
+        optimum_ms = std::max<int64_t>(1, std::min(optimum_ms, maximum_ms));
+        maximum_ms = std::max(maximum_ms, optimum_ms);
+    }
+}
+
+int64_t TimeManager::elapsedMs() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
@@ -0,0 +1,40 @@
+// timeman.h
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+// Budget for one search, shared by Search and MCTS. Zero means "no limit"; with neither a
+// movetime nor a clock the search is bounded by depth or simulations only.
+struct SearchLimits {
+    int64_t movetime_ms = 0;        // think for exactly this long
+    int64_t time_left_ms = 0;       // clock of the side to move
+    int64_t increment_ms = 0;
+    int moves_to_go = 0;            // moves until the next time control, 0 = rest of the game
+    int64_t move_overhead_ms = 30;  // kept back for communication latency
+    uint64_t nodes = 0;             // Search nodes or MCTS simulations
+
+    bool timed() const { return movetime_ms > 0 || time_left_ms > 0; }
+};
+
+// Turns SearchLimits into an optimum time (stop at the next natural point once past it)
+// and a maximum (abort, even mid-iteration)
+class TimeManager {
+public:
+    void start(const SearchLimits& limits);
+
+    bool timed() const { return is_timed; }
+    int64_t elapsedMs() const;
+    int64_t optimumMs() const { return optimum_ms; }
+    int64_t maximumMs() const { return maximum_ms; }
+    bool pastOptimum() const { return is_timed && elapsedMs() >= optimum_ms; }
+    bool pastMaximum() const { return is_timed && elapsedMs() >= maximum_ms; }
+
+private:
+    // Moves a clock is assumed to last for when there is no moves_to_go
+    static constexpr int DEFAULT_MOVES_TO_GO = 30;
+
+    std::chrono::steady_clock::time_point start_time;
+    bool is_timed = false;
+    int64_t optimum_ms = 0;
+    int64_t maximum_ms = 0;
+};
@@ -0,0 +1,56 @@
+#include "tt.h"
+#include <algorithm>
+
+void TranspositionTable::resize(size_t megabytes) {
+    size_t entries = std::max<size_t>(1, (megabytes << 20) / sizeof(Entry));
+    size_t size = 1;
+    while (size * 2 <= entries) size *= 2;
+    table.assign(size, Entry());
+    table.shrink_to_fit();
+    mask = size - 1;
+    generation = 0;
+}
+
+void TranspositionTable::clear() {
+    std::fill(table.begin(), table.end(), Entry());
+    generation = 0;
+}
+
+void TranspositionTable::store(uint64_t key, int depth, int score, Bound bound, const Move& move) {
+    Entry& entry = table[key & mask];
+    bool same = entry.key == key;
+    if (!same && entry.generation == generation && entry.bound != NONE && entry.depth > depth) return;
+    if (same && entry.generation == generation && bound != EXACT && entry.depth > depth) return;
+
+    // Keep the old move when a fail-low produced none
+    uint16_t packed = packMove(move);
+    if (same && packed == 0) packed = entry.move;
+    entry.key = key;
+    entry.score = static_cast<int16_t>(score);
+    entry.move = packed;
+    entry.depth = static_cast<uint8_t>(std::clamp(depth, 0, 255));
+    entry.bound = bound;
+    entry.generation = generation;
+}
+
+int TranspositionTable::hashfull() const {
+    size_t sample = std::min<size_t>(1000, table.size());
+    int used = 0;
+    for (size_t i = 0; i < sample; i++) {
+        if (table[i].bound != NONE && table[i].generation == generation) used++;
+    }
+    return static_cast<int>(used * 1000 / sample);
+}
+
+uint16_t TranspositionTable::packMove(const Move& move) {
+    if (move.isNone()) return 0;
+    return static_cast<uint16_t>(move.getFrom() | move.getTo() << 6 | move.getFlags() << 12);
+}
+
+Move TranspositionTable::unpackMove(const ChessBitboard& board, uint16_t packed) {
+    if (packed == 0) return Move();
+    Square from = packed & 63;
+    Piece::Type type = board.getPieceAt(from).type();
+    if (type == Piece::Type::NONE) return Move();
+    return Move(from, (packed >> 6) & 63, type, static_cast<uint8_t>(packed >> 12));
+}
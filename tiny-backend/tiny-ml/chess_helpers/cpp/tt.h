@@ -0,0 +1,52 @@
+// tt.h
+#pragma once
+#include "bitboard.h"
+#include <cstdint>
+#include <vector>
+
+// Transposition table for the alpha-beta search. One 16-byte entry per slot, indexed by
+// the low bits of the Zobrist hash and verified against the full key. An entry is
+// replaced by results from a newer search or from an equal or deeper one.
+class TranspositionTable {
+public:
+    enum Bound : uint8_t { NONE, UPPER, LOWER, EXACT };
+
+    struct Entry {
+        uint64_t key;
+        int16_t score;
+        uint16_t move;  // from | to << 6 | flags << 12, 0 = none
+        uint8_t depth;
+        uint8_t bound;
+        uint8_t generation;
+        uint8_t padding;
+    };
+    static_assert(sizeof(Entry) == 16, "entries are packed four to a cache line");
+
+    explicit TranspositionTable(size_t megabytes = 16) { resize(megabytes); }
+
+    // Reallocate (rounded down to a power of two entries) and clear
+    void resize(size_t megabytes);
+    void clear();
+    // Entries of older searches become preferred victims
+    void newSearch() { generation++; }
+
+    // The entry stored for `key`, or nullptr
+    const Entry* probe(uint64_t key) const {
+        const Entry& entry = table[key & mask];
+        return entry.key == key && entry.bound != NONE ? &entry : nullptr;
+    }
+    void store(uint64_t key, int depth, int score, Bound bound, const Move& move);
+
+    // Per mille of a sample of slots written by the current search (UCI hashfull)
+    int hashfull() const;
+    size_t bytes() const { return table.size() * sizeof(Entry); }
+
+    static uint16_t packMove(const Move& move);
+    // Rebuilds a packed move on `board`; the result still has to be checked with isPseudoLegal
+    static Move unpackMove(const ChessBitboard& board, uint16_t packed);
+
+private:
+    std::vector<Entry> table;
+    uint64_t mask = 0;
+    uint8_t generation = 0;
+};
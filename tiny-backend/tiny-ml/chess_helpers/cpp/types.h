@@ -2,7 +2,7 @@
 #pragma once
 #include <cstdint>
 
-using U64 = uint64_t;
+using U64 = unsigned long long; // same type as the U64 typedef in magicmoves.h
 using Square = int;
 using Bitboard = uint64_t;
 
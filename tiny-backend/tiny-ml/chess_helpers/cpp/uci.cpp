@@ -0,0 +1,427 @@
+// uci.cpp
+// Standalone UCI front end (chess_engine_uci, see build.sh) for GUIs and tournament
+// managers such as cutechess-cli. Plays with the alpha-beta Search, or native MCTS once
+// UseMCTS is set; with OwnBook and a BookFile, book moves are played without searching.
+// Commands are read on the main thread; each "go" runs on a worker that "stop",
+// "ponderhit" and the time limits end.
+#include "bitboard.h"
+#include "book.h"
+#include "mcts.h"
+#include "nnue.h"
+#include "search.h"
+#include "tablebase.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+constexpr const char* ENGINE_NAME = "tiny-chess";
+constexpr const char* START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+// Tree memory per MCTS simulation (nodes and edges, measured), used to keep it within Hash
+constexpr size_t MCTS_BYTES_PER_SIMULATION = 200;
+
+std::string squareName(Square square) {
+    return {static_cast<char>('a' + square % 8), static_cast<char>('1' + square / 8)};
+}
+
+std::string moveName(const Move& move) {
+    if (move.isNone()) return "0000";
+    std::string name = squareName(move.getFrom()) + squareName(move.getTo());
+    switch (move.getPromotionType()) {
+        case Piece::Type::QUEEN:  return name + 'q';
+        case Piece::Type::ROOK:   return name + 'r';
+        case Piece::Type::BISHOP: return name + 'b';
+        case Piece::Type::KNIGHT: return name + 'n';
+        default:                  return name;
+    }
+}
+
+std::string scoreText(int score) {
+    if (score >= Search::MATE_SCORE - Search::MAX_PLY) return "mate " + std::to_string((Search::MATE_SCORE - score + 1) / 2);
+    if (score <= -Search::MATE_SCORE + Search::MAX_PLY) return "mate -" + std::to_string((Search::MATE_SCORE + score) / 2);
+    return "cp " + std::to_string(score);
+}
+
+// MCTS values are expected results in [-1, 1]; GUIs want centipawns
+int valueToCentipawns(float value) {
+    double q = std::clamp(static_cast<double>(value), -0.99, 0.99);
+    return static_cast<int>(std::lround(111.714640912 * std::tan(1.5620688421 * q)));
+}
+
+class UciEngine {
+public:
+    UciEngine();
+    ~UciEngine() { stopSearch(); }
+    void loop(std::istream& in);
+
+private:
+    std::mutex output_mutex;
+    ChessBitboard board;     // position for the next "go"
+    ChessBitboard previous;  // the one before it, which the MCTS network also sees
+    bool has_previous = false;
+    std::vector<uint64_t> game_hashes;  // every position before `board`, for repetition detection
+
+    Search search;
+    NNUE::Network nnue;
+    std::unique_ptr<Evaluator> evaluator;
+    std::unique_ptr<MCTS> mcts;
+    MCTSConfig mcts_config;
+    std::string weights_file;
+    std::unique_ptr<Tablebase> tablebase;
+    int tb_probe_depth = 1;
+    int tb_probe_limit = Tablebase::MAX_PIECES;
+    std::unique_ptr<OpeningBook> book;
+    bool own_book = false;
+    std::mt19937_64 book_rng{std::random_device{}()};
+    size_t hash_mb = 16;
+    int64_t move_overhead_ms = 30;
+    bool use_mcts = false;
+
+    // Search state, guarded by state_mutex
+    std::thread worker;
+    std::thread timer;        // ends a search after ponderhit
+    std::mutex state_mutex;
+    std::condition_variable state_changed;
+    bool search_done = true;
+    bool hold = false;        // keep bestmove back until stop/ponderhit (go infinite, go ponder)
+    bool pondering = false;
+    SearchLimits ponder_limits;  // the clock to switch to on ponderhit
+
+    void say(const std::string& line);
+    void setOption(std::istringstream& in);
+    void position(std::istringstream& in);
+    void go(std::istringstream& in);
+    void ponderhit();
+    void stopSearch();
+    // Stop the running search, repeating until it has returned (a stop that arrives before
+    // the search has started would otherwise be lost)
+    void haltUntilDone(std::unique_lock<std::mutex>& lock);
+    MCTS& treeSearch();
+    void think(ChessBitboard root, ChessBitboard before, bool has_before, std::vector<uint64_t> history,
+               SearchLimits limits, int depth);
+};
+
+UciEngine::UciEngine() {
+    board.setStartingPosition();
+    mcts_config.dirichlet_epsilon = 0.0f;
+    mcts_config.early_stop = true;
+    search.setIterationCallback([this](const SearchResult& result) {
+        std::string line = "info depth " + std::to_string(result.depth) + " score " + scoreText(result.score) +
+                           " nodes " + std::to_string(result.nodes) +
+                           " nps " + std::to_string(result.nodes * 1000 / std::max<int64_t>(1, result.time_ms)) +
+                           " time " + std::to_string(result.time_ms) + " hashfull " + std::to_string(search.hashfull()) +
+                           (tablebase ? " tbhits " + std::to_string(result.tb_hits) : "") + " pv";
+        for (const Move& move : result.pv) line += " " + moveName(move);
+        say(line);
+    });
+}
+
+void UciEngine::say(const std::string& line) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    std::cout << line << std::endl;
+}
+
+void UciEngine::loop(std::istream& in) {
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream tokens(line);
+        std::string command;
+        tokens >> command;
+        if (command == "uci") {
+            say(std::string("id name ") + ENGINE_NAME);
+            say("id author tiny-chess developers");
+            say("option name Hash type spin default 16 min 1 max 65536");
+            say("option name Threads type spin default 1 min 1 max 256");
+            say("option name MoveOverhead type spin default 30 min 0 max 5000");
+            say("option name Ponder type check default false");
+            say("option name UseMCTS type check default false");
+            say("option name EvalFile type string default <empty>");
+            say("option name WeightsFile type string default <empty>");
+            say("option name SyzygyPath type string default <empty>");
+            say("option name SyzygyProbeDepth type spin default 1 min 1 max 100");
+            say("option name SyzygyProbeLimit type spin default 7 min 0 max 7");
+            say("option name OwnBook type check default false");
+            say("option name BookFile type string default <empty>");
+            say("uciok");
+        } else if (command == "isready") {
+            say("readyok");
+        } else if (command == "setoption") {
+            setOption(tokens);
+        } else if (command == "ucinewgame") {
+            stopSearch();
+            search.clear();
+            if (mcts) mcts->reset();
+        } else if (command == "position") {
+            position(tokens);
+        } else if (command == "go") {
+            go(tokens);
+        } else if (command == "stop") {
+            stopSearch();
+        } else if (command == "ponderhit") {
+            ponderhit();
+        } else if (command == "quit") {
+            break;
+        }
+    }
+}
+
+void UciEngine::setOption(std::istringstream& in) {
+    std::string token, name, value;
+    in >> token;  // "name"
+    while (in >> token && token != "value") name += (name.empty() ? "" : " ") + token;
+    std::getline(in >> std::ws, value);
+
+    stopSearch();
+    try {
+        if (name == "Hash") {
+            hash_mb = std::max(1, std::stoi(value));
+            search.setHashSize(hash_mb);
+        } else if (name == "Threads") {
+            // The alpha-beta search is single threaded; threads go to MCTS
+            mcts_config.threads = std::max(1, std::stoi(value));
+            mcts.reset();
+        } else if (name == "MoveOverhead") {
+            move_overhead_ms = std::max(0, std::stoi(value));
+        } else if (name == "UseMCTS") {
+            use_mcts = value == "true";
+        } else if (name == "EvalFile") {
+            if (value.empty() || value == "<empty>") {
+                search.setNetwork(nullptr);
+            } else {
+                nnue.load(value);
+                search.setNetwork(&nnue);
+            }
+        } else if (name == "WeightsFile") {
+            weights_file = value == "<empty>" ? "" : value;
+            mcts.reset();
+            evaluator.reset();
+        } else if (name == "SyzygyPath") {
+            std::unique_ptr<Tablebase> next;
+            if (!value.empty() && value != "<empty>") {
+                next = std::make_unique<Tablebase>(value);
+                next->setProbeLimit(tb_probe_limit);
+                say("info string found " + std::to_string(next->numTables()) + " tablebases, up to " +
+                    std::to_string(next->maxPieces()) + " pieces");
+            }
+            search.setTablebase(next.get(), tb_probe_depth);
+            if (mcts) mcts->setTablebase(next.get());
+            tablebase = std::move(next);
+        } else if (name == "SyzygyProbeDepth") {
+            tb_probe_depth = std::max(1, std::stoi(value));
+            search.setTablebase(tablebase.get(), tb_probe_depth);
+        } else if (name == "SyzygyProbeLimit") {
+            tb_probe_limit = std::clamp(std::stoi(value), 0, Tablebase::MAX_PIECES);
+            if (tablebase) tablebase->setProbeLimit(tb_probe_limit);
+        } else if (name == "OwnBook") {
+            own_book = value == "true";
+        } else if (name == "BookFile") {
+            book.reset();
+            if (!value.empty() && value != "<empty>") {
+                book = std::make_unique<OpeningBook>(value);
+                say("info string book " + value + " with " + std::to_string(book->size()) + " entries");
+            }
+        }
+    } catch (const std::exception& e) {
+        say(std::string("info string ") + name + ": " + e.what());
+        if (name == "EvalFile") search.setNetwork(nullptr);
+    }
+}
+
+void UciEngine::position(std::istringstream& in) {
+    std::string token, fen;
+    in >> token;
+    if (token == "startpos") {
+        fen = START_FEN;
+        in >> token;  // "moves", if any
+    } else if (token == "fen") {
+        while (in >> token && token != "moves") fen += (fen.empty() ? "" : " ") + token;
+    } else {
+        return;
+    }
+    if (!board.tryLoadFen(fen)) {
+        say("info string invalid FEN " + fen);
+        return;
+    }
+    has_previous = false;
+    game_hashes.clear();
+    while (in >> token) {
+        Move played;
+        for (const Move& move : board.generateLegalMoves()) {
+            if (moveName(move) == token) played = move;
+        }
+        if (played.isNone()) {
+            say("info string illegal move " + token);
+            break;
+        }
+        previous = board;
+        has_previous = true;
+        game_hashes.push_back(board.hash);
+        board.makeMove(played);
+    }
+}
+
+void UciEngine::go(std::istringstream& in) {
+    stopSearch();
+    SearchLimits limits;
+    limits.move_overhead_ms = move_overhead_ms;
+    int depth = Search::MAX_PLY - 1;
+    bool infinite = false, ponder = false;
+    std::string token;
+    int64_t value;
+    while (in >> token) {
+        if (token == "infinite") {
+            infinite = true;
+        } else if (token == "ponder") {
+            ponder = true;
+        } else if (in >> value) {
+            if (token == (board.white_to_move ? "wtime" : "btime")) limits.time_left_ms = value;
+            if (token == (board.white_to_move ? "winc" : "binc")) limits.increment_ms = value;
+            if (token == "movestogo") limits.moves_to_go = static_cast<int>(value);
+            if (token == "movetime") limits.movetime_ms = value;
+            if (token == "nodes") limits.nodes = static_cast<uint64_t>(value);
+            if (token == "depth") depth = static_cast<int>(value);
+        }
+    }
+
+    // Book moves are played at once; pondering and analysis always search
+    if (own_book && book && !infinite && !ponder) {
+        Move book_move = book->pick(board, book_rng);
+        if (!book_move.isNone()) {
+            say("bestmove " + moveName(book_move));
+            return;
+        }
+    }
+
+    SearchLimits search_limits = limits;
+    if (infinite || ponder) {
+        // The clock only starts on ponderhit
+        search_limits.movetime_ms = 0;
+        search_limits.time_left_ms = 0;
+    }
+    // Created here so haltUntilDone() never races with its construction
+    if (use_mcts) treeSearch();
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        search_done = false;
+        hold = infinite || ponder;
+        pondering = ponder;
+        ponder_limits = limits;
+    }
+    worker = std::thread(&UciEngine::think, this, board, previous, has_previous, game_hashes, search_limits, depth);
+}
+
+void UciEngine::ponderhit() {
+    std::unique_lock<std::mutex> lock(state_mutex);
+    if (!pondering) return;
+    pondering = false;
+    hold = false;
+    state_changed.notify_all();
+    if (search_done || !ponder_limits.timed()) return;
+
+    TimeManager time;
+    time.start(ponder_limits);
+    std::chrono::milliseconds budget(time.optimumMs());
+    timer = std::thread([this, budget] {
+        std::unique_lock<std::mutex> lock(state_mutex);
+        if (!state_changed.wait_for(lock, budget, [this] { return search_done; })) haltUntilDone(lock);
+    });
+}
+
+void UciEngine::haltUntilDone(std::unique_lock<std::mutex>& lock) {
+    while (!search_done) {
+        if (use_mcts) {
+            mcts->stop();
+        } else {
+            search.stop();
+        }
+        state_changed.wait_for(lock, std::chrono::milliseconds(5));
+    }
+}
+
+void UciEngine::stopSearch() {
+    if (!worker.joinable()) return;
+    {
+        std::unique_lock<std::mutex> lock(state_mutex);
+        hold = false;
+        pondering = false;
+        haltUntilDone(lock);
+        state_changed.notify_all();
+    }
+    worker.join();
+    if (timer.joinable()) timer.join();
+}
+
+MCTS& UciEngine::treeSearch() {
+    if (!evaluator) {
+        evaluator = std::make_unique<HandcraftedEvaluator>();
+        if (!weights_file.empty()) {
+            try {
+                evaluator = std::make_unique<NetworkEvaluator>(weights_file);
+            } catch (const std::exception& e) {
+                say(std::string("info string WeightsFile: ") + e.what() + ", using the hand-crafted evaluation");
+            }
+        }
+    }
+    if (!mcts) {
+        mcts = std::make_unique<MCTS>(*evaluator, mcts_config);
+        mcts->setTablebase(tablebase.get());
+    }
+    return *mcts;
+}
+
+void UciEngine::think(ChessBitboard root, ChessBitboard before, bool has_before, std::vector<uint64_t> history,
+                      SearchLimits limits, int depth) {
+    Move best, ponder_move;
+    try {
+        if (use_mcts) {
+            size_t cap = (hash_mb << 20) / MCTS_BYTES_PER_SIMULATION;
+            limits.nodes = limits.nodes ? std::min<uint64_t>(limits.nodes, cap) : cap;
+            auto start = std::chrono::steady_clock::now();
+            MCTSResult result = mcts->search(root, has_before ? &before : nullptr, limits);
+            int64_t time_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+            // Only the simulations this search ran: visits reused from the last tree are not its work
+            uint64_t simulations = result.simulations;
+            uint64_t nps = time_us > 0 ? simulations * 1000000 / static_cast<uint64_t>(time_us) : 0;
+            MCTSMemory memory = mcts->memoryUsage();
+            int hashfull = static_cast<int>(std::min<size_t>(1000, (memory.node_bytes + memory.edge_bytes) * 1000 / (hash_mb << 20)));
+            best = result.best_move;
+            say("info depth " + std::to_string(result.depth) + " score cp " + std::to_string(valueToCentipawns(result.value)) +
+                " nodes " + std::to_string(simulations) + " nps " + std::to_string(nps) +
+                " time " + std::to_string(time_us / 1000) + " hashfull " + std::to_string(hashfull) + " pv " + moveName(best));
+        } else {
+            search.setGameHistory(std::move(history));
+            SearchResult result = search.run(root, limits, depth);
+            best = result.best_move;
+            if (result.pv.size() > 1) ponder_move = result.pv[1];
+        }
+    } catch (const std::exception& e) {
+        say(std::string("info string search failed: ") + e.what());
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(state_mutex);
+        search_done = true;
+        state_changed.notify_all();
+        state_changed.wait(lock, [this] { return !hold; });
+    }
+    say("bestmove " + moveName(best) + (ponder_move.isNone() ? "" : " ponder " + moveName(ponder_move)));
+}
+
+}
+
+int main() {
+    std::ios::sync_with_stdio(false);
+    UciEngine engine;
+    engine.loop(std::cin);
+    return 0;
+}
@@ -0,0 +1,30 @@
+#include "zobrist.h"
+
+namespace Zobrist {
+
+namespace {
+
+constexpr uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+constexpr Keys makeKeys() {
+    Keys keys{};
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+    for (auto& piece : keys.piece_square)
+        for (uint64_t& key : piece) key = splitmix64(state);
+    for (uint64_t& key : keys.castling) key = splitmix64(state);
+    for (uint64_t& key : keys.en_passant_file) key = splitmix64(state);
+    keys.side = splitmix64(state);
+    return keys;
+}
+
+} // namespace
+
+// Built at compile time, so boards constructed during static initialisation can use it
+constexpr Keys KEYS = makeKeys();
+
+} // namespace Zobrist
@@ -0,0 +1,19 @@
+// zobrist.h
+#pragma once
+#include <cstdint>
+
+// Random keys for Zobrist hashing. ChessBitboard::hash is the XOR of the keys of every
+// piece on its square, the castling rights, the en passant file (only when a pawn of the
+// side to move can actually capture there) and SIDE when black is to move.
+namespace Zobrist {
+
+struct Keys {
+    uint64_t piece_square[16][64];  // indexed by Piece::raw()
+    uint64_t castling[16];
+    uint64_t en_passant_file[8];
+    uint64_t side;
+};
+
+extern const Keys KEYS;
+
+} // namespace Zobrist
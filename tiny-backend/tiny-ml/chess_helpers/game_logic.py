@@ -61,6 +61,19 @@ def history_to_tensor(history: list, color: bool) -> Tensor:
     
     return Tensor(planes).unsqueeze(0)
 
+def classical_evaluate(board, legal_moves, value_scale=400.0, prior_temperature=100.0):
+    """
+    Stand-in for ChessNet.predict before a network checkpoint exists, built on the C++
+    hand-crafted evaluation. Priors are a softmax over each move's static exchange score
+    (with a small bonus for checks); the value squashes the evaluation into [-1, 1] from
+    the side to move's perspective, like the network's tanh value head.
+    """
+    scores = np.array([board.see(m) + (50 if board.gives_check(m) else 0) for m in legal_moves], dtype=np.float32)
+    priors = np.exp((scores - scores.max()) / prior_temperature) if len(scores) else scores
+    priors = priors / priors.sum() if len(priors) else priors
+    value = float(np.tanh(board.evaluate() / value_scale))
+    return priors, value
+
 def move_to_policy_index(move):
     """Convert chess move to policy vector index following AlphaZero encoding"""
     from_square = move.get_from()
@@ -0,0 +1,62 @@
+"""
+Export a float HalfKP network to the quantized .nnue file read by the C++ engine
+(chess_helpers/cpp/nnue.h), using the Stockfish 12 HalfKP 256x2-32-32-1 layout.
+
+Expected float tensors (any dict of name -> array, e.g. a tinygrad safetensors state dict):
+    ft.weight   [41024, 256]  feature transformer, input activations clipped to [0, 1]
+    ft.bias     [256]
+    l1.weight   [32, 512]     l1.bias [32]   hidden layers, outputs clipped to [0, 1]
+    l2.weight   [32, 32]      l2.bias [32]
+    out.weight  [1, 32]       out.bias [1]   output in units of NNUE_TO_CP centipawns
+
+Usage: python -m chess_helpers.nnue_export models/halfkp.safetensors models/halfkp.nnue
+"""
+import struct
+import sys
+import numpy as np
+
+FILE_VERSION = 0x7AF32F16
+INPUT_DIMS, HALF_DIMS, L1_DIMS, L2_DIMS = 41024, 256, 32, 32
+ACTIVATION_SCALE = 127   # clipped activations [0, 1] -> [0, 127]
+WEIGHT_SCALE = 64        # hidden weights, undone by the >> 6 in the engine
+FV_SCALE = 16            # engine output units per centipawn
+NNUE_TO_CP = 600         # one unit of the float output in centipawns
+
+def _quantize(array, scale, dtype):
+    info = np.iinfo(dtype)
+    return np.clip(np.round(np.asarray(array, dtype=np.float64) * scale), info.min, info.max).astype(dtype)
+
+def export_nnue(weights, path, description="exported from tiny-ml"):
+    """Quantize float weights and write them as a HalfKP .nnue file."""
+    shapes = {
+        "ft.weight": (INPUT_DIMS, HALF_DIMS), "ft.bias": (HALF_DIMS,),
+        "l1.weight": (L1_DIMS, 2 * HALF_DIMS), "l1.bias": (L1_DIMS,),
+        "l2.weight": (L2_DIMS, L1_DIMS), "l2.bias": (L2_DIMS,),
+        "out.weight": (1, L2_DIMS), "out.bias": (1,),
+    }
+    for name, shape in shapes.items():
+        if name not in weights or tuple(np.shape(weights[name])) != shape:
+            raise ValueError(f"{name} must have shape {shape}")
+
+    out_scale = NNUE_TO_CP * FV_SCALE
+    desc = description.encode("utf-8")
+    with open(path, "wb") as f:
+        f.write(struct.pack("<III", FILE_VERSION, 0, len(desc)))
+        f.write(desc)
+        # Feature transformer
+        f.write(struct.pack("<I", 0))
+        f.write(_quantize(weights["ft.bias"], ACTIVATION_SCALE, np.int16).astype("<i2").tobytes())
+        f.write(_quantize(weights["ft.weight"], ACTIVATION_SCALE, np.int16).astype("<i2").tobytes())
+        # Dense layers, row-major [out][in]
+        f.write(struct.pack("<I", 0))
+        for layer in ("l1", "l2"):
+            f.write(_quantize(weights[f"{layer}.bias"], ACTIVATION_SCALE * WEIGHT_SCALE, np.int32).astype("<i4").tobytes())
+            f.write(_quantize(weights[f"{layer}.weight"], WEIGHT_SCALE, np.int8).tobytes())
+        f.write(_quantize(weights["out.bias"], out_scale, np.int32).astype("<i4").tobytes())
+        f.write(_quantize(weights["out.weight"], out_scale / ACTIVATION_SCALE, np.int8).tobytes())
+
+if __name__ == "__main__":
+    from tinygrad.nn.state import safe_load
+    state = {name: tensor.numpy() for name, tensor in safe_load(sys.argv[1]).items()}
+    export_nnue(state, sys.argv[2])
+    print(f"Wrote {sys.argv[2]}")
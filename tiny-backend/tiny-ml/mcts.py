@@ -1,11 +1,12 @@
 from dataclasses import dataclass, field
 import math
 import copy
+import time
 import numpy as np
 from typing import Any, Dict, List, Optional, Tuple
 from chess_helpers.cpp import chess_engine
 from model import ChessNet
-from chess_helpers.game_logic import is_game_over, get_game_result, board_to_tensor, move_to_policy_index, get_legal_moves, get_board_planes, history_to_tensor
+from chess_helpers.game_logic import is_game_over, get_game_result, board_to_tensor, move_to_policy_index, get_legal_moves, get_board_planes, history_to_tensor, classical_evaluate
 
 @dataclass
 class MCTSNode:
@@ -19,6 +20,7 @@ class MCTSNode:
     parent: 'MCTSNode' = None
     children: list = field(default_factory=list)
     prior: float = 0.0
+    noised: bool = False # Dirichlet noise already mixed into the children's priors
 
     def is_leaf_node(self):
         """
@@ -81,16 +83,45 @@ def mcts_traditional(model, start_state, num_simulations=100, exploration_consta
 
 
 
-def mcts_alphazero(model, start_state, initial_board_planes, num_simulations=100, exploration_constant=1.41, dirichlet_alpha=0.3, dirichlet_epsilon=0.25):
+def mcts_alphazero(model, start_state, initial_board_planes, num_simulations=100, exploration_constant=1.41, dirichlet_alpha=0.3, dirichlet_epsilon=0.25,
+                   time_budget_ms=None, early_stop=False, stop_event=None, cache=None):
     """
     AlphaZero MCTS implementation:
     - Expands ALL children at once when first visiting a leaf
     - Uses neural network policy to set prior probabilities
     - No traditional rollout - just neural network value
+    - With model=None the C++ hand-crafted evaluation provides priors and values instead,
+      so self-play can start before a network checkpoint exists
+    - start_state may be a subtree kept from the previous move (see find_subtree); its
+      statistics are kept and root noise is mixed in once
+    - Stops before num_simulations once time_budget_ms has passed, stop_event is set, or
+      (with early_stop) the most visited move can no longer be overtaken
+    - With a chess_engine.EvalCache, network results below the root are looked up by
+      position and previous position first and stored after a miss, so positions seen
+      again in this or later searches skip the network
     """
+
+    if start_state.children and not start_state.noised and dirichlet_epsilon > 0:
+        noise = np.random.dirichlet([dirichlet_alpha] * len(start_state.children))
+        for child, n in zip(start_state.children, noise):
+            child.prior = (1 - dirichlet_epsilon) * child.prior + dirichlet_epsilon * n
+    start_state.noised = True
     
+    start_time = time.perf_counter()
     # Main MCTS loop
-    for _ in range(num_simulations):
+    for simulation in range(num_simulations):
+        if stop_event is not None and stop_event.is_set():
+            break
+        elapsed_ms = (time.perf_counter() - start_time) * 1000
+        if time_budget_ms is not None and elapsed_ms >= time_budget_ms:
+            break
+        if early_stop and simulation % 16 == 0 and simulation > 0:
+            remaining = num_simulations - simulation
+            if time_budget_ms is not None and elapsed_ms > 0:
+                remaining = min(remaining, simulation * (time_budget_ms - elapsed_ms) / elapsed_ms)
+            if root_settled(start_state, remaining):
+                break
+
         current = start_state
         path = [current]
         
@@ -106,17 +137,34 @@ def mcts_alphazero(model, start_state, initial_board_planes, num_simulations=100
             # Terminal position
             value = get_game_result(current.board) or 0.0
         elif not current.children:
-            if current == start_state:
-                leaf_history = initial_board_planes
-            else:
-                current_planes = get_board_planes(current.board)
-                parent_planes = get_board_planes(current.parent.board)
-                leaf_history = [current_planes, parent_planes]
+            legal_moves = get_legal_moves(current.board)
 
-            leaf_tensor = history_to_tensor(leaf_history, current.board.white_to_move)
-            policy, value = model.predict(leaf_tensor)
+            if model is None:
+                classical_priors, value = classical_evaluate(current.board, legal_moves)
+            else:
+                # The root's history comes from the game rather than its parent, so it is not cached
+                cacheable = cache is not None and current != start_state
+                cached = cache.lookup(current.board, current.parent.board, len(legal_moves)) if cacheable else None
+                if cached is not None:
+                    network_priors, value = cached
+                else:
+                    if current == start_state:
+                        leaf_history = initial_board_planes
+                    else:
+                        current_planes = get_board_planes(current.board)
+                        parent_planes = get_board_planes(current.parent.board)
+                        leaf_history = [current_planes, parent_planes]
 
-            legal_moves = get_legal_moves(current.board)
+                    leaf_tensor = history_to_tensor(leaf_history, current.board.white_to_move)
+                    policy, value = model.predict(leaf_tensor)
+                    policy = policy.numpy()
+                    network_priors = [float(policy[0, idx]) if idx < policy.shape[1] else 0.01
+                                      for idx in (move_to_policy_index(move) for move in legal_moves)]
+                    if cacheable:
+                        cache.insert(current.board, current.parent.board, network_priors, value)
+                        # As the cache hands them back: renormalized over the legal moves
+                        total = sum(network_priors)
+                        network_priors = [p / total for p in network_priors] if total > 0 else network_priors
             
             # Add Dirichlet Noise for exploration at the root
             if current.parent is None:
@@ -127,8 +175,7 @@ def mcts_alphazero(model, start_state, initial_board_planes, num_simulations=100
                 new_board.make_move(move)
                 
                 # Get prior probability from neural network policy
-                move_idx = move_to_policy_index(move)
-                prior = policy[0, move_idx].item() if move_idx < policy.shape[1] else 0.01
+                prior = float(classical_priors[i]) if model is None else network_priors[i]
 
                 # Apply noise at the root
                 if current.parent is None:
@@ -159,6 +206,34 @@ def mcts_alphazero(model, start_state, initial_board_planes, num_simulations=100
     return None
 
 
+def root_settled(root, remaining):
+    """
+    True when no other move can overtake the most visited one in `remaining` more
+    simulations (always, once there is only one legal move).
+    """
+    if len(root.children) == 1:
+        return True
+    visits = sorted((child.visit_count for child in root.children), reverse=True)
+    return len(visits) > 1 and visits[0] - visits[1] > remaining
+
+
+def find_subtree(root, board, max_depth=2):
+    """
+    Find the node holding `board` among `root` and its descendants up to max_depth plies
+    (2 covers "we moved, then the opponent replied"), so the next search continues from
+    the visits already spent there. The node is detached from its parent, which leaves
+    its siblings to the garbage collector. Returns None if the position is not in the tree.
+    """
+    frontier = [root] if root is not None else []
+    for _ in range(max_depth + 1):
+        for node in frontier:
+            if node.board.same_position(board):
+                node.parent = None
+                return node
+        frontier = [child for node in frontier for child in node.children]
+    return None
+
+
 def ucb(node, exploration_constant):
     """
     Standard Upper Confidence Bound (UCT) calculation for node selection.
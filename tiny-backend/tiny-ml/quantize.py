@@ -0,0 +1,84 @@
+"""
+Post-training int8 quantization report for the native ChessNet.
+
+Calibrates chess_engine.QuantizedChessNet on positions from the self-play replay buffer,
+then compares it against the fp32 network on held-out positions (policy top-1 agreement,
+value MAE) and measures throughput of both at a few batch sizes.
+
+    python quantize.py                  # CALIBRATION=512 EVAL=1024 BATCHES=1,8,32
+
+Positions come from the shared replay buffer train.py fills (REPLAY=path, the same default),
+or from its replay_buffer.ckpt when no buffer is running.
+"""
+import os
+import shutil
+import sys
+import tempfile
+import time
+
+import numpy as np
+from tinygrad.helpers import getenv
+
+sys.path.append(os.path.join(os.path.dirname(__file__), '..'))
+from chess_helpers.cpp import chess_engine
+
+CHECKPOINT_PATH = "models/chess_net_checkpoint.safetensors"
+REPLAY_CHECKPOINT_PATH = "replay_buffer.ckpt"
+
+def replay_planes(replay_buffer, count):
+    """Up to count distinct positions of the replay buffer in random order, as one [n, 25, 8, 8] array."""
+    planes, _, _, slots, _ = replay_buffer.sample(2 * min(count, len(replay_buffer)))
+    _, first = np.unique(slots, return_index=True)
+    return planes[np.sort(first)][:count]
+
+def load_planes(count):
+    """Positions of the running replay buffer, else of the newest records of its checkpoint."""
+    replay_path = getenv("REPLAY", "/dev/shm/chess_replay.bin")
+    if os.path.exists(replay_path):
+        replay_buffer = chess_engine.ReplayBuffer(replay_path, seed=0)
+        if len(replay_buffer) > 0:
+            return replay_planes(replay_buffer, count), replay_path
+    if not os.path.exists(REPLAY_CHECKPOINT_PATH):
+        sys.exit(f"No replay buffer at {replay_path} and no {REPLAY_CHECKPOINT_PATH}; run train.py first")
+    with tempfile.TemporaryDirectory() as directory:
+        # restore() continues the checkpoint it reads from, so read a copy and leave the trainer's alone
+        checkpoint = shutil.copy(REPLAY_CHECKPOINT_PATH, directory)
+        replay_buffer = chess_engine.ReplayBuffer(os.path.join(directory, "replay.bin"), 4 * count, seed=0)
+        if replay_buffer.restore(checkpoint) == 0:
+            sys.exit(f"{REPLAY_CHECKPOINT_PATH} is empty")
+        return replay_planes(replay_buffer, count), REPLAY_CHECKPOINT_PATH
+
+def throughput(net, planes, batch_size, seconds=2.0):
+    """Positions per second for forward passes of batch_size positions."""
+    batch = planes[:batch_size]
+    net.forward(batch)
+    runs, start = 0, time.perf_counter()
+    while time.perf_counter() - start < seconds:
+        net.forward(batch)
+        runs += 1
+    return runs * batch_size / (time.perf_counter() - start)
+
+if __name__ == "__main__":
+    calibration_size = getenv("CALIBRATION", 512)
+    eval_size = getenv("EVAL", 1024)
+    batch_sizes = [int(b) for b in getenv("BATCHES", "1,8,32").split(",")]
+
+    planes, source = load_planes(calibration_size + eval_size)
+    calibration, held_out = planes[:calibration_size], planes[calibration_size:]
+    if len(calibration) == 0 or len(held_out) == 0:
+        sys.exit(f"Need more than {calibration_size} positions in {source}")
+
+    net = chess_engine.NativeChessNet(CHECKPOINT_PATH)
+    quantized = chess_engine.QuantizedChessNet(net, calibration)
+
+    report = chess_engine.compare_quantized(net, quantized, held_out)
+    print(f"int8 vs fp32 on {report.positions} held-out positions "
+          f"(calibrated on {len(calibration)}):")
+    print(f"  policy top-1 agreement: {report.policy_top1_agreement:.2%}")
+    print(f"  value MAE:              {report.value_mae:.4f} (max {report.value_max_error:.4f})")
+
+    print(f"{'batch':>6} {'fp32 pos/s':>12} {'int8 pos/s':>12} {'speedup':>8}")
+    for batch_size in batch_sizes:
+        fp32 = throughput(net, held_out, batch_size)
+        int8 = throughput(quantized, held_out, batch_size)
+        print(f"{batch_size:>6} {fp32:>12.1f} {int8:>12.1f} {int8 / fp32:>7.2f}x")
@@ -5,9 +5,7 @@ sys.path.append(os.path.join(os.path.dirname(__file__), '..'))
 import numpy as np
 import time
 import random
-from collections import deque
 from typing import List, Tuple
-import pickle
 
 import wandb
 from tinygrad.tensor import Tensor
@@ -20,7 +18,7 @@ from tinygrad.dtype import dtypes
 from model import ChessNet
 from mcts import mcts_alphazero, MCTSNode
 from chess_helpers.cpp import chess_engine
-from chess_helpers.game_logic import get_board_planes, history_to_tensor, move_to_policy_index
+from chess_helpers.game_logic import get_board_planes, move_to_policy_index
 
 Tensor.training=True
 
@@ -43,14 +41,19 @@ def create_policy_vector(root: MCTSNode, temperature: float) -> np.ndarray:
     return policy_vector
 
 @TinyJit
-def train_step(optimizer: Optimizer, model: ChessNet, board_tensors: Tensor, target_policies: Tensor, target_values: Tensor) -> Tuple[Tensor, Tensor]:
+def train_step(optimizer: Optimizer, model: ChessNet, board_tensors: Tensor, target_policies: Tensor, target_values: Tensor,
+               weights: Tensor) -> Tuple[Tensor, Tensor, Tensor]:
     """
     JIT-compiled training step for max performance.
+    Samples are weighted by their importance-sampling weights (all 1 without prioritized
+    replay); also returns each sample's loss for its new priority.
     """
     predicted_policies, predicted_values = model(board_tensors)
 
-    value_loss = (predicted_values - target_values).square().mean()
-    policy_loss = -(target_policies * predicted_policies.log_softmax()).sum() / len(board_tensors)
+    value_errors = (predicted_values - target_values).square()
+    policy_errors = -(target_policies * predicted_policies.log_softmax()).sum(axis=1, keepdim=True)
+    value_loss = (value_errors * weights).mean()
+    policy_loss = (policy_errors * weights).sum() / len(board_tensors)
     
     loss = value_loss + policy_loss
     
@@ -58,7 +61,7 @@ def train_step(optimizer: Optimizer, model: ChessNet, board_tensors: Tensor, tar
     loss.backward()
     optimizer.step()
     
-    return value_loss.realize(), policy_loss.realize()
+    return value_loss.realize(), policy_loss.realize(), (value_errors + policy_errors).detach().realize()
 
 
 if __name__ == "__main__":
@@ -74,7 +77,28 @@ if __name__ == "__main__":
         "temperature_initial": 1.0,
         "temperature_final": 0.1,
         "temperature_decay_half_life": 30, 
-        "replay_buffer_size": 50000
+        "replay_buffer_size": 50000,
+        # Sample the replay buffer in proportion to loss^alpha, correcting with importance
+        # weights (size * P)^-beta
+        "prioritized_replay": True,
+        "priority_alpha": 0.6,
+        "priority_beta": 0.4,
+        # With BOOK=book.bin each self-play game starts from up to this many weighted-random
+        # book moves, so games do not all replay the same opening
+        "book_plies": 8,
+        # With SHARDS=dir self-play positions are written as training shards of this many
+        # samples and batches are decoded from them in the background
+        "shard_samples": 16384,
+        # ...each turned round (colours exchanged) and, without castling rights, mirrored
+        # at random by the loader
+        "augment_flip": True,
+        "augment_mirror": True,
+        # Network results shared by the self-play games of an epoch (cleared when the
+        # weights change), so repeated openings and transpositions skip the network
+        "eval_cache_mb": 256,
+        # Without a checkpoint, the first epochs of self-play use the C++ hand-crafted
+        # evaluation instead of the untrained network
+        "classical_warmup_epochs": 1
     }
 
     if getenv("WANDB"):
@@ -85,47 +109,85 @@ if __name__ == "__main__":
     model = ChessNet(dtype=dtypes.half)
     optimizer = Adam(get_parameters(model), lr=config["learning_rate"])
     os.makedirs("models", exist_ok=True)
-    if os.path.exists("models/chess_net_checkpoint.safetensors"):
+    checkpoint_loaded = os.path.exists("models/chess_net_checkpoint.safetensors")
+    if checkpoint_loaded:
         model.load_state_dict(safe_load("models/chess_net_checkpoint.safetensors"))
         print("Loaded model weights from models/chess_net_checkpoint.safetensors")
 
     print("--- Running in Training Mode ---")
     
-    # Load replay buffer if it exists
-    replay_buffer_path = "replay_buffer.pkl"
-    if os.path.exists(replay_buffer_path):
-        with open(replay_buffer_path, 'rb') as f:
-            replay_buffer = pickle.load(f)
-        print(f"Loaded replay buffer with {len(replay_buffer)} experiences.")
+    # ROLE=selfplay only plays games into the replay buffer and ROLE=train only trains from
+    # it, so any number of self-play processes can feed one trainer; the default does both
+    role = getenv("ROLE", "both")
+    selfplay, training = role in ("both", "selfplay"), role in ("both", "train")
+    # The replay buffer is a ring in shared memory (REPLAY=path) that every process of a run
+    # opens; the trainer appends what was added since the last epoch to replay_buffer.ckpt
+    replay_buffer = chess_engine.ReplayBuffer(getenv("REPLAY", "/dev/shm/chess_replay.bin"),
+                                              config["replay_buffer_size"], alpha=config["priority_alpha"])
+    replay_checkpoint_path = "replay_buffer.ckpt"
+    if training and len(replay_buffer) == 0 and os.path.exists(replay_checkpoint_path):
+        print(f"Restored {replay_buffer.restore(replay_checkpoint_path)} experiences from {replay_checkpoint_path}")
     else:
-        replay_buffer = deque(maxlen=config["replay_buffer_size"])
-        print("No existing replay buffer found. Starting a new one.")
+        print(f"Replay buffer {replay_buffer.path} holds {len(replay_buffer)} experiences.")
+
+    # BOOK=path picks the self-play openings; BOOK_OUT=path writes a book of every game
+    # played in this run (rewritten each epoch) for later runs or the servers
+    opening_book = chess_engine.OpeningBook(getenv("BOOK", "")) if getenv("BOOK", "") else None
+    book_builder = chess_engine.OpeningBookBuilder() if getenv("BOOK_OUT", "") else None
+    # SHARDS=dir trains from every shard in dir (earlier runs' included) through the native
+    # loader instead of sampling the replay buffer
+    shard_dir = getenv("SHARDS", "")
+    shard_writer = chess_engine.ShardWriter(shard_dir, samples_per_shard=config["shard_samples"],
+                                            shuffle_window=config["replay_buffer_size"]) if shard_dir else None
+
+    eval_cache = chess_engine.EvalCache(config["eval_cache_mb"] << 20) if config["eval_cache_mb"] else None
 
     start_time = time.time()
 
     for epoch in range(config["epochs"]):
         print(f"\n--- Epoch {epoch+1}/{config['epochs']} ---")
+        warmup = not checkpoint_loaded and epoch < config["classical_warmup_epochs"]
+        if warmup and selfplay: print("Self-play guided by the hand-crafted evaluation (warm-up)")
+        if role == "selfplay" and os.path.exists("models/chess_net_checkpoint.safetensors"):
+            # Play with the trainer's latest weights
+            model.load_state_dict(safe_load("models/chess_net_checkpoint.safetensors"))
+        if eval_cache is not None: eval_cache.clear()
         
         # self-play
-        for game_num in range(config["games_per_epoch"]):
-            game_history_for_replay = []
+        for game_num in range(config["games_per_epoch"] if selfplay else 0):
+            game_policies = []
             board_plane_history = []
             board = chess_engine.ChessBitboard()
             board.set_starting_position()
+            start_board = chess_engine.ChessBitboard()
+            start_board.set_starting_position()
+            game_moves = []
+            while opening_book is not None and len(game_moves) < config["book_plies"]:
+                book_move = opening_book.pick(board)
+                if book_move is None: break
+                board.make_move(book_move)
+                game_moves.append(book_move)
+            selfplay_start = chess_engine.ChessBitboard()
+            selfplay_start.load_fen(board.to_fen())
+            book_moves = len(game_moves)
             move_count = 0
+            root_node = None
             
             while True:
                 board_plane_history.append(get_board_planes(board))
                 
-                root_node = MCTSNode(board=board)
+                # Continue from the subtree searched under the move just played
+                if root_node is None:
+                    root_node = MCTSNode(board=board)
                 
                 best_child_node = mcts_alphazero(
-                    model,
+                    None if warmup else model,
                     root_node, 
                     list(board_plane_history),
                     num_simulations=config["mcts_simulations"],
                     dirichlet_alpha=config["dirichlet_alpha"],
-                    dirichlet_epsilon=config["dirichlet_epsilon"]
+                    dirichlet_epsilon=config["dirichlet_epsilon"],
+                    cache=eval_cache
                 )
     
                 if best_child_node is None: break
@@ -135,47 +197,78 @@ if __name__ == "__main__":
 
                 policy = create_policy_vector(root_node, temp)
 
-                game_history_for_replay.append([list(board_plane_history), board.white_to_move, policy, 0.0])
+                game_policies.append(policy)
                 board.make_move(best_child_node.move)
+                game_moves.append(best_child_node.move)
                 best_child_node.parent = None
+                root_node = best_child_node
 
                 move_count += 1
                 if board.is_game_over(): break
             
             result = board.get_result()
-            for i in range(len(game_history_for_replay)):
-                game_history_for_replay[i][3] = result if (i % 2) == (len(game_history_for_replay) % 2) else -result
-            replay_buffer.extend(game_history_for_replay)
+            if game_policies:
+                replay_buffer.add_game(selfplay_start, game_moves[book_moves:], result, np.stack(game_policies))
+            if book_builder is not None:
+                book_builder.add_game(start_board, game_moves, result)
+            if shard_writer is not None and game_policies:
+                shard_writer.add_game(selfplay_start, game_moves[book_moves:], result, np.stack(game_policies))
             print(f"  Game {game_num + 1}/{config['games_per_epoch']} finished. Result: {result}, Moves: {move_count}. Replay buffer size: {len(replay_buffer)}")
 
         print(f"Epoch {epoch+1}: Self-play finished. Replay buffer size: {len(replay_buffer)}")
-        
-        # Save the replay buffer after the self-play phase
-        with open(replay_buffer_path, 'wb') as f:
-            pickle.dump(replay_buffer, f)
-        print(f"Replay buffer with {len(replay_buffer)} experiences saved to {replay_buffer_path}")
+        if eval_cache is not None and selfplay and not warmup:
+            cache_stats = eval_cache.stats()
+            print(f"Evaluation cache: {cache_stats.hit_rate:.1%} hits, {cache_stats.entries} positions")
+            if getenv("WANDB"):
+                wandb.log({"selfplay/cache_hit_rate": cache_stats.hit_rate})
+        if book_builder is not None:
+            entries = book_builder.write(getenv("BOOK_OUT", ""))
+            print(f"Opening book with {entries} moves from {book_builder.positions} positions saved to {getenv('BOOK_OUT', '')}")
+        if not training: continue
 
+        # Checkpoint the replay buffer after the self-play phase
+        written = replay_buffer.checkpoint(replay_checkpoint_path)
+        print(f"{written} new experiences saved to {replay_checkpoint_path}")
+
+
+        shard_loader = None
+        if shard_writer is not None:
+            shard_writer.flush()
+            shard_paths = chess_engine.ShardWriter.list(shard_dir)
+            if shard_paths:
+                shard_loader = chess_engine.ShardLoader(shard_paths, batch_size=config["batch_size"], seed=epoch,
+                                                        flip=config["augment_flip"], mirror=config["augment_mirror"])
+            print(f"{shard_writer.samples} positions written to {len(shard_paths)} shards in {shard_dir}")
+        if role == "train":
+            # Wait for the self-play processes to fill a batch
+            while len(replay_buffer) < config["batch_size"]: time.sleep(1)
+        training_samples = len(replay_buffer) if shard_writer is None else (shard_loader.samples if shard_loader else 0)
 
         # Training 
-        if len(replay_buffer) < config["batch_size"]:
+        if training_samples < config["batch_size"]:
             print("Not enough data in replay buffer. Skipping training for this epoch.")
             continue
 
         print("Training on collected data...")
-        num_batches = len(replay_buffer) // config["batch_size"]
+        num_batches = training_samples // config["batch_size"]
         for i in range(num_batches):
-            batch_indices = np.random.choice(len(replay_buffer), size=config["batch_size"], replace=False)
-            
-            batch_histories = [replay_buffer[i][0] for i in batch_indices]
-            batch_colors = [replay_buffer[i][1] for i in batch_indices]
-            batch_target_policies = np.array([replay_buffer[i][2] for i in batch_indices])
-            batch_target_values = np.array([replay_buffer[i][3] for i in batch_indices]).reshape(-1, 1)
-
-            board_tensors = Tensor.cat(*[history_to_tensor(hist, col) for hist, col in zip(batch_histories, batch_colors)], dim=0)
+            batch_slots = None
+            if shard_loader is not None:
+                # Decoded ahead of time on the loader's threads
+                batch_planes, batch_target_policies, batch_target_values = next(shard_loader)
+                batch_weights = np.ones((len(batch_planes), 1), dtype=np.float32)
+            else:
+                batch_planes, batch_target_policies, batch_target_values, batch_slots, batch_weights = replay_buffer.sample(
+                    config["batch_size"], prioritized=config["prioritized_replay"], beta=config["priority_beta"],
+                    flip=config["augment_flip"], mirror=config["augment_mirror"])
+            board_tensors = Tensor(batch_planes)
             target_policies = Tensor(batch_target_policies, dtype=dtypes.half)
             target_values = Tensor(batch_target_values, dtype=dtypes.half)
+            weights = Tensor(batch_weights, dtype=dtypes.half)
 
-            value_loss, policy_loss = train_step(optimizer, model, board_tensors, target_policies, target_values)
+            value_loss, policy_loss, sample_losses = train_step(optimizer, model, board_tensors, target_policies, target_values, weights)
+            if batch_slots is not None and config["prioritized_replay"]:
+                replay_buffer.update_priorities(batch_slots.tolist(), sample_losses.numpy().reshape(-1).tolist())
             
             if (i + 1) % 10 == 0:
                 print(f"  Batch {i+1}/{num_batches}: Value Loss = {value_loss.item():.4f}, Policy Loss = {policy_loss.item():.4f}")